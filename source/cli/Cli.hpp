@@ -18,6 +18,10 @@
 // --cull_invalid
 // --recompute_normals off
 // --fuse_vertices on
+// Textures
+// --cmpr_quality fast/normal/high
+// Mesh optimization
+// --stripify_budget_ms 0
 //
 using bool32 = uint32_t;
 
@@ -66,6 +70,15 @@ struct CliOptions {
   bool32 no_tristrip = false;
   bool32 ai_json = false;
   bool32 verbose = false;
+
+  // SZS
+  uint32_t szs_algo = 2; // librii::szs::Algo
+  uint32_t jobs = 0;     // 0 = one per core
+
+  // Import
+  bool32 no_cache = false;
+  uint32_t cmpr_quality = 1; // librii::image::CmprQuality
+  uint32_t stripify_budget_ms = 0; // 0 = no limit
 };
 
 std::optional<CliOptions> parse(int argc, const char** argv);
@@ -12,6 +12,8 @@
 #include <plugins/g3d/collection.hpp>
 #include <plugins/j3d/J3dIo.hpp>
 #include <plugins/rhst/RHSTImporter.hpp>
+#include <rsl/ParallelFor.hpp>
+#include <rsl/Timer.hpp>
 #include <sstream>
 
 namespace riistudio {
@@ -70,6 +72,12 @@ static auto GetMips(const CliOptions& opt)
   };
 }
 
+static auto GetCmprQuality(const CliOptions& opt)
+    -> librii::image::CmprQuality {
+  return static_cast<librii::image::CmprQuality>(
+      std::min<u32>(opt.cmpr_quality, 2));
+}
+
 class ImportBRRES {
 public:
   ImportBRRES(const CliOptions& opt) : m_opt(opt) {}
@@ -121,7 +129,10 @@ public:
     auto m_result = std::make_unique<riistudio::g3d::Collection>();
     bool ok = riistudio::rhst::CompileRHST(*tree, *m_result, m_from.string(),
                                            info, progress, GetMips(m_opt),
-                                           !m_opt.no_tristrip, m_opt.verbose);
+                                           !m_opt.no_tristrip, m_opt.verbose,
+                                           m_opt.jobs, !m_opt.no_cache,
+                                           GetCmprQuality(m_opt),
+                                           m_opt.stripify_budget_ms);
     if (!ok) {
       return std::unexpected("Failed to parse RHST");
     }
@@ -311,19 +322,26 @@ public:
       return false;
     }
 
-    fmt::print(stderr,
-               "Compressing SZS: {} => {} (Boyer-Moore-Horspool strategy)\n",
-               m_from.string(), m_to.string());
-    std::vector<u8> buf(file->size() * 2);
-    int size = librii::szs::encodeBoyerMooreHorspool(file->data(), buf.data(),
-                                                     file->size());
-    if (size < 0 || size > buf.size()) {
-      fmt::print(stderr, "Error: Failed to compress file\n");
+    auto algo = static_cast<librii::szs::Algo>(m_opt.szs_algo);
+    fmt::print(stderr, "Compressing SZS: {} => {} ({} strategy)\n",
+               m_from.string(), m_to.string(), magic_enum::enum_name(algo));
+    rsl::Timer timer;
+    auto buf = librii::szs::encodeAlgo(*file, algo, m_opt.jobs);
+    if (!buf) {
+      fmt::print(stderr, "Error: Failed to compress file: {}\n", buf.error());
       return false;
     }
-    buf.resize(roundUp(size, 32));
+    if (m_opt.verbose) {
+      const u32 ms = std::max(timer.elapsed(), 1u);
+      fmt::print(stderr,
+                 "Compressed {} => {} bytes ({:.1f}%) in {} ms ({:.2f} MB/s)\n",
+                 file->size(), buf->size(),
+                 100.0 * buf->size() / std::max<size_t>(file->size(), 1), ms,
+                 file->size() / 1000.0 / ms);
+    }
+    buf->resize(roundUp(buf->size(), 32));
 
-    plate::Platform::writeFile(buf, m_to.string());
+    plate::Platform::writeFile(*buf, m_to.string());
     return true;
   }
 
@@ -400,7 +418,10 @@ public:
     auto m_result = std::make_unique<T>();
     bool ok = riistudio::rhst::CompileRHST(*tree, *m_result, m_from.string(),
                                            info, progress, GetMips(m_opt),
-                                           !m_opt.no_tristrip, m_opt.verbose);
+                                           !m_opt.no_tristrip, m_opt.verbose,
+                                           m_opt.jobs, !m_opt.no_cache,
+                                           GetCmprQuality(m_opt),
+                                           m_opt.stripify_budget_ms);
     if (!ok) {
       return std::unexpected("Failed to compile RHST");
     }
@@ -447,40 +468,73 @@ public:
     if (!parseArgs()) {
       return std::unexpected("Error: failed to parse args");
     }
-    auto file = ReadFile(m_opt.from.view());
-    if (!file.has_value()) {
-      return std::unexpected("Error: Failed to read file");
+    if (std::filesystem::is_directory(m_from)) {
+      return extractFolder();
     }
-
-    // Max 4GB
-    u32 size = TRY(librii::szs::getExpandedSize(*file));
-    std::vector<u8> buf(size);
-    TRY(librii::szs::decode(buf, *file));
-
     fmt::print(stderr, "Extracting ARC.SZS,{} => {}\n", m_from.string(),
                m_to.string());
 
-    auto arc = TRY(librii::U8::LoadU8Archive(buf));
-    TRY(librii::U8::Extract(arc, m_to));
+    auto arc = TRY(librii::U8::ArchiveView::open(m_from));
+    TRY(librii::U8::Extract(arc, m_to, m_opt.jobs));
 
     return {};
   }
 
 private:
+  // Batch mode: extract every .szs/.arc in |m_from| into |m_to|/<name>.d.
+  // Parallelism is across archives, each archive is extracted serially.
+  Result<void> extractFolder() {
+    std::vector<std::filesystem::path> paths;
+    for (auto& entry : std::filesystem::directory_iterator(m_from)) {
+      auto ext = entry.path().extension();
+      if (entry.is_regular_file() && (ext == ".szs" || ext == ".arc")) {
+        paths.push_back(entry.path());
+      }
+    }
+    std::ranges::sort(paths);
+    std::vector<Result<void>> results(paths.size());
+    std::mutex print_mutex;
+    rsl::ParallelFor(paths.size(), m_opt.jobs, [&](size_t i) {
+      auto to = m_to / paths[i].filename();
+      to.replace_extension(".d");
+      {
+        std::unique_lock g(print_mutex);
+        fmt::print(stderr, "Extracting ARC.SZS,{} => {}\n", paths[i].string(),
+                   to.string());
+      }
+      results[i] = [&]() -> Result<void> {
+        auto arc = TRY(librii::U8::ArchiveView::open(paths[i]));
+        return librii::U8::Extract(arc, to, 1);
+      }();
+    });
+    for (size_t i = 0; i < paths.size(); ++i) {
+      if (!results[i]) {
+        return std::unexpected(
+            std::format("{}: {}", paths[i].string(), results[i].error()));
+      }
+    }
+    return {};
+  }
+
   bool parseArgs() {
     m_from = m_opt.from.view();
     m_to = m_opt.to.view();
 
     if (m_to.empty()) {
-      std::filesystem::path p = m_from;
-      p.replace_extension(".szs");
-      m_to = p;
+      if (std::filesystem::is_directory(m_from)) {
+        m_to = m_from;
+      } else {
+        std::filesystem::path p = m_from;
+        p.replace_extension(".d");
+        m_to = p;
+      }
     }
     if (!std::filesystem::exists(m_from)) {
       fmt::print(stderr, "Error: File {} does not exist.\n", m_from.string());
       return false;
     }
-    if (std::filesystem::exists(m_to)) {
+    if (std::filesystem::exists(m_to) &&
+        !std::filesystem::is_directory(m_from)) {
       fmt::print(stderr,
                  "Warning: File {} will be overwritten by this operation.\n",
                  m_to.string());
@@ -510,18 +564,13 @@ public:
     fmt::print(stderr, "Creating ARC.SZS,{} => {}\n", m_from.string(),
                std::filesystem::absolute(m_to).string());
 
-    auto arc = TRY(librii::U8::Create(m_from));
+    auto arc = TRY(librii::U8::Create(m_from, m_opt.jobs));
     auto buf = librii::U8::SaveU8Archive(arc);
-    std::vector<u8> szs(librii::szs::getWorstEncodingSize(buf));
-    fmt::print(stderr,
-               "Compressing SZS: {} => {} (Boyer-Moore-Horspool strategy)\n",
-               m_from.string(), m_to.string());
-    int sz = librii::szs::encodeBoyerMooreHorspool(buf.data(), szs.data(),
-                                                   buf.size());
-    if (sz <= 0 || sz > szs.size()) {
-      return std::unexpected("SZS encoding failed");
-    }
-    szs.resize(roundUp(sz, 32));
+    auto algo = static_cast<librii::szs::Algo>(m_opt.szs_algo);
+    fmt::print(stderr, "Compressing SZS: {} => {} ({} strategy)\n",
+               m_from.string(), m_to.string(), magic_enum::enum_name(algo));
+    auto szs = TRY(librii::szs::encodeAlgo(buf, algo, m_opt.jobs));
+    szs.resize(roundUp(szs.size(), 32));
 
     plate::Platform::writeFile(szs, m_to.string());
 
@@ -535,7 +584,7 @@ private:
 
     if (m_to.empty()) {
       std::filesystem::path p = m_from;
-      p.replace_extension(".d");
+      p.replace_extension(".szs");
       m_to = p;
     }
     if (!std::filesystem::exists(m_from)) {
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <core/common.h>
+#include <functional>
 #include <librii/gfx/PixelOcclusion.hpp>
 #include <string>
 #include <vector>
@@ -67,6 +68,22 @@ struct Texture : public virtual kpi::IObject, public GenerationIDTracked {
   }
   virtual u32 getEncodedSize(bool mip) const = 0;
   virtual Result<void> decode(std::vector<u8>& out, bool mip) const = 0;
+  //! @brief Capture what decode() needs, so that the returned function may
+  //! run on another thread while this texture is edited. By default, the
+  //! texture is decoded up front.
+  //!
+  virtual std::function<Result<std::vector<u8>>()>
+  makeDecoder(bool mip) const {
+    std::vector<u8> out;
+    auto ok = decode(out, mip);
+    out.resize(getDecodedSize(mip));
+    return [ok, out = std::move(out)]() -> Result<std::vector<u8>> {
+      if (!ok) {
+        return std::unexpected(ok.error());
+      }
+      return out;
+    };
+  }
 
   virtual u32 getImageCount() const = 0;
   virtual void setImageCount(u32 c) = 0;
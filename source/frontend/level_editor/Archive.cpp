@@ -6,31 +6,16 @@
 IMPORT_STD;
 
 Result<Archive> ReadArchive(std::span<const u8> buf) {
-  auto expanded = librii::szs::getExpandedSize(buf);
-  if (!expanded) {
-    rsl::error("Failed to grab expanded size");
+  auto view = librii::U8::ArchiveView::fromBuffer(buf);
+  if (!view) {
+    rsl::error("Failed to read archive: {}", view.error());
     return std::unexpected("Invalid .szs file");
   }
-
-  std::vector<u8> decoded(*expanded);
-  auto err = librii::szs::decode(decoded, buf);
-  if (!err) {
-    rsl::error("Failed to decode SZS");
-    return std::unexpected("Invalid .szs file");
-  }
-
-  if (decoded.size() < 4 || decoded[0] != 0x55 || decoded[1] != 0xaa ||
-      decoded[2] != 0x38 || decoded[3] != 0x2d) {
-    rsl::error("Not a valid archive");
-    return std::unexpected("Not a U8 archive");
+  if (auto ok = view->wait(); !ok) {
+    rsl::error("Failed to read archive: {}", ok.error());
+    return std::unexpected("Invalid .szs/U8 archive");
   }
-
-  auto tarc = librii::U8::LoadU8Archive(decoded);
-  if (!tarc) {
-    rsl::error("Failed to read archive");
-    return std::unexpected("Invalid U8 archive");
-  }
-  auto arc = *tarc;
+  const auto nodes = view->nodes();
 
   Archive n_arc;
 
@@ -40,12 +25,12 @@ Result<Archive> ReadArchive(std::span<const u8> buf) {
   };
   std::vector<Pair> n_path;
 
-  assert(arc.nodes.size());
+  assert(nodes.size());
 
   n_path.push_back(
-      Pair{.folder = &n_arc, .sibling_next = arc.nodes[0].folder.sibling_next});
-  for (int i = 1; i < arc.nodes.size(); ++i) {
-    auto& node = arc.nodes[i];
+      Pair{.folder = &n_arc, .sibling_next = nodes[0].folder.sibling_next});
+  for (u32 i = 1; i < nodes.size(); ++i) {
+    auto& node = nodes[i];
 
     while (!n_path.empty() && i == n_path.back().sibling_next)
       n_path.resize(n_path.size() - 1);
@@ -57,12 +42,9 @@ Result<Archive> ReadArchive(std::span<const u8> buf) {
       auto& parent = n_path[n_path.size() - 2];
       parent.folder->folders.emplace(node.name, std::move(tmp));
     } else {
-      const u32 start_pos = node.file.offset;
-      const u32 end_pos = node.file.offset + node.file.size;
-      assert(node.file.offset + node.file.size <= arc.file_data.size());
-      std::vector<u8> vec(arc.file_data.data() + start_pos,
-                          arc.file_data.data() + end_pos);
-      n_path.back().folder->files.emplace(node.name, std::move(vec));
+      auto data = view->fileData(node);
+      n_path.back().folder->files.emplace(
+          node.name, std::vector<u8>(data.begin(), data.end()));
     }
 
     while (!n_path.empty() && i + 1 == n_path.back().sibling_next)
@@ -85,11 +67,13 @@ static void ProcessArcs(const Archive* arc, std::string_view name,
                         librii::U8::U8Archive& u8) {
   const auto node_index = u8.nodes.size();
 
-  librii::U8::U8Archive::Node node{.is_folder = true,
-                                   .name = std::string(name)};
   // Since we write folders first, the parent will always be behind us
-  node.folder.parent = u8.nodes.size() - 1;
-  node.folder.sibling_next = 0; // Filled in later
+  librii::U8::U8Archive::Node node{
+      .is_folder = true,
+      .name = std::string(name),
+      .folder = {.parent = static_cast<u32>(u8.nodes.size() - 1),
+                 .sibling_next = 0}, // Filled in later
+  };
   u8.nodes.push_back(node);
 
   for (auto& data : arc->folders) {
@@ -98,11 +82,13 @@ static void ProcessArcs(const Archive* arc, std::string_view name,
 
   for (auto& [n, f] : arc->files) {
     {
-      librii::U8::U8Archive::Node node{.is_folder = false,
-                                       .name = std::string(n)};
-      node.file.offset =
-          u8.file_data.size(); // Note: relative->abs translation handled later
-      node.file.size = f.size();
+      librii::U8::U8Archive::Node node{
+          .is_folder = false,
+          .name = std::string(n),
+          // Note: relative->abs translation handled later
+          .file = {.offset = static_cast<u32>(u8.file_data.size()),
+                   .size = static_cast<u32>(f.size())},
+      };
       u8.nodes.push_back(node);
       u8.file_data.insert(u8.file_data.end(), f.begin(), f.end());
     }
@@ -123,7 +109,8 @@ std::vector<u8> WriteArchive(const Archive& arc) {
   return szs_buf;
 }
 
-std::optional<std::vector<u8>> FindFile(const Archive& arc, std::string path) {
+std::optional<std::span<const u8>> FindFile(const Archive& arc,
+                                           std::string path) {
   std::filesystem::path _path = path;
   _path = _path.lexically_normal();
 
@@ -154,8 +141,7 @@ FindFileWithOverloads(const Archive& arc, std::vector<std::string> paths) {
   for (auto& path : paths) {
     auto found = FindFile(arc, path);
     if (found.has_value()) {
-      return ResolveQuery{.file_data = std::move(*found),
-                          .resolved_path = path};
+      return ResolveQuery{.file_data = *found, .resolved_path = path};
     }
   }
 
@@ -24,10 +24,12 @@ FindFile(arc, "pictures/dogs/1.png");
 
 return arc.folders.find("pictures")?.folders.find("dogs")?.files.find("1.png");
 */
-std::optional<std::vector<u8>> FindFile(const Archive& arc, std::string path);
+//! The returned span is invalidated by any modification of |arc|
+std::optional<std::span<const u8>> FindFile(const Archive& arc,
+                                           std::string path);
 
 struct ResolveQuery {
-  std::vector<u8> file_data;
+  std::span<const u8> file_data;
   std::string resolved_path;
 };
 
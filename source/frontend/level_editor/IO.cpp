@@ -29,7 +29,7 @@ struct SimpleTransaction {
   kpi::LightIOTransaction trans;
 };
 
-Result<std::unique_ptr<g3d::Collection>> ReadBRRES(const std::vector<u8>& buf,
+Result<std::unique_ptr<g3d::Collection>> ReadBRRES(std::span<const u8> buf,
                                                    std::string path,
                                                    NeedResave need_resave) {
   auto result = std::make_unique<g3d::Collection>();
@@ -50,7 +50,7 @@ Result<std::unique_ptr<g3d::Collection>> ReadBRRES(const std::vector<u8>& buf,
 }
 
 Result<std::unique_ptr<librii::kmp::CourseMap>>
-ReadKMP(const std::vector<u8>& buf, std::string path) {
+ReadKMP(std::span<const u8> buf, std::string path) {
   auto map = TRY(librii::kmp::readKMP(buf));
   return std::make_unique<librii::kmp::CourseMap>(map);
 }
@@ -64,7 +64,7 @@ std::vector<u8> WriteKMP(const librii::kmp::CourseMap& map) {
 }
 
 Result<std::unique_ptr<librii::kcol::KCollisionData>>
-ReadKCL(const std::vector<u8>& buf, std::string path) {
+ReadKCL(std::span<const u8> buf, std::string path) {
   auto result = std::make_unique<librii::kcol::KCollisionData>();
 
   auto res = librii::kcol::ReadKCollisionData(*result, buf, buf.size());
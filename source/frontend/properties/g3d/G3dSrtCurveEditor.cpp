@@ -37,7 +37,6 @@ const float EditView_ZoomFactorAutoScrollDeltaFactor = 0.2;
 const float MouseDragThreshold = 5;
 
 using namespace librii::g3d;
-using librii::math::hermite;
 using librii::math::map;
 
 namespace riistudio::g3d {
@@ -720,25 +719,7 @@ float CurveEditor::sample_curve(GuiFrameContext& c,
                                 float frame) {
   assert(!track->empty());
 
-  auto left = track->at(0);
-  auto right = left;
-
-  if (frame < left.frame)
-    return left.value + (frame - left.frame) * left.tangent;
-
-  for (int i = 1; i < track->size(); i++) {
-    right = track->at(i);
-
-    if (frame < left.frame || frame > right.frame) {
-      left = right;
-      continue;
-    }
-
-    return hermite(frame, left.frame, left.value, left.tangent, right.frame,
-                   right.value, right.tangent);
-  }
-
-  return right.value + (frame - right.frame) * right.tangent;
+  return librii::math::KeyframeSampler::sampleOnce(*track, frame);
 }
 
 void CurveEditor::draw(GuiFrameContext& c, bool is_widget_hovered,
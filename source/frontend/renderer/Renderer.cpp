@@ -5,6 +5,7 @@
 #include <core/3d/gl.hpp>    // glPolygonMode
 #include <frontend/root.hpp> // RootWindow
 #include <imcxx/Widgets.hpp>
+#include <librii/glhelper/ShaderCache.hpp>
 #include <librii/glhelper/Util.hpp> // librii::glhelper::SetGlWireframe
 
 namespace riistudio::frontend {
@@ -34,6 +35,16 @@ void RenderSettings::drawMenuBar(bool draw_controller, bool draw_wireframe) {
       ImGui::Checkbox("Render Scene?"_j, &rend);
       if (draw_wireframe && librii::glhelper::IsGlWireframeSupported())
         ImGui::Checkbox("Wireframe Mode"_j, &wireframe);
+      {
+        const auto stats = librii::glhelper::ShaderCache::get().stats();
+        util::ConditionalActive a(false);
+        ImGui::Separator();
+        ImGui::Text("Shader programs: %u", stats.programs);
+        ImGui::Text("Shared by materials: %u hits, %u misses", stats.hits,
+                    stats.misses);
+        ImGui::Text("Read from disk: %u sources, %u binaries",
+                    stats.diskSources, stats.diskBinaries);
+      }
       ImGui::EndMenu();
     }
 
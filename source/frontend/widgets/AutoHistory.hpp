@@ -1,34 +1,26 @@
 #pragma once
 
 #include <core/common.h>
-#include <vector>
+#include <rsl/SnapshotHistory.hpp>
 
 namespace riistudio::lvl {
 
-template <typename T>
-inline void CommitHistory(size_t& cursor, std::vector<T>& chain) {
-  chain.resize(cursor + 1);
-  cursor++;
-}
-
-template <typename T>
-inline void UndoHistory(size_t& cursor, std::vector<T>& chain) {
-  if (cursor <= 0)
-    return;
-  --cursor;
-}
-
-template <typename T>
-inline void RedoHistory(size_t& cursor, std::vector<T>& chain) {
-  if (cursor + 1 >= chain.size())
-    return;
-  ++cursor;
-}
-
+//! Undo/redo for an editor that edits |T| in place through ImGui widgets.
+//!
+//! Edits are detected by comparing the document against the current state,
+//! but only on frames with user input (and every so often, in case of edits
+//! made otherwise). An edit is committed once the mouse is released.
 template <typename T> struct AutoHistory {
-  std::vector<T> mKmpHistory;
-  size_t history_cursor = 0;
+  rsl::SnapshotHistory<T> mHistory;
   bool commit_posted = false;
+  //! Frames left to compare for after the last input.
+  int scan_frames = 0;
+  //! Frames until the next comparison without input.
+  int idle_frames = 0;
+
+  //! Edits may land a frame after the input that caused them.
+  static constexpr int ScanFramesAfterInput = 2;
+  static constexpr int IdleScanInterval = 60;
 
   enum class RestoreStatus { AlreadyValid, Reverted };
   RestoreStatus restoreInvalidState(T& kmp) {
@@ -38,7 +30,7 @@ template <typename T> struct AutoHistory {
     // KMP has entered an invalid state, likely a NaN
     // attempt to restore it
 
-    if (mKmpHistory.empty()) {
+    if (mHistory.empty()) {
       // There's nothing we can do. Initial state is invalid
       assert(!"KMP read from disc is invalid");
 
@@ -47,7 +39,7 @@ template <typename T> struct AutoHistory {
     }
 
     // Revert it
-    kmp = mKmpHistory.back();
+    mHistory.restore(kmp);
 
     rsl::debug("Restored KMP to backup state\n");
 
@@ -56,37 +48,74 @@ template <typename T> struct AutoHistory {
     return RestoreStatus::Reverted;
   }
 
-  void update(T& kmp) {
-    if (mKmpHistory.empty()) {
-      assert(kmp == kmp && "Initial state is invalid");
-      mKmpHistory.push_back(kmp);
-      return;
-	}
+  static bool hasInput() {
+    const auto& io = ImGui::GetIO();
+    if (ImGui::IsAnyItemActive() || ImGui::IsAnyMouseDown() ||
+        !io.InputQueueCharacters.empty()) {
+      return true;
+    }
+    for (bool released : io.MouseReleased) {
+      if (released)
+        return true;
+    }
+    for (int k = ImGuiKey_NamedKey_BEGIN; k < ImGuiKey_NamedKey_END; ++k) {
+      if (ImGui::IsKeyDown(static_cast<ImGuiKey>(k)))
+        return true;
+    }
+    return false;
+  }
 
+  //! Record the document if it changed. Only a valid (NaN-free) document is
+  //! committed; an invalid one is reverted.
+  bool commitIfChanged(T& kmp) {
+    commit_posted = false;
+    if (!mHistory.differs(kmp))
+      return false;
     if (restoreInvalidState(kmp) != RestoreStatus::AlreadyValid)
+      return false;
+    mHistory.commit(kmp);
+    return true;
+  }
+
+  void update(T& kmp) {
+    if (mHistory.empty()) {
+      assert(kmp == kmp && "Initial state is invalid");
+      mHistory.reset(kmp);
       return;
+    }
 
-    assert(kmp == kmp && "Kmp is in an invalid state");
+    if (hasInput()) {
+      scan_frames = ScanFramesAfterInput;
+    }
+    const bool scan = scan_frames > 0 || --idle_frames <= 0;
+    if (scan) {
+      scan_frames = std::max(scan_frames - 1, 0);
+      idle_frames = IdleScanInterval;
+    }
 
-    if (!commit_posted && kmp != mKmpHistory[history_cursor]) {
+    if (!commit_posted && scan && mHistory.differs(kmp)) {
+      // A NaN compares unequal to everything, so invalid states end up here
+      if (restoreInvalidState(kmp) != RestoreStatus::AlreadyValid)
+        return;
       commit_posted = true;
     }
 
     if (commit_posted && !ImGui::IsAnyMouseDown()) {
-      CommitHistory(history_cursor, mKmpHistory);
-      mKmpHistory.push_back(kmp);
-      assert(mKmpHistory.back() == kmp);
-      commit_posted = false;
+      commitIfChanged(kmp);
     }
 
     // TODO: Only affect active window
     if (ImGui::GetIO().KeyCtrl) {
-      if (ImGui::IsKeyPressed(ImGui::GetKeyIndex(ImGuiKey_Z))) {
-        UndoHistory(history_cursor, mKmpHistory);
-        kmp = mKmpHistory[history_cursor];
-      } else if (ImGui::IsKeyPressed(ImGui::GetKeyIndex(ImGuiKey_Y))) {
-        RedoHistory(history_cursor, mKmpHistory);
-        kmp = mKmpHistory[history_cursor];
+      const bool undo = ImGui::IsKeyPressed(ImGui::GetKeyIndex(ImGuiKey_Z));
+      const bool redo = ImGui::IsKeyPressed(ImGui::GetKeyIndex(ImGuiKey_Y));
+      if (undo || redo) {
+        // Pending edits (e.g. mid-drag) become a state of their own, so the
+        // document matches the current state before stepping
+        commitIfChanged(kmp);
+        if (undo)
+          mHistory.undo(kmp);
+        else
+          mHistory.redo(kmp);
       }
     }
   }
@@ -18,17 +18,23 @@ ImagePreview::~ImagePreview() {
 }
 
 void ImagePreview::setFromImage(const lib3d::Texture& tex) {
+  tex.decode(mDecodeBuf, true);
+  setFromImage(tex, mDecodeBuf);
+  mDecodeBuf.clear();
+}
+
+void ImagePreview::setFromImage(const lib3d::Texture& tex,
+                                std::span<const u8> decoded) {
 #ifdef RII_GL
   width = tex.getWidth();
   height = tex.getHeight();
   mNumMipMaps = tex.getMipmapCount();
   mLod = std::min(static_cast<u32>(mLod), mNumMipMaps);
-  tex.decode(mDecodeBuf, true);
 
   if (mTexUploaded) {
     glDeleteTextures(1, &mGpuTexId);
   }
-  if (mDecodeBuf.size() && width && height) {
+  if (decoded.size() && width && height) {
     glGenTextures(1, &mGpuTexId);
   } else {
     mTexUploaded = false;
@@ -49,10 +55,9 @@ void ImagePreview::setFromImage(const lib3d::Texture& tex) {
   for (u32 i = 0; i <= tex.getMipmapCount(); ++i) {
     glTexImage2D(GL_TEXTURE_2D, i, GL_RGBA, tex.getWidth() >> i,
                  tex.getHeight() >> i, 0, GL_RGBA, GL_UNSIGNED_BYTE,
-                 mDecodeBuf.data() + slide);
+                 decoded.data() + slide);
     slide += (tex.getWidth() >> i) * (tex.getHeight() >> i) * 4;
   }
-  mDecodeBuf.clear();
 #endif
 }
 
@@ -12,6 +12,9 @@ public:
   ImagePreview();
   ~ImagePreview();
   void setFromImage(const lib3d::Texture& tex);
+  //! As above, from every level of |tex| already decoded. An empty |decoded|
+  //! clears the preview.
+  void setFromImage(const lib3d::Texture& tex, std::span<const u8> decoded);
 
   void draw(float width = -1.0f, float height = -1.0f, bool mip_slider = true);
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <frontend/widgets/Image.hpp>
+#include <librii/glhelper/DecodedTextureCache.hpp>
 
 namespace riistudio::frontend {
 
@@ -17,11 +18,20 @@ struct Lib3dCachedImagePreview {
     return last_tex_uuid == tex.getGenerationId();
   }
 
+  // Until a new image is decoded in the background, the previous one is
+  // drawn.
   void draw(const riistudio::lib3d::Texture& tex, float width = -1.0f,
             float height = -1.0f, bool mip_slider = true) {
     if (!isHolding(tex)) {
-      mImg.setFromImage(tex);
-      last_tex_uuid = tex.getGenerationId();
+      auto image =
+          librii::glhelper::DecodedTextureCache::get().request(tex, true);
+      if (!image) {
+        mImg.setFromImage(tex, {});
+        last_tex_uuid = tex.getGenerationId();
+      } else if (*image != nullptr) {
+        mImg.setFromImage(tex, **image);
+        last_tex_uuid = tex.getGenerationId();
+      }
     }
     mImg.draw(width, height, mip_slider);
   }
@@ -25,7 +25,7 @@ using namespace riistudio;
 //
 
 struct Node {
-  ModelView model;
+  const ModelView& model;
   const lib3d::Bone& bone;
   const libcube::IGCMaterial& mat;
   const libcube::IndexedPolygon& poly;
@@ -47,30 +47,52 @@ struct MyDefTex : public librii::image::NullTexture<64, 64> {
 };
 static MyDefTex DefaultTex(NullCheckerboard);
 
+std::span<const glm::mat4>
+G3dSkeletonCache::get(int model_id,
+                      std::span<const libcube::IBoneDelegate* const> bones) {
+  if (model_id >= std::ssize(mModels)) {
+    mModels.resize(model_id + 1);
+  }
+  auto& entry = mModels[model_id];
+  bool dirty = entry.key.size() != bones.size();
+  entry.key.resize(bones.size());
+  for (size_t i = 0; i < bones.size(); ++i) {
+    const BoneKey key{.srt = bones[i]->getSRT(),
+                      .parent = bones[i]->getBoneParent(),
+                      .ssc = bones[i]->getSSC()};
+    if (entry.key[i] != key) {
+      entry.key[i] = key;
+      dirty = true;
+    }
+  }
+  if (dirty) {
+    struct Bones_ {
+      size_t size() const { return m.size(); }
+      const libcube::IBoneDelegate& operator[](size_t i) const {
+        return *m[i];
+      }
+      std::span<const libcube::IBoneDelegate* const> m;
+    };
+    entry.matrices =
+        calcSrtMtxAll(Bones_{bones}, librii::g3d::ScalingRule::Maya);
+  }
+  return entry.matrices;
+}
+
 Result<std::vector<glm::mat4>> getPosMtx(const libcube::IndexedPolygon& p,
-                                         ModelView model, u64 mpid) {
+                                         const ModelView& model, u64 mpid) {
   std::vector<glm::mat4> out;
 
   const auto& mp = p.getMeshData().mMatrixPrimitives[mpid];
 
-  struct Bones_ {
-    size_t size() const { return m.bones.size(); }
-    libcube::IBoneDelegate& operator[](size_t i) {
-      return const_cast<libcube::IBoneDelegate&>(*m.bones[i]);
-    }
-    ModelView m;
-  };
-  Bones_ bones{model};
-
   const auto handle_drw = [&](const libcube::DrawMatrix& drw) -> Result<void> {
     glm::mat4x4 curMtx(0.0f);
 
     // Rigid -- bone space
     if (drw.mWeights.size() == 1) {
       u32 boneID = drw.mWeights[0].boneId;
-      EXPECT(boneID < model.bones.size());
-      curMtx = calcSrtMtx(*model.bones[boneID], bones,
-                          librii::g3d::ScalingRule::Maya);
+      EXPECT(boneID < model.boneMatrices.size());
+      curMtx = model.boneMatrices[boneID];
     } else {
       // already world space
       curMtx = glm::mat4x4(1.0f);
@@ -135,13 +157,15 @@ Result<void> MakeSceneNode(SceneNode& out, lib3d::IndexRange tenant,
       const auto found = tex_id_map.getCachedTexture(sampler.mTexture);
       if (!found) {
         err = std::format("Cannot find texture \"{}\"", sampler.mTexture);
+      }
+      obj.active_id = i;
+      if (!found || *found == ~0u) {
+        // Missing, still decoding or undecodable
         if (!tex_id_map.isCached(DefaultTex, 0)) {
           tex_id_map.cache(DefaultTex, 0);
         }
-        obj.active_id = i;
         obj.image_id = TRY(tex_id_map.getCachedTexture(DefaultTex, 0));
       } else {
-        obj.active_id = i;
         obj.image_id = *found;
       }
     }
@@ -267,7 +291,7 @@ void pushDisplay(lib3d::IndexRange tenant,
 }
 
 Result<void> gatherBoneRecursive(lib3d::SceneBuffers& output, u64 boneId,
-                                 ModelView view, glm::mat4 v_mtx,
+                                 const ModelView& view, glm::mat4 v_mtx,
                                  glm::mat4 p_mtx,
                                  G3dSceneRenderData& render_data,
                                  std::string& err, lib3d::RenderType type) {
@@ -341,8 +365,9 @@ Result<void> gatherBoneRecursive(lib3d::SceneBuffers& output, u64 boneId,
   return {};
 }
 
-std::string gather(lib3d::SceneBuffers& output, ModelView view, glm::mat4 v_mtx,
-                   glm::mat4 p_mtx, G3dSceneRenderData& render_data,
+std::string gather(lib3d::SceneBuffers& output, const ModelView& view,
+                   glm::mat4 v_mtx, glm::mat4 p_mtx,
+                   G3dSceneRenderData& render_data,
                    lib3d::RenderType type = lib3d::RenderType::Preview) {
   if (view.mats.empty() || view.polys.empty() || view.bones.empty())
     return {};
@@ -380,6 +405,8 @@ Result<void> G3DSceneAddNodesToBuffer(riistudio::lib3d::SceneState& state,
   for (auto& model : scene.getModels()) {
     ModelView view(model, scene);
     view.model_id = i++;
+    view.boneMatrices =
+        render_data.mSkeletonData.get(view.model_id, view.bones);
     auto err = gather(state.getBuffers(), view, v_mtx, p_mtx, render_data);
     if (err.size()) {
       _err = _err + "\n" + err;
@@ -401,6 +428,8 @@ Result<void> Any3DSceneAddNodesToBuffer(riistudio::lib3d::SceneState& state,
   for (auto& model : scene.getModels()) {
     ModelView view(model, scene);
     view.model_id = i++;
+    view.boneMatrices =
+        render_data.mSkeletonData.get(view.model_id, view.bones);
     auto err =
         gather(state.getBuffers(), view, v_mtx, p_mtx, render_data, type);
     if (err.size()) {
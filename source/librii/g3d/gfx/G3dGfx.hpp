@@ -7,7 +7,9 @@
 #include <librii/gfx/SceneState.hpp>
 #include <librii/gl/Compiler.hpp>
 #include <librii/gl/EnumConverter.hpp>
+#include <librii/glhelper/DecodedTextureCache.hpp>
 #include <librii/glhelper/GlTexture.hpp>
+#include <librii/glhelper/ShaderCache.hpp>
 #include <librii/glhelper/ShaderProgram.hpp>
 #include <unordered_map>
 #include <variant>
@@ -19,8 +21,7 @@ using namespace riistudio;
 // Add a Mesh to a VBO, returning the indices corresponding to that mesh.
 //
 // - Assumes poly.propagate(...) adds to the end of the VBO.
-//
-// TODO: poly.propagate is a hot path
+// - Identical index tuples within a primitive share one vertex.
 inline std::expected<lib3d::IndexRange, std::string>
 AddPolygonToVBO(librii::glhelper::VBOBuilder& vbo_builder,
                 const riistudio::lib3d::Model& mdl,
@@ -58,23 +59,35 @@ CompileMaterial(const lib3d::Material& _mat, lib3d::RenderType type) {
 
 struct CompiledLib3dTexture {
   CompiledLib3dTexture() = default;
-  CompiledLib3dTexture(const lib3d::Texture& tex)
-      : cached_gl_texture(tex), cached_generation_id(tex.getGenerationId()) {}
+  CompiledLib3dTexture(const lib3d::Texture& tex) { update(tex); }
 
   void forceInvalidate(const lib3d::Texture& tex) {
-    cached_gl_texture = librii::glhelper::GlTexture{tex};
-    cached_generation_id = tex.getGenerationId();
+    cached_generation_id = -1;
+    update(tex);
   }
 
+  // The previous image is kept until the new one is decoded in the
+  // background. A texture that fails to decode has no image.
   void update(const lib3d::Texture& tex) {
-    if (cached_generation_id != tex.getGenerationId())
-      forceInvalidate(tex);
+    if (cached_generation_id == tex.getGenerationId())
+      return;
+    auto image =
+        librii::glhelper::DecodedTextureCache::get().request(tex, true);
+    if (image && *image == nullptr)
+      return;
+    cached_gl_texture = {};
+    if (image) {
+      if (auto gl = librii::glhelper::GlTexture::makeTexture(tex, **image))
+        cached_gl_texture = std::move(*gl);
+    }
+    cached_generation_id = tex.getGenerationId();
   }
 
+  //! ~0 until the texture is first decoded.
   u32 getGlId() const { return cached_gl_texture.getGlId(); }
 
   librii::glhelper::GlTexture cached_gl_texture;
-  lib3d::GenerationIDTracked::GenerationID cached_generation_id;
+  lib3d::GenerationIDTracked::GenerationID cached_generation_id = -1;
 };
 
 // Texture cache, by texture name alone
@@ -141,146 +154,83 @@ struct G3dTextureCache {
   }
 };
 
-// Holds a ShaderProgram in a heap allocated box at a steady address; this
-// allows it to be attached to a material as a callback for updates.
-struct ObservableShader {
-  ObservableShader(librii::glhelper::ShaderProgram&& shader) {
-    mImpl = std::make_unique<Impl>(std::move(shader));
-  }
-
-  std::expected<librii::glhelper::ShaderProgram*, std::string> getProgram() {
-    if (mImpl->mErr.size()) {
-      return std::unexpected(mImpl->mErr);
-    }
-    return &mImpl->mProgram;
-  }
-  void syncWithMaterial(const lib3d::Material& mat, lib3d::RenderType type) {
-    mImpl->update(&mat, type);
-  }
-
-private:
-  // IObservers should be heap allocated
-  struct Impl {
-    Impl(librii::glhelper::ShaderProgram&& program)
-        : mProgram(std::move(program)) {}
-
-    librii::glhelper::ShaderProgram mProgram;
-    s32 mLastId = 0xFFFF'FFFF;
-    std::string mErr;
-
-    void update(const lib3d::Material* _mat, lib3d::RenderType type) {
-      assert(_mat != nullptr);
-      if (mLastId == _mat->getGenerationId())
-        return;
-      mLastId = _mat->getGenerationId();
-
-      auto result = CompileMaterial(*_mat, type);
-      if (auto* shader = std::get_if<librii::glhelper::ShaderProgram>(&result);
-          shader != nullptr) {
-        mProgram = std::move(*shader);
-        mErr = {};
-        return;
-      }
-
-      if (auto* err = std::get_if<ShaderCompileError>(&result);
-          err != nullptr) {
-        mErr = err->desc;
-      }
-    }
+// Programs of materials, shared through librii::glhelper::ShaderCache by
+// every material with the same librii::gl::ShaderKey: editing a color or
+// renaming a material never recompiles. A material with a hand-edited pixel
+// shader gets a program of its own.
+struct G3dShaderCache {
+  struct Entry {
+    s32 generation = -1;
+    std::expected<librii::glhelper::ShaderProgram*, std::string> program;
+    // Hand-edited pixel shader
+    std::optional<librii::glhelper::ShaderProgram> custom;
   };
-  std::unique_ptr<Impl> mImpl;
-};
-
-// Name-based shader cache with observables
-struct GenericShaderCache_WithObserverUpdates {
   // Maps material name -> Shader
-  // Each entry is heap allocated so we shouldnt have to worry about dangling
-  // references.
-  std::map<std::string, ObservableShader> mMatToShader;
+  std::map<std::string, Entry> mMatToShader;
 
   std::string key(const lib3d::Material& mat, lib3d::RenderType type) const {
     return mat.getName() + "###" + std::to_string(static_cast<int>(type));
   }
 
-  // TOOD: Better approach than observers
-  bool isShaderCached(const lib3d::Material& mat, lib3d::RenderType type) {
-    return mMatToShader.contains(key(mat, type));
-  }
-
-  Result<void> cacheShader(const lib3d::Material& mat, lib3d::RenderType type) {
-    const auto shader_sources = TRY(mat.generateShaders(type));
-
-    mMatToShader.emplace(
-        key(mat, type), librii::glhelper::ShaderProgram{shader_sources.first,
-                                                        shader_sources.second});
-    mMatToShader.at(key(mat, type)).syncWithMaterial(mat, type);
-    return {};
+  // Generate the shaders of every material of |host| on worker threads.
+  void prepare(const libcube::Scene& host, lib3d::RenderType type) {
+    std::vector<librii::gl::ShaderKey> keys;
+    for (auto& model : host.getModels()) {
+      for (auto& mat : model.getMaterials()) {
+        if (auto key = mat.getShaderKey(type)) {
+          keys.push_back(std::move(*key));
+        }
+      }
+    }
+    librii::glhelper::ShaderCache::get().prepare(keys);
   }
 
-  // TODO: We could do this all with just a map type
   std::expected<librii::glhelper::ShaderProgram*, std::string>
-  getCachedShader(const lib3d::Material& mat, lib3d::RenderType type) {
-    if (!isShaderCached(mat, type)) {
-      TRY(cacheShader(mat, type));
-    }
-
-    assert(isShaderCached(mat, type));
-    mMatToShader.at(key(mat, type)).syncWithMaterial(mat, type);
-    auto program = mMatToShader.at(key(mat, type)).getProgram();
-    if (!program) {
-      return std::unexpected(program.error());
+  getCachedShader(const libcube::IGCMaterial& mat, lib3d::RenderType type) {
+    auto& entry = mMatToShader[key(mat, type)];
+    if (entry.generation != mat.getGenerationId()) {
+      entry.generation = mat.getGenerationId();
+      entry.custom.reset();
+      entry.program = compile(entry, mat, type);
+      mat.isShaderError = !entry.program.has_value();
+      if (!entry.program) {
+        mat.shaderError = entry.program.error();
+      }
     }
-    return program;
+    return entry.program;
   }
-};
-
-#if 0
-struct G3dShaderCache_WithUnusableHashingMechanism {
-  using MatData = librii::g3d::G3dMaterialData;
 
-  class MatDataHash {
-  public:
-    std::size_t operator()(const MatData& data) const {
-      // We can do a lot better
-      return std::hash<std::string>()(data.name);
+private:
+  static std::expected<librii::glhelper::ShaderProgram*, std::string>
+  compile(Entry& entry, const libcube::IGCMaterial& mat,
+          lib3d::RenderType type) {
+    if (mat.applyCacheAgain) {
+      auto result = CompileMaterial(mat, type);
+      if (auto* err = std::get_if<ShaderCompileError>(&result)) {
+        return std::unexpected(err->desc);
+      }
+      return &entry.custom.emplace(
+          std::move(std::get<librii::glhelper::ShaderProgram>(result)));
     }
-  };
-
-  std::unordered_map<MatData, std::optional<librii::glhelper::ShaderProgram>,
-                     MatDataHash>
-      data;
-
-  Result<librii::glhelper::ShaderProgram*>
-  getCachedShader(const riistudio::g3d::Material& mat) {
-    // TODO: This could be more optimized
-    auto it = data.find(mat);
-    if (it != data.end())
-      return &*it->second;
-
-    auto result = CompileMaterial(mat);
-
-    if (auto* shader = std::get_if<librii::glhelper::ShaderProgram>(&result);
-        shader != nullptr) {
-      return &*(data[mat] = std::move(*shader));
+    auto& cache = librii::glhelper::ShaderCache::get();
+    auto program = [&]() -> Result<librii::glhelper::ShaderProgram*> {
+      const auto key = TRY(mat.getShaderKey(type));
+      const auto* sources = TRY(cache.sources(key));
+      // For the shader editor
+      mat.cachedPixelShader = sources->fragment + "\n\n // End of shader";
+      return cache.program(key);
+    }();
+    if (!program) {
+      return std::unexpected(
+          std::format("ShaderGen Error: {}", program.error()));
     }
-
-    // Compilation failed, so give up and pick a different shader
-    if (data.size()) {
-      return &*data.begin()->second;
+    if ((*program)->getError()) {
+      return std::unexpected(
+          std::format("GLSL Error: {}", (*program)->getErrorDesc()));
     }
-
-    // We can't do anything
-    return std::unexpected("Shader compiler error and no other shader to use");
+    return *program;
   }
 };
-#endif
-
-// GenericShaderCache_WithObserverUpdates: Hashmap ShaderData -> Shader; only
-// latest version kept in-memory G3dShaderCache_WithUnusableHashingMechanism:
-// Uses hashmap to store a mapping of ShaderData -> Shader
-
-using G3dShaderCache = GenericShaderCache_WithObserverUpdates;
-// using G3dShaderCache = G3dShaderCache_WithUnusableHashingMechanism;
 
 //! Represents a unique path to a certain drawcall.
 //!
@@ -351,6 +301,12 @@ struct G3dVertexRenderData {
       TRY(buildVertexBuffer(model, i++));
     }
 
+    const auto num_indices = mVboBuilder.mIndices.size();
+    const auto num_vertices = mVboBuilder.mVertexCount;
+    rsl::trace("VBO: {} vertices for {} indices ({:.2f}x reuse)", num_vertices,
+               num_indices,
+               num_vertices ? static_cast<f32>(num_indices) / num_vertices
+                            : 0.0f);
     TRY(mVboBuilder.build());
     return {};
   }
@@ -378,9 +334,7 @@ struct G3dVertexRenderData {
     }
   ANY_CHANGE:
     if (any_change) {
-      mVboBuilder.mData.clear();
-      mVboBuilder.mIndices.clear();
-      mVboBuilder.mPropogating.clear();
+      mVboBuilder.clear();
       mTenants.clear();
       mPolygonLastVerId.clear();
       TRY(init(host));
@@ -390,21 +344,44 @@ struct G3dVertexRenderData {
   }
 };
 
+// Model matrices of each model's bones, computed parent-first and only
+// recomputed when a bone's transform, parent or SSC flag changes.
+struct G3dSkeletonCache {
+  struct BoneKey {
+    librii::math::SRT3 srt;
+    s64 parent;
+    bool ssc;
+
+    bool operator==(const BoneKey&) const = default;
+  };
+  struct Entry {
+    std::vector<BoneKey> key;
+    std::vector<glm::mat4> matrices;
+  };
+  std::vector<Entry> mModels;
+
+  // Valid until the next call for the same model.
+  std::span<const glm::mat4>
+  get(int model_id, std::span<const libcube::IBoneDelegate* const> bones);
+};
+
 // - One vertex buffer object (VBO) representing the entire model
 // (librii::glhelper::VBOBuilder)
 // - A mapping of draw calls in the model to indices in the VBO
 // - A list of GL texture objects
 // - A mapping of .brres textures to slots of GL texture objects
-// - A list+mapping of material names to observable GL shader objects
+// - A mapping of material names to shared GL shader programs
 struct G3dSceneRenderData {
   G3dVertexRenderData mVertexRenderData;
   G3dTextureCache mTextureData;
   G3dShaderCache mMaterialData;
+  G3dSkeletonCache mSkeletonData;
 
   Result<void> init(const libcube::Scene& host) {
     TRY(mVertexRenderData.init(host));
     mTextureData.update(host);
-    // Shaders will be generated the first time the scene is drawn
+    // Programs are compiled the first time the scene is drawn
+    mMaterialData.prepare(host, lib3d::RenderType::Preview);
     return {};
   }
 };
@@ -421,6 +398,8 @@ struct ModelView {
   std::vector<const libcube::IGCMaterial*> mats;
   std::vector<const libcube::Texture*> textures;
   std::vector<libcube::DrawMatrix> drawMatrices;
+  // Model matrix of each bone; see G3dSkeletonCache
+  std::span<const glm::mat4> boneMatrices;
 
   ModelView(const libcube::Model& model, const libcube::Scene& scene) {
     for (auto& x : model.getBones()) {
@@ -6,6 +6,7 @@
 #include <librii/g3d/io/DictWriteIO.hpp>
 #include <librii/g3d/io/ModelIO.hpp>
 #include <librii/g3d/io/NameTableIO.hpp>
+#include <librii/math/keyframes.hpp>
 #include <map>
 #include <oishii/reader/binary_reader.hxx>
 #include <oishii/writer/binary_writer.hxx>
@@ -22,6 +23,12 @@ struct SRT0KeyFrame {
   f32 tangent{};
   bool operator==(const SRT0KeyFrame&) const = default;
 };
+inline librii::math::HermiteKey toHermiteKey(const SRT0KeyFrame& key) {
+  return {.frame = key.frame,
+          .value = key.value,
+          .tangentIn = key.tangent,
+          .tangentOut = key.tangent};
+}
 
 struct SRT0Track {
   // There will be numFrames + 1 keyframes for some reason
@@ -229,6 +229,14 @@ Result<void> WriteBRRES(librii::g3d::BinaryArchive& arc,
   RelocWriter linker(writer);
   NameTable names;
 
+  // Texture blocks make up most of a typical archive and are cheap to size.
+  u32 size_hint = 0;
+  for (auto& tex : arc.textures) {
+    const auto block = librii::g3d::CalcTextureBlockData(tex);
+    size_hint += block.size + block.start_align;
+  }
+  writer.reserve(writer.tell() + size_hint);
+
   const auto start = writer.tell();
   linker.label("BRRES");
   {
@@ -414,8 +422,7 @@ Result<void> WriteBRRES(librii::g3d::BinaryArchive& arc,
     names.poolNames();
     names.resolve(end);
     writer.seekSet(end);
-    for (auto p : names.mPool)
-      writer.write<u8>(p);
+    writer.writeSpan<u8>(names.mPool);
   }
 
   writer.alignTo(128);
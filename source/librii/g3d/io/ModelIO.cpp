@@ -14,6 +14,7 @@
 ///// Headers of glm_io.hpp
 #include <oishii/reader/binary_reader.hxx>
 #include <oishii/writer/binary_writer.hxx>
+#include <rsl/ParallelFor.hpp>
 #include <vendor/glm/vec2.hpp>
 #include <vendor/glm/vec3.hpp>
 
@@ -141,10 +142,16 @@ Result<void> readGenericBuffer(
       TRY(librii::gx::computeComponentCount(kind, out.mQuantize.mComp));
 
   reader.seekSet(start + startOfs);
-  for (auto& entry : out.mEntries) {
-    entry = TRY(librii::gx::readComponents<T>(reader.getUnsafe(),
-                                              out.mQuantize.mType, nComponents,
-                                              out.mQuantize.divisor));
+  if constexpr (std::is_same_v<T, librii::gx::Color>) {
+    for (auto& entry : out.mEntries) {
+      entry = TRY(librii::gx::readComponents<T>(
+          reader.getUnsafe(), out.mQuantize.mType, nComponents,
+          out.mQuantize.divisor));
+    }
+  } else {
+    TRY(librii::gx::readGenericComponentsArray<T>(
+        reader.getUnsafe(), out.mQuantize.mType.generic, nComponents,
+        out.mEntries, out.mQuantize.divisor));
   }
 
   if constexpr (HasMinimum) {
@@ -257,18 +264,36 @@ Result<void> BinaryModel::read(oishii::BinaryReader& unsafeReader,
   }));
   u32 i = 0;
   u32 num_furpolys = 0;
+  std::vector<MeshVertexDL> vertex_dls;
   TRY(readDict(secOfs.ofsMeshes,
                [&](const librii::g3d::BetterNode& dnode) -> Result<void> {
                  auto& poly = meshes.emplace_back();
                  bool badfur = false;
                  TRY(ReadMesh(poly, reader, isValid, positions, normals, colors,
                               texcoords, transaction, transaction_path, i++,
-                              &badfur));
+                              &badfur, &vertex_dls.emplace_back()));
                  if (badfur) {
                    ++num_furpolys;
                  }
                  return {};
                }));
+  {
+    // Polygons are independent, so their vertices are decoded in parallel
+    const size_t first = meshes.size() - vertex_dls.size();
+    size_t dl_bytes = 0;
+    for (const auto& dl : vertex_dls) {
+      dl_bytes += dl.data.size();
+    }
+    std::vector<Result<void>> decoded(vertex_dls.size());
+    rsl::ParallelFor(vertex_dls.size(), dl_bytes < 64 * 1024 ? 1 : 0,
+                     [&](size_t m) {
+                       decoded[m] =
+                           ReadMeshVertices(meshes[first + m], vertex_dls[m]);
+                     });
+    for (auto& result : decoded) {
+      TRY(result);
+    }
+  }
 
   if (num_furpolys != 0) {
     transaction.callback(
@@ -724,8 +749,10 @@ s32 parentOf(const librii::g3d::BoneData& bone) { return bone.mParent; }
 s32 ssc(const librii::g3d::BinaryBoneData& bone) { return bone.flag & 0x20; }
 s32 ssc(const librii::g3d::BoneData& bone) { return bone.ssc; }
 
+// |modelMtx| as computed by calcSrtMtxAll
 librii::g3d::BoneData fromBinaryBone(const librii::g3d::BinaryBoneData& bin,
-                                     auto&& bones, kpi::IOContext& ctx_,
+                                     const glm::mat4& modelMtx,
+                                     kpi::IOContext& ctx_,
                                      librii::g3d::ScalingRule scalingRule) {
   auto ctx = ctx_.sublet("Bone " + bin.name);
   librii::g3d::BoneData bone;
@@ -743,7 +770,6 @@ librii::g3d::BoneData fromBinaryBone(const librii::g3d::BinaryBoneData& bin,
   bone.mParent = bin.parent_id;
   // Skip sibling and child links -- we recompute it all
 
-  auto modelMtx = calcSrtMtx(bin, bones, scalingRule);
   auto modelMtx34 = glm::mat4x3(modelMtx);
 
   auto invModelMtx =
@@ -774,10 +800,12 @@ librii::g3d::BoneData fromBinaryBone(const librii::g3d::BinaryBoneData& bin,
   return bone;
 }
 
+// |modelMtx| as computed by calcSrtMtxAll
 Result<librii::g3d::BinaryBoneData>
 toBinaryBone(const librii::g3d::BoneData& bone,
              std::span<const librii::g3d::BoneData> bones, u32 bone_id,
-             librii::g3d::ScalingRule scalingRule, s32 matrixId) {
+             const glm::mat4& modelMtx, librii::g3d::ScalingRule scalingRule,
+             s32 matrixId) {
   librii::g3d::BinaryBoneData bin;
   bin.name = bone.mName;
   bin.matrixId = matrixId;
@@ -811,7 +839,6 @@ toBinaryBone(const librii::g3d::BoneData& bone,
     bin.sibling_right_id = it == siblings.end() - 1 ? -1 : *(it + 1);
   }
 
-  auto modelMtx = calcSrtMtx(bone, bones, scalingRule);
   auto modelMtx34 = glm::mat4x3(modelMtx);
 
   bin.modelMtx = modelMtx34;
@@ -1043,13 +1070,15 @@ Result<void> processModel(const BinaryModel& binary_model,
   }
 
   mdl.bones.resize(0);
+  const auto boneMatrices = calcSrtMtxAll(binary_model.bones,
+                                          binary_model.info.scalingRule);
   for (size_t i = 0; i < binary_model.bones.size(); ++i) {
     // CTools seemingly doesn't do this???
     if (binary_model.bones[i].id != i) {
       ctx.error("Bone IDs are desynced. Is this a CTools minimap???");
     }
     mdl.bones.emplace_back() =
-        fromBinaryBone(binary_model.bones[i], binary_model.bones, ctx,
+        fromBinaryBone(binary_model.bones[i], boneMatrices[i], ctx,
                        binary_model.info.scalingRule);
   }
 
@@ -1295,9 +1324,10 @@ Result<librii::g3d::BinaryModel> toBinaryModel(const Model& mdl) {
   for (auto [index, value] : rsl::enumerate(mdl.materials)) {
     bin.materials.push_back(librii::g3d::toBinMat(value, index));
   }
+  const auto boneMatrices = calcSrtMtxAll(bones, mdl.info.scalingRule);
   for (auto&& [index, value] : rsl::enumerate(mdl.bones)) {
-    auto bb = toBinaryBone(value, bones, index, mdl.info.scalingRule,
-                           boneToMatrix[index]);
+    auto bb = toBinaryBone(value, bones, index, boneMatrices[index],
+                           mdl.info.scalingRule, boneToMatrix[index]);
     bin.bones.emplace_back(TRY(bb));
   }
 
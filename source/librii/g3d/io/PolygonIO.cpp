@@ -1,6 +1,7 @@
 #include "PolygonIO.hpp"
 #include <librii/gpu/DLBuilder.hpp>
 #include <librii/gpu/DLInterpreter.hpp>
+#include <librii/gpu/DLMesh.hpp>
 
 namespace librii::g3d {
 
@@ -181,9 +182,8 @@ struct DLSetup {
 };
 
 static Result<std::vector<librii::gx::MatrixPrimitive>>
-ReadMPrims(rsl::SafeReader& reader, u32 buf_size,
-           const librii::gx::VertexDescriptor& desc, int currentMatrix = -1) {
-  std::vector<librii::gx::MatrixPrimitive> result;
+ReadMPrims(std::span<const u8> dl, const librii::gx::VertexDescriptor& desc,
+           int currentMatrix = -1) {
   struct QDisplayListMeshHandler final
       : public librii::gpu::QDisplayListHandler {
     Result<void> onCommandDraw(oishii::BinaryReader& reader,
@@ -202,41 +202,10 @@ ReadMPrims(rsl::SafeReader& reader, u32 buf_size,
         mPoly.mMatrixPrimitives.back().mCurrentMatrix = mCurrentMatrix;
       }
       auto& prim = mPoly.mMatrixPrimitives.back().mPrimitives.emplace_back(
-          librii::gx::IndexedPrimitive{});
-      prim.mType = type;
-      prim.mVertices.resize(nverts);
-      for (auto& vert : prim.mVertices) {
-        for (u32 i = 0; i < static_cast<u32>(librii::gx::VertexAttribute::Max);
-             ++i) {
-          if (mPoly.mVertexDescriptor.mBitfield & (1 << i)) {
-            const auto attr = static_cast<librii::gx::VertexAttribute>(i);
-            switch (mPoly.mVertexDescriptor.mAttributes[attr]) {
-            case librii::gx::VertexAttributeType::Direct:
-              if (attr ==
-                      librii::gx::VertexAttribute::PositionNormalMatrixIndex ||
-                  ((u32)attr >=
-                       (u32)librii::gx::VertexAttribute::Texture0MatrixIndex &&
-                   (u32)attr <=
-                       (u32)librii::gx::VertexAttribute::Texture7MatrixIndex)) {
-                vert[attr] =
-                    TRY(reader.tryRead<u8, oishii::EndianSelect::Big, true>());
-                break;
-              }
-              return std::unexpected("Mesh unsupported");
-            case librii::gx::VertexAttributeType::None:
-              break;
-            case librii::gx::VertexAttributeType::Byte:
-              vert[attr] =
-                  TRY(reader.tryRead<u8, oishii::EndianSelect::Big, true>());
-              break;
-            case librii::gx::VertexAttributeType::Short:
-              vert[attr] =
-                  TRY(reader.tryRead<u16, oishii::EndianSelect::Big, true>());
-              break;
-            }
-          }
-        }
-      }
+          type, nverts);
+      TRY(librii::gpu::DecodeVertices(oishii::SliceStream(reader), mLayout,
+                                      prim.mVertices));
+      reader.skip(nverts * mLayout.stride());
       return {};
     }
     Result<void> onCommandIndexedLoad(u32 cmd, u32 index, u16 address,
@@ -277,11 +246,15 @@ ReadMPrims(rsl::SafeReader& reader, u32 buf_size,
     int mLoadingNrmMatrices = 0;
     int mLoadingTexMatrices = 0;
     librii::gx::MeshData mPoly;
+    librii::gpu::VertexLayout mLayout;
     int mCurrentMatrix = -1;
   } meshHandler;
   meshHandler.mPoly.mVertexDescriptor = desc;
+  // Unlike J3D, disabled vertices are read as they are
+  meshHandler.mLayout = TRY(librii::gpu::VertexLayout::make(desc, false));
   meshHandler.mCurrentMatrix = currentMatrix;
-  TRY(librii::gpu::RunDisplayList(reader.getUnsafe(), meshHandler, buf_size));
+  oishii::BinaryReader reader(dl, "Vertex display list", std::endian::big);
+  TRY(librii::gpu::RunDisplayList(reader, meshHandler, dl.size()));
   return meshHandler.mPoly.mMatrixPrimitives;
 }
 
@@ -351,6 +324,8 @@ struct BinaryPolygon {
   DLSetup dl_setup;
 
   std::vector<librii::gx::MatrixPrimitive> matrixPrims;
+  //! On read, the primitives are left in here for ReadMeshVertices.
+  MeshVertexDL vertexDL;
 
   void writeA(oishii::Writer& w) {
     w.write(currentMatrix);
@@ -576,10 +551,18 @@ struct BinaryPolygon {
     dl_setup.cache.descv = desc;
     // TODO: dl_setup is not properly setup for save directly
 
-    // Read primitiveData
+    // Slice primitiveData
     primitiveData.seekTo(reader);
-    matrixPrims =
-        TRY(ReadMPrims(reader, primitiveData.buf_size, desc, currentMatrix));
+    const auto file = reader.getUnsafe().slice();
+    const size_t dl_start = reader.tell();
+    EXPECT(dl_start <= file.size() &&
+               primitiveData.buf_size <= file.size() - dl_start,
+           "Polygon display list runs past the end of the file");
+    vertexDL = {
+        .data = file.subspan(dl_start, primitiveData.buf_size),
+        .descriptor = desc,
+        .currentMatrix = currentMatrix,
+    };
 
     return {};
   }
@@ -605,7 +588,7 @@ ReadMesh(librii::g3d::PolygonData& poly, rsl::SafeReader& reader, bool& isValid,
          kpi::LightIOTransaction& transaction,
          const std::string& transaction_path,
 
-         u32 id, bool* badfur) {
+         u32 id, bool* badfur, MeshVertexDL* deferred) {
   const auto start = reader.tell();
 
   isValid &= TRY(reader.U32()) != 0; // size
@@ -672,7 +655,17 @@ ReadMesh(librii::g3d::PolygonData& poly, rsl::SafeReader& reader, bool& isValid,
     if (badfur != nullptr)
       *badfur = true;
   }
-  poly.mMatrixPrimitives = bin.matrixPrims;
+  if (deferred != nullptr) {
+    *deferred = std::move(bin.vertexDL);
+    return {};
+  }
+  return ReadMeshVertices(poly, bin.vertexDL);
+}
+
+Result<void> ReadMeshVertices(librii::g3d::PolygonData& poly,
+                              const MeshVertexDL& dl) {
+  poly.mMatrixPrimitives =
+      TRY(ReadMPrims(dl.data, dl.descriptor, dl.currentMatrix));
   return {};
 }
 
@@ -9,6 +9,16 @@
 
 namespace librii::g3d {
 
+//! The vertex display list of a polygon.
+struct MeshVertexDL {
+  std::span<const u8> data;
+  librii::gx::VertexDescriptor descriptor;
+  int currentMatrix = -1;
+};
+
+//! If |deferred|, the primitives are not decoded; |deferred| receives what
+//! ReadMeshVertices needs to decode them. Polygons are independent, so this
+//! may be done in parallel.
 Result<void>
 ReadMesh(librii::g3d::PolygonData& poly, rsl::SafeReader& reader, bool& isValid,
 
@@ -20,7 +30,11 @@ ReadMesh(librii::g3d::PolygonData& poly, rsl::SafeReader& reader, bool& isValid,
          kpi::LightIOTransaction& transaction,
          const std::string& transaction_path,
 
-         u32 id, bool* hasfur);
+         u32 id, bool* hasfur, MeshVertexDL* deferred = nullptr);
+
+//! Read the primitives of |poly| from its vertex display list.
+Result<void> ReadMeshVertices(librii::g3d::PolygonData& poly,
+                              const MeshVertexDL& dl);
 
 Result<void> WriteMesh(oishii::Writer& writer,
                        const librii::g3d::PolygonData& mesh,
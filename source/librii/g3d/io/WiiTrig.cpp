@@ -1,6 +1,7 @@
 #include "WiiTrig.hpp"
 
 #include <core/common.h>
+#include <rsl/Simd.hpp>
 
 namespace librii::g3d {
 
@@ -230,6 +231,35 @@ f32 WiiCos(f32 x) {
 // COLUMN-MAJOR IMPLEMENTATION
 glm::mat4x3 MTXConcat(const glm::mat4x3& a, const glm::mat4x3& b) {
   glm::mat4x3 v3;
+#ifdef RSL_HAS_SSE2
+  // Rows 0 and 1 share a register; row 2 uses the low half of another. The
+  // products and sums are done in double in the same order as below, so the
+  // result is identical.
+  __m128d a01[4], a2[4];
+  for (int k = 0; k < 4; ++k) {
+    a01[k] = _mm_cvtps_pd(_mm_castsi128_ps(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(&a[k][0]))));
+    a2[k] = _mm_set_sd(a[k][2]);
+  }
+  for (int c = 0; c < 4; ++c) {
+    const __m128d b0 = _mm_set1_pd(b[c][0]);
+    const __m128d b1 = _mm_set1_pd(b[c][1]);
+    const __m128d b2 = _mm_set1_pd(b[c][2]);
+    __m128d lo = _mm_add_pd(_mm_add_pd(_mm_mul_pd(a01[0], b0),
+                                       _mm_mul_pd(a01[1], b1)),
+                            _mm_mul_pd(a01[2], b2));
+    __m128d hi = _mm_add_sd(_mm_add_sd(_mm_mul_sd(a2[0], b0),
+                                       _mm_mul_sd(a2[1], b1)),
+                            _mm_mul_sd(a2[2], b2));
+    if (c == 3) {
+      lo = _mm_add_pd(lo, a01[3]);
+      hi = _mm_add_sd(hi, a2[3]);
+    }
+    _mm_storel_pi(reinterpret_cast<__m64*>(&v3[c][0]), _mm_cvtpd_ps(lo));
+    v3[c][2] = _mm_cvtss_f32(_mm_cvtsd_ss(_mm_setzero_ps(), hi));
+  }
+  return v3;
+#else
   // clang-format off
   v3[0][0] = ((WiiFloat)a[0][0] * (WiiFloat)b[0][0] + (WiiFloat)a[1][0] * (WiiFloat)b[0][1] + (WiiFloat)a[2][0] * (WiiFloat)b[0][2]);
   v3[1][0] = ((WiiFloat)a[0][0] * (WiiFloat)b[1][0] + (WiiFloat)a[1][0] * (WiiFloat)b[1][1] + (WiiFloat)a[2][0] * (WiiFloat)b[1][2]);
@@ -245,6 +275,7 @@ glm::mat4x3 MTXConcat(const glm::mat4x3& a, const glm::mat4x3& b) {
   v3[3][2] = ((WiiFloat)a[0][2] * (WiiFloat)b[3][0] + (WiiFloat)a[1][2] * (WiiFloat)b[3][1] + (WiiFloat)a[2][2] * (WiiFloat)b[3][2] + (WiiFloat)a[3][2]);
   // clang-format on
   return v3;
+#endif
 }
 
 // COLUMN-MAJOR IMPLEMENTATION
@@ -82,7 +82,7 @@ inline void CalcEnvelopeContribution(glm::mat4& thisMatrix,
   }
 }
 
-// SLOW IMPLEMENTATION
+// SLOW IMPLEMENTATION: walks the whole chain; see calcSrtMtxAll
 inline glm::mat4 calcSrtMtx(const auto& bone, auto&& bones,
                             librii::g3d::ScalingRule scalingRule) {
   std::vector<s32> path;
@@ -121,4 +121,59 @@ inline glm::mat4 calcSrtMtx(const auto& bone, auto&& bones,
   return tmp;
 }
 
+//! Parent-first evaluation order of a skeleton: |parents| receives the parent
+//! of each bone, or -1 for roots. Bones with an invalid parent, or whose
+//! ancestry loops, are treated as roots.
+inline std::vector<u32> calcBoneOrder(auto&& bones, std::vector<s32>& parents) {
+  const size_t count = std::ranges::size(bones);
+  parents.assign(count, -1);
+  std::vector<u32> order;
+  order.reserve(count);
+  // 0: unvisited, 1: on the current path, 2: ordered
+  std::vector<u8> state(count, 0);
+  std::vector<u32> path;
+  for (size_t i = 0; i < count; ++i) {
+    // Climb to the first ordered ancestor (or root), then order the path down
+    for (s32 it = static_cast<s32>(i); state[it] == 0;) {
+      state[it] = 1;
+      path.push_back(it);
+      const s32 parent = parentOf(bones[it]);
+      if (parent < 0 || parent >= std::ssize(bones) || state[parent] == 1) {
+        break;
+      }
+      parents[it] = parent;
+      it = parent;
+    }
+    for (auto it = path.rbegin(); it != path.rend(); ++it) {
+      state[*it] = 2;
+      order.push_back(*it);
+    }
+    path.clear();
+  }
+  return order;
+}
+
+//! Model matrices of every bone, as calcSrtMtx computes them, with each
+//! bone's envelope computed once from its parent's.
+inline std::vector<glm::mat4> calcSrtMtxAll(auto&& bones,
+                                            librii::g3d::ScalingRule rule) {
+  std::vector<s32> parents;
+  const auto order = calcBoneOrder(bones, parents);
+  std::vector<glm::mat4> envelopes(order.size(), glm::mat4(1.0f));
+  std::vector<glm::vec3> scales(order.size(), glm::vec3(1.0f));
+  std::vector<glm::mat4> out(order.size());
+  const glm::mat4 rootMtx(1.0f);
+  const glm::vec3 rootScale(1.0f, 1.0f, 1.0f);
+  for (u32 i : order) {
+    const s32 parent = parents[i];
+    CalcEnvelopeContribution(/*out*/ envelopes[i], /*out*/ scales[i],
+                             bones[i], parent < 0 ? rootMtx : envelopes[parent],
+                             parent < 0 ? rootScale : scales[parent], rule);
+    glm::mat4x3 tmp;
+    librii::g3d::Mtx_scale(tmp, envelopes[i], scales[i]);
+    out[i] = tmp;
+  }
+  return out;
+}
+
 } // namespace librii::g3d
@@ -1,5 +1,6 @@
 #include <glfw/glfw3.h>
 #include <librii/gl/Compiler.hpp>
+#include <rsl/StableHasher.hpp>
 #include <rsl/StringBuilder.hpp>
 namespace librii::gl {
 
@@ -1573,4 +1574,65 @@ compileShader(const gx::LowLevelGxMaterial& mat, std::string_view name,
   return GlShaderPair{compiled.first, compiled.second};
 }
 
+// Bump when the generated shaders change
+static constexpr u32 ShaderKeyVersion = 1;
+
+ShaderKey ShaderKey::make(const gx::LowLevelGxMaterial& mat,
+                          VisType vis_prim) {
+  // Every field GXProgram reads
+  ShaderKey key{.material = {}, .vis_prim = vis_prim, .hash = {}};
+  auto& m = key.material;
+  m.colorChanControls = mat.colorChanControls;
+  m.texGens = mat.texGens;
+  m.earlyZComparison = mat.earlyZComparison;
+  m.alphaCompare = mat.alphaCompare;
+  m.dstAlpha = mat.dstAlpha;
+  m.indirectStages = mat.indirectStages;
+  m.mSwapTable = mat.mSwapTable;
+  m.mStages = mat.mStages;
+
+  rsl::StableHasher h;
+  auto w = [&](auto... xs) { (h.word(static_cast<u32>(xs)), ...); };
+  w(ShaderKeyVersion, vis_prim);
+  w(m.colorChanControls.size());
+  for (auto& c : m.colorChanControls) {
+    w(c.enabled, c.Ambient, c.Material, c.lightMask, c.diffuseFn,
+      c.attenuationFn);
+  }
+  w(m.texGens.size());
+  for (auto& t : m.texGens) {
+    w(t.func, t.sourceParam, t.matrix, t.normalize, t.postMatrix);
+  }
+  w(m.earlyZComparison);
+  const auto& ac = m.alphaCompare;
+  w(ac.compLeft, ac.refLeft, ac.op, ac.compRight, ac.refRight);
+  w(m.dstAlpha.enabled, m.dstAlpha.alpha);
+  w(m.indirectStages.size());
+  for (auto& s : m.indirectStages) {
+    w(s.scale.U, s.scale.V, s.order.refMap, s.order.refCoord);
+  }
+  for (auto& e : m.mSwapTable) {
+    w(e.r, e.g, e.b, e.a);
+  }
+  w(m.mStages.size());
+  for (auto& s : m.mStages) {
+    w(s.rasOrder, s.texMap, s.texCoord, s.rasSwap, s.texMapSwap);
+    const auto& c = s.colorStage;
+    w(c.constantSelection, c.a, c.b, c.c, c.d, c.formula, c.bias, c.scale,
+      c.clamp, c.out);
+    const auto& a = s.alphaStage;
+    w(a.constantSelection, a.a, a.b, a.c, a.d, a.formula, a.bias, a.scale,
+      a.clamp, a.out);
+    const auto& i = s.indirectStage;
+    w(i.indStageSel, i.format, i.bias, i.matrix, i.wrapU, i.wrapV, i.addPrev,
+      i.utcLod, i.alpha);
+  }
+  key.hash = h.hex();
+  return key;
+}
+
+std::expected<GlShaderPair, std::string> compileShader(const ShaderKey& key) {
+  return compileShader(key.material, key.hash, key.vis_prim);
+}
+
 } // namespace librii::gl
@@ -118,4 +118,28 @@ std::expected<GlShaderPair, std::string>
 compileShader(const gx::LowLevelGxMaterial& mat, std::string_view name,
               VisType vis_prim = VisType::None);
 
+//! @brief The state of a material that its generated shaders depend on: the
+//! TEV stages, texgens, swap table, indirect stages, lighting channel
+//! controls, alpha test and destination alpha.
+//!
+//! Materials differing only in anything else (colors, blending, names...)
+//! have equal keys, and share one program.
+//!
+struct ShaderKey {
+  //! Only the state listed above; everything else is left at its default.
+  gx::LowLevelGxMaterial material;
+  VisType vis_prim = VisType::None;
+  //! 128-bit hash of the above, stable across runs (e.g. for on-disk
+  //! caches).
+  std::string hash;
+
+  static ShaderKey make(const gx::LowLevelGxMaterial& mat,
+                        VisType vis_prim = VisType::None);
+
+  bool operator==(const ShaderKey&) const = default;
+};
+
+//! As compileShader, named by the hash of the key.
+std::expected<GlShaderPair, std::string> compileShader(const ShaderKey& key);
+
 } // namespace librii::gl
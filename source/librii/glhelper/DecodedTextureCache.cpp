@@ -0,0 +1,152 @@
+#include "DecodedTextureCache.hpp"
+
+IMPORT_STD;
+
+namespace librii::glhelper {
+
+// Below this, a thread hop costs more than the decode.
+static constexpr size_t InlineDecodeSize = 64 * 64 * 4;
+
+DecodedTextureCache::DecodedTextureCache(size_t budget, unsigned num_threads)
+    : mBudget(budget), mPool(num_threads) {}
+
+DecodedTextureCache::~DecodedTextureCache() {
+  mTasks.cancel();
+  mTasks.wait();
+}
+
+DecodedTextureCache& DecodedTextureCache::get() {
+  static DecodedTextureCache sInstance;
+  return sInstance;
+}
+
+Result<DecodedTextureCache::Image>
+DecodedTextureCache::request(const riistudio::lib3d::Texture& tex, bool mip) {
+  // The address identifies the texture; the low bit tells the variants apart.
+  const u64 id = (reinterpret_cast<uintptr_t>(&tex) << 1) | (mip ? 1 : 0);
+  const s64 generation = tex.getGenerationId();
+  {
+    // Skip snapshotting the texture when the image is already known.
+    std::unique_lock g(mMutex);
+    auto it = mEntries.find(id);
+    if (it != mEntries.end() && it->second.generation == generation) {
+      mLru.splice(mLru.begin(), mLru, it->second.lru);
+      if (!it->second.error.empty()) {
+        return std::unexpected(it->second.error);
+      }
+      return it->second.image;
+    }
+  }
+  return request(id, generation, tex.getDecodedSize(mip),
+                 tex.makeDecoder(mip));
+}
+
+Result<DecodedTextureCache::Image>
+DecodedTextureCache::request(u64 id, s64 generation, size_t size,
+                             Decoder decoder) {
+  std::unique_lock g(mMutex);
+  auto it = mEntries.find(id);
+  if (it != mEntries.end()) {
+    if (it->second.generation == generation) {
+      mLru.splice(mLru.begin(), mLru, it->second.lru);
+      if (!it->second.error.empty()) {
+        return std::unexpected(it->second.error);
+      }
+      return it->second.image;
+    }
+    erase(it);
+  }
+
+  mLru.push_front(id);
+  Entry& entry = mEntries[id];
+  entry = {.generation = generation,
+           .image = nullptr,
+           .error = {},
+           .pending = true,
+           .lru = mLru.begin()};
+  if (size <= InlineDecodeSize) {
+    store(entry, decoder());
+    if (!entry.error.empty()) {
+      return std::unexpected(entry.error);
+    }
+    return entry.image;
+  }
+  mTasks.run([this, id, generation, decoder = std::move(decoder)] {
+    Result<std::vector<u8>> result = std::unexpected("Decoding failed");
+    // An exception would cancel every later task of the group
+    try {
+      result = decoder();
+    } catch (...) {
+    }
+    std::unique_lock g(mMutex);
+    auto it = mEntries.find(id);
+    // Superseded or cleared while decoding
+    if (it == mEntries.end() || it->second.generation != generation) {
+      return;
+    }
+    store(it->second, std::move(result));
+  });
+  return Image{};
+}
+
+void DecodedTextureCache::wait() { mTasks.wait(); }
+
+void DecodedTextureCache::clear() {
+  std::unique_lock g(mMutex);
+  mEntries.clear();
+  mLru.clear();
+  mBytes = 0;
+}
+
+size_t DecodedTextureCache::bytes() const {
+  std::unique_lock g(mMutex);
+  return mBytes;
+}
+
+size_t DecodedTextureCache::size() const {
+  std::unique_lock g(mMutex);
+  return mEntries.size();
+}
+
+void DecodedTextureCache::erase(std::unordered_map<u64, Entry>::iterator it) {
+  if (it->second.image) {
+    mBytes -= it->second.image->size();
+  }
+  mLru.erase(it->second.lru);
+  mEntries.erase(it);
+}
+
+void DecodedTextureCache::store(Entry& entry,
+                                Result<std::vector<u8>>&& result) {
+  entry.pending = false;
+  if (!result) {
+    entry.error = std::move(result.error());
+    return;
+  }
+  entry.image = std::make_shared<const std::vector<u8>>(std::move(*result));
+  mBytes += entry.image->size();
+  evict(entry);
+}
+
+void DecodedTextureCache::evict(const Entry& keep) {
+  // The most recent image and the one just decoded stay, even if over budget.
+  auto it = mLru.end();
+  while (mBytes > mBudget && it != mLru.begin()) {
+    --it;
+    if (it == mLru.begin()) {
+      break;
+    }
+    auto entry = mEntries.find(*it);
+    assert(entry != mEntries.end());
+    if (entry->second.pending || !entry->second.image ||
+        &entry->second == &keep) {
+      continue;
+    }
+    // Callers may still hold the image; only our reference goes.
+    auto next = std::next(it);
+    erase(entry);
+    it = next;
+  }
+}
+
+} // namespace librii::glhelper
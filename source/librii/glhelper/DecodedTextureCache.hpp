@@ -0,0 +1,87 @@
+#pragma once
+
+#include <core/3d/Texture.hpp>
+#include <core/common.h>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <rsl/ThreadPool.hpp>
+#include <unordered_map>
+
+namespace librii::glhelper {
+
+//! Decoded RGBA32 images, decoded on worker threads.
+//!
+//! Images are keyed by an identity and a generation: editing a texture bumps
+//! its generation ID, so the stale image is replaced on the next request.
+//! Once over budget, the least recently requested images are evicted. Nothing
+//! here touches GL, so the cache works headless.
+class DecodedTextureCache {
+public:
+  using Image = std::shared_ptr<const std::vector<u8>>;
+  //! Runs on a worker thread, so must not reference state that may be edited
+  //! meanwhile.
+  using Decoder = std::function<Result<std::vector<u8>>()>;
+
+  //! |num_threads| = 0 uses one worker per core.
+  explicit DecodedTextureCache(size_t budget = 256 * 1024 * 1024,
+                               unsigned num_threads = 0);
+  //! Pending decodes that have not started are dropped.
+  ~DecodedTextureCache();
+
+  //! The cache shared by the editor.
+  static DecodedTextureCache& get();
+
+  //! @brief The decoded image of |tex| (with every level if |mip|), or nullptr
+  //! while it is decoded in the background. Small textures are decoded
+  //! immediately. Failures are remembered until the texture changes.
+  //!
+  Result<Image> request(const riistudio::lib3d::Texture& tex, bool mip);
+
+  //! @brief As above, for any image.
+  //!
+  //! @param[in] id         Identity of the image.
+  //! @param[in] generation Version of the image; a new one replaces the old.
+  //! @param[in] size       Expected size of the decoded image in bytes.
+  //! @param[in] decoder    Produces the image.
+  //!
+  Result<Image> request(u64 id, s64 generation, size_t size, Decoder decoder);
+
+  //! Block until every pending decode has finished.
+  void wait();
+  //! Drop every image. Pending decodes are discarded when they finish.
+  void clear();
+
+  //! Bytes of decoded images held.
+  size_t bytes() const;
+  //! Number of images held, pending or not.
+  size_t size() const;
+
+private:
+  struct Entry {
+    s64 generation;
+    //! Null while pending or on failure.
+    Image image;
+    std::string error;
+    bool pending;
+    std::list<u64>::iterator lru;
+  };
+
+  void erase(std::unordered_map<u64, Entry>::iterator it);
+  void store(Entry& entry, Result<std::vector<u8>>&& result);
+  void evict(const Entry& keep);
+
+  mutable std::mutex mMutex;
+  std::unordered_map<u64, Entry> mEntries;
+  //! Most recently requested first.
+  std::list<u64> mLru;
+  size_t mBytes = 0;
+  size_t mBudget;
+
+  // Declared last: destroyed (joined) before the entries.
+  rsl::ThreadPool mPool;
+  rsl::TaskGroup mTasks{mPool};
+};
+
+} // namespace librii::glhelper
@@ -36,6 +36,10 @@ private:
 public:
   static std::optional<GlTexture>
   makeTexture(const riistudio::lib3d::Texture& tex);
+  //! As above, from every level of |tex| already decoded.
+  static std::optional<GlTexture>
+  makeTexture(const riistudio::lib3d::Texture& tex,
+              std::span<const u8> decoded);
 };
 
 } // namespace librii::glhelper
@@ -1,20 +1,332 @@
 #include "ShaderCache.hpp"
 
+#include <algorithm>
+#include <core/3d/gl.hpp>
+#include <core/util/timestamp.hpp> // GIT_TAG
+#include <fstream>
+#include <oishii/reader/binary_reader.hxx>
+#include <oishii/writer/binary_writer.hxx>
+#include <random>
+#include <rsl/Log.hpp>
+#include <rsl/ParallelFor.hpp>
+#include <rsl/StableHasher.hpp>
+#include <unordered_set>
+
 namespace librii::glhelper {
 
-std::map<std::pair<std::string, std::string>, std::unique_ptr<ShaderProgram>>
-    ShaderCache::mShaders;
-
-ShaderProgram& ShaderCache::compile(const std::string& vert,
-                                    const std::string& frag) {
-  const auto key = std::pair<std::string, std::string>(vert, frag);
-  const auto found = mShaders.find(key);
-  if (found != mShaders.end())
-    return *found->second.get();
-  auto new_program = std::make_unique<ShaderProgram>(vert, frag);
-  ShaderProgram& ref = *new_program.get();
-  mShaders.emplace(key, std::move(new_program));
-  return ref;
+// Bump when the file layout changes
+static constexpr u32 CacheVersion = 1;
+// "RSHS" and "RSHB" in the files, which are little endian
+static constexpr u32 SourcesMagic = 'R' | 'S' << 8 | 'H' << 16 | 'S' << 24;
+static constexpr u32 BinaryMagic = 'R' | 'S' << 8 | 'H' << 16 | 'B' << 24;
+static constexpr std::string_view SourcesExtension = ".glsl";
+static constexpr std::string_view BinaryExtension = ".bin";
+
+// Below this, threads cost more than they save.
+static constexpr size_t MinParallelKeys = 8;
+
+namespace {
+
+// Sources are also keyed by the build, in case the generator changed without
+// a bump of its version.
+std::string SourcesName(const gl::ShaderKey& key) {
+  rsl::StableHasher h;
+  h.word(CacheVersion);
+  h.bytes(GIT_TAG);
+  h.bytes(key.hash);
+  return h.hex() + std::string(SourcesExtension);
+}
+
+// A binary is only valid for the driver that produced it.
+const std::string& DriverName() {
+  static const std::string name = [] {
+    std::string name;
+#ifdef RII_GL
+    for (auto e : {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+      if (const auto* s = glGetString(e)) {
+        name += reinterpret_cast<const char*>(s);
+      }
+      name += '\n';
+    }
+#endif
+    return name;
+  }();
+  return name;
+}
+
+std::string BinaryName(const gl::GlShaderPair& sources) {
+  rsl::StableHasher h;
+  h.word(CacheVersion);
+  h.bytes(DriverName());
+  h.bytes(sources.vertex);
+  h.bytes(sources.fragment);
+  return h.hex() + std::string(BinaryExtension);
+}
+
+// Padded to keep the words that follow aligned
+Result<std::string> ReadString(oishii::BinaryReader& reader) {
+  const u32 size = TRY(reader.tryRead<u32>());
+  const auto buf = TRY(reader.tryReadBuffer<u8>(size));
+  reader.skip(-size & 3);
+  return std::string(buf.begin(), buf.end());
+}
+void WriteString(oishii::Writer& writer, std::string_view s) {
+  writer.write<u32>(static_cast<u32>(s.size()));
+  writer.writeSpan<u8>({reinterpret_cast<const u8*>(s.data()), s.size()});
+  for (size_t i = s.size(); i % 4 != 0; ++i) {
+    writer.write<u8>(0);
+  }
+}
+
+// Mark as recently used for trim()
+void Touch(const std::filesystem::path& path) {
+  std::error_code ec;
+  std::filesystem::last_write_time(
+      path, std::filesystem::file_time_type::clock::now(), ec);
+}
+
+// Write to a unique name and rename, so concurrent readers and writers of the
+// same file never see a partial one. Thread ids repeat across processes, so
+// the name is random.
+void WriteFile(const std::filesystem::path& path, oishii::Writer& writer) {
+  auto tmp = path;
+  std::random_device rd;
+  tmp += std::format(".{:08x}{:08x}.tmp", rd(), rd());
+  {
+    std::ofstream stream(tmp, std::ios::binary);
+    auto buf = writer.takeBuf();
+    stream.write(reinterpret_cast<const char*>(buf.data()), buf.size());
+    if (!stream) {
+      rsl::error("Failed to write shader cache entry {}", tmp.string());
+      return;
+    }
+  }
+  std::error_code ec;
+  std::filesystem::rename(tmp, path, ec);
+  if (ec) {
+    std::filesystem::remove(tmp, ec);
+  }
+}
+
+} // namespace
+
+std::filesystem::path ShaderCache::DefaultPath() {
+  std::error_code ec;
+  auto tmp = std::filesystem::temp_directory_path(ec);
+  return tmp / "RiiStudio" / "shaders";
+}
+
+ShaderCache::ShaderCache(std::filesystem::path dir, u64 max_bytes)
+    : mDir(std::move(dir)), mMaxBytes(max_bytes) {
+  if (!mDir.empty()) {
+    std::error_code ec;
+    std::filesystem::create_directories(mDir, ec);
+  }
+}
+
+ShaderCache::~ShaderCache() { trim(); }
+
+ShaderCache& ShaderCache::get() {
+  // Never destroyed: programs must not outlive the GL context
+  static ShaderCache* sInstance = [] {
+    auto* cache = new ShaderCache(DefaultPath());
+    cache->trim();
+    return cache;
+  }();
+  return *sInstance;
+}
+
+Result<gl::GlShaderPair> ShaderCache::load(const gl::ShaderKey& key,
+                                           bool* from_disk) const {
+  *from_disk = false;
+  if (mDir.empty()) {
+    return gl::compileShader(key);
+  }
+  const auto path = mDir / SourcesName(key);
+  auto cached = [&]() -> Result<gl::GlShaderPair> {
+    auto reader = TRY(oishii::BinaryReader::FromFilePath(path.string(),
+                                                         std::endian::little));
+    EXPECT(TRY(reader.tryRead<u32>()) == SourcesMagic);
+    EXPECT(TRY(reader.tryRead<u32>()) == CacheVersion);
+    gl::GlShaderPair sources;
+    sources.vertex = TRY(ReadString(reader));
+    sources.fragment = TRY(ReadString(reader));
+    return sources;
+  }();
+  if (cached) {
+    Touch(path);
+    *from_disk = true;
+    return cached;
+  }
+
+  auto sources = gl::compileShader(key);
+  if (sources) {
+    oishii::Writer writer(std::endian::little);
+    writer.write<u32>(SourcesMagic);
+    writer.write<u32>(CacheVersion);
+    WriteString(writer, sources->vertex);
+    WriteString(writer, sources->fragment);
+    WriteFile(path, writer);
+  }
+  return sources;
+}
+
+void ShaderCache::prepare(std::span<const gl::ShaderKey> keys,
+                          unsigned num_threads) {
+  std::vector<const gl::ShaderKey*> missing;
+  std::unordered_set<std::string_view> queued;
+  for (auto& key : keys) {
+    if (!mEntries.contains(key.hash) && queued.insert(key.hash).second) {
+      missing.push_back(&key);
+    }
+  }
+  if (missing.size() < MinParallelKeys) {
+    num_threads = 1;
+  }
+  std::vector<Result<gl::GlShaderPair>> sources(missing.size());
+  std::vector<char> from_disk(missing.size());
+  rsl::ParallelFor(missing.size(), num_threads, [&](size_t i) {
+    bool disk = false;
+    sources[i] = load(*missing[i], &disk);
+    from_disk[i] = disk;
+  });
+  for (size_t i = 0; i < missing.size(); ++i) {
+    mStats.diskSources += from_disk[i];
+    mEntries.emplace(missing[i]->hash, Entry{.key = *missing[i],
+                                             .sources = std::move(sources[i]),
+                                             .program = nullptr});
+  }
+}
+
+ShaderCache::Entry& ShaderCache::find(const gl::ShaderKey& key) {
+  auto it = mEntries.find(key.hash);
+  if (it == mEntries.end()) {
+    prepare({&key, 1});
+    it = mEntries.find(key.hash);
+  }
+  if (it->second.key == key) {
+    return it->second;
+  }
+  // A hash collision. Files on disk are named by the hash too, so generate
+  // the sources directly.
+  for (auto& entry : mCollisions) {
+    if (entry.key == key) {
+      return entry;
+    }
+  }
+  rsl::error("Shader key hash collision: {}", key.hash);
+  return mCollisions.emplace_back(Entry{.key = key,
+                                        .sources = gl::compileShader(key),
+                                        .program = nullptr});
+}
+
+Result<const gl::GlShaderPair*>
+ShaderCache::sources(const gl::ShaderKey& key) {
+  const auto& entry = find(key);
+  if (!entry.sources) {
+    return std::unexpected(entry.sources.error());
+  }
+  return &*entry.sources;
+}
+
+Result<ShaderProgram*> ShaderCache::program(const gl::ShaderKey& key) {
+  auto& entry = find(key);
+  if (!entry.sources) {
+    return std::unexpected(entry.sources.error());
+  }
+  if (entry.program) {
+    ++mStats.hits;
+  } else {
+    ++mStats.misses;
+    entry.program = link(*entry.sources);
+    ++mStats.programs;
+  }
+  return entry.program.get();
+}
+
+std::unique_ptr<ShaderProgram>
+ShaderCache::link(const gl::GlShaderPair& sources) {
+  if (mDir.empty() || !ShaderProgram::isBinarySupported()) {
+    return std::make_unique<ShaderProgram>(sources.vertex, sources.fragment);
+  }
+  const auto path = mDir / BinaryName(sources);
+  auto cached = [&]() -> Result<ProgramBinary> {
+    auto reader = TRY(oishii::BinaryReader::FromFilePath(path.string(),
+                                                         std::endian::little));
+    EXPECT(TRY(reader.tryRead<u32>()) == BinaryMagic);
+    EXPECT(TRY(reader.tryRead<u32>()) == CacheVersion);
+    ProgramBinary binary;
+    binary.format = TRY(reader.tryRead<u32>());
+    const u32 size = TRY(reader.tryRead<u32>());
+    binary.data = TRY(reader.tryReadBuffer<u8>(size));
+    return binary;
+  }();
+  if (cached) {
+    auto program = std::make_unique<ShaderProgram>(*cached);
+    if (!program->getError()) {
+      Touch(path);
+      ++mStats.diskBinaries;
+      return program;
+    }
+  }
+
+  auto program =
+      std::make_unique<ShaderProgram>(sources.vertex, sources.fragment);
+  if (!program->getError()) {
+    const auto binary = program->getBinary();
+    if (!binary.data.empty()) {
+      oishii::Writer writer(std::endian::little);
+      writer.write<u32>(BinaryMagic);
+      writer.write<u32>(CacheVersion);
+      writer.write<u32>(binary.format);
+      writer.write<u32>(static_cast<u32>(binary.data.size()));
+      writer.writeSpan<u8>(binary.data);
+      WriteFile(path, writer);
+    }
+  }
+  return program;
+}
+
+void ShaderCache::clear() {
+  mEntries.clear();
+  mCollisions.clear();
+  mStats.programs = 0;
+}
+
+void ShaderCache::trim() {
+  if (mDir.empty()) {
+    return;
+  }
+  struct File {
+    std::filesystem::file_time_type time;
+    u64 size;
+    std::filesystem::path path;
+  };
+  std::vector<File> files;
+  u64 total = 0;
+  std::error_code ec;
+  for (auto& it : std::filesystem::directory_iterator(mDir, ec)) {
+    const auto ext = it.path().extension();
+    if (!it.is_regular_file(ec) ||
+        (ext != SourcesExtension && ext != BinaryExtension)) {
+      continue;
+    }
+    File f{it.last_write_time(ec), it.file_size(ec), it.path()};
+    total += f.size;
+    files.push_back(std::move(f));
+  }
+  if (total <= mMaxBytes) {
+    return;
+  }
+  std::ranges::sort(files, {}, &File::time);
+  for (auto& f : files) {
+    if (total <= mMaxBytes) {
+      break;
+    }
+    if (std::filesystem::remove(f.path, ec)) {
+      total -= f.size;
+    }
+  }
 }
 
 } // namespace librii::glhelper
@@ -1,20 +1,94 @@
 #pragma once
 
+#include <core/common.h>
+#include <filesystem>
+#include <librii/gl/Compiler.hpp>
 #include <librii/glhelper/ShaderProgram.hpp>
-#include <map>
 #include <memory>
+#include <span>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 namespace librii::glhelper {
 
-struct ShaderCache {
-  static ShaderProgram& compile(const std::string& vert,
-                                const std::string& frag);
+//! @brief GL programs of material shaders, shared by every material with the
+//! same gl::ShaderKey.
+//!
+//! GLSL is generated on worker threads by prepare(), and kept on disk by key
+//! so reopening a scene skips generation. Where the driver supports program
+//! binaries, linked programs are kept on disk too, by sources and driver. The
+//! directory is bounded by size: trim() evicts the least recently used
+//! entries, and runs on destruction. Only prepare() is parallel; call
+//! everything from the GL thread.
+//!
+class ShaderCache {
+public:
+  struct Stats {
+    //! Programs held.
+    u32 programs = 0;
+    //! Requests served by a program already held: another material with the
+    //! same key, or an edit that left the key unchanged.
+    u32 hits = 0;
+    u32 misses = 0;
+    //! Sources read from disk rather than generated.
+    u32 diskSources = 0;
+    //! Programs loaded from a binary on disk rather than compiled.
+    u32 diskBinaries = 0;
+  };
+
+  //! e.g. $TMP/RiiStudio/shaders
+  static std::filesystem::path DefaultPath();
+
+  //! An empty |dir| keeps nothing on disk.
+  explicit ShaderCache(std::filesystem::path dir,
+                       u64 max_bytes = 128 * 1024 * 1024);
+  ~ShaderCache();
+  ShaderCache(const ShaderCache&) = delete;
+  ShaderCache& operator=(const ShaderCache&) = delete;
+
+  //! The cache shared by the editor. Trimmed once, on first use.
+  static ShaderCache& get();
+
+  //! Generate (or read from disk) the sources of the |keys| not yet held, on
+  //! up to |num_threads| threads (0 = one per core).
+  void prepare(std::span<const gl::ShaderKey> keys, unsigned num_threads = 0);
+  //! Sources of |key|, generating them if not yet held.
+  Result<const gl::GlShaderPair*> sources(const gl::ShaderKey& key);
+  //! @brief The program of |key|, compiling it if not yet held.
+  //!
+  //! @return An error only if the sources could not be generated; a program
+  //! that failed to compile reports it through getError().
+  //!
+  Result<ShaderProgram*> program(const gl::ShaderKey& key);
+
+  Stats stats() const { return mStats; }
+  //! Drop every program and source held (not those on disk). Programs
+  //! returned earlier are deleted.
+  void clear();
+  //! Delete the oldest files until the directory fits in max_bytes.
+  void trim();
 
 private:
-  static std::map<std::pair<std::string, std::string>,
-                  std::unique_ptr<ShaderProgram>>
-      mShaders;
+  struct Entry {
+    gl::ShaderKey key;
+    Result<gl::GlShaderPair> sources;
+    //! Null until first requested.
+    std::unique_ptr<ShaderProgram> program;
+  };
+
+  Entry& find(const gl::ShaderKey& key);
+  Result<gl::GlShaderPair> load(const gl::ShaderKey& key,
+                                bool* from_disk) const;
+  std::unique_ptr<ShaderProgram> link(const gl::GlShaderPair& sources);
+
+  std::filesystem::path mDir;
+  u64 mMaxBytes = 0;
+  //! By gl::ShaderKey::hash
+  std::unordered_map<std::string, Entry> mEntries;
+  //! Keys whose hash matches an entry of another key. Not kept on disk.
+  std::vector<Entry> mCollisions;
+  Stats mStats;
 };
 
 } // namespace librii::glhelper
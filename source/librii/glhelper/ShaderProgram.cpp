@@ -42,6 +42,11 @@ ShaderProgram::ShaderProgram(const char* vtx, const char* frag) {
     // mErrorDesc = frag;
   }
   mShaderProgram = glCreateProgram();
+#ifdef RII_BACKEND_GLFW
+  if (isBinarySupported())
+    glProgramParameteri(mShaderProgram, GL_PROGRAM_BINARY_RETRIEVABLE_HINT,
+                        GL_TRUE);
+#endif
   glAttachShader(mShaderProgram, vertexShader);
   glAttachShader(mShaderProgram, fragmentShader);
   glLinkProgram(mShaderProgram);
@@ -51,6 +56,56 @@ ShaderProgram::ShaderProgram(const char* vtx, const char* frag) {
 }
 ShaderProgram::ShaderProgram(const std::string& vtx, const std::string& frag)
     : ShaderProgram(vtx.c_str(), frag.c_str()) {}
+
+// Program binaries are core in GL 4.1 and GLES 3.0, but not in WebGL
+#ifdef RII_BACKEND_GLFW
+bool ShaderProgram::isBinarySupported() {
+  static const bool supported = [] {
+    s32 formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    return formats > 0;
+  }();
+  return supported;
+}
+
+ShaderProgram::ShaderProgram(const ProgramBinary& binary) {
+  mShaderProgram = glCreateProgram();
+  glProgramBinary(mShaderProgram, binary.format, binary.data.data(),
+                  static_cast<s32>(binary.data.size()));
+  s32 success;
+  glGetProgramiv(mShaderProgram, GL_LINK_STATUS, &success);
+  if (!success) {
+    bError = true;
+    mErrorDesc = "Program binary rejected by the driver";
+  }
+}
+
+ProgramBinary ShaderProgram::getBinary() const {
+  ProgramBinary binary;
+  s32 length = 0;
+  if (bError || !isBinarySupported())
+    return binary;
+  glGetProgramiv(mShaderProgram, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0)
+    return binary;
+  binary.data.resize(length);
+  GLenum format = 0;
+  glGetProgramBinary(mShaderProgram, length, &length, &format,
+                     binary.data.data());
+  binary.data.resize(length);
+  binary.format = format;
+  return binary;
+}
+#else
+bool ShaderProgram::isBinarySupported() { return false; }
+
+ShaderProgram::ShaderProgram(const ProgramBinary&)
+    : mErrorDesc("Program binaries are unsupported"), mShaderProgram(~0),
+      bError(true) {}
+
+ProgramBinary ShaderProgram::getBinary() const { return {}; }
+#endif
+
 ShaderProgram::~ShaderProgram() {
 #ifndef RII_PLATFORM_EMSCRIPTEN
   if (mShaderProgram != ~0)
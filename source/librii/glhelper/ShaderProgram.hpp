@@ -1,13 +1,24 @@
 #pragma once
 
 #include <core/common.h>
+#include <span>
 #include <string>
+#include <vector>
 
 namespace librii::glhelper {
 
+//! A linked program in a driver-specific format (glGetProgramBinary).
+struct ProgramBinary {
+  u32 format = 0;
+  std::vector<u8> data;
+};
+
 struct ShaderProgram {
   explicit ShaderProgram(const char* vtx, const char* frag);
   explicit ShaderProgram(const std::string& vtx, const std::string& frag);
+  //! Fails (getError()) if the driver rejects the binary, e.g. after a driver
+  //! update.
+  explicit ShaderProgram(const ProgramBinary& binary);
   ShaderProgram(ShaderProgram&& rhs)
       : mErrorDesc(rhs.mErrorDesc), mShaderProgram(rhs.mShaderProgram),
         bError(rhs.bError) {
@@ -29,6 +40,11 @@ struct ShaderProgram {
   bool getError() const { return bError; }
   std::string getErrorDesc() const { return mErrorDesc; }
 
+  //! Whether the driver can save and load linked programs.
+  static bool isBinarySupported();
+  //! Empty if unsupported.
+  ProgramBinary getBinary() const;
+
 private:
   std::string mErrorDesc;
   u32 mShaderProgram;
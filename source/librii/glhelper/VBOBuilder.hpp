@@ -1,6 +1,8 @@
 #pragma once
 
+#include <algorithm>
 #include <core/common.h>
+#include <cstring>
 #include <map>
 #include <memory>
 #include <tuple>
@@ -25,6 +27,9 @@ struct VBOBuilder {
 
   std::vector<u8> mData;
   std::vector<u32> mIndices;
+  // Vertices in mPropogating, for builders that share vertices between indices.
+  // Others just emit one vertex per index.
+  u32 mVertexCount = 0;
 
   struct VertexArray {
     VAOEntry descriptor;
@@ -38,11 +43,33 @@ struct VBOBuilder {
 
   void uploadIndexBuffer();
 
+  void clear() {
+    mData.clear();
+    mIndices.clear();
+    mVertexCount = 0;
+    mPropogating.clear();
+  }
+
+  // Stable reference: look a stream up once, not per vertex.
+  VertexArray& attribute(u32 binding_point) {
+    return mPropogating[binding_point];
+  }
+  // Make room for |bytes| more, growing geometrically across calls.
+  static void reserve(VertexArray& attrib, std::size_t bytes) {
+    const std::size_t needed = attrib.data.size() + bytes;
+    if (needed > attrib.data.capacity()) {
+      attrib.data.reserve(std::max(needed, attrib.data.capacity() * 2));
+    }
+  }
+
   template <typename T> void pushData(u32 binding_point, const T& data) {
-    auto& attrib_buf = mPropogating[binding_point];
+    pushData(mPropogating[binding_point], data);
+  }
+  template <typename T>
+  static void pushData(VertexArray& attrib_buf, const T& data) {
     const std::size_t begin = attrib_buf.data.size();
     attrib_buf.data.resize(attrib_buf.data.size() + sizeof(T));
-    *reinterpret_cast<T*>(attrib_buf.data.data() + begin) = data;
+    std::memcpy(attrib_buf.data.data() + begin, &data, sizeof(T));
   }
 
   void bind();
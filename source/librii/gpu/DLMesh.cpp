@@ -1,60 +1,123 @@
 #include "DLMesh.hpp"
 
-namespace librii::gpu {
+#include <rsl/ParallelFor.hpp>
 
-// This is always BE
-constexpr oishii::EndianSelect CmdProcEndian = oishii::EndianSelect::Big;
+namespace librii::gpu {
 
-static std::expected<u16, std::string> ProcessAttr(
-    oishii::BinaryReader& reader,
-    const std::map<gx::VertexAttribute, gx::VertexAttributeType>& attribstypes,
-    gx::VertexAttribute a, u32 vi) {
-  u16 val = 0;
+static constexpr size_t MaxFields =
+    static_cast<size_t>(gx::VertexAttribute::Max);
 
-  switch (attribstypes.at(a)) {
-  case gx::VertexAttributeType::None:
-    break;
-  case gx::VertexAttributeType::Byte:
-    val = TRY(reader.tryRead<u8, CmdProcEndian, true>());
-    EXPECT(val != 0xff);
-    break;
-  case gx::VertexAttributeType::Short:
-    val = TRY(reader.tryRead<u16, CmdProcEndian, true>());
-    if (val == 0xffff) {
-      printf("Index: %u, Attribute: %x\n", vi, (u32)a);
-      reader.warnAt("Disabled vertex", reader.tell() - 2, reader.tell());
+Result<VertexLayout> VertexLayout::make(const gx::VertexDescriptor& descriptor,
+                                        bool rejectDisabled) {
+  VertexLayout layout;
+  for (size_t a = 0; a < MaxFields; ++a) {
+    if ((descriptor.mBitfield & (1 << a)) == 0)
+      continue;
+    const auto attr = static_cast<gx::VertexAttribute>(a);
+    const auto it = descriptor.mAttributes.find(attr);
+    EXPECT(it != descriptor.mAttributes.end(),
+           "Vertex descriptor is missing an enabled attribute");
+    const bool matrix =
+        attr == gx::VertexAttribute::PositionNormalMatrixIndex ||
+        gx::IsTexNMtxIdx(attr);
+    u32 size = 0;
+    switch (it->second) {
+    case gx::VertexAttributeType::None:
+      continue;
+    case gx::VertexAttributeType::Direct:
+      // As PNM indices are always direct, we
+      // still use them in an all-indexed vertex
+      if (!matrix) {
+        return std::unexpected("Direct vertex data is unsupported.");
+      }
+      size = 1;
+      break;
+    case gx::VertexAttributeType::Byte:
+      size = 1;
+      break;
+    case gx::VertexAttributeType::Short:
+      size = 2;
+      break;
+    default:
+      return std::unexpected("Unknown vertex attribute format.");
     }
-    EXPECT(val != 0xffff);
-    break;
-  case gx::VertexAttributeType::Direct:
-    if (a != gx::VertexAttribute::PositionNormalMatrixIndex &&
-        a != gx::VertexAttribute::Texture0MatrixIndex &&
-        a != gx::VertexAttribute::Texture1MatrixIndex) {
+    layout.mFields[layout.mCount++] = {
+        .attr = attr,
+        .offset = static_cast<u8>(layout.mStride),
+        .wide = static_cast<u8>(size - 1),
+        // Out of range of an index: never matches
+        .disabled = rejectDisabled ? (1u << (8 * size)) - 1 : 0x10000u,
+        .buffer = !matrix,
+    };
+    layout.mStride += size;
+  }
+  return layout;
+}
 
-      return std::unexpected("Direct vertex data is unsupported.");
+// One instance per number of fields, so the loop over fields unrolls.
+//
+// @return Whether a disabled vertex was read.
+template <size_t N>
+static bool DecodeFixed(const u8* data, const VertexLayout::Field* fields,
+                        u32 stride, std::span<gx::IndexedVertex> out,
+                        u16* maxIndex) {
+  std::array<VertexLayout::Field, N> f;
+  std::copy_n(fields, N, f.begin());
+  std::array<u16, N> hi{};
+  bool disabled = false;
+  for (auto& vtx : out) {
+    for (size_t j = 0; j < N; ++j) {
+      // Big endian; for 8-bit indices, the same byte is read twice and the
+      // second read masked off.
+      const u32 w = f[j].wide;
+      const u16 val =
+          static_cast<u16>((data[f[j].offset] << (8 * w)) |
+                           (data[f[j].offset + w] & (0u - w)));
+      vtx[f[j].attr] = val;
+      hi[j] = std::max(hi[j], val);
+      disabled |= val == f[j].disabled;
     }
-    // As PNM indices are always direct, we
-    // still use them in an all-indexed vertex
-    val = TRY(reader.tryRead<u8, CmdProcEndian, true>());
-    EXPECT(val != 0xff);
-    break;
-  default:
-    return std::unexpected("Unknown vertex attribute format.");
+    data += stride;
   }
-
-  return val;
+  std::copy_n(hi.begin(), N, maxIndex);
+  return disabled;
 }
 
-Result<void>
-DecodeMeshDisplayList(oishii::BinaryReader& reader, u32 start, u32 size,
-                      IMeshDLDelegate& delegate,
-                      const librii::gx::VertexDescriptor& descriptor,
-                      std::map<gx::VertexBufferAttribute, u32>* optUsageMap) {
-  oishii::Jump<oishii::Whence::Set> g(reader, start);
+using DecodeFn = bool (*)(const u8*, const VertexLayout::Field*, u32,
+                          std::span<gx::IndexedVertex>, u16*);
+static constexpr auto DecodeTable = []<size_t... N>(std::index_sequence<N...>) {
+  return std::array<DecodeFn, sizeof...(N)>{&DecodeFixed<N>...};
+}(std::make_index_sequence<MaxFields + 1>{});
+
+Result<void> DecodeVertices(std::span<const u8> data,
+                            const VertexLayout& layout,
+                            std::span<gx::IndexedVertex> out,
+                            VertexBufferUsage* usage) {
+  EXPECT(static_cast<u64>(layout.stride()) * out.size() <= data.size(),
+         "Vertex data runs past the end of the display list");
+  const auto fields = layout.fields();
+  std::array<u16, MaxFields> hi{};
+  const bool disabled = DecodeTable[fields.size()](
+      data.data(), fields.data(), layout.stride(), out, hi.data());
+  EXPECT(!disabled, "Disabled vertex (index of 0xFF or 0xFFFF)");
+  if (usage != nullptr && !out.empty()) {
+    for (size_t j = 0; j < fields.size(); ++j) {
+      if (fields[j].buffer) {
+        s32& m = usage->maxIndex[static_cast<size_t>(fields[j].attr)];
+        m = std::max<s32>(m, hi[j]);
+      }
+    }
+  }
+  return {};
+}
 
-  const u32 end = reader.tell() + size;
-  while (reader.tell() < end) {
-    const u8 tag = TRY(reader.tryRead<u8, CmdProcEndian, true>());
+Result<void> DecodeMeshDisplayList(std::span<const u8> dl,
+                                   const VertexLayout& layout,
+                                   std::vector<gx::IndexedPrimitive>& out,
+                                   VertexBufferUsage* usage) {
+  size_t pos = 0;
+  while (pos < dl.size()) {
+    const u8 tag = dl[pos++];
 
     // NOP
     if (tag == 0)
@@ -64,31 +127,46 @@ DecodeMeshDisplayList(oishii::BinaryReader& reader, u32 start, u32 size,
       return std::unexpected("Unexpected command in mesh display list.");
     }
 
-    u16 nVerts = TRY(reader.tryRead<u16, CmdProcEndian, true>());
-    auto& prim = delegate.addIndexedPrimitive(
-        gx::DecodeDrawPrimitiveCommand(tag), nVerts);
-
-    for (u16 vi = 0; vi < nVerts; ++vi) {
-      for (int a = 0; a < (int)gx::VertexAttribute::Max; ++a) {
-        if (descriptor.mBitfield & (1 << a)) {
-          const auto attr = static_cast<gx::VertexAttribute>(a);
-          const auto attr_buf = static_cast<gx::VertexBufferAttribute>(a);
+    EXPECT(pos + 2 <= dl.size(),
+           "Draw command runs past the end of the display list");
+    const u16 nVerts = static_cast<u16>((dl[pos] << 8) | dl[pos + 1]);
+    pos += 2;
+    auto& prim =
+        out.emplace_back(gx::DecodeDrawPrimitiveCommand(tag), nVerts);
+    TRY(DecodeVertices(dl.subspan(pos), layout, prim.mVertices, usage));
+    pos += static_cast<size_t>(nVerts) * layout.stride();
+  }
 
-          const u16 val =
-              TRY(ProcessAttr(reader, descriptor.mAttributes, attr, vi));
-          prim.mVertices[vi][attr] = val;
+  return {};
+}
 
-          // TODO: Probably don't validate this here
-          if (attr != gx::VertexAttribute::PositionNormalMatrixIndex &&
-              !IsTexNMtxIdx(attr)) {
-            if (optUsageMap && (*optUsageMap)[attr_buf] <= val)
-              (*optUsageMap)[attr_buf] = val;
-          }
-        }
-      }
+Result<void> DecodeMeshDisplayLists(std::span<const MeshDisplayList> lists,
+                                    VertexBufferUsage* usage,
+                                    unsigned num_threads) {
+  size_t bytes = 0;
+  for (const auto& list : lists) {
+    bytes += list.data.size();
+  }
+  // Small models decode faster than threads start up
+  if (bytes < 64 * 1024) {
+    num_threads = 1;
+  }
+  std::vector<Result<void>> results(lists.size());
+  std::vector<VertexBufferUsage> usages(lists.size());
+  rsl::ParallelFor(lists.size(), num_threads, [&](size_t i) {
+    results[i] = [&]() -> Result<void> {
+      const auto& list = lists[i];
+      const auto layout = TRY(VertexLayout::make(*list.descriptor));
+      return DecodeMeshDisplayList(list.data, layout, *list.primitives,
+                                   &usages[i]);
+    }();
+  });
+  for (size_t i = 0; i < lists.size(); ++i) {
+    TRY(results[i]);
+    if (usage != nullptr) {
+      usage->merge(usages[i]);
     }
   }
-
   return {};
 }
 
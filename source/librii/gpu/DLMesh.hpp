@@ -1,20 +1,103 @@
 #pragma once
 
+#include <algorithm>
 #include <librii/gx.h>
-#include <map>
-#include <oishii/reader/binary_reader.hxx>
+#include <span>
 
 namespace librii::gpu {
 
-struct IMeshDLDelegate {
-  virtual gx::IndexedPrimitive& addIndexedPrimitive(gx::PrimitiveType type,
-                                                    u16 nVerts) = 0;
+//! Highest index referenced in each vertex buffer.
+struct VertexBufferUsage {
+  static constexpr size_t NumAttributes =
+      static_cast<size_t>(gx::VertexBufferAttribute::Max);
+  //! -1 for buffers that are not referenced.
+  std::array<s32, NumAttributes> maxIndex;
+
+  VertexBufferUsage() { maxIndex.fill(-1); }
+
+  bool used(gx::VertexBufferAttribute attr) const {
+    return maxIndex[static_cast<size_t>(attr)] >= 0;
+  }
+  //! Number of entries of the buffer that are referenced.
+  u32 count(gx::VertexBufferAttribute attr) const {
+    return static_cast<u32>(maxIndex[static_cast<size_t>(attr)] + 1);
+  }
+  void merge(const VertexBufferUsage& other) {
+    for (size_t i = 0; i < NumAttributes; ++i) {
+      maxIndex[i] = std::max(maxIndex[i], other.maxIndex[i]);
+    }
+  }
+  bool operator==(const VertexBufferUsage&) const = default;
+};
+
+//! @brief The byte layout of an indexed vertex in a display list, compiled
+//! from a vertex descriptor.
+//!
+//! Every attribute sits at a fixed offset, so vertices are decoded without
+//! branching on the descriptor.
+//!
+class VertexLayout {
+public:
+  struct Field {
+    gx::VertexAttribute attr;
+    u8 offset;
+    //! 1 for 16-bit indices, 0 for 8-bit ones.
+    u8 wide;
+    //! Index of a disabled vertex (0xFF or 0xFFFF), which is rejected.
+    u32 disabled;
+    //! Whether the index refers to a vertex buffer (not a matrix).
+    bool buffer;
+  };
+
+  //! J3D rejects disabled vertices; G3D reads their indices as they are.
+  static Result<VertexLayout> make(const gx::VertexDescriptor& descriptor,
+                                   bool rejectDisabled = true);
+
+  std::span<const Field> fields() const { return {mFields.data(), mCount}; }
+  //! Bytes per vertex.
+  u32 stride() const { return mStride; }
+
+private:
+  std::array<Field, static_cast<size_t>(gx::VertexAttribute::Max)> mFields{};
+  u32 mCount = 0;
+  u32 mStride = 0;
+};
+
+//! @brief Decode |out.size()| consecutive vertices from |data|.
+//!
+//! @param[in]  data   Starts at the first vertex.
+//! @param[in]  layout Layout of a vertex.
+//! @param[out] out    Receives the vertices.
+//! @param[out] usage  Optional: updated with the indices read.
+//!
+Result<void> DecodeVertices(std::span<const u8> data,
+                            const VertexLayout& layout,
+                            std::span<gx::IndexedVertex> out,
+                            VertexBufferUsage* usage = nullptr);
+
+//! @brief Decode a display list of draw commands (and NOPs), appending a
+//! primitive to |out| per draw.
+//!
+//! @param[out] usage Optional: updated with the indices read.
+//!
+Result<void> DecodeMeshDisplayList(std::span<const u8> dl,
+                                   const VertexLayout& layout,
+                                   std::vector<gx::IndexedPrimitive>& out,
+                                   VertexBufferUsage* usage = nullptr);
+
+struct MeshDisplayList {
+  std::span<const u8> data;
+  const gx::VertexDescriptor* descriptor;
+  std::vector<gx::IndexedPrimitive>* primitives;
 };
 
-Result<void>
-DecodeMeshDisplayList(oishii::BinaryReader& reader, u32 start, u32 size,
-                      IMeshDLDelegate& delegate,
-                      const gx::VertexDescriptor& descriptor,
-                      std::map<gx::VertexBufferAttribute, u32>* optUsageMap);
+//! @brief Decode independent display lists on up to |num_threads| threads
+//! (0 = one per core).
+//!
+//! @return The error of the first list that failed, if any.
+//!
+Result<void> DecodeMeshDisplayLists(std::span<const MeshDisplayList> lists,
+                                    VertexBufferUsage* usage = nullptr,
+                                    unsigned num_threads = 0);
 
 } // namespace librii::gpu
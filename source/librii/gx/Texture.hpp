@@ -10,6 +10,8 @@ enum {
   _CTF = 0x20,
   _ZTF = 0x10,
 };
+// Values are the hardware's (TX_SETIMAGE0 format field). TEX0 and TEX1 store
+// them as-is and are read by casting, so they must not be renumbered.
 enum class TextureFormat {
   I4,
   I8,
@@ -19,13 +21,16 @@ enum class TextureFormat {
   RGB5A3,
   RGBA8,
 
-  C4,
+  C4 = 0x8,
   C8,
   C14X2,
   CMPR = 0xE,
 
   Extension_RawRGBA32 = 0xFF
 };
+static_assert(static_cast<int>(TextureFormat::RGBA8) == 0x6);
+static_assert(static_cast<int>(TextureFormat::C4) == 0x8);
+static_assert(static_cast<int>(TextureFormat::C14X2) == 0xA);
 
 inline bool IsPaletteFormat(TextureFormat format) {
   switch (format) {
@@ -286,6 +286,47 @@ inline Result<T> readGenericComponents(oishii::BinaryReader& reader,
   return out;
 }
 
+//! Read |out.size()| entries of |true_count| components each. The raw
+//! scalars are fetched with one bulk read and dequantized afterwards.
+template <typename T>
+inline Result<void> readGenericComponentsArray(
+    oishii::BinaryReader& reader, gx::VertexBufferType::Generic type,
+    std::size_t true_count, std::span<T> out, u32 divisor = 0) {
+  EXPECT(true_count <= 3 && true_count >= 1);
+  const auto count = static_cast<u32>(out.size() * true_count);
+
+  const auto dequantize = [&]<typename S>() -> Result<void> {
+    const auto raw = TRY(reader.tryReadBuffer<S>(count));
+    const f32 scale = 1.0f / static_cast<f32>(1 << divisor);
+    auto it = raw.begin();
+    for (auto& entry : out) {
+      entry = T{};
+      for (std::size_t i = 0; i < true_count; ++i) {
+        if constexpr (std::is_same_v<S, f32>) {
+          ((f32*)&entry.x)[i] = *it++;
+        } else {
+          ((f32*)&entry.x)[i] = static_cast<f32>(*it++) * scale;
+        }
+      }
+    }
+    return {};
+  };
+
+  switch (type) {
+  case gx::VertexBufferType::Generic::u8:
+    return dequantize.template operator()<u8>();
+  case gx::VertexBufferType::Generic::s8:
+    return dequantize.template operator()<s8>();
+  case gx::VertexBufferType::Generic::u16:
+    return dequantize.template operator()<u16>();
+  case gx::VertexBufferType::Generic::s16:
+    return dequantize.template operator()<s16>();
+  case gx::VertexBufferType::Generic::f32:
+    return dequantize.template operator()<f32>();
+  }
+  EXPECT(false, "Invalid VertexBufferType::Generic");
+}
+
 template <typename T>
 inline Result<T> readComponents(oishii::BinaryReader& reader,
                                 gx::VertexBufferType type,
@@ -416,6 +457,12 @@ template <typename TB, VBufferKind kind> struct VertexBuffer {
         mQuant.divisor));
     return {};
   }
+  //! Fill all of mData from |reader| with a single bulk read.
+  Result<void> readBufferGeneric(oishii::BinaryReader& reader) {
+    return readGenericComponentsArray<TB>(reader, mQuant.type.generic,
+                                          TRY(ComputeComponentCount()),
+                                          mData, mQuant.divisor);
+  }
   Result<void> readBufferEntryColor(oishii::BinaryReader& reader,
                                     librii::gx::Color& result) {
     result = TRY(readColorComponents(reader, mQuant.type.color));
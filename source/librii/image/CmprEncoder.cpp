@@ -3,9 +3,17 @@
  * @brief CMPR encoding. Based on WIMGT's implementation.
  */
 
+#include "CmprEncoder.hpp"
+
 #include <core/common.h>
 
+#include <glm/geometric.hpp>
+#include <glm/mat3x3.hpp>
+#include <glm/vec3.hpp>
+#include <limits>
 #include <oishii/util/util.hxx>
+#include <rsl/ParallelFor.hpp>
+#include <rsl/Simd.hpp>
 
 IMPORT_STD;
 
@@ -246,7 +254,94 @@ CMPR_close_info(const u8* data,    // source data
   }
 }
 
-static inline void WIMGT_CMPR(const u8* data, cmpr_info_t* info) {
+
+//---- palette error
+
+#ifdef RSL_HAS_SSE2
+
+// The 16 pixels of a block as four rows of RGBA lanes.
+struct cmpr_block_t {
+  __m128i px[4];
+  __m128i opaque[4]; // all bits set for pixels with alpha >= 0x80
+};
+
+static inline void load_block(const u8* data, cmpr_block_t* blk) {
+  for (u32 i = 0; i < 4; i++) {
+    blk->px[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data) + i);
+    blk->opaque[i] = _mm_srai_epi32(blk->px[i], 31);
+  }
+}
+
+// Per-pixel calc_distance(): the RGB bytes of |d| summed in each lane
+static inline __m128i lane_distance(__m128i px, __m128i col) {
+  const __m128i lo = _mm_set1_epi32(0xff);
+  const __m128i d = _mm_and_si128(
+      _mm_or_si128(_mm_subs_epu8(px, col), _mm_subs_epu8(col, px)),
+      _mm_set1_epi32(0x00ffffff));
+  return _mm_add_epi32(_mm_add_epi32(_mm_and_si128(d, lo),
+                                     _mm_and_si128(_mm_srli_epi32(d, 8), lo)),
+                       _mm_srli_epi32(d, 16));
+}
+
+// Sum over the opaque pixels of the distance to the closest of the first N
+// palette entries. Equal to the scalar loop of WIMGT; |limit| is only used
+// there to stop early.
+template <u32 N>
+static inline u32 palette_error(const cmpr_block_t& blk, const u8 (*pal)[4],
+                                u32 /* limit */) {
+  __m128i col[N];
+  for (u32 i = 0; i < N; i++) {
+    col[i] = _mm_set1_epi32(pal[i][0] | pal[i][1] << 8 | pal[i][2] << 16);
+  }
+  __m128i sum = _mm_setzero_si128();
+  for (u32 r = 0; r < 4; r++) {
+    __m128i best = lane_distance(blk.px[r], col[0]);
+    for (u32 i = 1; i < N; i++) {
+      // Distances are below 0x300, so the upper half of each lane stays zero
+      best = _mm_min_epi16(best, lane_distance(blk.px[r], col[i]));
+    }
+    sum = _mm_add_epi32(sum, _mm_and_si128(best, blk.opaque[r]));
+  }
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+  return static_cast<u32>(_mm_cvtsi128_si32(sum));
+}
+
+#else
+
+struct cmpr_block_t {
+  const u8* data;
+};
+
+static inline void load_block(const u8* data, cmpr_block_t* blk) {
+  blk->data = data;
+}
+
+template <u32 N>
+static inline u32 palette_error(const cmpr_block_t& blk, const u8 (*pal)[4],
+                                u32 limit) {
+  u32 dist = 0;
+  const u8* data_end = blk.data + CMPR_DATA_SIZE;
+  for (const u8* dat = blk.data; dat < data_end && dist < limit; dat += 4) {
+    if (dat[3] & 0x80) {
+      u32 best = calc_distance(dat, pal[0]);
+      for (u32 i = 1; i < N; i++) {
+        best = std::min(best, calc_distance(dat, pal[i]));
+      }
+      dist += best;
+    }
+  }
+  return dist;
+}
+
+#endif // RSL_HAS_SSE2
+
+//---- CmprQuality::Normal
+
+// Tries every pair of distinct (quantized) block colors as endpoints.
+// Returns the number of distinct colors.
+static inline u32 WIMGT_CMPR(const u8* data, const cmpr_block_t& blk,
+                             cmpr_info_t* info) {
   assert(info);
   memset(info, 0, sizeof(*info));
 
@@ -284,99 +379,315 @@ static inline void WIMGT_CMPR(const u8* data, cmpr_info_t* info) {
 
   info->opaque_count = opaque_count;
   if (!opaque_count)
-    return;
+    return 0;
 
   assert(n_sum);
   if (n_sum < 3) {
     memcpy(info->p[0], sum[0].col, 4);
     memcpy(info->p[1], sum[n_sum - 1].col, 4);
-    return;
+    return n_sum;
   }
 
   assert(opaque_count >= 3);
 
   u32 best0 = 0, best1 = 0, max_dist = (u32)-1;
-  if (info->opaque_count < CMPR_MAX_COL) {
-    // we have transparent points -> 1 middle point
-
-    for (u32 s0 = 0; s0 < n_sum; s0++) {
-      u8* pal0 = sum[s0].col;
-      for (u32 s1 = s0 + 1; s1 < n_sum; s1++) {
-        u8* pal1 = sum[s1].col;
-        u8 pal2[4];
-        pal2[0] = (pal0[0] + pal1[0]) / 2;
-        pal2[1] = (pal0[1] + pal1[1]) / 2;
-        pal2[2] = (pal0[2] + pal1[2]) / 2;
-
-        u32 dist = 0;
-        const u8* dat;
-        for (dat = data; dat < data_end && dist < max_dist; dat += 4) {
-          if (dat[3] & 0x80) {
-            const u32 d0 = calc_distance(dat, pal0);
-            const u32 d1 = calc_distance(dat, pal1);
-            const u32 d2 = calc_distance(dat, pal2);
-            if (d0 <= d1)
-              dist += d0 < d2 ? d0 : d2;
-            else
-              dist += d1 < d2 ? d1 : d2;
-          }
-        }
-        if (max_dist > dist) {
-          max_dist = dist;
-          best0 = s0;
-          best1 = s1;
-        }
+  for (u32 s0 = 0; s0 < n_sum; s0++) {
+    const u8* pal0 = sum[s0].col;
+    for (u32 s1 = s0 + 1; s1 < n_sum; s1++) {
+      const u8* pal1 = sum[s1].col;
+      u8 pal[4][4];
+      memcpy(pal[0], pal0, 4);
+      memcpy(pal[1], pal1, 4);
+
+      u32 dist;
+      if (info->opaque_count < CMPR_MAX_COL) {
+        // we have transparent points -> 1 middle point
+        pal[2][0] = (pal0[0] + pal1[0]) / 2;
+        pal[2][1] = (pal0[1] + pal1[1]) / 2;
+        pal[2][2] = (pal0[2] + pal1[2]) / 2;
+        dist = palette_error<3>(blk, pal, max_dist);
+      } else {
+        // no transparent points -> 2 middle point
+        pal[2][0] = (2 * pal0[0] + pal1[0]) / 3;
+        pal[2][1] = (2 * pal0[1] + pal1[1]) / 3;
+        pal[2][2] = (2 * pal0[2] + pal1[2]) / 3;
+        pal[3][0] = (pal0[0] + 2 * pal1[0]) / 3;
+        pal[3][1] = (pal0[1] + 2 * pal1[1]) / 3;
+        pal[3][2] = (pal0[2] + 2 * pal1[2]) / 3;
+        dist = palette_error<4>(blk, pal, max_dist);
+      }
+      if (max_dist > dist) {
+        max_dist = dist;
+        best0 = s0;
+        best1 = s1;
       }
     }
-  } else {
-    // no transparent points -> 2 middle point
-
-    u32 s0;
-    for (s0 = 0; s0 < n_sum; s0++) {
-      u8* pal0 = sum[s0].col;
-      u32 s1;
-      for (s1 = s0 + 1; s1 < n_sum; s1++) {
-        u8* pal1 = sum[s1].col;
-        u8 pal2[4];
-        pal2[0] = (2 * pal0[0] + pal1[0]) / 3;
-        pal2[1] = (2 * pal0[1] + pal1[1]) / 3;
-        pal2[2] = (2 * pal0[2] + pal1[2]) / 3;
-        u8 pal3[4];
-        pal3[0] = (pal0[0] + 2 * pal1[0]) / 3;
-        pal3[1] = (pal0[1] + 2 * pal1[1]) / 3;
-        pal3[2] = (pal0[2] + 2 * pal1[2]) / 3;
-
-        u32 dist = 0;
-        const u8* dat;
-        for (dat = data; dat < data_end && dist < max_dist; dat += 4) {
-          const u32 d0 = calc_distance(dat, pal0);
-          const u32 d1 = calc_distance(dat, pal1);
-          const u32 d2 = calc_distance(dat, pal2);
-          const u32 d3 = calc_distance(dat, pal3);
-          if (d0 <= d1) {
-            if (d2 <= d3)
-              dist += d0 < d2 ? d0 : d2;
-            else
-              dist += d0 < d3 ? d0 : d3;
-          } else {
-            if (d2 <= d3)
-              dist += d1 <= d2 ? d1 : d2;
-            else
-              dist += d1 <= d3 ? d1 : d3;
+  }
+
+  memcpy(info->p[0], sum[best0].col, 4);
+  memcpy(info->p[1], sum[best1].col, 4);
+  return n_sum;
+}
+
+//---- CmprQuality::Fast and CmprQuality::High
+
+struct cmpr_points_t {
+  glm::vec3 p[CMPR_MAX_COL];
+  u32 n;
+};
+
+static inline void gather_opaque(const u8* data, cmpr_points_t* pts) {
+  pts->n = 0;
+  for (const u8* dat = data; dat < data + CMPR_DATA_SIZE; dat += 4) {
+    if (dat[3] & 0x80) {
+      pts->p[pts->n++] = glm::vec3(dat[0], dat[1], dat[2]);
+    }
+  }
+}
+
+// Principal axis of the points by power iteration on their covariance.
+// Zero if all points are equal.
+static glm::vec3 principal_axis(const cmpr_points_t& pts) {
+  glm::vec3 mean(0.0f);
+  for (u32 i = 0; i < pts.n; i++) {
+    mean += pts.p[i];
+  }
+  mean /= static_cast<float>(pts.n);
+
+  glm::mat3 cov(0.0f);
+  for (u32 i = 0; i < pts.n; i++) {
+    const glm::vec3 d = pts.p[i] - mean;
+    cov += glm::outerProduct(d, d);
+  }
+
+  glm::vec3 axis(1.0f);
+  for (u32 i = 0; i < 8; i++) {
+    axis = cov * axis;
+    const float m = std::max({std::abs(axis.x), std::abs(axis.y),
+                              std::abs(axis.z)});
+    if (m == 0.0f) {
+      return glm::vec3(0.0f);
+    }
+    axis /= m;
+  }
+  return axis;
+}
+
+static inline void set_endpoint(u8* pal, glm::vec3 c) {
+  c = glm::clamp(glm::round(c), 0.0f, 255.0f);
+  pal[0] = static_cast<u8>(c.x);
+  pal[1] = static_cast<u8>(c.y);
+  pal[2] = static_cast<u8>(c.z);
+  pal[3] = 0xff;
+}
+
+// Endpoints at the extremes of the principal axis
+static inline void Fast_CMPR(const u8* data, cmpr_info_t* info) {
+  assert(info);
+  memset(info, 0, sizeof(*info));
+
+  cmpr_points_t pts;
+  gather_opaque(data, &pts);
+  info->opaque_count = pts.n;
+  if (!pts.n)
+    return;
+
+  const glm::vec3 axis = principal_axis(pts);
+  u32 lo = 0, hi = 0;
+  float lo_dot = glm::dot(pts.p[0], axis), hi_dot = lo_dot;
+  for (u32 i = 1; i < pts.n; i++) {
+    const float d = glm::dot(pts.p[i], axis);
+    if (d < lo_dot) {
+      lo_dot = d;
+      lo = i;
+    } else if (d > hi_dot) {
+      hi_dot = d;
+      hi = i;
+    }
+  }
+  set_endpoint(info->p[0], pts.p[hi]);
+  set_endpoint(info->p[1], pts.p[lo]);
+}
+
+// Cluster fit: with the points ordered along the principal axis, every split
+// of that order into N runs (one per palette entry, weighted by |alpha| toward
+// endpoint a) is solved for the least-squares endpoints.
+template <u32 N> struct ClusterFit {
+  struct Sums {
+    float aa = 0.0f, bb = 0.0f, ab = 0.0f;
+    glm::vec3 ax{0.0f}, bx{0.0f};
+  };
+
+  ClusterFit(const cmpr_points_t& pts, const float (&alpha)[N])
+      : n(pts.n), alpha(alpha) {
+    const glm::vec3 axis = principal_axis(pts);
+    u32 order[CMPR_MAX_COL];
+    float dots[CMPR_MAX_COL];
+    for (u32 i = 0; i < n; i++) {
+      order[i] = i;
+      dots[i] = glm::dot(pts.p[i], axis);
+    }
+    std::sort(order, order + n,
+              [&](u32 l, u32 r) { return dots[l] > dots[r]; });
+    prefix[0] = glm::vec3(0.0f);
+    for (u32 i = 0; i < n; i++) {
+      prefix[i + 1] = prefix[i] + pts.p[order[i]];
+    }
+  }
+
+  // Points [begin, end) take palette entry |cluster|
+  void add(Sums& s, u32 cluster, u32 begin, u32 end) const {
+    const float count = static_cast<float>(end - begin);
+    const float a = alpha[cluster], b = 1.0f - a;
+    const glm::vec3 x = prefix[end] - prefix[begin];
+    s.aa += a * a * count;
+    s.bb += b * b * count;
+    s.ab += a * b * count;
+    s.ax += a * x;
+    s.bx += b * x;
+  }
+
+  void search(u32 cluster, u32 begin, Sums s) {
+    if (cluster == N - 1) {
+      add(s, cluster, begin, n);
+      solve(s);
+      return;
+    }
+    for (u32 end = begin; end <= n; end++) {
+      Sums next = s;
+      add(next, cluster, begin, end);
+      search(cluster + 1, end, next);
+    }
+  }
+
+  void solve(const Sums& s) {
+    const float det = s.aa * s.bb - s.ab * s.ab;
+    if (std::abs(det) < 1e-6f) {
+      return;
+    }
+    const glm::vec3 a =
+        glm::clamp((s.ax * s.bb - s.bx * s.ab) / det, 0.0f, 255.0f);
+    const glm::vec3 b =
+        glm::clamp((s.bx * s.aa - s.ax * s.ab) / det, 0.0f, 255.0f);
+    // Squared error, less the constant sum of |x|^2
+    const float err = glm::dot(a, a) * s.aa + glm::dot(b, b) * s.bb +
+                      2.0f * (s.ab * glm::dot(a, b) - glm::dot(a, s.ax) -
+                              glm::dot(b, s.bx));
+    if (err < best) {
+      best = err;
+      best_a = a;
+      best_b = b;
+    }
+  }
+
+  u32 n;
+  const float (&alpha)[N];
+  glm::vec3 prefix[CMPR_MAX_COL + 1];
+  float best = std::numeric_limits<float>::infinity();
+  glm::vec3 best_a{0.0f}, best_b{0.0f};
+};
+
+// The palette of an encoded block as the hardware decodes it: endpoints are
+// expanded by bit replication and blended 5:3 rather than 2:1.
+static inline void decode_palette(const u8* block, u8 (*pal)[4]) {
+  const u16 p0 = block[0] << 8 | block[1];
+  const u16 p1 = block[2] << 8 | block[3];
+  const u16 p[2] = {p0, p1};
+  for (u32 i = 0; i < 2; i++) {
+    const u32 r = p[i] >> 11, g = p[i] >> 5 & 0x3f, b = p[i] & 0x1f;
+    pal[i][0] = r << 3 | r >> 2;
+    pal[i][1] = g << 2 | g >> 4;
+    pal[i][2] = b << 3 | b >> 2;
+  }
+  for (u32 c = 0; c < 3; c++) {
+    if (p0 > p1) {
+      pal[2][c] = (pal[0][c] * 5 + pal[1][c] * 3) >> 3;
+      pal[3][c] = (pal[0][c] * 3 + pal[1][c] * 5) >> 3;
+    } else {
+      pal[2][c] = pal[3][c] = (pal[0][c] + pal[1][c]) / 2;
+    }
+  }
+}
+
+static inline u32 squared_distance(const u8* v1, const u8* v2) {
+  u32 err = 0;
+  for (u32 c = 0; c < 3; c++) {
+    const int d = (int)v1[c] - (int)v2[c];
+    err += d * d;
+  }
+  return err;
+}
+
+// Reassign the indices of the opaque pixels of an encoded block to the closest
+// decoded palette entry. Returns the squared RGB error.
+static inline u32 refit_indices(const u8* data, u8* block) {
+  u8 pal[4][4];
+  decode_palette(block, pal);
+  // Entry 3 is transparent in three-color blocks
+  const u32 n_pal =
+      (block[0] << 8 | block[1]) > (block[2] << 8 | block[3]) ? 4 : 3;
+  u32 err = 0;
+  for (u32 i = 0; i < 4; i++) {
+    u8 val = 0;
+    for (u32 j = 0; j < 4; j++, data += 4) {
+      val <<= 2;
+      if (data[3] & 0x80) {
+        u32 best = 0, best_err = squared_distance(data, pal[0]);
+        for (u32 k = 1; k < n_pal; k++) {
+          const u32 e = squared_distance(data, pal[k]);
+          if (e < best_err) {
+            best = k;
+            best_err = e;
           }
         }
-        if (max_dist > dist) {
-          max_dist = dist;
-          best0 = s0;
-          best1 = s1;
-        }
+        val |= best;
+        err += best_err;
+      } else {
+        val |= 3;
       }
     }
+    block[4 + i] = val;
   }
+  return err;
+}
 
-  memcpy(info->p[0], sum[best0].col, 4);
-  memcpy(info->p[1], sum[best1].col, 4);
+// Cluster fit against the hardware palette. The WIMGT endpoints are kept where
+// they still do better.
+static inline void High_CMPR(const u8* data, const cmpr_block_t& blk,
+                             u8* dest) {
+  cmpr_info_t info;
+  const u32 n_sum = WIMGT_CMPR(data, blk, &info);
+  CMPR_close_info(data, &info, dest);
+  if (!info.opaque_count)
+    return;
+  u32 best = refit_indices(data, dest);
+  if (n_sum < 3 || !best)
+    return;
+
+  cmpr_points_t pts;
+  gather_opaque(data, &pts);
+
+  cmpr_info_t fit = info;
+  if (info.opaque_count < CMPR_MAX_COL) {
+    static constexpr float alpha[3] = {1.0f, 0.5f, 0.0f};
+    ClusterFit<3> cf(pts, alpha);
+    cf.search(0, 0, {});
+    set_endpoint(fit.p[0], cf.best_a);
+    set_endpoint(fit.p[1], cf.best_b);
+  } else {
+    static constexpr float alpha[4] = {1.0f, 5.0f / 8.0f, 3.0f / 8.0f, 0.0f};
+    ClusterFit<4> cf(pts, alpha);
+    cf.search(0, 0, {});
+    set_endpoint(fit.p[0], cf.best_a);
+    set_endpoint(fit.p[1], cf.best_b);
+  }
+  u8 block[8];
+  CMPR_close_info(data, &fit, block);
+  if (refit_indices(data, block) < best) {
+    memcpy(dest, block, 8);
+  }
 }
+
 struct Image_t;
 u32 CalcImageSize(u32 width,  // width of image in pixel
                   u32 height, // height of image in pixel
@@ -428,7 +739,28 @@ CalcImageBlock(u32 width, u32 height,
     *img_size = size;
 }
 
-void EncodeDXT1(u8* dest_img, const u8* source_img, u32 width, u32 height) {
+// Copy the 4x4 pixels at (x, y), repeating the last row and column past the
+// edges of the image.
+static inline void gather_block(u8* vector, const u8* source, u32 width,
+                                u32 height, u32 x, u32 y) {
+  const u32 line_size = width * 4;
+  if (x + 4 <= width && y + 4 <= height) {
+    const u8* src = source + y * line_size + x * 4;
+    for (u32 i = 0; i < 4; i++, vector += 16, src += line_size) {
+      memcpy(vector, src, 16);
+    }
+    return;
+  }
+  for (u32 i = 0; i < 4; i++) {
+    const u8* row = source + std::min(y + i, height - 1) * line_size;
+    for (u32 j = 0; j < 4; j++, vector += 4) {
+      memcpy(vector, row + std::min(x + j, width - 1) * 4, 4);
+    }
+  }
+}
+
+void EncodeDXT1(u8* dest_img, const u8* source_img, u32 width, u32 height,
+                CmprQuality quality) {
   assert(dest_img);
   assert(source_img);
 
@@ -440,45 +772,47 @@ void EncodeDXT1(u8* dest_img, const u8* source_img, u32 width, u32 height) {
   CalcImageBlock(width, height, bits_per_pixel, block_width, block_height,
                  &h_blocks, &v_blocks, &img_size);
 
-  u8* dest = dest_img;
-  const u8* src1 = source_img;
-
-  const u32 block_size = block_width * 4;
+  // Each 8x8 block is four 8-byte DXT1 blocks
+  const u32 row_size = h_blocks * 32;
+  assert(row_size * v_blocks == img_size);
 
-  const u32 xwidth = ((width + 0x1f) & ~0x1f);
-  const u32 line_size = xwidth * 4;
-  const u32 delta[] = {0, 16, 4 * line_size, 4 * line_size + 16};
-
-  while (v_blocks-- > 0) {
-    const u8* src2 = src1;
-    u32 hblk = h_blocks;
-    while (hblk-- > 0) {
+  const auto encode_row = [&](size_t v_block) {
+    u8* dest = dest_img + v_block * row_size;
+    for (u32 h_block = 0; h_block < h_blocks; h_block++) {
       for (u32 subb = 0; subb < 4; subb++) {
         //---- first collect the data of the 16 pixel
 
-        u8 vector[16 * 4], *vect = vector;
-        const u8* src3 = src2 + delta[subb];
-        for (u32 i = 0; i < 4; i++) {
-          memcpy(vect, src3, 16);
-          vect += 16;
-          src3 += line_size;
-        }
-        assert(vect == vector + sizeof(vector));
+        alignas(16) u8 vector[CMPR_DATA_SIZE];
+        gather_block(vector, source_img, width, height,
+                     h_block * block_width + (subb & 1) * 4,
+                     v_block * block_height + (subb >> 1) * 4);
 
         //--- analyze data
 
+        cmpr_block_t blk;
+        load_block(vector, &blk);
         cmpr_info_t info;
-        WIMGT_CMPR(vector, &info);
-        CMPR_close_info(vector, &info, dest);
+        switch (quality) {
+        case CmprQuality::Fast:
+          Fast_CMPR(vector, &info);
+          CMPR_close_info(vector, &info, dest);
+          break;
+        case CmprQuality::Normal:
+          WIMGT_CMPR(vector, blk, &info);
+          CMPR_close_info(vector, &info, dest);
+          break;
+        case CmprQuality::High:
+          High_CMPR(vector, blk, dest);
+          break;
+        }
         dest += 8;
       }
-      src2 += block_size;
     }
-    src1 += line_size * block_height;
-  }
-
-  assert(dest == dest_img + img_size);
-  // assert(src1 <= dest_img->data + dest_img->data_size);
+  };
+  // Rows of blocks are independent. Small images (most mip levels) are not
+  // worth the threads.
+  const unsigned num_threads = width * height >= 128 * 128 ? 0 : 1;
+  rsl::ParallelFor(v_blocks, num_threads, encode_row);
 }
 
 } // namespace librii::image
@@ -4,15 +4,30 @@
 
 namespace librii::image {
 
-//! @brief Encode a RGBA32 buffer to GC DXT1.
+//! @brief Trade-off between CMPR encoding speed and quality.
 //!
-//! @param[in] dest   Pointer to the output buffer. Must be appropriately sized.
-//! (Call procedure)
-//! @param[in] source Pointer to the source buffer. Must be appropriately sized.
-//! (width * height * 4)
-//! @param[in] width  Width of the image.
-//! @param[in] height Height of the image.
+enum class CmprQuality {
+  //! Endpoints at the extremes of the principal color axis.
+  Fast,
+  //! Best pair of block colors as endpoints (WIMGT).
+  Normal,
+  //! Least-squares cluster fit against the palette the hardware decodes,
+  //! where better than Normal.
+  High,
+};
+
+//! @brief Encode a RGBA32 buffer to GC DXT1. Large images are encoded on all
+//! cores.
+//!
+//! @param[in] dest    Pointer to the output buffer. Must be appropriately
+//! sized. (Call procedure)
+//! @param[in] source  Pointer to the source buffer. Must be appropriately
+//! sized. (width * height * 4)
+//! @param[in] width   Width of the image.
+//! @param[in] height  Height of the image.
+//! @param[in] quality Endpoint search to use.
 //!
-void EncodeDXT1(u8* dest, const u8* source, u32 width, u32 height);
+void EncodeDXT1(u8* dest, const u8* source, u32 width, u32 height,
+                CmprQuality quality = CmprQuality::Normal);
 
 } // namespace librii::image
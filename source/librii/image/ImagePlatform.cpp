@@ -6,7 +6,7 @@
 #include <vendor/avir/lancir.h>
 #include <vendor/dolemu/TextureDecoder/TextureDecoder.h>
 
-#include <rsl/Ranges.hpp>
+#include <rsl/ParallelFor.hpp>
 
 IMPORT_STD;
 
@@ -218,9 +218,10 @@ void encodeRGBA8(u8* dst, const u32* src4, u32 width, u32 height) {
 
 // raw 8-bit RGBA -> X
 Result<void> encode(u8* dst, const u8* src, int width, int height,
-                    gx::TextureFormat texformat) {
+                    gx::TextureFormat texformat, CmprQuality cmpr_quality,
+                    Palette* palette) {
   if (texformat == gx::TextureFormat::CMPR) {
-    EncodeDXT1(dst, src, width, height);
+    EncodeDXT1(dst, src, width, height, cmpr_quality);
     return {};
   }
 
@@ -259,8 +260,22 @@ Result<void> encode(u8* dst, const u8* src, int width, int height,
     return {};
   }
 
-  // No palette support
-  return std::unexpected("No palette support");
+  if (gx::IsPaletteFormat(texformat)) {
+    if (palette == nullptr) {
+      return std::unexpected("Palette formats need a palette to encode to");
+    }
+    const u32 max_colors = getPaletteSize(texformat);
+    if (palette->tlut.empty()) {
+      const std::span<const u8> pixels(src, width * height * 4);
+      palette->tlut = QuantizePalette(pixels, max_colors, palette->format);
+    }
+    EXPECT(palette->tlut.size() / 2 <= max_colors);
+    EncodePalette(dst, src, width, height, texformat, palette->tlut,
+                  palette->format, palette->dither);
+    return {};
+  }
+
+  return std::unexpected("Unsupported texture format");
 }
 // Change format, no resizing
 Result<void> reencode(u8* dst, const u8* src, int width, int height,
@@ -271,110 +286,172 @@ Result<void> reencode(u8* dst, const u8* src, int width, int height,
   return encode(dst, tmp.data(), width, height, newFormat);
 }
 
+static bool overlaps(std::span<const u8> a, std::span<const u8> b) {
+  return std::less<>{}(a.data(), b.data() + b.size()) &&
+         std::less<>{}(b.data(), a.data() + a.size());
+}
+
 void resize(std::span<u8> dst, int dx, int dy, std::span<const u8> src, int sx,
             int sy, ResizingAlgorithm type) {
-  std::vector<u8> src_(src.begin(), src.end());
-  std::vector<u8> dst_(dst.begin(), dst.end());
+  // The resizers cannot work in place
+  std::vector<u8> copy;
+  if (overlaps(dst, src)) {
+    copy.assign(src.begin(), src.end());
+    src = copy;
+  }
   if (type == ResizingAlgorithm::AVIR) {
     avir::CImageResizer<> Avir8BitImageResizer(8);
     // TODO: Allow more customization (args, k)
-    Avir8BitImageResizer.resizeImage(src_.data(), sx, sy, 0, dst_.data(), dx,
-                                     dy, 4, 0);
+    Avir8BitImageResizer.resizeImage(src.data(), sx, sy, 0, dst.data(), dx, dy,
+                                     4, 0);
   } else {
     avir::CLancIR AvirLanczos;
-    AvirLanczos.resizeImage(src_.data(), sx, sy, 0, dst_.data(), dx, dy, 4, 0);
+    AvirLanczos.resizeImage(src.data(), sx, sy, 0, dst.data(), dx, dy, 4);
   }
+}
 
-  for (size_t i = 0; i < dst_.size(); ++i) {
-    dst[i] = dst_[i];
+// Average each 2x2 block of |src| into a pixel of |dst|. An axis of length one
+// is averaged along the other only.
+static void downsampleBox(u8* dst, const u8* src, int sx, int sy) {
+  const int dx = std::max(sx >> 1, 1);
+  const int dy = std::max(sy >> 1, 1);
+  for (int y = 0; y < dy; ++y) {
+    const u8* row0 = src + std::min(y * 2, sy - 1) * sx * 4;
+    const u8* row1 = src + std::min(y * 2 + 1, sy - 1) * sx * 4;
+    for (int x = 0; x < dx; ++x) {
+      const int x0 = std::min(x * 2, sx - 1) * 4;
+      const int x1 = std::min(x * 2 + 1, sx - 1) * 4;
+      for (int c = 0; c < 4; ++c) {
+        *dst++ = (row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] +
+                  2) >>
+                 2;
+      }
+    }
   }
 }
 
-struct RGBA32ImageSource {
-  static Result<RGBA32ImageSource> make(std::span<const u8> buf, int w, int h,
-                                        gx::TextureFormat fmt) {
-    RGBA32ImageSource tmp;
-    tmp.mBuf = buf | rsl::ToList();
-    tmp.mW = w;
-    tmp.mH = h;
-    tmp.mFmt = fmt;
-    if (tmp.mFmt == gx::TextureFormat::Extension_RawRGBA32) {
-      tmp.mDecoded = buf | rsl::ToList();
-    } else {
-      tmp.mTmp.resize(roundUp(w, 32) * roundUp(h, 32) *
-                      4 /* Round up for SIMD */);
-      EXPECT(tmp.mBuf.size() >= getEncodedSize(w, h, tmp.mFmt));
-      decode(tmp.mTmp.data(), tmp.mBuf.data(), w, h, tmp.mFmt);
-      tmp.mDecoded = tmp.mTmp;
+void generateMipChain(std::span<u8> dst, int dx, int dy, u32 mipMapCount,
+                      std::span<const u8> src, int sx, int sy,
+                      ResizingAlgorithm algorithm, MipFilter filter) {
+  std::vector<u32> offsets{0};
+  for (u32 i = 0; i < mipMapCount; ++i) {
+    offsets.push_back(offsets.back() +
+                      std::max(dx >> i, 1) * std::max(dy >> i, 1) * 4);
+  }
+  assert(dst.size() >= offsets.back() + std::max(dx >> mipMapCount, 1) *
+                                            std::max(dy >> mipMapCount, 1) *
+                                            4);
+  const auto level = [&](u32 i) { return dst.subspan(offsets[i]); };
+
+  // Resizing the base in place would overwrite the source of the other levels
+  std::vector<u8> copy;
+  if (overlaps(dst, src) && (dx != sx || dy != sy)) {
+    copy.assign(src.begin(), src.end());
+    src = copy;
+  }
+  if (dx == sx && dy == sy) {
+    if (dst.data() != src.data()) {
+      std::memmove(dst.data(), src.data(), dx * dy * 4);
+    }
+  } else {
+    resize(dst, dx, dy, src, sx, sy, algorithm);
+  }
+  if (filter == MipFilter::Box) {
+    for (u32 i = 1; i <= mipMapCount; ++i) {
+      downsampleBox(level(i).data(), level(i - 1).data(),
+                    std::max(dx >> (i - 1), 1), std::max(dy >> (i - 1), 1));
     }
-    return tmp;
+    return;
   }
+  // Levels resampled from the source are independent
+  rsl::ParallelFor(mipMapCount, dx * dy >= 256 * 256 ? 0 : 1, [&](size_t i) {
+    ++i;
+    resize(level(i), std::max(dx >> i, 1), std::max(dy >> i, 1), src, sx, sy,
+           algorithm);
+  });
+}
 
-  std::span<const u8> get() const { return mDecoded; }
-  u32 size() const { return mW * mH * 4; }
-  int width() const { return mW; }
-  int height() const { return mH; }
+// Bytes of scratch memory transformLevel needs to decode, then resize, a level.
+static std::pair<size_t, size_t> levelScratchSize(int dwidth, int dheight,
+                                                  gx::TextureFormat oldformat,
+                                                  int swidth, int sheight) {
+  size_t decoded = 0;
+  if (oldformat != gx::TextureFormat::Extension_RawRGBA32) {
+    decoded = roundUp(swidth, 32) * roundUp(sheight, 32) *
+              4 /* Round up for SIMD */;
+  }
+  size_t resized = 0;
+  if (swidth != dwidth || sheight != dheight) {
+    resized = dwidth * dheight * 4;
+  }
+  return {decoded, resized};
+}
 
-private:
-  std::vector<u8> mTmp = {};
-  std::vector<u8> mDecoded = {};
-  std::vector<u8> mBuf = {};
-  int mW = {};
-  int mH = {};
-  gx::TextureFormat mFmt = {gx::TextureFormat::Extension_RawRGBA32};
-};
-struct RGBA32ImageTarget {
-  RGBA32ImageTarget(int w, int h) : mW(w), mH(h) {
-    mTmp.resize(roundUp(w, 32) * roundUp(h, 32) * 4);
-  }
-  [[nodiscard]] Result<void> copyTo(std::span<u8> dst, gx::TextureFormat fmt) {
-    if (fmt == gx::TextureFormat::Extension_RawRGBA32) {
-      EXPECT(dst.size() >= mTmp.size());
-      memcpy(dst.data(), mTmp.data(), mTmp.size());
+// Resize and re-encode a single level. |src| must not overlap |dst|.
+// Intermediate images go to |scratch|, sized by levelScratchSize().
+static Result<void>
+transformLevel(std::span<u8> dst, int dwidth, int dheight,
+               gx::TextureFormat oldformat, gx::TextureFormat newformat,
+               std::span<const u8> src, int swidth, int sheight,
+               ResizingAlgorithm algorithm, CmprQuality cmpr_quality,
+               Palette* palette, std::span<u8> scratch) {
+  const auto [decoded_size, resized_size] =
+      levelScratchSize(dwidth, dheight, oldformat, swidth, sheight);
+  EXPECT(scratch.size() >= decoded_size + resized_size);
+  std::span<const u8> pixels = src;
+  if (oldformat == gx::TextureFormat::Extension_RawRGBA32) {
+    EXPECT(src.size() >= static_cast<size_t>(swidth * sheight * 4));
+  } else {
+    EXPECT(src.size() >=
+           static_cast<size_t>(getEncodedSize(swidth, sheight, oldformat)));
+    const auto decoded = scratch.subspan(0, decoded_size);
+    if (gx::IsPaletteFormat(oldformat)) {
+      EXPECT(palette != nullptr && !palette->tlut.empty(),
+             "Palette formats need a palette to decode");
+      // The decoder looks up any index the format can hold
+      std::vector<u8> tlut(getPaletteSize(oldformat) * 2);
+      std::ranges::copy_n(palette->tlut.begin(),
+                          std::min(palette->tlut.size(), tlut.size()),
+                          tlut.begin());
+      decode(decoded.data(), src.data(), swidth, sheight, oldformat,
+             tlut.data(), palette->format);
     } else {
-      EXPECT(dst.size() >= getEncodedSize(mW, mH, fmt));
-      EXPECT(mTmp.size() >= mW * mH * 4);
-      return encode(dst.data(), mTmp.data(), mW, mH, fmt);
+      decode(decoded.data(), src.data(), swidth, sheight, oldformat);
     }
-    return {};
+    pixels = decoded;
   }
-  void fromOtherSized(std::span<const u8> src, u32 ow, u32 oh,
-                      ResizingAlgorithm al) {
-    mTmp.resize(mW * mH * 4);
-    // assert(src.size() >= mTmp.size());
-    if (ow == mW && oh == mH) {
-      memcpy(mTmp.data(), src.data(), mTmp.size());
-    } else {
-      resize(mTmp, mW, mH, src, ow, oh, al);
-    }
+
+  if (swidth != dwidth || sheight != dheight) {
+    const auto resized = scratch.subspan(decoded_size, resized_size);
+    resize(resized, dwidth, dheight, pixels, swidth, sheight, algorithm);
+    pixels = resized;
   }
-  void fromOtherSized(const RGBA32ImageSource& source, ResizingAlgorithm al) {
-    fromOtherSized(source.get(), source.width(), source.height(), al);
+
+  if (newformat == gx::TextureFormat::Extension_RawRGBA32) {
+    EXPECT(dst.size() >= static_cast<size_t>(dwidth * dheight * 4));
+    memcpy(dst.data(), pixels.data(), dwidth * dheight * 4);
+    return {};
   }
-  std::span<u8> get() { return {mTmp.data(), mTmp.size()}; }
-  std::span<const u8> get() const { return {mTmp.data(), mTmp.size()}; }
-  u32 size() const { return mW * mH * 4; }
+  EXPECT(dst.size() >=
+         static_cast<size_t>(getEncodedSize(dwidth, dheight, newformat)));
+  return encode(dst.data(), pixels.data(), dwidth, dheight, newformat,
+                cmpr_quality, palette);
+}
 
-private:
-  std::vector<u8> mTmp;
-  int mW;
-  int mH;
-};
-[[nodiscard]] Result<void> transform(std::span<u8> dst_, int dwidth,
-                                     int dheight, gx::TextureFormat oldformat,
+[[nodiscard]] Result<void> transform(std::span<u8> dst, int dwidth, int dheight,
+                                     gx::TextureFormat oldformat,
                                      std::optional<gx::TextureFormat> newformat,
-                                     std::span<const u8> src_, int swidth,
+                                     std::span<const u8> src, int swidth,
                                      int sheight, u32 mipMapCount,
-                                     ResizingAlgorithm algorithm) {
-  std::vector<u8> dst(dst_.begin(), dst_.end());
-  std::vector<u8> src(src_.begin(), src_.end());
+                                     ResizingAlgorithm algorithm,
+                                     CmprQuality cmpr_quality,
+                                     Palette* palette) {
 #ifdef IMAGE_DEBUG
   printf(
       "Transform: Dest={%p, w:%i, h:%i}, Source={%p, w:%i, h:%i}, NumMip=%u\n",
       dst.data(), dwidth, dheight, src.data(), swidth, sheight, mipMapCount);
 #endif // IMAGE_DEBUG
   EXPECT(!dst.empty());
-  EXPECT(!src.empty());
   EXPECT(dwidth > 0 && dheight > 0);
   if (swidth <= 0)
     swidth = dwidth;
@@ -385,48 +462,67 @@ private:
   if (!newformat.has_value())
     newformat = oldformat;
 
-  // Determine whether to decode this sublevel as an image or many sublvels.
   if (mipMapCount >= 1) {
     if (!is_power_of_2(swidth) || !is_power_of_2(sheight) ||
         !is_power_of_2(dwidth) || !is_power_of_2(dheight)) {
       return std::unexpected(
           "It is a GPU hardware requirement that mipmaps be powers of two");
     }
-    TRY(transform(dst, dwidth, dheight, oldformat, newformat, src, swidth,
-                  sheight, 0, algorithm));
-    for (u32 i = 1; i <= mipMapCount; ++i) {
-      const auto src_lod_ofs =
-          getEncodedSize(swidth, sheight, oldformat, i - 1);
-      const auto dst_lod_ofs =
-          getEncodedSize(dwidth, dheight, newformat.value(), i - 1);
-      const auto src_lod_x = swidth >> i;
-      const auto src_lod_y = sheight >> i;
-      auto dst_lod_x = dwidth >> i;
-      auto dst_lod_y = dheight >> i;
-
-      TRY(transform(std::span(dst).subspan(dst_lod_ofs), dst_lod_x, dst_lod_y,
-                    oldformat, newformat.value(),
-                    std::span(src).subspan(src_lod_ofs), src_lod_x, src_lod_y,
-                    0, algorithm));
-    }
-  } else {
-    EXPECT(swidth > 0 && sheight > 0);
-    auto source = TRY(RGBA32ImageSource::make(src, swidth, sheight, oldformat));
-    EXPECT(source.get().size());
-
-    // TODO: We don't always need to allocate this
-    RGBA32ImageTarget target(dwidth, dheight);
-    EXPECT(target.get().size());
-
-    target.fromOtherSized(source, algorithm);
+  }
 
-    // TODO: A copy here can be prevented
-    TRY(target.copyTo(dst, newformat.value()));
+  // Levels are written while later source levels are still to be read
+  std::vector<u8> src_copy;
+  if (overlaps(dst, src)) {
+    src_copy.assign(src.begin(), src.end());
+    src = src_copy;
   }
 
-  EXPECT(dst_.size() == dst.size());
-  for (size_t i = 0; i < dst_.size(); ++i) {
-    dst_[i] = dst[i];
+  // One allocation covers the intermediate images of every level, so levels
+  // running at once each have their own slice.
+  std::vector<size_t> scratch_ofs{0};
+  for (u32 i = 0; i <= mipMapCount; ++i) {
+    const auto [decoded, resized] =
+        levelScratchSize(dwidth >> i, dheight >> i, oldformat, swidth >> i,
+                         sheight >> i);
+    scratch_ofs.push_back(scratch_ofs.back() + decoded + resized);
+  }
+  std::vector<u8> scratch(scratch_ofs.back());
+
+  const auto level = [&](u32 i) -> Result<void> {
+    const u32 src_ofs =
+        i == 0 ? 0 : getEncodedSize(swidth, sheight, oldformat, i - 1);
+    const u32 dst_ofs =
+        i == 0 ? 0 : getEncodedSize(dwidth, dheight, *newformat, i - 1);
+    EXPECT(src_ofs <= src.size() && dst_ofs <= dst.size());
+    const auto level_scratch = std::span(scratch).subspan(
+        scratch_ofs[i], scratch_ofs[i + 1] - scratch_ofs[i]);
+    return transformLevel(dst.subspan(dst_ofs), dwidth >> i, dheight >> i,
+                          oldformat, *newformat, src.subspan(src_ofs),
+                          swidth >> i, sheight >> i, algorithm, cmpr_quality,
+                          palette, level_scratch);
+  };
+
+  // A generated palette comes from the base level and is shared by the rest
+  u32 first = 0;
+  if (palette != nullptr && palette->tlut.empty() &&
+      gx::IsPaletteFormat(*newformat)) {
+    TRY(level(0));
+    first = 1;
+  }
+  // Levels are independent; the largest are handed out first. The encoders
+  // split large levels further, so outside of a pool start one for both.
+  std::vector<Result<void>> results(mipMapCount + 1 - first);
+  const auto run_level = [&](size_t i) { results[i] = level(first + i); };
+  const bool large = dwidth * dheight >= 128 * 128;
+  if (large && rsl::ThreadPool::current() == nullptr) {
+    rsl::ThreadPool pool;
+    rsl::ParallelFor(pool, results.size(), 0, run_level);
+  } else {
+    rsl::ParallelFor(results.size(), mipMapCount > 0 && large ? 0 : 1,
+                     run_level);
+  }
+  for (auto& result : results) {
+    TRY(result);
   }
   return {};
 }
@@ -6,6 +6,8 @@
 #include <tuple>
 
 #include <librii/gx.h>
+#include <librii/image/CmprEncoder.hpp>
+#include <librii/image/PaletteEncoder.hpp>
 
 namespace librii::image {
 
@@ -52,6 +54,18 @@ void decode(u8* dst, const u8* src, int width, int height,
             gx::TextureFormat texformat, const u8* tlut = nullptr,
             gx::PaletteFormat tlutformat = gx::PaletteFormat::IA8);
 
+//! @brief Palette (Texture Lookup) of a C4, C8 or C14X2 image.
+//!
+struct Palette {
+  //! Format of the palette entries.
+  gx::PaletteFormat format = gx::PaletteFormat::RGB5A3;
+  //! Big-endian palette data. When encoding, an empty palette is generated
+  //! from the image; when decoding, it is the palette of the source.
+  std::vector<u8> tlut;
+  //! Diffuse the quantization error when encoding (Floyd-Steinberg).
+  bool dither = false;
+};
+
 //! @brief Encode an image to a GPU texture.
 //!
 //! @param[in] dst The destination pointer to the decoded data. The encoded
@@ -60,12 +74,18 @@ void decode(u8* dst, const u8* src, int width, int height,
 //! @param[in] width The width of the image in pixels.
 //! @param[in] height The height of the image in pixels.
 //! @param[in] texformat The format of the image.
+//! @param[in] cmpr_quality Endpoint search to use for CMPR.
+//! @param[in,out] palette Palette of a C4, C8 or C14X2 image. Required for
+//! those formats.
 //!
 //! @pre For efficiency reasons, this method does not handle the case where dst
 //! == src.
 //!
-[[nodiscard]] Result<void> encode(u8* dst, const u8* src, int width, int height,
-                                  gx::TextureFormat texformat);
+[[nodiscard]] Result<void>
+encode(u8* dst, const u8* src, int width, int height,
+       gx::TextureFormat texformat,
+       CmprQuality cmpr_quality = CmprQuality::Normal,
+       Palette* palette = nullptr);
 
 //! @brief Specifies an algorithm for downscaling/upscaling an image.
 //!
@@ -86,6 +106,33 @@ enum ResizingAlgorithm { AVIR, Lanczos };
 void resize(std::span<u8> dst, int dx, int dy, std::span<const u8> src, int sx,
             int sy, ResizingAlgorithm type = ResizingAlgorithm::Lanczos);
 
+//! @brief Specifies how the levels of a generated mip chain are derived.
+//!
+enum class MipFilter {
+  //! Average 2x2 blocks of the level above. Fast.
+  Box,
+  //! Resize every level from the source image. Sharper.
+  Resample,
+};
+
+//! @brief Generate a mip chain from a raw, 8-bit RGBA buffer.
+//!
+//! @param[in] dst         The destination pointer: every level, one after
+//! the other. (May equal the source pointer)
+//! @param[in] dx          Width of the base level in pixels.
+//! @param[in] dy          Height of the base level in pixels.
+//! @param[in] mipMapCount Number of levels past the base.
+//! @param[in] src         Pointer to the source image.
+//! @param[in] sx          Width of the source image in pixels.
+//! @param[in] sy          Height of the source image in pixels.
+//! @param[in] algorithm   Algorithm to utilize for resizing from the source.
+//! @param[in] filter      How levels past the base are derived.
+//!
+void generateMipChain(std::span<u8> dst, int dx, int dy, u32 mipMapCount,
+                      std::span<const u8> src, int sx, int sy,
+                      ResizingAlgorithm algorithm = ResizingAlgorithm::Lanczos,
+                      MipFilter filter = MipFilter::Resample);
+
 //! @brief Perform a composite transformation on image data, with mipmap
 //! support.
 //!
@@ -106,8 +153,13 @@ void resize(std::span<u8> dst, int dx, int dy, std::span<const u8> src, int sx,
 //! @param[in] sy			Height of the source image in pixels. If
 //! below 1, the value of dy is used.
 //! @param[in] mipMapCount	Number of additional levels of detail past the
-//! first image. Zero corresponds to the base image--no mipmapping.
+//! first image. Zero corresponds to the base image--no mipmapping. Levels are
+//! encoded in parallel.
 //! @param[in] algorithm	Algorithm to utilize for upscaling/downscaling.
+//! @param[in] cmpr_quality	Endpoint search to use when encoding CMPR.
+//! @param[in,out] palette	Palette of the source and/or target, when either
+//! is C4, C8 or C14X2. Generated from the base level if empty; every level
+//! shares it.
 //!
 [[nodiscard]] Result<void>
 transform(std::span<u8> dst, int dwidth, int dheight,
@@ -115,6 +167,8 @@ transform(std::span<u8> dst, int dwidth, int dheight,
           std::optional<gx::TextureFormat> newformat = std::nullopt,
           std::span<const u8> src = {}, int sx = -1, int sy = -1,
           u32 mipMapCount = 0,
-          ResizingAlgorithm algorithm = ResizingAlgorithm::Lanczos);
+          ResizingAlgorithm algorithm = ResizingAlgorithm::Lanczos,
+          CmprQuality cmpr_quality = CmprQuality::Normal,
+          Palette* palette = nullptr);
 
 } // namespace librii::image
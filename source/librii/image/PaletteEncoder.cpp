@@ -0,0 +1,492 @@
+/*
+ * @file
+ * @brief C4/C8/C14X2 encoding: palette quantization and index assignment.
+ */
+
+#include "PaletteEncoder.hpp"
+
+#include <array>
+#include <climits>
+#include <cstring>
+#include <optional>
+#include <queue>
+#include <rsl/ParallelFor.hpp>
+#include <rsl/Simd.hpp>
+
+IMPORT_STD;
+
+namespace librii::image {
+
+namespace {
+
+using Rgba = std::array<u8, 4>;
+
+// Bit replication, as the hardware expands palette entries.
+constexpr u8 Expand3(u32 v) { return (v << 5) | (v << 2) | (v >> 1); }
+constexpr u8 Expand4(u32 v) { return (v << 4) | v; }
+constexpr u8 Expand5(u32 v) { return (v << 3) | (v >> 2); }
+constexpr u8 Expand6(u32 v) { return (v << 2) | (v >> 4); }
+// Nearest |bits|-bit value of an 8-bit channel.
+constexpr u32 Reduce(u32 v, u32 bits) {
+  const u32 max = (1 << bits) - 1;
+  return (v * max + 127) / 255;
+}
+
+u16 EncodeEntry(const Rgba& c, gx::PaletteFormat format) {
+  switch (format) {
+  case gx::PaletteFormat::IA8: {
+    const u32 i = (c[0] * 77 + c[1] * 150 + c[2] * 29 + 128) >> 8;
+    return (c[3] << 8) | i;
+  }
+  case gx::PaletteFormat::RGB565:
+    return (Reduce(c[0], 5) << 11) | (Reduce(c[1], 6) << 5) | Reduce(c[2], 5);
+  case gx::PaletteFormat::RGB5A3: {
+    const u32 a = Reduce(c[3], 3);
+    if (a == 7) {
+      return 0x8000 | (Reduce(c[0], 5) << 10) | (Reduce(c[1], 5) << 5) |
+             Reduce(c[2], 5);
+    }
+    return (a << 12) | (Reduce(c[0], 4) << 8) | (Reduce(c[1], 4) << 4) |
+           Reduce(c[2], 4);
+  }
+  }
+  return 0;
+}
+
+Rgba DecodeEntry(u16 v, gx::PaletteFormat format) {
+  switch (format) {
+  case gx::PaletteFormat::IA8:
+    return {static_cast<u8>(v), static_cast<u8>(v), static_cast<u8>(v),
+            static_cast<u8>(v >> 8)};
+  case gx::PaletteFormat::RGB565:
+    return {Expand5(v >> 11), Expand6((v >> 5) & 0x3F), Expand5(v & 0x1F),
+            0xFF};
+  case gx::PaletteFormat::RGB5A3:
+    if (v & 0x8000) {
+      return {Expand5((v >> 10) & 0x1F), Expand5((v >> 5) & 0x1F),
+              Expand5(v & 0x1F), 0xFF};
+    }
+    return {Expand4((v >> 8) & 0xF), Expand4((v >> 4) & 0xF),
+            Expand4(v & 0xF), Expand3((v >> 12) & 0x7)};
+  }
+  return {};
+}
+
+// Nearest palette entry by squared RGBA distance; ties go to the lowest index.
+// Entries are stored as interleaved 16-bit (r, g) and (b, a) pairs, so one
+// pmaddwd per pair scores four entries.
+class NearestColor {
+public:
+  explicit NearestColor(std::span<const Rgba> palette) {
+    // Padding entries are far enough away to never win, but near enough that
+    // their distance fits in 32 bits.
+    const size_t padded = roundUp(palette.size(), 4);
+    mRG.resize(padded * 2, 0x3FFF);
+    mBA.resize(padded * 2, 0x3FFF);
+    for (size_t i = 0; i < palette.size(); ++i) {
+      mRG[i * 2] = palette[i][0];
+      mRG[i * 2 + 1] = palette[i][1];
+      mBA[i * 2] = palette[i][2];
+      mBA[i * 2 + 1] = palette[i][3];
+    }
+  }
+
+  u32 operator()(const Rgba& c) const {
+#ifdef RSL_HAS_SSE2
+    const __m128i rg = _mm_set1_epi32(c[0] | (c[1] << 16));
+    const __m128i ba = _mm_set1_epi32(c[2] | (c[3] << 16));
+    const __m128i four = _mm_set1_epi32(4);
+    __m128i index = _mm_setr_epi32(0, 1, 2, 3);
+    __m128i best = _mm_set1_epi32(INT_MAX);
+    __m128i best_index = _mm_setzero_si128();
+    for (size_t i = 0; i < mRG.size(); i += 8) {
+      const __m128i d_rg = _mm_sub_epi16(
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(&mRG[i])), rg);
+      const __m128i d_ba = _mm_sub_epi16(
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(&mBA[i])), ba);
+      const __m128i dist =
+          _mm_add_epi32(_mm_madd_epi16(d_rg, d_rg), _mm_madd_epi16(d_ba, d_ba));
+      const __m128i closer = _mm_cmplt_epi32(dist, best);
+      best = _mm_or_si128(_mm_and_si128(closer, dist),
+                          _mm_andnot_si128(closer, best));
+      best_index = _mm_or_si128(_mm_and_si128(closer, index),
+                                _mm_andnot_si128(closer, best_index));
+      index = _mm_add_epi32(index, four);
+    }
+    alignas(16) s32 dists[4];
+    alignas(16) s32 indices[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(dists), best);
+    _mm_store_si128(reinterpret_cast<__m128i*>(indices), best_index);
+    u32 result = 0;
+    for (u32 i = 1; i < 4; ++i) {
+      if (dists[i] < dists[result] ||
+          (dists[i] == dists[result] && indices[i] < indices[result])) {
+        result = i;
+      }
+    }
+    return indices[result];
+#else
+    u32 result = 0;
+    s32 best = INT_MAX;
+    for (size_t i = 0; i < mRG.size() / 2; ++i) {
+      const s32 dr = mRG[i * 2] - c[0];
+      const s32 dg = mRG[i * 2 + 1] - c[1];
+      const s32 db = mBA[i * 2] - c[2];
+      const s32 da = mBA[i * 2 + 1] - c[3];
+      const s32 dist = dr * dr + dg * dg + db * db + da * da;
+      if (dist < best) {
+        best = dist;
+        result = i;
+      }
+    }
+    return result;
+#endif
+  }
+
+private:
+  std::vector<s16> mRG;
+  std::vector<s16> mBA;
+};
+
+// A distinct (snapped) color of the image and its pixel count.
+struct Entry {
+  Rgba color;
+  u32 count;
+};
+
+Rgba WeightedMean(std::span<const Entry> entries) {
+  std::array<u64, 4> sum{};
+  u64 weight = 0;
+  for (const auto& e : entries) {
+    for (int c = 0; c < 4; ++c) {
+      sum[c] += u64(e.color[c]) * e.count;
+    }
+    weight += e.count;
+  }
+  Rgba mean{};
+  for (int c = 0; c < 4; ++c) {
+    mean[c] = static_cast<u8>((sum[c] + weight / 2) / weight);
+  }
+  return mean;
+}
+
+// Repeatedly split the box with the widest channel range, weighted by its
+// pixel count, at the weighted median of that channel.
+std::vector<Rgba> MedianCut(std::vector<Entry>& entries, u32 max_colors) {
+  struct Box {
+    u32 begin;
+    u32 end;
+    int channel;
+    u64 score;
+    bool operator<(const Box& rhs) const { return score < rhs.score; }
+  };
+  const auto make_box = [&](u32 begin, u32 end) {
+    Box box{.begin = begin, .end = end, .channel = 0, .score = 0};
+    if (end - begin < 2) {
+      return box;
+    }
+    Rgba lo{0xFF, 0xFF, 0xFF, 0xFF}, hi{};
+    u64 weight = 0;
+    for (u32 i = begin; i < end; ++i) {
+      for (int c = 0; c < 4; ++c) {
+        lo[c] = std::min(lo[c], entries[i].color[c]);
+        hi[c] = std::max(hi[c], entries[i].color[c]);
+      }
+      weight += entries[i].count;
+    }
+    for (int c = 0; c < 4; ++c) {
+      const u64 score = u64(hi[c] - lo[c]) * weight;
+      if (score > box.score) {
+        box.channel = c;
+        box.score = score;
+      }
+    }
+    return box;
+  };
+
+  std::priority_queue<Box> queue;
+  queue.push(make_box(0, entries.size()));
+  std::vector<Box> boxes;
+  while (!queue.empty() && queue.size() + boxes.size() < max_colors) {
+    const Box box = queue.top();
+    queue.pop();
+    if (box.score == 0) {
+      // Every other box in the queue is a single color too.
+      boxes.push_back(box);
+      continue;
+    }
+    const auto first = entries.begin() + box.begin;
+    const auto last = entries.begin() + box.end;
+    std::sort(first, last, [c = box.channel](const Entry& l, const Entry& r) {
+      return l.color[c] < r.color[c];
+    });
+    u64 total = 0;
+    for (auto it = first; it != last; ++it) {
+      total += it->count;
+    }
+    u32 split = box.begin;
+    for (u64 weight = 0; weight * 2 < total;) {
+      weight += entries[split++].count;
+    }
+    split = std::clamp(split, box.begin + 1, box.end - 1);
+    queue.push(make_box(box.begin, split));
+    queue.push(make_box(split, box.end));
+  }
+  for (; !queue.empty(); queue.pop()) {
+    boxes.push_back(queue.top());
+  }
+
+  std::vector<Rgba> palette;
+  for (const auto& box : boxes) {
+    palette.push_back(WeightedMean(
+        std::span(entries).subspan(box.begin, box.end - box.begin)));
+  }
+  return palette;
+}
+
+Rgba Snap(const Rgba& c, gx::PaletteFormat format) {
+  return DecodeEntry(EncodeEntry(c, format), format);
+}
+
+// Lloyd iterations over the distinct colors, keeping every center
+// representable in the palette format.
+void RefineKMeans(std::span<const Entry> entries, std::vector<Rgba>& palette,
+                  gx::PaletteFormat format, u32 iterations) {
+  constexpr size_t chunk_size = 4096;
+  const size_t num_chunks = (entries.size() + chunk_size - 1) / chunk_size;
+  std::vector<u32> assignment(entries.size());
+  // Outside of a pool, start the workers once instead of every iteration.
+  std::optional<rsl::ThreadPool> own_pool;
+  if (num_chunks > 4 && rsl::ThreadPool::current() == nullptr) {
+    own_pool.emplace();
+  }
+  for (u32 it = 0; it < iterations; ++it) {
+    const NearestColor nearest(palette);
+    const auto assign = [&](size_t chunk) {
+      const size_t end =
+          std::min(entries.size(), (chunk + 1) * chunk_size);
+      for (size_t i = chunk * chunk_size; i < end; ++i) {
+        assignment[i] = nearest(entries[i].color);
+      }
+    };
+    if (own_pool) {
+      rsl::ParallelFor(*own_pool, num_chunks, 0, assign);
+    } else {
+      rsl::ParallelFor(num_chunks, num_chunks > 4 ? 0 : 1, assign);
+    }
+
+    std::vector<std::array<u64, 5>> sums(palette.size());
+    for (size_t i = 0; i < entries.size(); ++i) {
+      auto& sum = sums[assignment[i]];
+      for (int c = 0; c < 4; ++c) {
+        sum[c] += u64(entries[i].color[c]) * entries[i].count;
+      }
+      sum[4] += entries[i].count;
+    }
+    bool changed = false;
+    for (size_t i = 0; i < palette.size(); ++i) {
+      const u64 weight = sums[i][4];
+      if (weight == 0) {
+        continue;
+      }
+      Rgba mean{};
+      for (int c = 0; c < 4; ++c) {
+        mean[c] = static_cast<u8>((sums[i][c] + weight / 2) / weight);
+      }
+      mean = Snap(mean, format);
+      changed |= mean != palette[i];
+      palette[i] = mean;
+    }
+    if (!changed) {
+      break;
+    }
+  }
+}
+
+// Width and height of a block of indices.
+std::pair<u32, u32> IndexBlock(gx::TextureFormat format) {
+  switch (format) {
+  case gx::TextureFormat::C4:
+    return {8, 8};
+  case gx::TextureFormat::C8:
+    return {8, 4};
+  default:
+    return {4, 4};
+  }
+}
+
+} // namespace
+
+u32 getPaletteSize(gx::TextureFormat format) {
+  switch (format) {
+  case gx::TextureFormat::C4:
+    return 16;
+  case gx::TextureFormat::C8:
+    return 256;
+  case gx::TextureFormat::C14X2:
+    return 16384;
+  default:
+    return 0;
+  }
+}
+
+std::vector<u8> QuantizePalette(std::span<const u8> source, u32 max_colors,
+                                gx::PaletteFormat format) {
+  assert(max_colors > 0);
+
+  // Every palette format is 16-bit, so snapping to it first bounds the number
+  // of distinct colors to quantize.
+  std::vector<u32> histogram(1 << 16);
+  for (size_t i = 0; i + 4 <= source.size(); i += 4) {
+    ++histogram[EncodeEntry({source[i], source[i + 1], source[i + 2],
+                             source[i + 3]},
+                            format)];
+  }
+  std::vector<Entry> entries;
+  for (u32 v = 0; v < histogram.size(); ++v) {
+    if (histogram[v] != 0) {
+      entries.push_back({DecodeEntry(v, format), histogram[v]});
+    }
+  }
+
+  std::vector<Rgba> palette;
+  if (entries.size() <= max_colors) {
+    for (const auto& e : entries) {
+      palette.push_back(e.color);
+    }
+  } else {
+    palette = MedianCut(entries, max_colors);
+    for (auto& c : palette) {
+      c = Snap(c, format);
+    }
+    // For C14X2 the boxes are already small; k-means is not worth the cost.
+    if (max_colors <= 256) {
+      RefineKMeans(entries, palette, format, 8);
+    }
+  }
+
+  std::vector<u8> tlut(palette.size() * 2);
+  for (size_t i = 0; i < palette.size(); ++i) {
+    const u16 v = EncodeEntry(palette[i], format);
+    tlut[i * 2] = v >> 8;
+    tlut[i * 2 + 1] = v & 0xFF;
+  }
+  return tlut;
+}
+
+void EncodePalette(u8* dest, const u8* source, u32 width, u32 height,
+                   gx::TextureFormat format, std::span<const u8> tlut,
+                   gx::PaletteFormat tlut_format, bool dither) {
+  assert(dest);
+  assert(source);
+  assert(!tlut.empty() && tlut.size() / 2 <= getPaletteSize(format));
+
+  std::vector<Rgba> palette(tlut.size() / 2);
+  for (size_t i = 0; i < palette.size(); ++i) {
+    palette[i] = DecodeEntry((tlut[i * 2] << 8) | tlut[i * 2 + 1],
+                             tlut_format);
+  }
+  const NearestColor nearest(palette);
+  // Nearest entry by snapped color. Entries map to themselves; other colors
+  // are searched on demand.
+  std::vector<u16> lut(1 << 16, 0xFFFF);
+  for (size_t i = palette.size(); i-- > 0;) {
+    lut[EncodeEntry(palette[i], tlut_format)] = i;
+  }
+  const auto resolve = [&](u16 key) {
+    lut[key] = nearest(DecodeEntry(key, tlut_format));
+  };
+
+  std::vector<u16> indices(width * height);
+  if (!dither) {
+    for (u32 i = 0; i < width * height; ++i) {
+      const u8* px = source + i * 4;
+      indices[i] = EncodeEntry({px[0], px[1], px[2], px[3]}, tlut_format);
+    }
+    std::vector<u8> used(1 << 16);
+    std::vector<u16> missing;
+    for (const u16 key : indices) {
+      if (lut[key] == 0xFFFF && !used[key]) {
+        used[key] = true;
+        missing.push_back(key);
+      }
+    }
+    constexpr size_t chunk_size = 256;
+    const size_t num_chunks = (missing.size() + chunk_size - 1) / chunk_size;
+    rsl::ParallelFor(num_chunks, num_chunks > 4 ? 0 : 1, [&](size_t chunk) {
+      const size_t end = std::min(missing.size(), (chunk + 1) * chunk_size);
+      for (size_t i = chunk * chunk_size; i < end; ++i) {
+        resolve(missing[i]);
+      }
+    });
+    for (auto& index : indices) {
+      index = lut[index];
+    }
+  } else {
+    // Error of the current and next row, in sixteenths, with a pixel of
+    // padding on either side.
+    std::vector<std::array<s32, 4>> error(width + 2), next(width + 2);
+    const bool gray = tlut_format == gx::PaletteFormat::IA8;
+    const int channels = tlut_format == gx::PaletteFormat::RGB565 ? 3 : 4;
+    for (u32 y = 0; y < height; ++y) {
+      std::fill(next.begin(), next.end(), std::array<s32, 4>{});
+      for (u32 x = 0; x < width; ++x) {
+        Rgba c;
+        memcpy(c.data(), source + (y * width + x) * 4, 4);
+        if (gray) {
+          // Gray entries cannot absorb chroma error; diffuse intensity only.
+          c = DecodeEntry(EncodeEntry(c, tlut_format) | 0xFF00, tlut_format);
+          c[3] = source[(y * width + x) * 4 + 3];
+        }
+        for (int k = 0; k < 4; ++k) {
+          c[k] = std::clamp(c[k] + error[x + 1][k] / 16, 0, 255);
+        }
+        const u16 key = EncodeEntry(c, tlut_format);
+        if (lut[key] == 0xFFFF) {
+          resolve(key);
+        }
+        const u16 index = lut[key];
+        indices[y * width + x] = index;
+        for (int k = 0; k < channels; ++k) {
+          const s32 e = c[k] - palette[index][k];
+          error[x + 2][k] += e * 7;
+          next[x][k] += e * 3;
+          next[x + 1][k] += e * 5;
+          next[x + 2][k] += e;
+        }
+      }
+      std::swap(error, next);
+    }
+  }
+
+  // Blocks past the edges of the image repeat its last row and column.
+  const auto [block_w, block_h] = IndexBlock(format);
+  for (u32 by = 0; by < height; by += block_h) {
+    for (u32 bx = 0; bx < width; bx += block_w) {
+      for (u32 y = by; y < by + block_h; ++y) {
+        const u16* row = indices.data() + std::min(y, height - 1) * width;
+        for (u32 x = bx; x < bx + block_w; ++x) {
+          const u16 index = row[std::min(x, width - 1)];
+          switch (format) {
+          case gx::TextureFormat::C4:
+            if (x & 1) {
+              *dest++ |= index;
+            } else {
+              *dest = index << 4;
+            }
+            break;
+          case gx::TextureFormat::C8:
+            *dest++ = index;
+            break;
+          default:
+            *dest++ = index >> 8;
+            *dest++ = index & 0xFF;
+            break;
+          }
+        }
+      }
+    }
+  }
+}
+
+} // namespace librii::image
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <core/common.h>
+
+#include <librii/gx.h>
+
+namespace librii::image {
+
+//! @brief Compute the number of palette entries an image format can index.
+//!
+//! @param[in] format Format of the image.
+//!
+//! @return 16 for C4, 256 for C8, 16384 for C14X2 and 0 for other formats.
+//!
+u32 getPaletteSize(gx::TextureFormat format);
+
+//! @brief Build a palette for a RGBA32 buffer: colors are snapped to the
+//! precision of the palette format, median cut down to |max_colors| and
+//! refined with k-means.
+//!
+//! @param[in] source     RGBA32 pixels of the image.
+//! @param[in] max_colors Maximum number of palette entries.
+//! @param[in] format     Format of the palette entries.
+//!
+//! @return Big-endian palette (Texture Lookup) data.
+//!
+std::vector<u8> QuantizePalette(std::span<const u8> source, u32 max_colors,
+                                gx::PaletteFormat format);
+
+//! @brief Encode a RGBA32 buffer to C4, C8 or C14X2 indices into a palette.
+//!
+//! @param[in] dest        Pointer to the output buffer. Must be appropriately
+//! sized. (Call procedure)
+//! @param[in] source      Pointer to the source buffer. Must be appropriately
+//! sized. (width * height * 4)
+//! @param[in] width       Width of the image.
+//! @param[in] height      Height of the image.
+//! @param[in] format      C4, C8 or C14X2.
+//! @param[in] tlut        Big-endian palette data.
+//! @param[in] tlut_format Format of the palette data.
+//! @param[in] dither      Diffuse the quantization error (Floyd-Steinberg).
+//!
+void EncodePalette(u8* dest, const u8* source, u32 width, u32 height,
+                   gx::TextureFormat format, std::span<const u8> tlut,
+                   gx::PaletteFormat tlut_format, bool dither = false);
+
+} // namespace librii::image
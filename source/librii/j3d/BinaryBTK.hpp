@@ -2,6 +2,7 @@
 
 #include <core/common.h>
 #include <glm/vec3.hpp>
+#include <librii/math/keyframes.hpp>
 #include <oishii/forward_declarations.hxx>
 
 namespace librii::j3d {
@@ -13,6 +14,12 @@ struct KeyFrame {
   float tangentOut{};
   bool operator==(const KeyFrame&) const = default;
 };
+inline librii::math::HermiteKey toHermiteKey(const KeyFrame& key) {
+  return {.frame = key.time,
+          .value = key.value,
+          .tangentIn = key.tangentIn,
+          .tangentOut = key.tangentOut};
+}
 
 using Track = std::vector<KeyFrame>;
 
@@ -8,6 +8,8 @@
 
 #include <LibBadUIFramework/Plugins.hpp> // LightIOTransaction
 
+#include <rsl/InternPool.hpp>
+
 namespace librii::j3d {
 
 struct TevOrder {
@@ -55,7 +57,7 @@ struct Indirect {
   bool operator==(const Indirect& rhs) const noexcept = default;
 };
 struct MatCache {
-  template <typename T> using Section = std::vector<T>;
+  template <typename T> using Section = rsl::InternPool<T>;
   Section<Indirect> indirectInfos;
   Section<librii::gx::CullMode> cullModes;
   Section<librii::gx::Color> matColors;
@@ -89,14 +91,11 @@ struct MatCache {
   bool operator==(const MatCache&) const = default;
 
   void clear() { *this = MatCache{}; }
-  template <typename T>
-  void update_section(std::vector<T>& sec, const T& data) {
-    if (std::find(sec.begin(), sec.end(), data) == sec.end()) {
-      sec.push_back(data);
-    }
+  template <typename T> void update_section(Section<T>& sec, const T& data) {
+    sec.append(data);
   }
   template <typename T, typename U>
-  void update_section_multi(std::vector<T>& sec, const U& source) {
+  void update_section_multi(Section<T>& sec, const U& source) {
     for (int i = 0; i < source.size(); ++i) {
       update_section(sec, source[i]);
     }
@@ -125,3 +124,69 @@ struct J3dModel {
 };
 
 } // namespace librii::j3d
+
+// Hashes for MatCache sections. Floats go through rsl::HashValue so that
+// 0.0f and -0.0f still land in the same bucket.
+namespace rsl {
+template <> struct InternHash<librii::j3d::TevOrder> {
+  std::size_t operator()(const librii::j3d::TevOrder& x) const {
+    return HashFields(x.rasOrder, x.texMap, x.texCoord);
+  }
+};
+template <> struct InternHash<librii::gx::ChannelControl> {
+  std::size_t operator()(const librii::gx::ChannelControl& x) const {
+    return HashFields(x.enabled, x.Ambient, x.Material, x.lightMask,
+                      x.diffuseFn, x.attenuationFn);
+  }
+};
+template <> struct InternHash<librii::gx::TexCoordGen> {
+  std::size_t operator()(const librii::gx::TexCoordGen& x) const {
+    return HashFields(x.func, x.sourceParam, x.matrix, x.normalize,
+                      x.postMatrix);
+  }
+};
+template <> struct InternHash<librii::j3d::MaterialData::TexMatrix> {
+  std::size_t operator()(const librii::j3d::MaterialData::TexMatrix& x) const {
+    return HashFields(x.projection, x.scale.x, x.scale.y, x.rotate,
+                      x.translate.x, x.translate.y, x.effectMatrix, x.method,
+                      x.option);
+  }
+};
+template <> struct InternHash<librii::j3d::MaterialData::J3DSamplerData> {
+  std::size_t
+  operator()(const librii::j3d::MaterialData::J3DSamplerData& x) const {
+    return HashFields(x.mTexture, x.mWrapU, x.mWrapV, x.mMinFilter,
+                      x.mMagFilter, x.btiId);
+  }
+};
+template <> struct InternHash<librii::gx::TevStage> {
+  std::size_t operator()(const librii::gx::TevStage& x) const {
+    const auto& c = x.colorStage;
+    const auto& a = x.alphaStage;
+    return HashFields(x.rasOrder, x.texMap, x.texCoord, c.a, c.b, c.c, c.d,
+                      c.formula, c.out, a.a, a.b, a.c, a.d, a.formula, a.out,
+                      x.indirectStage.matrix);
+  }
+};
+template <> struct InternHash<librii::j3d::Fog> {
+  std::size_t operator()(const librii::j3d::Fog& x) const {
+    return HashFields(x.type, x.enabled, x.center, x.startZ, x.endZ, x.nearZ,
+                      x.farZ, x.color, x.rangeAdjTable);
+  }
+};
+template <> struct InternHash<librii::gx::AlphaComparison> {
+  std::size_t operator()(const librii::gx::AlphaComparison& x) const {
+    return HashFields(x.compLeft, x.refLeft, x.op, x.compRight, x.refRight);
+  }
+};
+template <> struct InternHash<librii::gx::ZMode> {
+  std::size_t operator()(const librii::gx::ZMode& x) const {
+    return HashFields(x.compare, x.function, x.update);
+  }
+};
+template <> struct InternHash<librii::j3d::NBTScale> {
+  std::size_t operator()(const librii::j3d::NBTScale& x) const {
+    return HashFields(x.enable, x.scale.x, x.scale.y, x.scale.z);
+  }
+};
+} // namespace rsl
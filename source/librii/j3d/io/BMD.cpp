@@ -129,15 +129,9 @@ processModelForWrite(BMDExportContext& model,
       Tex tmp(tex, samp);
       tmp.btiId = i;
 
-      auto found = std::find(texCache.begin(), texCache.end(), tmp);
-      if (found == texCache.end()) {
-        texCache.push_back(tmp);
-        if (it)
-          it->btiId = texCache.size() - 1;
-      } else {
-        if (it)
-          it->btiId = found - texCache.begin();
-      }
+      const u32 cached = texCache.append(tmp);
+      if (it)
+        it->btiId = cached;
     }
   }
 
@@ -255,38 +249,43 @@ Result<void> detailReadBMD(J3dModel& mdl, oishii::BinaryReader& reader,
   // Read shapes
   TRY(readSHP1(ctx));
 
-  for (const auto& e : ctx.mVertexBufferMaxIndices) {
-    switch (e.first) {
+  const auto& usage = ctx.mVertexBufferMaxIndices;
+  for (size_t i = 0; i < usage.NumAttributes; ++i) {
+    const auto attr = static_cast<gx::VertexBufferAttribute>(i);
+    if (!usage.used(attr))
+      continue;
+    const u32 count = usage.count(attr);
+    switch (attr) {
     case gx::VertexBufferAttribute::Position:
-      if (ctx.mdl.vertexData.pos.mData.size() != e.second + 1) {
+      if (ctx.mdl.vertexData.pos.mData.size() != count) {
         rsl::trace(
             "The position vertex buffer currently has {} greedily-claimed "
             "entries due to 32B padding; {} are used.",
-            ctx.mdl.vertexData.pos.mData.size(), e.second + 1);
-        ctx.mdl.vertexData.pos.mData.resize(e.second + 1);
+            ctx.mdl.vertexData.pos.mData.size(), count);
+        ctx.mdl.vertexData.pos.mData.resize(count);
       }
       break;
     case gx::VertexBufferAttribute::Color0:
     case gx::VertexBufferAttribute::Color1: {
       auto& buf =
           ctx.mdl.vertexData
-              .color[(int)e.first - (int)gx::VertexBufferAttribute::Color0];
-      if (buf.mData.size() != e.second + 1) {
+              .color[(int)attr - (int)gx::VertexBufferAttribute::Color0];
+      if (buf.mData.size() != count) {
         rsl::trace("The color buffer currently has {} greedily-claimed entries "
                    "due to 32B padding; {} are used.",
-                   buf.mData.size(), e.second + 1);
-        buf.mData.resize(e.second + 1);
+                   buf.mData.size(), count);
+        buf.mData.resize(count);
       }
       break;
     }
     case gx::VertexBufferAttribute::Normal: {
       auto& buf = ctx.mdl.vertexData.norm;
-      if (buf.mData.size() != e.second + 1) {
+      if (buf.mData.size() != count) {
         rsl::trace(
             "The normal buffer currently has {} greedily-claimed entries "
             "due to 32B padding; {} are used.",
-            buf.mData.size(), e.second + 1);
-        buf.mData.resize(e.second + 1);
+            buf.mData.size(), count);
+        buf.mData.resize(count);
       }
       break;
     }
@@ -300,13 +299,13 @@ Result<void> detailReadBMD(J3dModel& mdl, oishii::BinaryReader& reader,
     case gx::VertexBufferAttribute::TexCoord7: {
       auto& buf =
           ctx.mdl.vertexData
-              .uv[(int)e.first - (int)gx::VertexBufferAttribute::TexCoord0];
-      if (buf.mData.size() != e.second + 1) {
+              .uv[(int)attr - (int)gx::VertexBufferAttribute::TexCoord0];
+      if (buf.mData.size() != count) {
         rsl::trace(
             "The UV buffer currently has {} greedily-claimed entries due "
             "to 32B padding; {} are used.",
-            buf.mData.size(), e.second + 1);
-        buf.mData.resize(e.second + 1);
+            buf.mData.size(), count);
+        buf.mData.resize(count);
       }
       break;
     }
@@ -317,8 +316,8 @@ Result<void> detailReadBMD(J3dModel& mdl, oishii::BinaryReader& reader,
       //      break;
     default:
       return std::unexpected(std::format(
-          "Unsupported VertexBufAttribute {} ({})", static_cast<int>(e.first),
-          magic_enum::enum_name(e.first)));
+          "Unsupported VertexBufAttribute {} ({})", static_cast<int>(attr),
+          magic_enum::enum_name(attr)));
     }
   }
 
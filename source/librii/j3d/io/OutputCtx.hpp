@@ -2,6 +2,7 @@
 
 #include <LibBadUIFramework/Plugins.hpp>
 #include <core/common.h>
+#include <librii/gpu/DLMesh.hpp>
 #include <map>
 #include <oishii/writer/binary_writer.hxx>
 #include <oishii/writer/node.hxx>
@@ -30,8 +31,7 @@ struct BMDOutputContext {
   std::vector<u16> shapeIdLut;
 
   // For VTX1 trimming (length isn't stored)
-  std::map<librii::gx::VertexBufferAttribute, u32>
-      mVertexBufferMaxIndices; // Attr : Max Idx
+  librii::gpu::VertexBufferUsage mVertexBufferMaxIndices;
 
   // Associate section magics with file positions and size
   struct SectionEntry {
@@ -181,11 +181,22 @@ struct LinkNode final : public T, public oishii::Node {
   const oishii::Node& getSelf() const override { return *this; }
 };
 
+} // namespace librii::j3d
+
+template <> struct rsl::InternHash<librii::j3d::Tex> {
+  std::size_t operator()(const librii::j3d::Tex& x) const {
+    return HashFields(x.btiId, x.mFormat, x.mWidth, x.mHeight, x.mWrapU,
+                      x.mWrapV, x.mMinFilter, x.mMagFilter);
+  }
+};
+
+namespace librii::j3d {
+
 struct BMDExportContext {
   J3dModel& mdl;
   // We forget these by default
   MatCache mMatCache;
-  std::vector<Tex> mTexCache;
+  rsl::InternPool<Tex> mTexCache;
   // Collection& col;
   /*
   We need to associate Samplers and TexData
@@ -175,10 +175,12 @@ struct EVP1Node {
       mLinkingRestriction.alignment = 8;
     }
     Result<void> write(oishii::Writer& writer) const noexcept {
-      for (f32 f : mWeightPool)
-        writer.write<f32>(f);
+      writer.writeSpan<f32>(mWeightPool);
       return {};
     }
+    u32 sizeHint() const noexcept override {
+      return mWeightPool.size() * sizeof(f32);
+    }
   };
   struct MatrixInvBindTable : public SimpleEvpNode {
     MatrixInvBindTable(const EVP1Node& node, const J3dModel& md)
@@ -269,24 +271,20 @@ struct DRW1Node {
 
     std::expected<void, std::string>
     write(oishii::Writer& writer) const noexcept {
-      // TODO -- we can do much better
-      std::vector<int> envelopesToWrite;
+      rsl::InternPool<int> envelopesToWrite;
       for (int i = 0; i < mMdl.drawMatrices.size(); ++i) {
         if (mMdl.drawMatrices[i].mWeights.size() <= 1) {
           EXPECT(mMdl.drawMatrices[i].mWeights[0].weight == 1.0f);
         } else {
-          envelopesToWrite.push_back(i);
+          envelopesToWrite.push(i);
         }
       }
 
       int i = 0;
       for (const auto& drw : mMdl.drawMatrices) {
         EXPECT(!drw.mWeights.empty());
-        writer.write<u16>(drw.mWeights.size() > 1
-                              ? std::find(envelopesToWrite.begin(),
-                                          envelopesToWrite.end(), i) -
-                                    envelopesToWrite.begin()
-                              : drw.mWeights[0].boneId);
+        writer.write<u16>(drw.mWeights.size() > 1 ? envelopesToWrite.find(i)
+                                                  : drw.mWeights[0].boneId);
         ++i;
       }
 
@@ -295,9 +293,7 @@ struct DRW1Node {
       for (const auto& drw : mMdl.drawMatrices) {
         EXPECT(!drw.mWeights.empty());
         if (drw.mWeights.size() > 1)
-          writer.write<u16>(
-              std::find(envelopesToWrite.begin(), envelopesToWrite.end(), i) -
-              envelopesToWrite.begin());
+          writer.write<u16>(envelopesToWrite.find(i));
         ++i;
       }
 
@@ -527,7 +527,7 @@ Result<void> readMAT3(BMDOutputContext& ctx) {
   return {};
 }
 template <typename T, u32 bodyAlign = 1, u32 entryAlign = 1,
-          bool compress = true>
+          bool compress = true, typename Hash = rsl::InternHash<T>>
 class MCompressableVector : public oishii::Node {
   struct Child : public oishii::Node {
     Child(const MCompressableVector& parent, u32 index)
@@ -564,24 +564,9 @@ public:
   }
 
   u32 append(const T& entry) {
-    const auto found = std::find(mEntries.begin(), mEntries.end(), entry);
-    if (found == mEntries.end() || !compress) {
-      mEntries.push_back(entry);
-      return mEntries.size() - 1;
-    }
-    return found - mEntries.begin();
-  }
-  int find(const T& entry) const {
-    int outIdx = -1;
-    for (int i = 0; i < mEntries.size(); ++i)
-      if (entry == mEntries[i]) {
-        outIdx = i;
-        break;
-      }
-    // Intentionally complete
-    // TODO: rfind
-    return outIdx;
+    return compress ? mEntries.append(entry) : mEntries.push(entry);
   }
+  int find(const T& entry) const { return mEntries.find(entry); }
   u32 getNumEntries() const { return mEntries.size(); }
   const T& getEntry(u32 idx) const {
     assert(idx < mEntries.size());
@@ -593,7 +578,7 @@ public:
   }
 
 public:
-  std::vector<T> mEntries;
+  rsl::InternPool<T, Hash> mEntries;
 };
 struct MAT3Node;
 struct SerializableMaterial {
@@ -605,17 +590,18 @@ struct SerializableMaterial {
 
   bool operator==(const SerializableMaterial& rhs) const noexcept;
 };
-auto find = [](const auto& buf, const auto x) {
-  auto found = std::find(buf.begin(), buf.end(), x);
-  // if (found == buf.end()) {
-  // 	buf.push_back(x);
-  // }
-  assert(found != buf.end());
-  if (found == buf.end()) {
+struct SerializableMaterialHash {
+  std::size_t operator()(const SerializableMaterial& smat) const;
+};
+template <typename T, typename U>
+int find(const MatCache::Section<T>& buf, const U& x) {
+  const int found = buf.find(static_cast<T>(x));
+  assert(found >= 0);
+  if (found < 0) {
     printf("Invalid data entry not cached.\n");
   }
-  return found == buf.end() ? -1 : found - buf.begin();
-};
+  return found;
+}
 template <typename TIdx, typename T, typename TPool>
 void write_array_vec(oishii::Writer& writer, const T& vec, TPool& pool) {
   for (int i = 0; i < vec.size(); ++i)
@@ -624,7 +610,7 @@ void write_array_vec(oishii::Writer& writer, const T& vec, TPool& pool) {
     writer.write<TIdx>(-1);
 }
 template <typename T>
-int write_cache(oishii::Writer& writer, const std::vector<T>& cache) {
+int write_cache(oishii::Writer& writer, const MatCache::Section<T>& cache) {
   // while (writer.tell() % io_wrapper<T>::SizeOf) writer.write(0xff);
   const auto start = writer.tell();
   for (auto& x : cache) {
@@ -641,7 +627,8 @@ struct MAT3Node : public oishii::Node {
   struct Section : MCompressableVector<T, 4, 0, true> {};
 
   struct EntrySection final
-      : public Section<SerializableMaterial, MatSec::Max> {
+      : public MCompressableVector<SerializableMaterial, 4, 0, true,
+                                   SerializableMaterialHash> {
 
     EntrySection(const J3dModel& mdl, const MAT3Node& mat3) : mMdl(mdl) {
       for (int i = 0; i < mMdl.materials.size(); ++i)
@@ -705,8 +692,7 @@ struct MAT3Node : public oishii::Node {
         writer.write<u8>(0);
       auto lutStart = writer.tell();
 
-      for (const auto e : mEntries.mLut)
-        writer.write<u16>(e);
+      writer.writeSpan<u16>(mEntries.mLut);
 
       oishii::Jump<oishii::Whence::Set, oishii::Writer> g(writer, ofsLut);
       writer.write<s32>(lutStart - start);
@@ -815,6 +801,14 @@ bool SerializableMaterial::operator==(
   return a == b;
   //  return mMAT3.mMdl.materials[mIdx] == rhs.mMAT3.mMdl.materials[rhs.mIdx];
 }
+std::size_t
+SerializableMaterialHash::operator()(const SerializableMaterial& smat) const {
+  const librii::j3d::MaterialData& m = smat.mMAT3.mMdl.materials[smat.mIdx];
+  return rsl::HashFields(m.name, m.flag, m.cullMode, m.xlu, m.earlyZComparison,
+                         m.dither, m.chanData.size(), m.texGens.size(),
+                         m.texMatrices.size(), m.samplers.size(),
+                         m.mStages.size());
+}
 void io_wrapper<SerializableMaterial>::onWrite(
     oishii::Writer& writer, const SerializableMaterial& smat) {
   const librii::j3d::MaterialData& m = smat.mMAT3.mMdl.materials[smat.mIdx];
@@ -64,6 +64,14 @@ Result<void> readSHP1(BMDOutputContext& ctx) {
   // reader.seekSet(ofsStringTable + g.start);
   // const auto nameTable = readNameTable(reader);
 
+  // Display lists are decoded once every shape is read
+  struct PendingDL {
+    int shape;
+    size_t mprim;
+    std::span<const u8> data;
+  };
+  std::vector<PendingDL> pending;
+
   std::array<s16, 10> mtxListLast;
   for (int si = 0; si < size; ++si) {
     auto& shape = ctx.mdl.shapes[si];
@@ -141,30 +149,36 @@ Result<void> readSHP1(BMDOutputContext& ctx) {
 
       // Mtx Prim Data
       MatrixData mtxPrimHdr = TRY(readMatrixData());
-      gx::MatrixPrimitive& mprim = shape.mMatrixPrimitives.emplace_back(
-          mtxPrimHdr.current_matrix, mtxPrimHdr.matrixList);
-
-      struct SHP1_MPrim : librii::gpu::IMeshDLDelegate {
-        librii::gx::IndexedPrimitive&
-        addIndexedPrimitive(gx::PrimitiveType type, u16 nVerts) override {
-          return mprim.mPrimitives.emplace_back(type, nVerts);
-        }
-        SHP1_MPrim(gx::MatrixPrimitive& mp) : mprim(mp) {}
-
-      private:
-        gx::MatrixPrimitive& mprim;
-      } mprim_del(mprim);
-      TRY(DecodeMeshDisplayList(reader.getUnsafe(), g.start + ofsDL + dlOfs,
-                                dlSz, mprim_del, shape.mVertexDescriptor,
-                                &ctx.mVertexBufferMaxIndices));
+      shape.mMatrixPrimitives.emplace_back(mtxPrimHdr.current_matrix,
+                                           mtxPrimHdr.matrixList);
+
+      const auto file = reader.getUnsafe().slice();
+      const u64 dl_start = g.start + ofsDL + dlOfs;
+      EXPECT(dl_start + dlSz <= file.size(),
+             "Display list runs past the end of the file");
+      pending.push_back({.shape = si,
+                         .mprim = shape.mMatrixPrimitives.size() - 1,
+                         .data = file.subspan(dl_start, dlSz)});
     }
   }
 
+  // They are independent, so are decoded in parallel
+  std::vector<librii::gpu::MeshDisplayList> lists;
+  for (const auto& dl : pending) {
+    auto& shape = ctx.mdl.shapes[dl.shape];
+    lists.push_back(
+        {.data = dl.data,
+         .descriptor = &shape.mVertexDescriptor,
+         .primitives = &shape.mMatrixPrimitives[dl.mprim].mPrimitives});
+  }
+  TRY(librii::gpu::DecodeMeshDisplayLists(lists,
+                                          &ctx.mVertexBufferMaxIndices));
+
   return {};
 }
 
 template <typename T, u32 bodyAlign = 1, u32 entryAlign = 1,
-          bool compress = true>
+          bool compress = true, typename Hash = rsl::InternHash<T>>
 class CompressableVector : public oishii::Node {
   struct Child : public oishii::Node {
     Child(const CompressableVector& parent, u32 index)
@@ -201,21 +215,11 @@ public:
   }
 
   u32 append(const T& entry) {
-    const auto found = std::find(mEntries.begin(), mEntries.end(), entry);
-    if (found == mEntries.end() || !compress) {
-      mEntries.push_back(entry);
-      return mEntries.size() - 1;
-    }
-    return found - mEntries.begin();
+    return compress ? mEntries.append(entry) : mEntries.push(entry);
   }
+  // Last match, as uncompressed pools may hold duplicates
   int find(const T& entry) const {
-    int outIdx = -1;
-    for (int i = 0; i < mEntries.size(); ++i)
-      if (entry == mEntries[i])
-        outIdx = i;
-    // Intentionally complete
-    // TODO: rfind
-    return outIdx;
+    return mEntries.find(entry, rsl::InternPool<T, Hash>::Match::Last);
   }
   u32 getNumEntries() const { return mEntries.size(); }
   const T& getEntry(u32 idx) const {
@@ -228,7 +232,7 @@ public:
   }
 
 protected:
-  std::vector<T> mEntries;
+  rsl::InternPool<T, Hash> mEntries;
 };
 struct WriteableVertexDescriptor : librii::gx::VertexDescriptor {
   WriteableVertexDescriptor(const VertexDescriptor& d) {
@@ -243,6 +247,11 @@ struct WriteableVertexDescriptor : librii::gx::VertexDescriptor {
     writer.write<u32>(0);
   }
 };
+struct VcdHash {
+  std::size_t operator()(const WriteableVertexDescriptor& v) const {
+    return rsl::HashValue(v.mAttributes);
+  }
+};
 struct WriteableMatrixList : public std::vector<s16> {
   WriteableMatrixList(const std::vector<s16>& parent) {
     *(std::vector<s16>*)this = parent;
@@ -268,7 +277,8 @@ struct SHP1Node final : public oishii::Node {
     }
   }
 
-  CompressableVector<WriteableVertexDescriptor, 32, 16> mVcdPool;
+  CompressableVector<WriteableVertexDescriptor, 32, 16, true, VcdHash>
+      mVcdPool;
   CompressableVector<WriteableMatrixList,
 #ifdef ALIGN_MTX_CHILDS
                      32, 32,
@@ -278,16 +288,6 @@ struct SHP1Node final : public oishii::Node {
                      false>
       mMtxListPool;
   Result<void> write(oishii::Writer& writer) const noexcept override {
-    // VCD List compression compute.
-    //	struct VCDHasher
-    //	{
-    //		std::size_t operator()(const VertexDescriptor& v) const { return
-    // v.mBitfield; }
-    //	};
-    //	std::map<VertexDescriptor, int, VCDHasher> vcd;
-    //	for (auto& shp : mModel.mShapes)
-    //		vcd[shp.mVertexDescriptor] = 0;
-
     writer.write<u32, oishii::EndianSelect::Big>('SHP1');
     writer.writeLink<s32>({*this}, {*this, oishii::Hook::EndOfChildren});
 
@@ -302,19 +302,12 @@ struct TEX1Node final : public oishii::Node {
 
     Result<void> write(oishii::Writer& writer) const noexcept {
       const auto& tex = mMdl.textures[mIdx];
-      const auto before = writer.tell();
-
-      writer.skip(tex.mData.size() - 1);
-      writer.write<u8>(0);
-      writer.skip(-tex.mData.size());
-
-      // memcpy_s(writer.getDataBlockStart() + before, writer.endpos(),
-      // tex.mData.data(), tex.mData.size());
-      memcpy(writer.getDataBlockStart() + before, tex.mData.data(),
-             tex.mData.size());
-      writer.skip(tex.mData.size());
+      writer.writeSpan<u8>(tex.mData);
       return {};
     }
+    u32 sizeHint() const noexcept override {
+      return mMdl.textures[mIdx].mData.size();
+    }
 
     const J3dModel& mMdl;
     const u32 mIdx;
@@ -196,18 +196,14 @@ Result<void> readVTX1(BMDOutputContext& ctx) {
         auto pos = reinterpret_cast<decltype(ctx.mdl.vertexData.pos)*>(buf);
 
         pos->mData.resize(ensize);
-        for (int i = 0; i < ensize; ++i) {
-          TRY(pos->readBufferEntryGeneric(reader.getUnsafe(), pos->mData[i]));
-        }
+        TRY(pos->readBufferGeneric(reader.getUnsafe()));
         break;
       }
       case VBufferKind::normal: {
         auto nrm = reinterpret_cast<decltype(ctx.mdl.vertexData.norm)*>(buf);
 
         nrm->mData.resize(ensize);
-        for (int i = 0; i < ensize; ++i) {
-          TRY(nrm->readBufferEntryGeneric(reader.getUnsafe(), nrm->mData[i]));
-        }
+        TRY(nrm->readBufferGeneric(reader.getUnsafe()));
         break;
       }
       case VBufferKind::color: {
@@ -226,9 +222,7 @@ Result<void> readVTX1(BMDOutputContext& ctx) {
             reinterpret_cast<decltype(ctx.mdl.vertexData.uv)::value_type*>(buf);
 
         uv->mData.resize(ensize);
-        for (int i = 0; i < ensize; ++i) {
-          TRY(uv->readBufferEntryGeneric(reader.getUnsafe(), uv->mData[i]));
-        }
+        TRY(uv->readBufferGeneric(reader.getUnsafe()));
         break;
       }
       }
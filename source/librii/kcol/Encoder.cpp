@@ -0,0 +1,416 @@
+#include "Encoder.hpp"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <glm/geometric.hpp>
+#include <rsl/InternPool.hpp>
+#include <rsl/ParallelFor.hpp>
+#include <rsl/SimpleReader.hpp>
+
+template <> struct rsl::InternHash<glm::vec3> {
+  std::size_t operator()(const glm::vec3& v) const {
+    return HashFields(v.x, v.y, v.z);
+  }
+};
+
+namespace librii::kcol {
+
+//! Triangle/box overlap by the separating axis theorem (Akenine-Moller)
+static bool TriBoxOverlap(const glm::vec3& center, const glm::vec3& half,
+                          const std::array<glm::vec3, 3>& tri) {
+  const glm::vec3 v0 = tri[0] - center;
+  const glm::vec3 v1 = tri[1] - center;
+  const glm::vec3 v2 = tri[2] - center;
+  const std::array<glm::vec3, 3> edges{v1 - v0, v2 - v1, v0 - v2};
+
+  // Box normals
+  for (int i = 0; i < 3; ++i) {
+    const float lo = std::min({v0[i], v1[i], v2[i]});
+    const float hi = std::max({v0[i], v1[i], v2[i]});
+    if (lo > half[i] || hi < -half[i])
+      return false;
+  }
+
+  // Triangle normal
+  const glm::vec3 n = glm::cross(edges[0], edges[1]);
+  const float d = glm::dot(n, v0);
+  const float r = half.x * std::abs(n.x) + half.y * std::abs(n.y) +
+                  half.z * std::abs(n.z);
+  if (d > r || d < -r)
+    return false;
+
+  // Edge cross products
+  for (const auto& e : edges) {
+    for (int i = 0; i < 3; ++i) {
+      glm::vec3 axis{0.0f};
+      axis[(i + 1) % 3] = -e[(i + 2) % 3];
+      axis[(i + 2) % 3] = e[(i + 1) % 3];
+      const float p0 = glm::dot(axis, v0);
+      const float p1 = glm::dot(axis, v1);
+      const float p2 = glm::dot(axis, v2);
+      const float rad = half.x * std::abs(axis.x) + half.y * std::abs(axis.y) +
+                        half.z * std::abs(axis.z);
+      if (std::min({p0, p1, p2}) > rad || std::max({p0, p1, p2}) < -rad)
+        return false;
+    }
+  }
+  return true;
+}
+
+struct Bounds {
+  glm::vec3 min{std::numeric_limits<float>::max()};
+  glm::vec3 max{std::numeric_limits<float>::lowest()};
+
+  void add(const glm::vec3& v) {
+    min = glm::min(min, v);
+    max = glm::max(max, v);
+  }
+};
+
+//! Range of blocks, of width 1 << shift, touched by |tri|.
+static std::pair<glm::uvec3, glm::uvec3>
+BlockRange(const std::array<glm::vec3, 3>& tri, const glm::vec3& area_min,
+           s32 shift, const glm::uvec3& count, float margin) {
+  Bounds b;
+  for (auto& v : tri)
+    b.add(v);
+  const float width = static_cast<float>(1u << shift);
+  const glm::vec3 lo = glm::floor((b.min - area_min - margin) / width);
+  const glm::vec3 hi = glm::floor((b.max - area_min + margin) / width);
+  const glm::vec3 last = glm::vec3(count) - 1.0f;
+  return {glm::uvec3(glm::clamp(lo, glm::vec3(0.0f), last)),
+          glm::uvec3(glm::clamp(hi, glm::vec3(0.0f), last))};
+}
+
+static bool BlockOverlaps(const glm::vec3& area_min, const glm::uvec3& origin,
+                          s32 shift, float margin,
+                          const std::array<glm::vec3, 3>& tri) {
+  const float half = static_cast<float>(1u << shift) * 0.5f;
+  return TriBoxOverlap(area_min + glm::vec3(origin) + half,
+                       glm::vec3(half + margin), tri);
+}
+
+//! Zero-area triangles have no prism
+static bool IsDegenerate(const std::array<glm::vec3, 3>& tri) {
+  return glm::length(glm::cross(tri[1] - tri[0], tri[2] - tri[0])) <= 1e-6f;
+}
+
+namespace {
+
+//! The blocks below one root block. nodes[0] is the root block itself.
+struct Octree {
+  struct Node {
+    std::vector<u16> prisms; //!< 1-based, as stored
+    s32 children = -1;       //!< First of eight consecutive nodes
+  };
+  std::vector<Node> nodes;
+};
+
+struct OctreeBuilder {
+  const KclEncoderOptions& options;
+  const std::vector<std::array<glm::vec3, 3>>& tris;
+  glm::vec3 area_min;
+
+  void split(Octree& tree, u32 node, glm::uvec3 origin, s32 shift) const {
+    if (tree.nodes[node].prisms.size() <= options.max_triangles_per_leaf ||
+        shift <= options.min_block_width_shift) {
+      return;
+    }
+    const auto prisms = std::move(tree.nodes[node].prisms);
+    const u32 first = tree.nodes.size();
+    tree.nodes[node].prisms = {};
+    tree.nodes[node].children = first;
+    tree.nodes.resize(first + 8);
+
+    const u32 half = 1u << (shift - 1);
+    for (u32 i = 0; i < 8; ++i) {
+      const glm::uvec3 child =
+          origin + glm::uvec3{i & 1, (i >> 1) & 1, (i >> 2) & 1} * half;
+      auto& out = tree.nodes[first + i].prisms;
+      for (u16 p : prisms) {
+        if (BlockOverlaps(area_min, child, shift - 1, options.block_margin,
+                          tris[p - 1]))
+          out.push_back(p);
+      }
+    }
+    for (u32 i = 0; i < 8; ++i) {
+      const glm::uvec3 child =
+          origin + glm::uvec3{i & 1, (i >> 1) & 1, (i >> 2) & 1} * half;
+      split(tree, first + i, child, shift - 1);
+    }
+  }
+};
+
+} // namespace
+
+//! Serialize the octrees, big endian. All offsets are relative to the start of
+//! the entry array holding them, so arrays are laid out parent-first. Leaves
+//! point at the 0 preceding their list; identical lists are shared.
+static std::vector<u8> WriteBlocks(const std::vector<Octree>& trees) {
+  const u32 roots_size = trees.size() * 4;
+
+  // Child entry arrays
+  std::vector<std::vector<u32>> array_pos(trees.size());
+  u32 pos = roots_size;
+  for (size_t t = 0; t < trees.size(); ++t) {
+    array_pos[t].resize(trees[t].nodes.size());
+    for (size_t n = 0; n < trees[t].nodes.size(); ++n) {
+      if (trees[t].nodes[n].children >= 0) {
+        array_pos[t][n] = pos;
+        pos += 8 * 4;
+      }
+    }
+  }
+
+  // Lists, after two zeros: the first is the empty list
+  const u32 lists_begin = pos;
+  rsl::InternPool<std::vector<u16>> lists;
+  std::vector<u32> list_pos;
+  pos += 4;
+  for (const auto& tree : trees) {
+    for (const auto& node : tree.nodes) {
+      if (node.children >= 0 || node.prisms.empty())
+        continue;
+      if (lists.append(node.prisms) == list_pos.size()) {
+        list_pos.push_back(pos);
+        pos += (node.prisms.size() + 1) * 2;
+      }
+    }
+  }
+
+  std::vector<u8> out(roundUp(pos, 4));
+  for (size_t i = 0; i < lists.size(); ++i) {
+    u32 p = list_pos[i];
+    for (u16 prism : lists[i]) {
+      rsl::store<u16>(prism, out, p);
+      p += 2;
+    }
+  }
+
+  const auto entry = [&](const Octree& tree, const std::vector<u32>& arrays,
+                         u32 n, u32 base) -> u32 {
+    const auto& node = tree.nodes[n];
+    if (node.children >= 0)
+      return arrays[n] - base;
+    const u32 list = node.prisms.empty()
+                         ? lists_begin
+                         : list_pos[lists.find(node.prisms)] - 2;
+    return (list - base) | 0x8000'0000;
+  };
+  for (size_t t = 0; t < trees.size(); ++t) {
+    const auto& tree = trees[t];
+    rsl::store<u32>(entry(tree, array_pos[t], 0, 0), out, t * 4);
+    for (size_t n = 0; n < tree.nodes.size(); ++n) {
+      const s32 first = tree.nodes[n].children;
+      if (first < 0)
+        continue;
+      const u32 base = array_pos[t][n];
+      for (u32 i = 0; i < 8; ++i)
+        rsl::store<u32>(entry(tree, array_pos[t], first + i, base), out,
+                        base + i * 4);
+    }
+  }
+  return out;
+}
+
+Result<KCollisionData> EncodeKCollisionData(std::span<const KclTriangle> tris,
+                                            const KclEncoderOptions& options) {
+  KCollisionData data;
+  data.prism_thickness = options.prism_thickness;
+  data.sphere_radius = options.sphere_radius;
+
+  // Prisms, with positions and normals pooled
+  rsl::InternPool<glm::vec3> positions, normals;
+  std::vector<std::array<glm::vec3, 3>> kept;
+  for (const auto& tri : tris) {
+    if (IsDegenerate(tri.verts))
+      continue;
+    const auto& [a, b, c] = tri.verts;
+    const glm::vec3 fnrm = glm::normalize(glm::cross(b - a, c - a));
+    const glm::vec3 enrm1 = glm::normalize(glm::cross(a - c, fnrm));
+    const glm::vec3 enrm2 = glm::normalize(glm::cross(b - a, fnrm));
+    const glm::vec3 enrm3 = glm::normalize(glm::cross(c - b, fnrm));
+    const float height = glm::dot(c - a, enrm3);
+    if (!(height > 0.0f) || !std::isfinite(height))
+      continue;
+
+    data.prism_data.push_back(KCollisionPrismData{
+        .height = height,
+        .pos_i = static_cast<u16>(positions.append(a)),
+        .fnrm_i = static_cast<u16>(normals.append(fnrm)),
+        .enrm1_i = static_cast<u16>(normals.append(enrm1)),
+        .enrm2_i = static_cast<u16>(normals.append(enrm2)),
+        .enrm3_i = static_cast<u16>(normals.append(enrm3)),
+        .attribute = tri.attribute,
+    });
+    kept.push_back(tri.verts);
+    if (positions.size() > 0xFFFF || normals.size() > 0xFFFF ||
+        kept.size() >= 0xFFFF) {
+      return std::unexpected("Too many triangles for a KCL file");
+    }
+  }
+  data.pos_data = positions.entries();
+  data.nrm_data = normals.entries();
+  if (kept.empty()) {
+    return std::unexpected("No valid triangles");
+  }
+
+  // Area: a power-of-two box per axis, split into a grid of root blocks
+  Bounds bounds;
+  for (const auto& tri : kept)
+    for (const auto& v : tri)
+      bounds.add(v);
+  data.area_min_pos = glm::floor(bounds.min - options.block_margin);
+  const glm::vec3 extent =
+      bounds.max + options.block_margin - data.area_min_pos + 1.0f;
+  glm::ivec3 area_shift;
+  for (int i = 0; i < 3; ++i) {
+    area_shift[i] = std::max<s32>(
+        std::bit_width(static_cast<u32>(std::ceil(extent[i])) - 1),
+        options.min_block_width_shift);
+    if (area_shift[i] > 31) {
+      return std::unexpected("Collision model is too large");
+    }
+  }
+  const s32 max_shift = std::min({area_shift.x, area_shift.y, area_shift.z});
+  s32 shift = options.block_width_shift;
+  if (shift < 0) {
+    shift = std::min(options.min_block_width_shift, max_shift);
+    while (shift < max_shift &&
+           area_shift.x + area_shift.y + area_shift.z - 3 * shift >
+               options.max_root_blocks_shift)
+      ++shift;
+  }
+  shift = std::min(shift, max_shift);
+
+  data.area_x_width_mask = ~0u << area_shift.x;
+  data.area_y_width_mask = ~0u << area_shift.y;
+  data.area_z_width_mask = ~0u << area_shift.z;
+  data.block_width_shift = shift;
+  data.area_x_blocks_shift = area_shift.x - shift;
+  data.area_xy_blocks_shift = data.area_x_blocks_shift + area_shift.y - shift;
+
+  // Bin triangles into root blocks, then build each root's octree in parallel
+  const glm::uvec3 count{1u << (area_shift.x - shift),
+                         1u << (area_shift.y - shift),
+                         1u << (area_shift.z - shift)};
+  std::vector<Octree> trees(count.x * count.y * count.z);
+  for (auto& tree : trees)
+    tree.nodes.resize(1);
+  for (u32 i = 0; i < kept.size(); ++i) {
+    const auto [lo, hi] = BlockRange(kept[i], data.area_min_pos, shift, count,
+                                     options.block_margin);
+    for (u32 z = lo.z; z <= hi.z; ++z)
+      for (u32 y = lo.y; y <= hi.y; ++y)
+        for (u32 x = lo.x; x <= hi.x; ++x)
+          trees[(z << data.area_xy_blocks_shift) |
+                (y << data.area_x_blocks_shift) | x]
+              .nodes[0]
+              .prisms.push_back(static_cast<u16>(i + 1));
+  }
+
+  const OctreeBuilder builder{options, kept, data.area_min_pos};
+  rsl::ParallelFor(trees.size(), options.num_threads, [&](size_t i) {
+    auto& root = trees[i].nodes[0].prisms;
+    const glm::uvec3 origin =
+        glm::uvec3{i & (count.x - 1),
+                   (i >> data.area_x_blocks_shift) & (count.y - 1),
+                   i >> data.area_xy_blocks_shift}
+        << static_cast<u32>(shift);
+    std::erase_if(root, [&](u16 p) {
+      return !BlockOverlaps(data.area_min_pos, origin, shift,
+                            options.block_margin, kept[p - 1]);
+    });
+    builder.split(trees[i], 0, origin, shift);
+  });
+
+  data.block_data = WriteBlocks(trees);
+  return data;
+}
+
+std::vector<KclTriangle> ToTriangles(const KCollisionData& data) {
+  std::vector<KclTriangle> tris;
+  tris.reserve(data.prism_data.size());
+  for (const auto& prism : data.prism_data) {
+    tris.push_back(KclTriangle{.verts = FromPrism(data, prism),
+                               .attribute = prism.attribute});
+  }
+  return tris;
+}
+
+std::string ValidateKCollisionBlocks(const KCollisionData& data) {
+  // Leaves, grouped by root block
+  struct Leaf {
+    glm::uvec3 origin;
+    s32 shift;
+    u32 list;
+  };
+  const s32 shift = data.block_width_shift;
+  std::vector<std::vector<Leaf>> leaves(
+      1u << (data.area_xy_blocks_shift +
+             std::countr_zero(data.area_z_width_mask) - shift));
+  auto err = WalkKCollisionBlocks(
+      data, {.node = {},
+             .leaf = [&](glm::uvec3 origin, s32 s, u32 list) {
+               const glm::uvec3 root = origin >> static_cast<u32>(shift);
+               leaves[(root.z << data.area_xy_blocks_shift) |
+                      (root.y << data.area_x_blocks_shift) | root.x]
+                   .push_back({origin, s, list});
+             }});
+  if (!err.empty()) {
+    return err;
+  }
+
+  const auto tris = ToTriangles(data);
+  const glm::uvec3 count{
+      1u << data.area_x_blocks_shift,
+      1u << (data.area_xy_blocks_shift - data.area_x_blocks_shift),
+      static_cast<u32>(leaves.size()) >> data.area_xy_blocks_shift};
+  std::vector<std::vector<u16>> bins(leaves.size());
+  for (u32 i = 0; i < tris.size(); ++i) {
+    if (IsDegenerate(tris[i].verts))
+      continue;
+    const auto [lo, hi] =
+        BlockRange(tris[i].verts, data.area_min_pos, shift, count, 0.0f);
+    for (u32 z = lo.z; z <= hi.z; ++z)
+      for (u32 y = lo.y; y <= hi.y; ++y)
+        for (u32 x = lo.x; x <= hi.x; ++x)
+          bins[(z << data.area_xy_blocks_shift) |
+               (y << data.area_x_blocks_shift) | x]
+              .push_back(static_cast<u16>(i + 1));
+  }
+
+  std::vector<std::string> errors(leaves.size());
+  rsl::ParallelFor(leaves.size(), 0, [&](size_t r) {
+    std::vector<u16> listed;
+    for (const auto& leaf : leaves[r]) {
+      listed.clear();
+      for (u32 p = leaf.list; rsl::load<u16>(data.block_data, p) != 0; p += 2)
+        listed.push_back(rsl::load<u16>(data.block_data, p));
+      std::sort(listed.begin(), listed.end());
+
+      // Shrink the block slightly: prisms only approximate their triangles
+      const float width = static_cast<float>(1u << leaf.shift);
+      const float half = width * 0.5f;
+      const glm::vec3 center = data.area_min_pos + glm::vec3(leaf.origin) + half;
+      for (u16 p : bins[r]) {
+        if (!TriBoxOverlap(center, glm::vec3(half - width / 1024.0f),
+                           tris[p - 1].verts) ||
+            std::binary_search(listed.begin(), listed.end(), p))
+          continue;
+        errors[r] = "Prism " + std::to_string(p) + " overlaps the block at (" +
+                    std::to_string(leaf.origin.x) + ", " +
+                    std::to_string(leaf.origin.y) + ", " +
+                    std::to_string(leaf.origin.z) + ") of width " +
+                    std::to_string(1u << leaf.shift) + " but is not listed";
+        return;
+      }
+    }
+  });
+  for (auto& e : errors)
+    if (!e.empty())
+      return e;
+  return "";
+}
+
+} // namespace librii::kcol
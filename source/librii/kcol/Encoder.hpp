@@ -0,0 +1,52 @@
+#pragma once
+
+#include <array>
+#include <core/common.h>
+#include <glm/vec3.hpp>
+#include <librii/kcol/Model.hpp>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace librii::kcol {
+
+struct KclTriangle {
+  std::array<glm::vec3, 3> verts;
+  u16 attribute = 0;
+};
+
+struct KclEncoderOptions {
+  //! Blocks holding more triangles than this are split into eight children
+  u32 max_triangles_per_leaf = 30;
+  //! Blocks are never split below 2^min_block_width_shift units
+  s32 min_block_width_shift = 5;
+  //! Width of the root blocks, as a power of two. -1 picks the smallest width
+  //! that keeps the root grid within 2^max_root_blocks_shift blocks.
+  s32 block_width_shift = -1;
+  s32 max_root_blocks_shift = 12;
+  //! Blocks are grown by this many units when testing triangle overlap, so
+  //! that queries near a block edge still see neighboring prisms.
+  f32 block_margin = 0.0f;
+
+  f32 prism_thickness = 300.0f;
+  f32 sphere_radius = 250.0f;
+
+  //! Worker threads for building the octree (0 = one per core)
+  unsigned num_threads = 0;
+};
+
+//! Build prisms and the spatial octree for a triangle soup. Degenerate
+//! triangles are dropped.
+Result<KCollisionData> EncodeKCollisionData(std::span<const KclTriangle> tris,
+                                            const KclEncoderOptions& options =
+                                                {});
+
+//! Recover the triangles of an existing collision model, e.g. to re-encode it.
+std::vector<KclTriangle> ToTriangles(const KCollisionData& data);
+
+//! Walk the octree in |data.block_data| and check that it is well formed, and
+//! that every prism is listed in every leaf block its triangle overlaps.
+//! Returns an empty string on success.
+std::string ValidateKCollisionBlocks(const KCollisionData& data);
+
+} // namespace librii::kcol
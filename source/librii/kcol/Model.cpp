@@ -1,5 +1,8 @@
 #include "Model.hpp"
+#include <bit>
 #include <math.h>
+#include <oishii/writer/binary_writer.hxx>
+#include <set>
 
 IMPORT_STD;
 
@@ -134,6 +137,182 @@ std::string ReadKCollisionData(KCollisionData& data, std::span<const u8> bytes,
   return "";
 }
 
+Result<std::vector<u8>> WriteKCollisionData(const KCollisionData& data,
+                                            const SerializationProfile& profile) {
+  if (profile.quantization != Quantization::Float32) {
+    return std::unexpected("Only Float32 quantization is supported");
+  }
+  if (profile.major_revision != 1) {
+    return std::unexpected("Only V1 KCL files are supported");
+  }
+
+  // block_data is stored as it is found in Wii files: big endian. Swap the
+  // node entries and prism lists when targeting a little endian platform.
+  std::vector<u8> block_data = data.block_data;
+  if (profile.endian != std::endian::big) {
+    std::set<u32> nodes, lists;
+    auto err =
+        WalkKCollisionBlocks(data, {.node = [&](u32 ofs) { nodes.insert(ofs); },
+                                    .leaf = [&](glm::uvec3, s32, u32 list) {
+                                      lists.insert(list);
+                                    }});
+    if (!err.empty()) {
+      return std::unexpected("Cannot swap block data: " + err);
+    }
+    const auto swap = [&](auto type, u32 ofs) {
+      using T = decltype(type);
+      rsl::store<T>(rsl::GetFlipped(rsl::load<T>(block_data, ofs)),
+                    block_data, ofs);
+    };
+    const u32 num_roots =
+        1u << (data.area_xy_blocks_shift +
+               std::countr_zero(data.area_z_width_mask) -
+               data.block_width_shift);
+    for (u32 i = 0; i < num_roots; ++i)
+      swap(u32{}, i * 4);
+    for (u32 ofs : nodes)
+      for (u32 i = 0; i < 8; ++i)
+        swap(u32{}, ofs + i * 4);
+    // Lists may share a suffix, so mark each u16 to swap it only once
+    std::vector<bool> list_u16(block_data.size() / 2);
+    for (u32 ofs : lists)
+      for (; rsl::load<u16>(data.block_data, ofs) != 0; ofs += 2)
+        list_u16[ofs / 2] = true;
+    for (u32 i = 0; i < list_u16.size(); ++i)
+      if (list_u16[i])
+        swap(u16{}, i * 2);
+  }
+
+  const u32 pos_data_offset = sizeof(KCollisionV1Header);
+  const u32 nrm_data_offset =
+      pos_data_offset + data.pos_data.size() * sizeof(Vector3f);
+  const u32 prism_data_offset =
+      nrm_data_offset + data.nrm_data.size() * sizeof(Vector3f);
+  const u32 block_data_offset =
+      prism_data_offset + data.prism_data.size() * sizeof(KCollisionPrismData);
+
+  oishii::Writer writer(
+      profile.endian,
+      oishii::Writer::SizeHint{block_data_offset +
+                               static_cast<u32>(block_data.size())});
+  auto writeVec3 = [&](const glm::vec3& v) {
+    writer.write<f32>(v.x);
+    writer.write<f32>(v.y);
+    writer.write<f32>(v.z);
+  };
+
+  writer.write<u32>(pos_data_offset);
+  writer.write<u32>(nrm_data_offset);
+  // 1-indexed
+  writer.write<u32>(prism_data_offset - sizeof(KCollisionPrismData));
+  writer.write<u32>(block_data_offset);
+  writer.write<f32>(data.prism_thickness);
+  writeVec3(data.area_min_pos);
+  writer.write<u32>(data.area_x_width_mask);
+  writer.write<u32>(data.area_y_width_mask);
+  writer.write<u32>(data.area_z_width_mask);
+  writer.write<s32>(data.block_width_shift);
+  writer.write<s32>(data.area_x_blocks_shift);
+  writer.write<s32>(data.area_xy_blocks_shift);
+  writer.write<f32>(data.sphere_radius);
+
+  for (const auto& pos : data.pos_data)
+    writeVec3(pos);
+  for (const auto& nrm : data.nrm_data)
+    writeVec3(nrm);
+  for (const auto& prism : data.prism_data) {
+    writer.write<f32>(prism.height);
+    writer.write<u16>(prism.pos_i);
+    writer.write<u16>(prism.fnrm_i);
+    writer.write<u16>(prism.enrm1_i);
+    writer.write<u16>(prism.enrm2_i);
+    writer.write<u16>(prism.enrm3_i);
+    writer.write<u16>(prism.attribute);
+  }
+  writer.writeSpan<u8>(block_data);
+
+  return writer.takeBuf();
+}
+
+static std::string WalkNode(const KCollisionData& data,
+                            const KclBlockVisitor& visitor, u32 base,
+                            u32 entry, glm::uvec3 origin, s32 shift) {
+  const auto& blocks = data.block_data;
+  if (entry + 4 > blocks.size()) {
+    return "Block entry out of bounds";
+  }
+  const u32 value = rsl::load<u32>(blocks, entry);
+  const u64 target = static_cast<u64>(base) + (value & 0x7FFF'FFFF);
+
+  if (value & 0x8000'0000) {
+    // Points at the terminator before the list
+    const u64 list = target + 2;
+    for (u64 i = list;; i += 2) {
+      if (i + 2 > blocks.size()) {
+        return "Unterminated prism list";
+      }
+      const u16 prism = rsl::load<u16>(blocks, i);
+      if (prism == 0) {
+        break;
+      }
+      if (prism > data.prism_data.size()) {
+        return "Prism index out of bounds";
+      }
+    }
+    if (visitor.leaf) {
+      visitor.leaf(origin, shift, static_cast<u32>(list));
+    }
+    return "";
+  }
+
+  if (value == 0 || shift <= 0) {
+    return "Malformed octree";
+  }
+  if (target + 32 > blocks.size()) {
+    return "Block node out of bounds";
+  }
+  if (visitor.node) {
+    visitor.node(static_cast<u32>(target));
+  }
+  const u32 half = 1u << (shift - 1);
+  for (u32 i = 0; i < 8; ++i) {
+    const glm::uvec3 child =
+        origin + glm::uvec3{i & 1, (i >> 1) & 1, (i >> 2) & 1} * half;
+    auto err = WalkNode(data, visitor, target, target + i * 4, child, shift - 1);
+    if (!err.empty()) {
+      return err;
+    }
+  }
+  return "";
+}
+
+std::string WalkKCollisionBlocks(const KCollisionData& data,
+                                 const KclBlockVisitor& visitor) {
+  const s32 shift = data.block_width_shift;
+  const s32 x_shift = data.area_x_blocks_shift;
+  const s32 xy_shift = data.area_xy_blocks_shift;
+  const s32 z_shift = std::countr_zero(data.area_z_width_mask) - shift;
+  if (shift < 0 || shift > 31 || x_shift < 0 || xy_shift < x_shift ||
+      z_shift < 0 || xy_shift + z_shift > 24) {
+    return "Invalid block dimensions";
+  }
+
+  for (u32 z = 0; z < (1u << z_shift); ++z) {
+    for (u32 y = 0; y < (1u << (xy_shift - x_shift)); ++y) {
+      for (u32 x = 0; x < (1u << x_shift); ++x) {
+        const u32 index = (z << xy_shift) | (y << x_shift) | x;
+        auto err = WalkNode(data, visitor, 0, index * 4,
+                            glm::uvec3{x, y, z} << static_cast<u32>(shift),
+                            shift);
+        if (!err.empty()) {
+          return err;
+        }
+      }
+    }
+  }
+  return "";
+}
+
 constexpr std::array<char, 8> WiimmSZSIdentifier = {'W', 'i', 'i', 'm',
                                                     'm', 'S', 'Z', 'S'};
 
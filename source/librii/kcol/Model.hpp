@@ -16,6 +16,8 @@
 #include <variant>
 
 #include <core/util/timestamp.hpp>
+#include <functional>
+#include <librii/kcol/SerializationProfile.hpp>
 
 namespace librii::kcol {
 
@@ -126,6 +128,27 @@ struct KCollisionData {
 std::string ReadKCollisionData(KCollisionData& data, std::span<const u8> bytes,
                                u32 file_size);
 
+//! Only Float32, V1 profiles are supported.
+Result<std::vector<u8>>
+WriteKCollisionData(const KCollisionData& data,
+                    const SerializationProfile& profile =
+                        PlatformProfile(Platform::Revolution));
+
+//! Callbacks for WalkKCollisionBlocks. Offsets are into block_data.
+struct KclBlockVisitor {
+  //! A node's eight child entries, at |offset|
+  std::function<void(u32 offset)> node;
+  //! A leaf spanning [origin, origin + (1 << shift)) relative to area_min_pos.
+  //! Its prism indices (1-based) start at |list| and end with a 0.
+  std::function<void(glm::uvec3 origin, s32 shift, u32 list)> leaf;
+};
+
+//! Walk the octree in |data.block_data|, checking every offset and prism index.
+//! Shared nodes and lists are visited once per reference. Returns an empty
+//! string on success.
+std::string WalkKCollisionBlocks(const KCollisionData& data,
+                                 const KclBlockVisitor& visitor);
+
 inline std::array<glm::vec3, 3> FromPrism(const KCollisionData& data,
                                           const KCollisionPrismData& prism) {
   return FromPrism(prism.height, data.pos_data[prism.pos_i],
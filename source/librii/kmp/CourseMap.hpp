@@ -11,6 +11,7 @@
 #include <librii/kmp/data/MapStage.hpp>
 #include <librii/kmp/data/MapStart.hpp>
 #include <rsl/SmallVector.hpp>
+#include <rsl/SnapshotHistory.hpp>
 
 namespace librii::kmp {
 
@@ -34,3 +35,16 @@ struct CourseMap {
 };
 
 } // namespace librii::kmp
+
+// Each list is edited on its own; undo states share the untouched ones.
+// Must list every member.
+template <> struct rsl::SnapshotSections<librii::kmp::CourseMap> {
+  using T = librii::kmp::CourseMap;
+  static constexpr std::tuple members{
+      &T::mRevision,      &T::mOpeningPanIndex, &T::mVideoPanIndex,
+      &T::mStartPoints,   &T::mEnemyPaths,      &T::mItemPaths,
+      &T::mCheckPaths,    &T::mPaths,           &T::mGeoObjs,
+      &T::mAreas,         &T::mCameras,         &T::mRespawnPoints,
+      &T::mCannonPoints,  &T::mStages,          &T::mMissionPoints,
+  };
+};
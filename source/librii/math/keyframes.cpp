@@ -0,0 +1,177 @@
+#include "keyframes.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <rsl/Simd.hpp>
+
+namespace librii::math {
+
+static constexpr f32 Infinity = std::numeric_limits<f32>::infinity();
+
+u32 KeyframeSampler::addTrack(std::span<const HermiteKey> keys,
+                              Extrapolation extrapolation) {
+  const bool linear = extrapolation == Extrapolation::Linear;
+  const HermiteKey first = keys.empty() ? HermiteKey{} : keys.front();
+  const HermiteKey last = keys.empty() ? HermiteKey{} : keys.back();
+  const u32 begin = static_cast<u32>(mStart.size());
+  pushSegment(first.frame, Infinity, first.value, first.value,
+              linear ? first.tangentIn : 0.0f, 0.0f);
+  for (size_t i = 1; i < keys.size(); ++i) {
+    const HermiteKey& l = keys[i - 1];
+    const HermiteKey& r = keys[i];
+    pushSegment(l.frame, r.frame - l.frame, l.value, r.value, l.tangentOut,
+                r.tangentIn);
+  }
+  pushSegment(last.frame, Infinity, last.value, last.value,
+              linear ? last.tangentOut : 0.0f, 0.0f);
+  mTracks.push_back({.first = begin,
+                     .count = static_cast<u32>(mStart.size()) - begin});
+  mCursors.push_back(0);
+  return size() - 1;
+}
+
+u32 KeyframeSampler::addSampledTrack(std::span<const f32> values, f32 step) {
+  std::vector<HermiteKey> keys(values.size());
+  for (size_t i = 0; i < values.size(); ++i) {
+    const f32 prev = values[i > 0 ? i - 1 : i];
+    const f32 next = values[i + 1 < values.size() ? i + 1 : i];
+    keys[i] = {.frame = static_cast<f32>(i) * step, .value = values[i]};
+    // With both tangents at the slope of a segment, the curve is a line
+    if (i > 0) {
+      keys[i].tangentIn = (values[i] - prev) / step;
+    }
+    if (i + 1 < values.size()) {
+      keys[i].tangentOut = (next - values[i]) / step;
+    }
+  }
+  return addTrack(keys, Extrapolation::Clamp);
+}
+
+void KeyframeSampler::clear() {
+  mStart.clear();
+  mLength.clear();
+  mValue0.clear();
+  mValue1.clear();
+  mTangent0.clear();
+  mTangent1.clear();
+  mTracks.clear();
+  mCursors.clear();
+}
+
+void KeyframeSampler::pushSegment(f32 start, f32 length, f32 v0, f32 v1,
+                                  f32 m0, f32 m1) {
+  mStart.push_back(start);
+  mLength.push_back(length);
+  mValue0.push_back(v0);
+  mValue1.push_back(v1);
+  mTangent0.push_back(m0);
+  mTangent1.push_back(m1);
+}
+
+u32 KeyframeSampler::findSegment(const Track& track, u32 cursor,
+                                 f32 frame) const {
+  const f32* start = mStart.data() + track.first;
+  // The segment before the first key has no lower bound; the one after the
+  // last key has no upper bound.
+  auto contains = [&](u32 i) {
+    return (i == 0 || start[i] <= frame) &&
+           (i + 1 == track.count || frame < start[i + 1]);
+  };
+  if (contains(cursor)) {
+    return cursor;
+  }
+  if (cursor + 1 < track.count && contains(cursor + 1)) {
+    return cursor + 1;
+  }
+  // Last segment starting at or before |frame|
+  const f32* it = std::upper_bound(start + 1, start + track.count, frame);
+  return static_cast<u32>(it - start) - 1;
+}
+
+f32 KeyframeSampler::sample(u32 track, f32 frame) {
+  assert(track < mTracks.size());
+  const Track& t = mTracks[track];
+  mCursors[track] = findSegment(t, mCursors[track], frame);
+  const u32 s = t.first + mCursors[track];
+  return eval(frame, mStart[s], mLength[s], mValue0[s], mValue1[s],
+              mTangent0[s], mTangent1[s]);
+}
+
+#ifdef RSL_HAS_SSE2
+// eval() on four lanes
+static __m128 Eval4(__m128 frame, __m128 start, __m128 length, __m128 v0,
+                    __m128 v1, __m128 m0, __m128 m1) {
+  const __m128 d = _mm_sub_ps(frame, start);
+  const __m128 t = _mm_div_ps(d, length);
+  const __m128 inv_t = _mm_sub_ps(t, _mm_set1_ps(1.0f));
+  const __m128 tangents =
+      _mm_add_ps(_mm_mul_ps(inv_t, m0), _mm_mul_ps(t, m1));
+  const __m128 ease = _mm_mul_ps(
+      _mm_mul_ps(t, t),
+      _mm_sub_ps(_mm_set1_ps(3.0f), _mm_mul_ps(_mm_set1_ps(2.0f), t)));
+  return _mm_add_ps(
+      _mm_add_ps(v0, _mm_mul_ps(_mm_mul_ps(d, inv_t), tangents)),
+      _mm_mul_ps(ease, _mm_sub_ps(v1, v0)));
+}
+#endif
+
+void KeyframeSampler::sample(f32 frame, std::span<f32> out) {
+  assert(out.size() >= mTracks.size());
+  size_t i = 0;
+#ifdef RSL_HAS_SSE2
+  const __m128 frames = _mm_set1_ps(frame);
+  for (; i + 4 <= mTracks.size(); i += 4) {
+    u32 s[4];
+    for (size_t j = 0; j < 4; ++j) {
+      const Track& t = mTracks[i + j];
+      mCursors[i + j] = findSegment(t, mCursors[i + j], frame);
+      s[j] = t.first + mCursors[i + j];
+    }
+    auto gather = [&](const std::vector<f32>& v) {
+      return _mm_setr_ps(v[s[0]], v[s[1]], v[s[2]], v[s[3]]);
+    };
+    _mm_storeu_ps(out.data() + i,
+                  Eval4(frames, gather(mStart), gather(mLength),
+                        gather(mValue0), gather(mValue1), gather(mTangent0),
+                        gather(mTangent1)));
+  }
+#endif
+  for (; i < mTracks.size(); ++i) {
+    out[i] = sample(static_cast<u32>(i), frame);
+  }
+}
+
+void KeyframeSampler::bake(u32 track, f32 start, f32 step,
+                           std::span<f32> out) const {
+  assert(track < mTracks.size());
+  const Track& t = mTracks[track];
+  u32 cursor = 0;
+  size_t i = 0;
+#ifdef RSL_HAS_SSE2
+  for (; i + 4 <= out.size(); i += 4) {
+    f32 frames[4];
+    u32 s[4];
+    for (size_t j = 0; j < 4; ++j) {
+      frames[j] = start + static_cast<f32>(i + j) * step;
+      cursor = findSegment(t, cursor, frames[j]);
+      s[j] = t.first + cursor;
+    }
+    auto gather = [&](const std::vector<f32>& v) {
+      return _mm_setr_ps(v[s[0]], v[s[1]], v[s[2]], v[s[3]]);
+    };
+    _mm_storeu_ps(out.data() + i,
+                  Eval4(_mm_loadu_ps(frames), gather(mStart), gather(mLength),
+                        gather(mValue0), gather(mValue1), gather(mTangent0),
+                        gather(mTangent1)));
+  }
+#endif
+  for (; i < out.size(); ++i) {
+    const f32 frame = start + static_cast<f32>(i) * step;
+    cursor = findSegment(t, cursor, frame);
+    const u32 s = t.first + cursor;
+    out[i] = eval(frame, mStart[s], mLength[s], mValue0[s], mValue1[s],
+                  mTangent0[s], mTangent1[s]);
+  }
+}
+
+} // namespace librii::math
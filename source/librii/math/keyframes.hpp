@@ -0,0 +1,131 @@
+#pragma once
+
+#include <core/common.h>
+#include <ranges>
+
+namespace librii::math {
+
+//! A keyframe of a Hermite curve. Tangents are in units per frame.
+//!
+//! Other key types are sampled through a `HermiteKey toHermiteKey(const K&)`
+//! overload found by argument-dependent lookup.
+struct HermiteKey {
+  f32 frame{};
+  f32 value{};
+  f32 tangentIn{};
+  f32 tangentOut{};
+  bool operator==(const HermiteKey&) const = default;
+};
+inline HermiteKey toHermiteKey(const HermiteKey& key) { return key; }
+
+//! Value of a track outside of its first and last keyframes.
+enum class Extrapolation {
+  //! Continue along the tangent of the outermost keyframe (SRT0).
+  Linear,
+  //! Hold the value of the outermost keyframe (J3D).
+  Clamp,
+};
+
+//! @brief Samples many keyframe tracks at once.
+//!
+//! Tracks are compiled into one table of Hermite segments, stored as
+//! separate arrays per field. Each track remembers the segment it was last
+//! sampled in, so playing forward skips the search. Keyframes must be sorted
+//! by frame.
+//!
+class KeyframeSampler {
+public:
+  //! @return The index of the track.
+  u32 addTrack(std::span<const HermiteKey> keys,
+               Extrapolation extrapolation = Extrapolation::Linear);
+  template <std::ranges::range R>
+    requires(!std::convertible_to<R, std::span<const HermiteKey>>)
+  u32 addTrack(R&& keys, Extrapolation extrapolation = Extrapolation::Linear) {
+    std::vector<HermiteKey> tmp;
+    for (auto&& key : keys) {
+      tmp.push_back(toHermiteKey(key));
+    }
+    return addTrack(std::span<const HermiteKey>(tmp), extrapolation);
+  }
+  //! @brief A track of one value every |step| frames from frame 0, linearly
+  //! interpolated (e.g. a channel of a CLR0 track). The ends are held.
+  //!
+  //! @return The index of the track.
+  //!
+  u32 addSampledTrack(std::span<const f32> values, f32 step = 1.0f);
+
+  u32 size() const { return static_cast<u32>(mTracks.size()); }
+  void clear();
+
+  //! Sample every track at |frame|: |out| receives one value per track.
+  void sample(f32 frame, std::span<f32> out);
+  f32 sample(u32 track, f32 frame);
+  //! Sample |track| at |start|, |start| + |step|, ... into |out|.
+  void bake(u32 track, f32 start, f32 step, std::span<f32> out) const;
+
+  //! Sample a single track without compiling it.
+  static f32 sampleOnce(std::ranges::random_access_range auto&& keys,
+                        f32 frame,
+                        Extrapolation extrapolation = Extrapolation::Linear) {
+    const auto count = std::ranges::size(keys);
+    if (count == 0) {
+      return 0.0f;
+    }
+    // First key after |frame|
+    auto it = std::ranges::upper_bound(
+        keys, frame, {}, [](auto&& key) { return toHermiteKey(key).frame; });
+    const bool linear = extrapolation == Extrapolation::Linear;
+    if (it == std::ranges::begin(keys)) {
+      const HermiteKey first = toHermiteKey(*it);
+      return evalLinear(frame, first.frame, first.value,
+                        linear ? first.tangentIn : 0.0f);
+    }
+    const HermiteKey left = toHermiteKey(*std::ranges::prev(it));
+    if (it == std::ranges::end(keys)) {
+      return evalLinear(frame, left.frame, left.value,
+                        linear ? left.tangentOut : 0.0f);
+    }
+    const HermiteKey right = toHermiteKey(*it);
+    return eval(frame, left.frame, right.frame - left.frame, left.value,
+                right.value, left.tangentOut, right.tangentIn);
+  }
+
+  //! Same operations, in the same order, as librii::math::hermite.
+  static f32 eval(f32 frame, f32 start, f32 length, f32 v0, f32 v1, f32 m0,
+                  f32 m1) {
+    const f32 t = (frame - start) / length;
+    const f32 inv_t = t - 1.0f;
+    return v0 + (frame - start) * inv_t * (inv_t * m0 + t * m1) +
+           t * t * (3.0f - 2.0f * t) * (v1 - v0);
+  }
+  static f32 evalLinear(f32 frame, f32 start, f32 value, f32 slope) {
+    return value + (frame - start) * slope;
+  }
+
+private:
+  struct Track {
+    //! Index of the segment before the first key; the rest follow.
+    u32 first;
+    //! Including the ones before the first and after the last key.
+    u32 count;
+  };
+
+  void pushSegment(f32 start, f32 length, f32 v0, f32 v1, f32 m0, f32 m1);
+  u32 findSegment(const Track& track, u32 cursor, f32 frame) const;
+
+  // Segments before the first and after the last key are linear: they have
+  // an infinite length, v1 = v0 and m1 = 0, for which eval() reduces to
+  // evalLinear().
+  std::vector<f32> mStart;
+  std::vector<f32> mLength;
+  std::vector<f32> mValue0;
+  std::vector<f32> mValue1;
+  std::vector<f32> mTangent0;
+  std::vector<f32> mTangent1;
+
+  std::vector<Track> mTracks;
+  //! Last segment sampled, relative to the track's first
+  std::vector<u32> mCursors;
+};
+
+} // namespace librii::math
@@ -0,0 +1,181 @@
+#include "CompactMesh.hpp"
+
+#include "TriangleSet.hpp"
+
+namespace librii::rhst {
+
+std::size_t VertexArrays::bytes() const {
+  std::size_t total = mMatrixIndices.capacity() * sizeof(s8) +
+                      mPositions.capacity() * sizeof(glm::vec3) +
+                      mNormals.capacity() * sizeof(glm::vec3);
+  for (auto& c : mColors) {
+    total += c.capacity() * sizeof(glm::vec4);
+  }
+  for (auto& uv : mUvs) {
+    total += uv.capacity() * sizeof(glm::vec2);
+  }
+  return total;
+}
+
+void VertexArrays::push_back(const Vertex& v) {
+  if (mVcd & 1) {
+    mMatrixIndices.push_back(v.matrix_index);
+  }
+  if (hasPosition(mVcd)) {
+    mPositions.push_back(v.position);
+  }
+  if (hasNormal(mVcd)) {
+    mNormals.push_back(v.normal);
+  }
+  for (u32 i = 0; i < 2; ++i) {
+    if (hasColor(mVcd, i)) {
+      mColors[i].push_back(v.colors[i]);
+    }
+  }
+  for (u32 i = 0; i < 8; ++i) {
+    if (hasTexCoord(mVcd, i)) {
+      mUvs[i].push_back(v.uvs[i]);
+    }
+  }
+  ++mSize;
+}
+
+Vertex VertexArrays::operator[](std::size_t i) const {
+  Vertex v;
+  if (mVcd & 1) {
+    v.matrix_index = mMatrixIndices[i];
+  }
+  if (hasPosition(mVcd)) {
+    v.position = mPositions[i];
+  }
+  if (hasNormal(mVcd)) {
+    v.normal = mNormals[i];
+  }
+  for (u32 c = 0; c < 2; ++c) {
+    if (hasColor(mVcd, c)) {
+      v.colors[c] = mColors[c][i];
+    }
+  }
+  for (u32 c = 0; c < 8; ++c) {
+    if (hasTexCoord(mVcd, c)) {
+      v.uvs[c] = mUvs[c][i];
+    }
+  }
+  return v;
+}
+
+void VertexArrays::reserve(std::size_t n) {
+  if (mVcd & 1) {
+    mMatrixIndices.reserve(n);
+  }
+  if (hasPosition(mVcd)) {
+    mPositions.reserve(n);
+  }
+  if (hasNormal(mVcd)) {
+    mNormals.reserve(n);
+  }
+  for (u32 c = 0; c < 2; ++c) {
+    if (hasColor(mVcd, c)) {
+      mColors[c].reserve(n);
+    }
+  }
+  for (u32 c = 0; c < 8; ++c) {
+    if (hasTexCoord(mVcd, c)) {
+      mUvs[c].reserve(n);
+    }
+  }
+}
+
+void VertexArrays::shrink_to_fit() {
+  mMatrixIndices.shrink_to_fit();
+  mPositions.shrink_to_fit();
+  mNormals.shrink_to_fit();
+  for (auto& c : mColors) {
+    c.shrink_to_fit();
+  }
+  for (auto& uv : mUvs) {
+    uv.shrink_to_fit();
+  }
+}
+
+CompactMatrixPrimitive Compact(const MatrixPrimitive& prim,
+                               u32 vertex_descriptor) {
+  CompactMatrixPrimitive out;
+  out.draw_matrices = prim.draw_matrices;
+  out.vertices = VertexArrays(vertex_descriptor);
+  VertexIds ids;
+  for (auto& p : prim.primitives) {
+    auto& dst = out.primitives.emplace_back();
+    dst.topology = p.topology;
+    dst.indices.reserve(p.vertices.size());
+    for (auto& v : p.vertices) {
+      // Keyed by the whole vertex, as the stripifiers always were: merging
+      // vertices that differ only in inactive attributes could change strips.
+      const u32 id = ids.id(v);
+      if (id == out.vertices.size()) {
+        out.vertices.push_back(v);
+      }
+      dst.indices.push_back(id);
+    }
+  }
+  out.vertices.shrink_to_fit();
+  return out;
+}
+
+MatrixPrimitive Expand(const CompactMatrixPrimitive& prim) {
+  MatrixPrimitive out;
+  out.draw_matrices = prim.draw_matrices;
+  for (auto& p : prim.primitives) {
+    auto& dst = out.primitives.emplace_back();
+    dst.topology = p.topology;
+    dst.vertices.reserve(p.indices.size());
+    for (u32 i : p.indices) {
+      dst.vertices.push_back(prim.vertices[i]);
+    }
+  }
+  return out;
+}
+
+static CompactMesh CompactHeader(const Mesh& mesh) {
+  return CompactMesh{
+      .name = mesh.name,
+      .can_merge = mesh.can_merge,
+      .current_matrix = mesh.current_matrix,
+      .vertex_descriptor = mesh.vertex_descriptor,
+      .matrix_primitives = {},
+  };
+}
+
+CompactMesh Compact(Mesh&& mesh) {
+  CompactMesh out = CompactHeader(mesh);
+  for (auto& mp : mesh.matrix_primitives) {
+    out.matrix_primitives.push_back(Compact(mp, mesh.vertex_descriptor));
+    mp.primitives = {};
+  }
+  mesh.matrix_primitives = {};
+  return out;
+}
+
+CompactMesh Compact(const Mesh& mesh) {
+  CompactMesh out = CompactHeader(mesh);
+  for (auto& mp : mesh.matrix_primitives) {
+    out.matrix_primitives.push_back(Compact(mp, mesh.vertex_descriptor));
+  }
+  return out;
+}
+
+Mesh Expand(const CompactMesh& mesh) {
+  Mesh out{
+      .name = mesh.name,
+      .can_merge = mesh.can_merge,
+      .current_matrix = mesh.current_matrix,
+      .vertex_descriptor = mesh.vertex_descriptor,
+      .matrix_primitives = {},
+  };
+  for (auto& mp : mesh.matrix_primitives) {
+    out.matrix_primitives.push_back(Expand(mp));
+  }
+  return out;
+}
+
+} // namespace librii::rhst
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <array>
+#include <core/common.h>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <librii/rhst/RHST.hpp>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace librii::rhst {
+
+//! Vertex descriptor with every attribute a Vertex can carry.
+constexpr u32 AllVertexAttributes = 1 | (0xFFF << 9);
+
+//! Structure-of-arrays vertex storage holding only the attributes enabled in a
+//! vertex descriptor. A mesh with just positions and one UV set takes 20 bytes
+//! per vertex rather than the 124 of a Vertex.
+class VertexArrays {
+public:
+  VertexArrays() = default;
+  explicit VertexArrays(u32 vertex_descriptor) : mVcd(vertex_descriptor) {}
+
+  u32 vertexDescriptor() const { return mVcd; }
+  std::size_t size() const { return mSize; }
+  //! Heap bytes used by the attribute arrays.
+  std::size_t bytes() const;
+
+  //! Appends the active attributes of |v|.
+  void push_back(const Vertex& v);
+  //! Gathers vertex |i|. Inactive attributes are left at their defaults.
+  Vertex operator[](std::size_t i) const;
+
+  // Empty if the attribute is inactive
+  std::span<const s8> matrixIndices() const { return mMatrixIndices; }
+  std::span<const glm::vec3> positions() const { return mPositions; }
+  std::span<const glm::vec3> normals() const { return mNormals; }
+  std::span<const glm::vec4> colors(u32 chan) const { return mColors[chan]; }
+  std::span<const glm::vec2> uvs(u32 chan) const { return mUvs[chan]; }
+
+  void reserve(std::size_t n);
+  void shrink_to_fit();
+
+private:
+  u32 mVcd = 0;
+  std::size_t mSize = 0;
+  std::vector<s8> mMatrixIndices;
+  std::vector<glm::vec3> mPositions;
+  std::vector<glm::vec3> mNormals;
+  std::array<std::vector<glm::vec4>, 2> mColors;
+  std::array<std::vector<glm::vec2>, 8> mUvs;
+};
+
+//! A primitive as indices into its VertexArrays.
+struct IndexedPrimitive {
+  Topology topology = Topology::Triangles;
+  std::vector<u32> indices;
+
+  bool operator==(const IndexedPrimitive&) const = default;
+};
+
+//! MatrixPrimitive with deduplicated, attribute-masked vertices.
+struct CompactMatrixPrimitive {
+  std::array<s32, 10> draw_matrices{-1, -1, -1, -1, -1, -1, -1, -1, -1, -1};
+  VertexArrays vertices;
+  std::vector<IndexedPrimitive> primitives;
+};
+
+//! Mesh with compact matrix primitives. Converting a Mesh drops attributes not
+//! in its vertex_descriptor, which compileMesh ignores anyway.
+struct CompactMesh {
+  std::string name = "Untitled Mesh";
+  bool can_merge = true;
+
+  s32 current_matrix = 0;
+  u32 vertex_descriptor = 0;
+
+  std::vector<CompactMatrixPrimitive> matrix_primitives;
+};
+
+inline size_t VertexCount(std::span<const IndexedPrimitive> prims) {
+  size_t score = 0;
+  for (auto& p : prims) {
+    score += p.indices.size();
+  }
+  return score;
+}
+inline size_t FaceCount(std::span<const IndexedPrimitive> prims) {
+  u32 face = 0;
+  for (auto& p : prims) {
+    if (p.topology == Topology::Triangles) {
+      face += p.indices.size() / 3;
+    } else if (p.topology == Topology::TriangleStrip ||
+               p.topology == Topology::TriangleFan) {
+      face += p.indices.size() - 2;
+    }
+  }
+  return face;
+}
+
+//! Deduplicates the vertices of |prim|, keeping only the attributes in
+//! |vertex_descriptor|. Indices are assigned in order of first use.
+CompactMatrixPrimitive Compact(const MatrixPrimitive& prim,
+                               u32 vertex_descriptor = AllVertexAttributes);
+MatrixPrimitive Expand(const CompactMatrixPrimitive& prim);
+//! Frees the vertices of |mesh| as they are converted.
+CompactMesh Compact(Mesh&& mesh);
+CompactMesh Compact(const Mesh& mesh);
+Mesh Expand(const CompactMesh& mesh);
+
+// The stripifiers proper work on indices: |prims| index into |vertices|, which
+// is left untouched. The MatrixPrimitive versions in RHST.hpp wrap these.
+Result<MeshOptimizerStats>
+StripifyTrianglesAlgo(const VertexArrays& vertices,
+                      std::vector<IndexedPrimitive>& prims, Algo algo);
+Result<Algo> StripifyTriangles(const VertexArrays& vertices,
+                               std::vector<IndexedPrimitive>& prims,
+                               std::optional<Algo> except = std::nullopt,
+                               std::string_view debug_name = "?",
+                               bool verbose = true,
+                               rsl::ThreadPool* pool = nullptr,
+                               u32 time_budget_ms = 0);
+Result<Algo> StripifyTriangles(CompactMatrixPrimitive& prim,
+                               std::optional<Algo> except = std::nullopt,
+                               std::string_view debug_name = "?",
+                               bool verbose = true,
+                               rsl::ThreadPool* pool = nullptr,
+                               u32 time_budget_ms = 0);
+
+} // namespace librii::rhst
@@ -1,29 +1,39 @@
 #pragma once
 
-#include <librii/rhst/RHST.hpp>
+#include <librii/rhst/CompactMesh.hpp>
+#include <librii/rhst/MeshUtils.hpp>
 
 namespace librii::rhst {
 
-// As RHST isn't an indexed format (yet), this class does the conversion.
+// Stripifiers want a triangle list over dense vertex IDs [0, n), while compact
+// indices refer to the whole VertexArrays of the matrix primitive. This class
+// does the conversion; vertices are numbered in order of first use.
 template <typename T = u32> struct IndexBuffer {
-  static Result<IndexBuffer<T>> create(const MatrixPrimitive& prim) {
-    EXPECT(prim.primitives.size() == 1);
-    EXPECT(prim.primitives[0].topology == Topology::Triangles);
+  static Result<IndexBuffer<T>>
+  create(std::span<const IndexedPrimitive> prims) {
     IndexBuffer<T> tmp;
-    for (auto& v : prim.primitives[0].vertices) {
-      auto it = std::find(tmp.vertices.begin(), tmp.vertices.end(), v);
-      if (it != tmp.vertices.end()) {
-        tmp.index_data.push_back(it - tmp.vertices.begin());
-        continue;
+    std::vector<T> local; // Compact index -> dense index
+    for (auto& p : prims) {
+      for (auto idx : MeshUtils::AsTrianglesIdx(p.topology, p.indices.size())) {
+        const u32 v = p.indices[TRY(idx)];
+        if (v >= local.size()) {
+          local.resize(v + 1, Unused);
+        }
+        if (local[v] == Unused) {
+          local[v] = static_cast<T>(tmp.vertices.size());
+          tmp.vertices.push_back(v);
+        }
+        tmp.index_data.push_back(local[v]);
       }
-      tmp.index_data.push_back(static_cast<T>(tmp.vertices.size()));
-      tmp.vertices.push_back(v);
-      EXPECT(tmp.vertices[tmp.vertices.size() - 1] == v);
     }
     return tmp;
   }
-  std::vector<Vertex> vertices;
+  // Compact index of each dense vertex
+  std::vector<u32> vertices;
   std::vector<T> index_data;
+
+private:
+  static constexpr T Unused = static_cast<T>(~0ull);
 };
 
 } // namespace librii::rhst
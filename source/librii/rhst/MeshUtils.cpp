@@ -2,9 +2,9 @@
 
 namespace librii::rhst {
 
-coro::generator<Result<size_t>>
-MeshUtils::AsTrianglesIdx(const Primitive& prim) {
-  switch (prim.topology) {
+coro::generator<Result<size_t>> MeshUtils::AsTrianglesIdx(Topology topology,
+                                                          size_t count) {
+  switch (topology) {
   case Topology::TriangleStrip: {
     //
     // TRIANGLE STRIPS
@@ -15,7 +15,7 @@ MeshUtils::AsTrianglesIdx(const Primitive& prim) {
     //      | /
     //      v1
     //
-    if (prim.vertices.size() < 3) {
+    if (count < 3) {
       co_yield std::unexpected("Invalid triangle strip size");
     }
     for (size_t v = 0; v < 3; ++v) {
@@ -37,7 +37,7 @@ MeshUtils::AsTrianglesIdx(const Primitive& prim) {
     //      | /   \ /  \
     //      v1-----v3--v5
     //
-    for (size_t v = 3; v < prim.vertices.size(); ++v) {
+    for (size_t v = 3; v < count; ++v) {
       co_yield v - ((v & 1) ? 1 : 2);
       co_yield v - ((v & 1) ? 2 : 1);
       co_yield v;
@@ -54,7 +54,7 @@ MeshUtils::AsTrianglesIdx(const Primitive& prim) {
     //      |/
     //      v1
     //
-    if (prim.vertices.size() < 3) {
+    if (count < 3) {
       co_yield std::unexpected("Invalid triangle fan size");
     }
     for (size_t v = 0; v < 3; ++v) {
@@ -85,7 +85,7 @@ MeshUtils::AsTrianglesIdx(const Primitive& prim) {
     //      | /
     //      v1
     //
-    for (size_t v = 3; v < prim.vertices.size(); ++v) {
+    for (size_t v = 3; v < count; ++v) {
       co_yield static_cast<size_t>(0);
       co_yield v - 1;
       co_yield v;
@@ -112,10 +112,10 @@ MeshUtils::AsTrianglesIdx(const Primitive& prim) {
     //      | /       \ |       /  |
     //      v1         v5     v7--v8
     //
-    if (prim.vertices.size() % 3 != 0) {
+    if (count % 3 != 0) {
       co_yield std::unexpected("Invalid triangle size");
     }
-    for (size_t i = 0; i < prim.vertices.size(); ++i) {
+    for (size_t i = 0; i < count; ++i) {
       co_yield i;
     }
     co_return;
@@ -125,6 +125,11 @@ MeshUtils::AsTrianglesIdx(const Primitive& prim) {
   co_yield std::unexpected("Unexpected primitive type");
 }
 
+coro::generator<Result<size_t>>
+MeshUtils::AsTrianglesIdx(const Primitive& prim) {
+  return AsTrianglesIdx(prim.topology, prim.vertices.size());
+}
+
 coro::generator<Result<Vertex>>
 MeshUtils::AsTriangles(std::span<const Primitive> primitives) {
   for (auto& prim : primitives) {
@@ -47,6 +47,10 @@ public:
   // |prim| in triangle form.
   static coro::generator<Result<size_t>> AsTrianglesIdx(const Primitive& prim);
 
+  // As above, for a primitive of |count| vertices. Works for index buffers.
+  static coro::generator<Result<size_t>> AsTrianglesIdx(Topology topology,
+                                                        size_t count);
+
   // Transforms a list of primitives of any type |primitives| to a list of
   // just triangles.
   static coro::generator<Result<Vertex>>
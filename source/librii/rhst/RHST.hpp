@@ -11,6 +11,10 @@
 
 #include <coro/generator.hpp>
 
+namespace rsl {
+class ThreadPool;
+} // namespace rsl
+
 inline std::partial_ordering operator<=>(const glm::vec4& l,
                                          const glm::vec4& r) {
   if (auto cmp = l.x <=> r.x; cmp != 0) {
@@ -380,10 +384,17 @@ Result<MeshOptimizerStats> StripifyTrianglesAlgo(MatrixPrimitive& prim,
                                                  Algo algo);
 
 // Brute-force every algorithm
+//
+// With a |pool|, the algorithms run concurrently as a task group on it (this
+// may be nested inside a task of the same pool). With a nonzero
+// |time_budget_ms|, algorithms that have not started when the budget runs out
+// are skipped and the best result so far is kept.
 Result<Algo> StripifyTriangles(MatrixPrimitive& prim,
                                std::optional<Algo> except = std::nullopt,
                                std::string_view debug_name = "?",
-                               bool verbose = true);
+                               bool verbose = true,
+                               rsl::ThreadPool* pool = nullptr,
+                               u32 time_budget_ms = 0);
 
 Result<SceneTree> ReadSceneTree(std::span<const u8> file_data);
 
@@ -1,7 +1,9 @@
+#include "CompactMesh.hpp"
 #include "IndexBuffer.hpp"
 #include "MeshUtils.hpp"
 #include "RHST.hpp"
 #include "TriFanMeshOptimizer.hpp"
+#include "TriangleSet.hpp"
 #include <rsmeshopt/HaroohieTriStripifier.hpp>
 
 #include <draco/mesh/mesh_stripifier.h>
@@ -13,145 +15,33 @@
 #include <fort.hpp>
 #undef throw
 #include <rsl/Ranges.hpp>
-
-#if defined(__APPLE__) || defined(__linux__)
-#include <range/v3/range/conversion.hpp>
-#include <range/v3/view/chunk.hpp>
-#endif
+#include <rsl/ThreadPool.hpp>
 
 namespace librii::rhst {
 
-// Validates that an optimization pass did not damage the model itself.
-// - Duplicates are allowed
-// - Degenerates are stripped
-class TriList {
-public:
-  Result<void> SetFromMPrim(const MatrixPrimitive& prim) {
-    triangles_.reserve(20'000);
-
-#if defined(__APPLE__) || defined(__linux__)
-    auto verts =
-        ranges::to<std::vector>(MeshUtils::AsTriangles(prim.primitives));
-    for (auto it : verts | ranges::views::chunk(3)) {
-#else
-    for (auto it :
-         MeshUtils::AsTriangles(prim.primitives) | std::views::chunk(3)) {
-#endif
-      std::array<Vertex, 3> tri;
-      size_t i = 0;
-      for (auto& x : it) {
-        if (!x.has_value()) {
-          return std::unexpected(x.error());
-        }
-        tri[i++] = *x;
-      }
-      // Discard degenerate triangles
-      if (tri[0] == tri[1] || tri[0] == tri[2] || tri[1] == tri[2] ||
-          tri[0] == tri[2]) {
-        continue;
-      }
-      // Sort triangle
-      if (tri[0] > tri[1]) {
-        std::swap(tri[0], tri[1]);
-      }
-      if (tri[1] > tri[2]) {
-        std::swap(tri[1], tri[2]);
-      }
-      if (tri[0] > tri[1]) {
-        std::swap(tri[0], tri[1]);
-      }
-      InsertTriangle(tri[0], tri[1], tri[2]);
-    }
-
-    std::sort(triangles_.begin(), triangles_.end());
-
-    return {};
-  }
-
-  bool operator==(const TriList& rhs) const = default;
-
-private:
-  struct Tri {
-    Vertex a{}, b{}, c{};
-    std::partial_ordering operator<=>(const Tri& rhs) const {
-      if (auto cmp = a <=> rhs.a; cmp != 0)
-        return cmp;
-      if (auto cmp = b <=> rhs.b; cmp != 0)
-        return cmp;
-      return c <=> rhs.c;
-    }
-    bool operator==(const Tri&) const = default;
-  };
-
-  // Insert a triangle into the list unsorted
-  void InsertTriangle(const Vertex& a, const Vertex& b, const Vertex& c) {
-    Tri tri{a, b, c};
-    triangles_.push_back(tri);
-  }
-
-public:
-  // Sorted, duplicates allowed
-  std::vector<Tri> triangles_;
-};
-
-Result<void> ValidateMeshesEqualImpl(const TriList& ll, const TriList& rl) {
-  if (ll.triangles_.size() != rl.triangles_.size()) {
-    return std::unexpected(
-        std::format("Number of triangles does not match (l: {}, r: {})",
-                    ll.triangles_.size(), rl.triangles_.size()));
-  }
-  for (size_t i = 0; i < ll.triangles_.size(); ++i) {
-    auto a = ll.triangles_[i];
-    auto b = rl.triangles_[i];
-    if (a != b) {
-#ifndef NDEBUG
-      auto test = a.a.position <=> b.a.position;
-      bool ok_a = a.a == b.a;
-      bool ok_b = a.b == b.b;
-#endif
-      bool ok_c = a.c == b.c;
-      return std::unexpected(std::format("Mismatch at triangle {}/{}", i,
-                                         ll.triangles_.size() - 1));
-    }
-  }
-  return {};
-}
-Result<void> ValidateMeshesEqual(const MatrixPrimitive& l,
-                                 const MatrixPrimitive& r) {
-  TriList ll, rl;
-  if (auto ok = ll.SetFromMPrim(l); !ok) {
-    return std::unexpected("Failed to validate. Initial mprim is invalid: " +
-                           ok.error());
-  }
-  if (auto ok = rl.SetFromMPrim(r); !ok) {
-    return std::unexpected("Failed to validate. New mprim is invalid: " +
-                           ok.error());
-  }
-  return ValidateMeshesEqualImpl(ll, rl);
-}
-
 // Instruments collection of Optimizer stats of a certain primitive encoding
 // algorithm like triangle stripification.
 class MeshOptimizerStatsCollector {
 public:
-  MeshOptimizerStatsCollector(const MatrixPrimitive& prim) {
-    prim_ = &prim;
-    stats_.before_indices = VertexCount(*prim_);
-    stats_.before_faces = FaceCount(*prim_);
+  MeshOptimizerStatsCollector(const std::vector<IndexedPrimitive>& prims,
+                              size_t num_vertices) {
+    prims_ = &prims;
+    stats_.before_indices = VertexCount(*prims_);
+    stats_.before_faces = FaceCount(*prims_);
     timer_.reset();
 #ifndef NDEBUG
-    backup_ = *prim_;
+    backup_ = *prims_;
+    num_vertices_ = num_vertices;
 #endif
   }
 
   // Ends the session and returns the results.
   MeshOptimizerStats End() {
-    stats_.after_indices = VertexCount(*prim_);
-    stats_.after_faces = FaceCount(*prim_);
+    stats_.after_indices = VertexCount(*prims_);
+    stats_.after_faces = FaceCount(*prims_);
     stats_.ms_elapsed = timer_.elapsed();
 #ifndef NDEBUG
-    auto ok = ValidateMeshesEqual(backup_, *prim_);
-    // assert(ok);
+    Verify();
 #endif
     return stats_;
   }
@@ -162,62 +52,71 @@ public:
 
 #ifndef NDEBUG
   void Verify() {
-    auto ok = ValidateMeshesEqual(backup_, *prim_);
-    // assert(ok);
+    TriangleSet before, after;
+    auto ok = before.SetFromIndexed(backup_, num_vertices_);
+    ok = after.SetFromIndexed(*prims_, num_vertices_);
+    // assert(ok && before == after);
   }
 #endif
 
 private:
-  const MatrixPrimitive* prim_{};
+  const std::vector<IndexedPrimitive>* prims_{};
   MeshOptimizerStats stats_{};
   rsl::Timer timer_{};
 #ifndef NDEBUG
-  MatrixPrimitive backup_;
+  std::vector<IndexedPrimitive> backup_;
+  size_t num_vertices_{};
 #endif
 };
 
 // Test bench for a variety of "experiments -- different ways to encode a set of
 // Primitives. Experiments are scored by vertex count; only the winning
 // experiment will be selected for actual output.
+//
+// Experiments are index lists into the same VertexArrays, so they are cheap to
+// copy and a compact index doubles as the vertex ID for validation.
 template <typename KeyT> class MeshOptimizerExperimentHolder {
 public:
-  MeshOptimizerExperimentHolder(const MatrixPrimitive& baseline)
-      : baseline_(baseline) {}
+  using Experiment = std::vector<IndexedPrimitive>;
+
+  MeshOptimizerExperimentHolder(const Experiment& baseline,
+                                size_t num_vertices)
+      : baseline_(baseline), num_vertices_(num_vertices) {}
 
   // Creates an experiment with the specified index |key| based on the baseline.
-  MatrixPrimitive& CreateExperiment(KeyT key) {
+  Experiment& CreateExperiment(KeyT key) {
     // unordered_map guarantees reference stability
     // operator[] constructs elements as necessary
     return (experiments_[key] = baseline_);
   }
 
-  const MatrixPrimitive& GetExperiment(KeyT key) const {
+  const Experiment& GetExperiment(KeyT key) const {
     assert(experiments_.contains(key));
     return experiments_.at(key);
   }
 
   [[nodiscard]] Result<void> ValidateExperimentWithBaseline(KeyT key) const {
     assert(experiments_.contains(key));
-    // Constructing a TriList is sufficiently expensive to warrant caching.
+    // Constructing a TriangleSet is sufficiently expensive to warrant caching.
     if (!baselineList_) {
-      TriList list;
-      TRY(list.SetFromMPrim(baseline_));
+      TriangleSet list;
+      TRY(list.SetFromIndexed(baseline_, num_vertices_));
       baselineList_ = std::move(list);
     }
-    TriList ref;
-    TRY(ref.SetFromMPrim(experiments_.at(key)));
+    TriangleSet ref;
+    TRY(ref.SetFromIndexed(experiments_.at(key), num_vertices_));
     return ValidateMeshesEqualImpl(*baselineList_, ref);
   }
 
   [[nodiscard]] Result<void> ValidateAllWithBaseline() const {
     if (!baselineList_) {
-      TriList list;
-      TRY(list.SetFromMPrim(baseline_));
+      TriangleSet list;
+      TRY(list.SetFromIndexed(baseline_, num_vertices_));
       baselineList_ = std::move(list);
     }
     for (auto& [key, experiment] : experiments_) {
-      TriList ref;
-      TRY(ref.SetFromMPrim(experiments_.at(key)));
+      TriangleSet ref;
+      TRY(ref.SetFromIndexed(experiments_.at(key), num_vertices_));
       auto ok = ValidateMeshesEqualImpl(*baselineList_, ref);
       if (!ok) {
         return std::unexpected(
@@ -251,7 +150,7 @@ public:
     }
   }
 
-  const MatrixPrimitive& GetFirstWinner() const {
+  const Experiment& GetFirstWinner() const {
     for (KeyT winner : CalcWinners()) {
       return experiments_.at(winner);
     }
@@ -294,10 +193,10 @@ public:
 private:
   // Const as baseLineList may be generated based on this within a const
   // function.
-  const MatrixPrimitive baseline_{};
-  // For validation. Mutable so ValidateExperimentWithBaseline can remain const.
-  mutable std::optional<TriList> baselineList_;
-  std::unordered_map<KeyT, MatrixPrimitive> experiments_{};
+  const Experiment baseline_{};
+  const size_t num_vertices_{};
+  mutable std::optional<TriangleSet> baselineList_;
+  std::unordered_map<KeyT, Experiment> experiments_{};
   std::unordered_map<KeyT, MeshOptimizerStats> stats_{};
 };
 
@@ -388,9 +287,10 @@ PrintScoresOfExperiment(const MeshOptimizerExperimentHolder<KeyT>& holder) {
 
 // Class for managing index buffers of TriangleFan and TriangleStrip data. Joins
 // all simple strips/fans (size=3) into a single TRIANGLES buffer at the end.
+// |vertices| maps the dense indices of an IndexBuffer back to compact ones.
 class PrimitiveRestartSplitter {
 public:
-  PrimitiveRestartSplitter(Topology topology, std::span<const Vertex> vertices,
+  PrimitiveRestartSplitter(Topology topology, std::span<const u32> vertices,
                            u32 primitive_restart_index)
       : topology_(topology), vertices_(vertices),
         primitive_restart_index_(primitive_restart_index) {}
@@ -409,23 +309,23 @@ public:
   void SetIndices(std::vector<u32>&& indices) { indices_ = std::move(indices); }
 
   // Convert cached index buffer into a list of RHST primitives.
-  coro::generator<Primitive> Primitives() const;
+  coro::generator<IndexedPrimitive> Primitives() const;
 
 private:
   Topology topology_{};
-  std::span<const Vertex> vertices_{};
+  std::span<const u32> vertices_{};
   u32 primitive_restart_index_{~0u};
   std::vector<u32> indices_{};
 };
 
-coro::generator<Primitive> PrimitiveRestartSplitter::Primitives() const {
-  Primitive triangles{};
+coro::generator<IndexedPrimitive> PrimitiveRestartSplitter::Primitives() const {
+  IndexedPrimitive triangles{};
   triangles.topology = Topology::Triangles;
   for (auto strip : MeshUtils::SplitByPrimitiveRestart<unsigned int>(
            indices_, primitive_restart_index_)) {
     assert(strip.size() >= 3);
-    Primitive* p{};
-    Primitive tmp;
+    IndexedPrimitive* p{};
+    IndexedPrimitive tmp;
     // Triangle Fans and Triangle Strips of length 3 are just triangles.
     if (strip.size() == 3) {
       p = &triangles;
@@ -436,52 +336,55 @@ coro::generator<Primitive> PrimitiveRestartSplitter::Primitives() const {
     for (auto u : strip) {
       assert(u != primitive_restart_index_);
       assert(u < vertices_.size());
-      p->vertices.push_back(vertices_[u]);
+      p->indices.push_back(vertices_[u]);
     }
     if (strip.size() > 3) {
       co_yield *p;
     }
   }
-  if (!triangles.vertices.empty()) {
+  if (!triangles.indices.empty()) {
     co_yield triangles;
   }
 }
 
+namespace {
+
+using Prims = std::vector<IndexedPrimitive>;
+
 Result<MeshOptimizerStats>
-StripifyTrianglesMeshOptimizer(MatrixPrimitive& prim) {
-  MeshOptimizerStatsCollector stats(prim);
+StripifyTrianglesMeshOptimizer(const VertexArrays& verts, Prims& prims) {
+  MeshOptimizerStatsCollector stats(prims, verts.size());
 
-  auto buf = TRY(IndexBuffer<u32>::create(prim));
-  std::vector<Vertex> vertices = std::move(buf.vertices);
+  auto buf = TRY(IndexBuffer<u32>::create(prims));
   std::vector<u32> index_data = std::move(buf.index_data);
 
   size_t index_count = index_data.size();
-  size_t vertex_count = vertices.size();
+  size_t vertex_count = buf.vertices.size();
   std::vector<unsigned int> strip(meshopt_stripifyBound(index_count));
   unsigned int restart_index = ~0u;
   size_t strip_size = meshopt_stripify(
       &strip[0], index_data.data(), index_count, vertex_count, restart_index);
   strip.resize(strip_size);
 
-  PrimitiveRestartSplitter splitter(Topology::TriangleStrip, vertices, ~0u);
+  PrimitiveRestartSplitter splitter(Topology::TriangleStrip, buf.vertices, ~0u);
   splitter.SetIndices(std::move(strip));
-  prim.primitives.clear();
-  for (Primitive& p : splitter.Primitives()) {
-    prim.primitives.push_back(std::move(p));
+  prims.clear();
+  for (IndexedPrimitive& p : splitter.Primitives()) {
+    prims.push_back(std::move(p));
   }
 
   return stats.End();
 }
-Result<MeshOptimizerStats> StripifyTrianglesTriStripper(MatrixPrimitive& prim) {
-  MeshOptimizerStatsCollector stats(prim);
-  auto buf = TRY(IndexBuffer<u32>::create(prim));
-  std::vector<Vertex> vertices = std::move(buf.vertices);
+Result<MeshOptimizerStats>
+StripifyTrianglesTriStripper(const VertexArrays& verts, Prims& prims) {
+  MeshOptimizerStatsCollector stats(prims, verts.size());
+  auto buf = TRY(IndexBuffer<u32>::create(prims));
 
   auto out = TRY(rsmeshopt::StripifyTrianglesTriStripper(buf.index_data));
 
-  prim.primitives.clear();
+  prims.clear();
   for (auto& x : out) {
-    auto& to = prim.primitives.emplace_back();
+    auto& to = prims.emplace_back();
     switch (x.Type) {
     case triangle_stripper::TRIANGLES:
       to.topology = Topology::Triangles;
@@ -491,76 +394,76 @@ Result<MeshOptimizerStats> StripifyTrianglesTriStripper(MatrixPrimitive& prim) {
       break;
     }
     for (size_t idx : x.Indices) {
-      to.vertices.push_back(vertices[idx]);
+      to.indices.push_back(buf.vertices[idx]);
     }
   }
 
   return stats.End();
 }
 Result<MeshOptimizerStats>
-StripifyTrianglesNvTriStripPort(MatrixPrimitive& prim) {
-  MeshOptimizerStatsCollector stats(prim);
-  auto buf = TRY(IndexBuffer<u32>::create(prim));
-  std::vector<Vertex> vertices = std::move(buf.vertices);
+StripifyTrianglesNvTriStripPort(const VertexArrays& verts, Prims& prims) {
+  MeshOptimizerStatsCollector stats(prims, verts.size());
+  auto buf = TRY(IndexBuffer<u32>::create(prims));
   std::vector<u32> index_data = std::move(buf.index_data);
 
   EXPECT(index_data.size() % 3 == 0);
   auto strips = TRY(rsmeshopt::StripifyTrianglesNvTriStripPort(index_data));
 
-  prim.primitives.clear();
+  prims.clear();
   for (auto& x : strips) {
     EXPECT(x.size() >= 3);
     if (x.size() <= 3)
       continue;
-    auto& to = prim.primitives.emplace_back();
+    auto& to = prims.emplace_back();
     to.topology = Topology::TriangleStrip;
     for (int idx : x) {
-      to.vertices.push_back(vertices[idx]);
+      to.indices.push_back(buf.vertices[idx]);
     }
   }
-  auto& v_new = prim.primitives.emplace_back();
+  auto& v_new = prims.emplace_back();
   v_new.topology = Topology::Triangles;
   for (auto& x : strips) {
     if (x.size() == 3) {
       for (int y : x) {
-        v_new.vertices.push_back(vertices[y]);
+        v_new.indices.push_back(buf.vertices[y]);
       }
     }
   }
-  if (v_new.vertices.size() == 0) {
-    prim.primitives.resize(prim.primitives.size() - 1);
+  if (v_new.indices.size() == 0) {
+    prims.resize(prims.size() - 1);
   }
 
   return stats.End();
 }
 
-Result<MeshOptimizerStats> StripifyTrianglesHaroohie(MatrixPrimitive& prim) {
-  MeshOptimizerStatsCollector stats(prim);
-  auto buf = TRY(IndexBuffer<u32>::create(prim));
-  std::vector<Vertex> vertices = std::move(buf.vertices);
+Result<MeshOptimizerStats> StripifyTrianglesHaroohie(const VertexArrays& verts,
+                                                     Prims& prims) {
+  MeshOptimizerStatsCollector stats(prims, verts.size());
+  auto buf = TRY(IndexBuffer<u32>::create(prims));
   std::vector<u32> index_data = std::move(buf.index_data);
   EXPECT(index_data.size() % 3 == 0);
 
-  PrimitiveRestartSplitter splitter(Topology::TriangleStrip, vertices, ~0u);
-  splitter.Reserve(buf.index_data.size());
+  PrimitiveRestartSplitter splitter(Topology::TriangleStrip, buf.vertices, ~0u);
+  splitter.Reserve(index_data.size());
 
   HaroohiePals::TriangleStripifier stripifier;
   auto ok = stripifier.GenerateTriangleStripsWithPrimitiveRestart(
       index_data, ~0u, splitter.OutputIterator());
   EXPECT(ok);
 
-  prim.primitives.clear();
-  for (Primitive& p : splitter.Primitives()) {
-    prim.primitives.push_back(std::move(p));
+  prims.clear();
+  for (IndexedPrimitive& p : splitter.Primitives()) {
+    prims.push_back(std::move(p));
   }
 
   return stats.End();
 }
 
-Result<MeshOptimizerStats> ToFanTriangles(MatrixPrimitive& prim, u32 min_len,
+Result<MeshOptimizerStats> ToFanTriangles(const VertexArrays& verts,
+                                          Prims& prims, u32 min_len,
                                           size_t max_runs) {
-  MeshOptimizerStatsCollector stats(prim);
-  auto buf = TRY(IndexBuffer<u32>::create(prim));
+  MeshOptimizerStatsCollector stats(prims, verts.size());
+  auto buf = TRY(IndexBuffer<u32>::create(prims));
 
   PrimitiveRestartSplitter splitter(Topology::TriangleFan, buf.vertices, ~0u);
   splitter.Reserve(buf.index_data.size());
@@ -570,25 +473,23 @@ Result<MeshOptimizerStats> ToFanTriangles(MatrixPrimitive& prim, u32 min_len,
       buf.index_data, ~0u, splitter.OutputIterator(), options);
   EXPECT(ok);
 
-  prim.primitives.clear();
-  for (Primitive& p : splitter.Primitives()) {
-    prim.primitives.push_back(std::move(p));
+  prims.clear();
+  for (IndexedPrimitive& p : splitter.Primitives()) {
+    prims.push_back(std::move(p));
   }
 #ifndef NDEBUG
   stats.Verify();
 #endif
   // PrimitiveRestartSplitter puts a batch of triangles at the very end if
   // there remain any.
-  if (prim.primitives.size() > 0) {
-    auto& triangles = prim.primitives[prim.primitives.size() - 1];
+  if (prims.size() > 0) {
+    auto& triangles = prims[prims.size() - 1];
     if (triangles.topology == Topology::Triangles) {
-      MatrixPrimitive tmp;
-      tmp.draw_matrices = prim.draw_matrices;
-      tmp.primitives.push_back(triangles);
-      auto algo = TRY(StripifyTriangles(tmp, Algo::RiiFans));
-      prim.primitives.resize(prim.primitives.size() - 1);
-      for (auto& x : tmp.primitives) {
-        prim.primitives.push_back(x);
+      Prims tmp{std::move(triangles)};
+      prims.resize(prims.size() - 1);
+      auto algo = TRY(StripifyTriangles(verts, tmp, Algo::RiiFans));
+      for (auto& x : tmp) {
+        prims.push_back(std::move(x));
       }
       stats.SetComment(std::format("min_len: {}, max_runs: {}, stripifier: {}",
                                    min_len, max_runs,
@@ -598,9 +499,10 @@ Result<MeshOptimizerStats> ToFanTriangles(MatrixPrimitive& prim, u32 min_len,
   return stats.End();
 }
 
-Result<MeshOptimizerStats> ToFanTriangles2(MatrixPrimitive& prim) {
-  MeshOptimizerStatsCollector stats(prim);
-  auto vc = VertexCount(prim);
+Result<MeshOptimizerStats> ToFanTriangles2(const VertexArrays& verts,
+                                           Prims& prims) {
+  MeshOptimizerStatsCollector stats(prims, verts.size());
+  auto vc = VertexCount(prims);
   if (vc >= 20'000) {
     // TODO: Workaround -- skips on sufficiently complex meshes, for now
     stats.SetComment("Skipping mesh to save time: too complex");
@@ -609,14 +511,14 @@ Result<MeshOptimizerStats> ToFanTriangles2(MatrixPrimitive& prim) {
 
   std::array<size_t, 6> depths = {vc, 5, 10, 20, 40, 80};
 
-  MeshOptimizerExperimentHolder<size_t> experiments(prim);
+  MeshOptimizerExperimentHolder<size_t> experiments(prims, verts.size());
   for (auto& d : depths) {
     auto& tmp = experiments.CreateExperiment(d);
-    auto stats = TRY(ToFanTriangles(tmp, 4, d));
+    auto stats = TRY(ToFanTriangles(verts, tmp, 4, d));
     experiments.SetStats(d, stats);
   }
   // TRY(experiments.ValidateAllWithBaseline());
-  prim = experiments.GetFirstWinner();
+  prims = experiments.GetFirstWinner();
   stats.SetComment(experiments.GetStats(experiments.GetFirstWinnerAlgo())
                        .value_or(MeshOptimizerStats{})
                        .comment);
@@ -630,13 +532,12 @@ struct DracoMesh {
   size_t vertex_count{};
 };
 
-Result<DracoMesh> ToDraco(const MatrixPrimitive& prim) {
-  auto buf = TRY(IndexBuffer<u32>::create(prim));
+Result<DracoMesh> ToDraco(const VertexArrays& verts, const Prims& prims) {
+  auto buf = TRY(IndexBuffer<u32>::create(prims));
   auto& index_data = buf.index_data;
-  auto& vertices = buf.vertices;
   assert(index_data.size() % 3 == 0);
   size_t index_count = index_data.size();
-  size_t vertex_count = vertices.size();
+  size_t vertex_count = buf.vertices.size();
 
   auto mesh = std::make_shared<draco::Mesh>();
   for (size_t i = 0; i < index_data.size(); i += 3) {
@@ -652,8 +553,13 @@ Result<DracoMesh> ToDraco(const MatrixPrimitive& prim) {
   auto other = std::make_unique<draco::PointAttribute>();
   other->Init(draco::GeometryAttribute::GENERIC, 1, draco::DT_UINT32, false,
               vertex_count);
-  for (size_t i = 0; i < vertices.size(); ++i) {
-    pos->SetAttributeValue(draco::AttributeValueIndex(i), &vertices[i]);
+  const auto positions = verts.positions();
+  for (size_t i = 0; i < vertex_count; ++i) {
+    glm::vec3 p{};
+    if (!positions.empty()) {
+      p = positions[buf.vertices[i]];
+    }
+    pos->SetAttributeValue(draco::AttributeValueIndex(i), &p);
     u32 tmp = i;
     other->SetAttributeValue(draco::AttributeValueIndex(i), &tmp);
   }
@@ -667,10 +573,10 @@ Result<DracoMesh> ToDraco(const MatrixPrimitive& prim) {
   };
 }
 
-Result<MeshOptimizerStats> StripifyTrianglesDraco(MatrixPrimitive& prim,
-                                                  bool degen) {
-  MeshOptimizerStatsCollector stats(prim);
-  auto draco_mesh = TRY(ToDraco(prim));
+Result<MeshOptimizerStats> StripifyTrianglesDraco(const VertexArrays& verts,
+                                                  Prims& prims, bool degen) {
+  MeshOptimizerStatsCollector stats(prims, verts.size());
+  auto draco_mesh = TRY(ToDraco(verts, prims));
   auto& [mesh, buf, index_count, vertex_count] = draco_mesh;
 
   PrimitiveRestartSplitter splitter(Topology::TriangleStrip, buf.vertices, ~0u);
@@ -685,41 +591,98 @@ Result<MeshOptimizerStats> StripifyTrianglesDraco(MatrixPrimitive& prim,
         *mesh, ~0u, splitter.OutputIterator());
   }
   EXPECT(ok);
-  prim.primitives.clear();
-  for (Primitive& p : splitter.Primitives()) {
-    prim.primitives.push_back(std::move(p));
+  prims.clear();
+  for (IndexedPrimitive& p : splitter.Primitives()) {
+    prims.push_back(std::move(p));
   }
   return stats.End();
 }
 
-Result<MeshOptimizerStats> StripifyTrianglesAlgo(MatrixPrimitive& prim,
-                                                 Algo algo) {
+// Runs |f| on the compact form of |prim|, which is only written back on
+// success.
+template <typename F>
+auto OnCompact(MatrixPrimitive& prim, F&& f) -> decltype(f(
+    std::declval<const VertexArrays&>(), std::declval<Prims&>())) {
+  auto compact = Compact(prim);
+  auto result = f(compact.vertices, compact.primitives);
+  if (result) {
+    prim = Expand(compact);
+  }
+  return result;
+}
+
+} // namespace
+
+Result<MeshOptimizerStats>
+StripifyTrianglesMeshOptimizer(MatrixPrimitive& prim) {
+  return OnCompact(prim, [](auto& verts, auto& prims) {
+    return StripifyTrianglesMeshOptimizer(verts, prims);
+  });
+}
+Result<MeshOptimizerStats> StripifyTrianglesTriStripper(MatrixPrimitive& prim) {
+  return OnCompact(prim, [](auto& verts, auto& prims) {
+    return StripifyTrianglesTriStripper(verts, prims);
+  });
+}
+Result<MeshOptimizerStats>
+StripifyTrianglesNvTriStripPort(MatrixPrimitive& prim) {
+  return OnCompact(prim, [](auto& verts, auto& prims) {
+    return StripifyTrianglesNvTriStripPort(verts, prims);
+  });
+}
+Result<MeshOptimizerStats> StripifyTrianglesHaroohie(MatrixPrimitive& prim) {
+  return OnCompact(prim, [](auto& verts, auto& prims) {
+    return StripifyTrianglesHaroohie(verts, prims);
+  });
+}
+Result<MeshOptimizerStats> StripifyTrianglesDraco(MatrixPrimitive& prim,
+                                                  bool degen) {
+  return OnCompact(prim, [degen](auto& verts, auto& prims) {
+    return StripifyTrianglesDraco(verts, prims, degen);
+  });
+}
+Result<MeshOptimizerStats> ToFanTriangles(MatrixPrimitive& prim, u32 min_len,
+                                          size_t max_runs) {
+  return OnCompact(prim, [=](auto& verts, auto& prims) {
+    return ToFanTriangles(verts, prims, min_len, max_runs);
+  });
+}
+
+Result<MeshOptimizerStats> StripifyTrianglesAlgo(const VertexArrays& verts,
+                                                 Prims& prims, Algo algo) {
   switch (algo) {
   case Algo::MeshOptmzr:
-    return StripifyTrianglesMeshOptimizer(prim);
+    return StripifyTrianglesMeshOptimizer(verts, prims);
   case Algo::TriStripper:
-    return StripifyTrianglesTriStripper(prim);
+    return StripifyTrianglesTriStripper(verts, prims);
   case Algo::NvTriStrip:
-    return StripifyTrianglesNvTriStripPort(prim);
+    return StripifyTrianglesNvTriStripPort(verts, prims);
   case Algo::Haroohie:
-    return StripifyTrianglesHaroohie(prim);
+    return StripifyTrianglesHaroohie(verts, prims);
   case Algo::Draco:
-    return StripifyTrianglesDraco(prim, false);
+    return StripifyTrianglesDraco(verts, prims, false);
   case Algo::DracoDegen:
-    return StripifyTrianglesDraco(prim, true);
+    return StripifyTrianglesDraco(verts, prims, true);
   case Algo::RiiFans:
     // This calls everything else on result.
-    return ToFanTriangles2(prim);
+    return ToFanTriangles2(verts, prims);
   }
   return std::unexpected("Invalid mesh algorithm");
 }
+Result<MeshOptimizerStats> StripifyTrianglesAlgo(MatrixPrimitive& prim,
+                                                 Algo algo) {
+  return OnCompact(prim, [algo](auto& verts, auto& prims) {
+    return StripifyTrianglesAlgo(verts, prims, algo);
+  });
+}
 
 // Brute-force every algorithm
-Result<Algo> StripifyTriangles(MatrixPrimitive& prim,
+Result<Algo> StripifyTriangles(const VertexArrays& verts, Prims& prims,
                                std::optional<Algo> except,
-                               std::string_view debug_name, bool verbose) {
-  MeshOptimizerExperimentHolder<Algo> experiments(prim);
-  u32 ms_on_validate = 0;
+                               std::string_view debug_name, bool verbose,
+                               rsl::ThreadPool* pool, u32 time_budget_ms) {
+  MeshOptimizerExperimentHolder<Algo> experiments(prims, verts.size());
+  std::vector<Algo> algos;
   for (auto e : magic_enum::enum_values<Algo>()) {
     if (except && *except == e) {
       // Disabled by user input
@@ -737,27 +700,74 @@ Result<Algo> StripifyTriangles(MatrixPrimitive& prim,
       // This almost *never* wins, and is quite slow at that, but is here so we
       // can never possibly lose to BrawlBox.
     }
-    auto& tmp = experiments.CreateExperiment(e);
-    auto results = StripifyTrianglesAlgo(tmp, e);
-    if (!results) {
+    algos.push_back(e);
+  }
+  // The first algorithm always runs, even over budget. MeshOptimizer is by far
+  // the fastest, so start with it.
+  std::ranges::stable_partition(algos,
+                                [](Algo e) { return e == Algo::MeshOptmzr; });
+
+  // The holder is not thread-safe: create every experiment up front and only
+  // touch the slots from the tasks.
+  std::vector<Prims*> slots;
+  for (Algo e : algos) {
+    slots.push_back(&experiments.CreateExperiment(e));
+  }
+  std::vector<std::optional<Result<MeshOptimizerStats>>> results(algos.size());
+  rsl::Timer budget;
+  const auto run = [&](size_t i) {
+    if (i != 0 && time_budget_ms != 0 && budget.elapsed() >= time_budget_ms) {
+      return;
+    }
+    results[i] = StripifyTrianglesAlgo(verts, *slots[i], algos[i]);
+  };
+  if (pool != nullptr) {
+    rsl::TaskGroup group(*pool);
+    for (size_t i = 1; i < algos.size(); ++i) {
+      group.run([&run, i] { run(i); });
+    }
+    if (!algos.empty()) {
+      run(0);
+    }
+    group.wait();
+  } else {
+    for (size_t i = 0; i < algos.size(); ++i) {
+      run(i);
+    }
+  }
+
+  for (size_t i = 0; i < algos.size(); ++i) {
+    const Algo e = algos[i];
+    const auto& result = results[i];
+    if (!result) {
+      experiments.SetStats(e, {.comment = "Skipped: over time budget"});
+    } else if (!*result) {
       experiments.CreateExperiment(e);
-      experiments.SetStats(e, {.comment = results.error()});
-      continue;
+      experiments.SetStats(e, {.comment = result->error()});
+    } else {
+      experiments.SetStats(e, **result);
+    }
+  }
+
+  // Only the output needs to be validated. Check the best experiment; if it is
+  // invalid, reset it and try the next best.
+  u32 ms_on_validate = 0;
+  std::set<Algo> rejected;
+  while (!algos.empty()) {
+    const Algo e = experiments.GetFirstWinnerAlgo();
+    if (rejected.contains(e)) {
+      // Every remaining candidate was reset to the baseline
+      break;
     }
-    // If invalid, reset and comment the error
     rsl::Timer timer;
     auto ok = experiments.ValidateExperimentWithBaseline(e);
     ms_on_validate += timer.elapsed();
-    if (!ok) {
-      experiments.CreateExperiment(e);
-      experiments.SetStats(e, {.comment = ok.error()});
-      continue;
+    if (ok) {
+      break;
     }
-    experiments.SetStats(e, *results);
-  }
-  std::vector<std::string_view> winners;
-  for (Algo e : experiments.CalcWinners()) {
-    winners.push_back(magic_enum::enum_name(e));
+    rejected.insert(e);
+    experiments.CreateExperiment(e);
+    experiments.SetStats(e, {.comment = ok.error()});
   }
   if (verbose && !except) {
     auto table = PrintScoresOfExperiment(experiments);
@@ -768,8 +778,24 @@ Result<Algo> StripifyTriangles(MatrixPrimitive& prim,
                "validation\n---\n",
                debug_name, thread_id.str(), table, ms_on_validate);
   }
-  prim = experiments.GetFirstWinner();
+  prims = experiments.GetFirstWinner();
   return experiments.GetFirstWinnerAlgo();
 }
+Result<Algo> StripifyTriangles(CompactMatrixPrimitive& prim,
+                               std::optional<Algo> except,
+                               std::string_view debug_name, bool verbose,
+                               rsl::ThreadPool* pool, u32 time_budget_ms) {
+  return StripifyTriangles(prim.vertices, prim.primitives, except, debug_name,
+                           verbose, pool, time_budget_ms);
+}
+Result<Algo> StripifyTriangles(MatrixPrimitive& prim,
+                               std::optional<Algo> except,
+                               std::string_view debug_name, bool verbose,
+                               rsl::ThreadPool* pool, u32 time_budget_ms) {
+  return OnCompact(prim, [&](auto& verts, auto& prims) {
+    return StripifyTriangles(verts, prims, except, debug_name, verbose, pool,
+                             time_budget_ms);
+  });
+}
 
 } // namespace librii::rhst
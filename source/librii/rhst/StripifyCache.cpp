@@ -0,0 +1,230 @@
+#include "StripifyCache.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <fstream>
+#include <oishii/reader/binary_reader.hxx>
+#include <oishii/writer/binary_writer.hxx>
+#include <random>
+#include <rsl/Log.hpp>
+#include <rsl/SafeReader.hpp>
+#include <rsl/StableHasher.hpp>
+
+namespace librii::rhst {
+
+// Bump when the tournament or the file layout changes
+static constexpr u32 CacheVersion = 2;
+// "RSTC" in the file, which is little endian
+static constexpr u32 CacheMagic = 'R' | 'S' << 8 | 'T' << 16 | 'C' << 24;
+static constexpr std::string_view CacheExtension = ".strip";
+
+namespace {
+
+using rsl::StableHasher;
+
+void HashFloats(StableHasher& h, std::span<const f32> floats) {
+  for (f32 f : floats) {
+    h.word(std::bit_cast<u32>(f));
+  }
+}
+template <typename T> std::span<const f32> AsFloats(std::span<const T> v) {
+  return {reinterpret_cast<const f32*>(v.data()),
+          v.size() * sizeof(T) / sizeof(f32)};
+}
+
+} // namespace
+
+std::filesystem::path StripifyCache::DefaultPath() {
+  std::error_code ec;
+  auto tmp = std::filesystem::temp_directory_path(ec);
+  return tmp / "RiiStudio" / "stripify";
+}
+
+StripifyCache::StripifyCache(std::filesystem::path dir, u64 max_bytes)
+    : mDir(std::move(dir)), mMaxBytes(max_bytes) {
+  std::error_code ec;
+  std::filesystem::create_directories(mDir, ec);
+}
+
+StripifyCache::~StripifyCache() { trim(); }
+
+std::string StripifyCache::Key(const CompactMatrixPrimitive& prim,
+                               std::optional<Algo> except) {
+  StableHasher h;
+  h.word(CacheVersion);
+  h.word(except ? static_cast<u32>(*except) : ~0u);
+  for (s32 d : prim.draw_matrices) {
+    h.word(static_cast<u32>(d));
+  }
+  const auto& v = prim.vertices;
+  h.word(v.vertexDescriptor());
+  h.word(static_cast<u32>(v.size()));
+  for (s8 m : v.matrixIndices()) {
+    h.word(static_cast<u32>(m));
+  }
+  HashFloats(h, AsFloats(v.positions()));
+  HashFloats(h, AsFloats(v.normals()));
+  for (u32 i = 0; i < 2; ++i) {
+    HashFloats(h, AsFloats(v.colors(i)));
+  }
+  for (u32 i = 0; i < 8; ++i) {
+    HashFloats(h, AsFloats(v.uvs(i)));
+  }
+  h.word(static_cast<u32>(prim.primitives.size()));
+  for (auto& p : prim.primitives) {
+    h.word(static_cast<u32>(p.topology));
+    h.word(static_cast<u32>(p.indices.size()));
+    for (u32 i : p.indices) {
+      h.word(i);
+    }
+  }
+  return h.hex();
+}
+
+std::optional<StripifyCache::Entry>
+StripifyCache::get(const std::string& key) {
+  const auto path = mDir / (key + std::string(CacheExtension));
+  auto entry = [&]() -> Result<Entry> {
+    auto reader = TRY(oishii::BinaryReader::FromFilePath(path.string(),
+                                                         std::endian::little));
+    EXPECT(TRY(reader.tryRead<u32>()) == CacheMagic);
+    EXPECT(TRY(reader.tryRead<u32>()) == CacheVersion);
+    Entry e;
+    e.algo = TRY(rsl::enum_cast<Algo>(TRY(reader.tryRead<u32>())));
+    e.stats.before_indices = TRY(reader.tryRead<u32>());
+    e.stats.after_indices = TRY(reader.tryRead<u32>());
+    e.stats.before_faces = TRY(reader.tryRead<u32>());
+    e.stats.after_faces = TRY(reader.tryRead<u32>());
+    e.stats.ms_elapsed = TRY(reader.tryRead<u32>());
+    const u32 num_prims = TRY(reader.tryRead<u32>());
+    for (u32 i = 0; i < num_prims; ++i) {
+      auto& p = e.primitives.emplace_back();
+      p.topology = TRY(rsl::enum_cast<Topology>(TRY(reader.tryRead<u32>())));
+      const u32 count = TRY(reader.tryRead<u32>());
+      p.indices = TRY(reader.tryReadBuffer<u32>(count));
+    }
+    return e;
+  }();
+  if (!entry) {
+    ++mMisses;
+    return std::nullopt;
+  }
+  // Mark as recently used for trim()
+  std::error_code ec;
+  std::filesystem::last_write_time(
+      path, std::filesystem::file_time_type::clock::now(), ec);
+  ++mHits;
+  return std::move(*entry);
+}
+
+void StripifyCache::put(const std::string& key, const Entry& entry) {
+  oishii::Writer writer(std::endian::little);
+  writer.write<u32>(CacheMagic);
+  writer.write<u32>(CacheVersion);
+  writer.write<u32>(static_cast<u32>(entry.algo));
+  writer.write<u32>(entry.stats.before_indices);
+  writer.write<u32>(entry.stats.after_indices);
+  writer.write<u32>(entry.stats.before_faces);
+  writer.write<u32>(entry.stats.after_faces);
+  writer.write<u32>(entry.stats.ms_elapsed);
+  writer.write<u32>(static_cast<u32>(entry.primitives.size()));
+  for (auto& p : entry.primitives) {
+    writer.write<u32>(static_cast<u32>(p.topology));
+    writer.write<u32>(static_cast<u32>(p.indices.size()));
+    writer.writeSpan<u32>(p.indices);
+  }
+
+  // Write to a unique name and rename, so concurrent readers and writers of
+  // the same key never see a partial file. Thread ids repeat across
+  // processes, so the name is random.
+  const auto path = mDir / (key + std::string(CacheExtension));
+  auto tmp = path;
+  std::random_device rd;
+  tmp += std::format(".{:08x}{:08x}.tmp", rd(), rd());
+  {
+    std::ofstream stream(tmp, std::ios::binary);
+    auto buf = writer.takeBuf();
+    stream.write(reinterpret_cast<const char*>(buf.data()), buf.size());
+    if (!stream) {
+      rsl::error("Failed to write stripify cache entry {}", tmp.string());
+      return;
+    }
+  }
+  std::error_code ec;
+  std::filesystem::rename(tmp, path, ec);
+  if (ec) {
+    std::filesystem::remove(tmp, ec);
+  }
+}
+
+void StripifyCache::trim() {
+  struct File {
+    std::filesystem::file_time_type time;
+    u64 size;
+    std::filesystem::path path;
+  };
+  std::vector<File> files;
+  u64 total = 0;
+  std::error_code ec;
+  for (auto& it : std::filesystem::directory_iterator(mDir, ec)) {
+    if (!it.is_regular_file(ec) || it.path().extension() != CacheExtension) {
+      continue;
+    }
+    File f{it.last_write_time(ec), it.file_size(ec), it.path()};
+    total += f.size;
+    files.push_back(std::move(f));
+  }
+  if (total <= mMaxBytes) {
+    return;
+  }
+  std::ranges::sort(files, {}, &File::time);
+  for (auto& f : files) {
+    if (total <= mMaxBytes) {
+      break;
+    }
+    if (std::filesystem::remove(f.path, ec)) {
+      total -= f.size;
+    }
+  }
+}
+
+Result<Algo> StripifyTrianglesCached(StripifyCache& cache,
+                                     CompactMatrixPrimitive& prim,
+                                     std::optional<Algo> except,
+                                     std::string_view debug_name, bool verbose,
+                                     rsl::ThreadPool* pool,
+                                     u32 time_budget_ms) {
+  const auto key = StripifyCache::Key(prim, except);
+  if (auto entry = cache.get(key);
+      entry && entry->stats.before_indices == VertexCount(prim.primitives)) {
+    const bool in_range = std::ranges::all_of(entry->primitives, [&](auto& p) {
+      return std::ranges::all_of(
+          p.indices, [&](u32 i) { return i < prim.vertices.size(); });
+    });
+    if (in_range) {
+      prim.primitives = std::move(entry->primitives);
+      return entry->algo;
+    }
+  }
+
+  StripifyCache::Entry entry;
+  entry.stats.before_indices = VertexCount(prim.primitives);
+  entry.stats.before_faces = FaceCount(prim.primitives);
+  rsl::Timer timer;
+  entry.algo = TRY(StripifyTriangles(prim, except, debug_name, verbose, pool,
+                                     time_budget_ms));
+  entry.stats.ms_elapsed = timer.elapsed();
+  // Algorithms are only skipped once the budget has run out. A run that
+  // finished within it tried them all, so its result is safe to reuse without
+  // a budget.
+  if (time_budget_ms != 0 && entry.stats.ms_elapsed >= time_budget_ms) {
+    return entry.algo;
+  }
+  entry.stats.after_indices = VertexCount(prim.primitives);
+  entry.stats.after_faces = FaceCount(prim.primitives);
+  entry.primitives = prim.primitives;
+  cache.put(key, entry);
+  return entry.algo;
+}
+
+} // namespace librii::rhst
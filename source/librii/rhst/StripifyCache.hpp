@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <core/common.h>
+#include <filesystem>
+#include <librii/rhst/CompactMesh.hpp>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace librii::rhst {
+
+//! Persistent cache of StripifyTriangles results.
+//!
+//! Entries are files named by a 128-bit hash of the input primitive (vertices,
+//! indices, draw matrices) and of the tournament settings, so re-importing an
+//! unchanged mesh skips the tournament entirely. Only the output indices are
+//! stored: stripifiers never change the vertex arrays. The directory is bounded by
+//! size: trim() evicts the least recently used entries, and runs on
+//! destruction. Safe to use from several threads at once.
+class StripifyCache {
+public:
+  struct Entry {
+    Algo algo{};
+    MeshOptimizerStats stats{};
+    std::vector<IndexedPrimitive> primitives;
+  };
+
+  //! e.g. $TMP/RiiStudio/stripify
+  static std::filesystem::path DefaultPath();
+
+  explicit StripifyCache(std::filesystem::path dir,
+                         u64 max_bytes = 512 * 1024 * 1024);
+  ~StripifyCache();
+  StripifyCache(const StripifyCache&) = delete;
+  StripifyCache& operator=(const StripifyCache&) = delete;
+
+  //! Stable across runs and platforms of the same endianness.
+  static std::string Key(const CompactMatrixPrimitive& prim,
+                         std::optional<Algo> except);
+
+  std::optional<Entry> get(const std::string& key);
+  void put(const std::string& key, const Entry& entry);
+  //! Delete the oldest entries until the directory fits in max_bytes.
+  void trim();
+
+  u32 hits() const { return mHits; }
+  u32 misses() const { return mMisses; }
+
+private:
+  std::filesystem::path mDir;
+  u64 mMaxBytes = 0;
+  std::atomic<u32> mHits = 0;
+  std::atomic<u32> mMisses = 0;
+};
+
+//! StripifyTriangles, reusing and recording results in |cache|. Results cut
+//! short by |time_budget_ms| are not recorded.
+Result<Algo> StripifyTrianglesCached(StripifyCache& cache,
+                                     CompactMatrixPrimitive& prim,
+                                     std::optional<Algo> except = std::nullopt,
+                                     std::string_view debug_name = "?",
+                                     bool verbose = true,
+                                     rsl::ThreadPool* pool = nullptr,
+                                     u32 time_budget_ms = 0);
+
+} // namespace librii::rhst
@@ -0,0 +1,197 @@
+#include "TriangleSet.hpp"
+
+#include "CompactMesh.hpp"
+#include "MeshUtils.hpp"
+#include <algorithm>
+#include <rsl/InternPool.hpp>
+
+namespace librii::rhst {
+
+std::size_t VertexHash::operator()(const Vertex& v) const {
+  std::size_t seed = 0;
+  const auto add = [&](f32 f) { rsl::HashCombine(seed, rsl::HashValue(f)); };
+  for (int i = 0; i < 3; ++i) {
+    add(v.position[i]);
+    add(v.normal[i]);
+  }
+  for (auto& uv : v.uvs) {
+    add(uv.x);
+    add(uv.y);
+  }
+  for (auto& c : v.colors) {
+    for (int i = 0; i < 4; ++i) {
+      add(c[i]);
+    }
+  }
+  rsl::HashCombine(seed, rsl::HashValue(v.matrix_index));
+  // HashCombine leaves the low bits poorly mixed; the table masks them
+  seed ^= seed >> 33;
+  seed *= 0xFF51AFD7ED558CCDull;
+  seed ^= seed >> 33;
+  return seed;
+}
+
+u32 VertexIds::id(const Vertex& v) {
+  if ((mVertices.size() + 1) * 2 > mSlots.size()) {
+    grow();
+  }
+  const std::size_t h = VertexHash{}(v);
+  const std::size_t mask = mSlots.size() - 1;
+  for (std::size_t i = h & mask;; i = (i + 1) & mask) {
+    const u32 slot = mSlots[i];
+    if (slot == Empty) {
+      mSlots[i] = static_cast<u32>(mVertices.size());
+      mVertices.push_back(v);
+      mHashes.push_back(h);
+      return mSlots[i];
+    }
+    if (mHashes[slot] == h && mVertices[slot] == v) {
+      return slot;
+    }
+  }
+}
+
+void VertexIds::grow() {
+  mSlots.assign(std::max<std::size_t>(mSlots.size() * 2, 1024), Empty);
+  const std::size_t mask = mSlots.size() - 1;
+  for (u32 id = 0; id < mVertices.size(); ++id) {
+    std::size_t i = mHashes[id] & mask;
+    while (mSlots[i] != Empty) {
+      i = (i + 1) & mask;
+    }
+    mSlots[i] = id;
+  }
+}
+
+// LSD radix sort over 16-bit digits, skipping digits that are the same for
+// every key.
+static void RadixSort(std::vector<u64>& keys) {
+  if (keys.size() < 1024) {
+    std::ranges::sort(keys);
+    return;
+  }
+  std::vector<u64> tmp(keys.size());
+  std::vector<u32> count(1 << 16);
+  for (int shift = 0; shift < 64; shift += 16) {
+    std::ranges::fill(count, 0);
+    for (u64 k : keys) {
+      ++count[(k >> shift) & 0xFFFF];
+    }
+    if (count[(keys[0] >> shift) & 0xFFFF] == keys.size()) {
+      continue;
+    }
+    u32 sum = 0;
+    for (auto& c : count) {
+      sum += std::exchange(c, sum);
+    }
+    for (u64 k : keys) {
+      tmp[count[(k >> shift) & 0xFFFF]++] = k;
+    }
+    keys.swap(tmp);
+  }
+}
+
+void TriangleSet::add(Tri tri) {
+  // Discard degenerate triangles
+  if (tri[0] == tri[1] || tri[1] == tri[2] || tri[0] == tri[2]) {
+    return;
+  }
+  // Rotate the smallest ID to the front, keeping the winding
+  std::ranges::rotate(tri, std::ranges::min_element(tri));
+  triangles_.push_back(tri);
+}
+
+void TriangleSet::sort(std::size_t num_ids) {
+  // 21 bits per ID packs a triangle into a single radix-sortable key
+  if (num_ids <= (1u << 21)) {
+    std::vector<u64> keys(triangles_.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+      auto& t = triangles_[i];
+      keys[i] = (u64(t[0]) << 42) | (u64(t[1]) << 21) | u64(t[2]);
+    }
+    RadixSort(keys);
+    for (size_t i = 0; i < keys.size(); ++i) {
+      const u64 k = keys[i];
+      triangles_[i] = {static_cast<u32>(k >> 42),
+                       static_cast<u32>((k >> 21) & 0x1FFFFF),
+                       static_cast<u32>(k & 0x1FFFFF)};
+    }
+  } else {
+    std::ranges::sort(triangles_);
+  }
+}
+
+Result<void> TriangleSet::SetFromMPrim(const MatrixPrimitive& prim,
+                                       VertexIds& ids) {
+  triangles_.clear();
+  std::vector<u32> local;
+  for (auto& p : prim.primitives) {
+    // Intern each vertex once; strips and fans reference them several times.
+    local.resize(p.vertices.size());
+    for (size_t i = 0; i < p.vertices.size(); ++i) {
+      local[i] = ids.id(p.vertices[i]);
+    }
+    Tri tri;
+    size_t n = 0;
+    for (auto idx : MeshUtils::AsTrianglesIdx(p)) {
+      tri[n++] = local[TRY(idx)];
+      if (n == 3) {
+        n = 0;
+        add(tri);
+      }
+    }
+  }
+  sort(ids.size());
+  return {};
+}
+
+Result<void> TriangleSet::SetFromIndexed(std::span<const IndexedPrimitive> prims,
+                                         std::size_t num_vertices) {
+  triangles_.clear();
+  for (auto& p : prims) {
+    Tri tri;
+    size_t n = 0;
+    for (auto idx : MeshUtils::AsTrianglesIdx(p.topology, p.indices.size())) {
+      tri[n++] = p.indices[TRY(idx)];
+      if (n == 3) {
+        n = 0;
+        add(tri);
+      }
+    }
+  }
+  sort(num_vertices);
+  return {};
+}
+
+Result<void> ValidateMeshesEqualImpl(const TriangleSet& ll,
+                                     const TriangleSet& rl) {
+  if (ll.triangles_.size() != rl.triangles_.size()) {
+    return std::unexpected(
+        std::format("Number of triangles does not match (l: {}, r: {})",
+                    ll.triangles_.size(), rl.triangles_.size()));
+  }
+  auto [l, r] = std::ranges::mismatch(ll.triangles_, rl.triangles_);
+  if (l != ll.triangles_.end()) {
+    return std::unexpected(
+        std::format("Mismatch at triangle {}/{}", l - ll.triangles_.begin(),
+                    ll.triangles_.size() - 1));
+  }
+  return {};
+}
+
+Result<void> ValidateMeshesEqual(const MatrixPrimitive& l,
+                                 const MatrixPrimitive& r) {
+  VertexIds ids;
+  TriangleSet ll, rl;
+  if (auto ok = ll.SetFromMPrim(l, ids); !ok) {
+    return std::unexpected("Failed to validate. Initial mprim is invalid: " +
+                           ok.error());
+  }
+  if (auto ok = rl.SetFromMPrim(r, ids); !ok) {
+    return std::unexpected("Failed to validate. New mprim is invalid: " +
+                           ok.error());
+  }
+  return ValidateMeshesEqualImpl(ll, rl);
+}
+
+} // namespace librii::rhst
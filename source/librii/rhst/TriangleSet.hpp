@@ -0,0 +1,66 @@
+#pragma once
+
+#include <array>
+#include <core/common.h>
+#include <librii/rhst/RHST.hpp>
+#include <span>
+#include <vector>
+
+namespace librii::rhst {
+
+struct IndexedPrimitive;
+
+struct VertexHash {
+  std::size_t operator()(const Vertex& v) const;
+};
+
+//! Maps vertices to dense integer IDs. Shared by every TriangleSet that is to
+//! be compared, so that equal vertices get equal IDs.
+//!
+//! An open-addressing table: unlike rsl::InternPool, interning a new vertex
+//! does not allocate a bucket, which dominates on meshes with millions of
+//! vertices.
+class VertexIds {
+public:
+  u32 id(const Vertex& v);
+  std::size_t size() const { return mVertices.size(); }
+
+private:
+  void grow();
+
+  static constexpr u32 Empty = ~0u;
+  std::vector<Vertex> mVertices;
+  std::vector<std::size_t> mHashes;
+  std::vector<u32> mSlots; // Power-of-two sized, at most half full
+};
+
+//! The triangles of a MatrixPrimitive as a sorted multiset of vertex ID
+//! triples, for checking that an optimization pass did not damage the model.
+//! - Duplicates are allowed
+//! - Degenerates are stripped
+//! - Winding is kept: triples are rotated so the smallest ID comes first
+class TriangleSet {
+public:
+  using Tri = std::array<u32, 3>;
+
+  Result<void> SetFromMPrim(const MatrixPrimitive& prim, VertexIds& ids);
+  //! Compact indices already identify vertices: equal vertices share an index.
+  Result<void> SetFromIndexed(std::span<const IndexedPrimitive> prims,
+                              std::size_t num_vertices);
+
+  bool operator==(const TriangleSet& rhs) const = default;
+
+  // Sorted, duplicates allowed
+  std::vector<Tri> triangles_;
+
+private:
+  void add(Tri tri);
+  void sort(std::size_t num_ids);
+};
+
+Result<void> ValidateMeshesEqualImpl(const TriangleSet& ll,
+                                     const TriangleSet& rl);
+Result<void> ValidateMeshesEqual(const MatrixPrimitive& l,
+                                 const MatrixPrimitive& r);
+
+} // namespace librii::rhst
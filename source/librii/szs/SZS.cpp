@@ -1,5 +1,7 @@
 #include "SZS.hpp"
+#include <cstring>
 #include <oishii/writer/binary_writer.hxx>
+#include <rsl/ParallelFor.hpp>
 
 namespace librii::szs {
 
@@ -11,76 +13,148 @@ Result<u32> getExpandedSize(std::span<const u8> src) {
   return (src[4] << 24) | (src[5] << 16) | (src[6] << 8) | src[7];
 }
 
+// Copy a backreference of |len| bytes starting |dist| bytes behind |out|.
+// Bounds must already have been checked. |slack| is the number of writable
+// bytes past |out|, which may exceed |len|.
+static inline void copyBackref(u8* out, u32 dist, u32 len, size_t slack) {
+  const u8* from = out - dist;
+  // Common case: short, non-overlapping match. One unaligned 16-byte copy;
+  // bytes past |len| are overwritten by whatever comes next.
+  if (dist >= 16 && len <= 16 && slack >= 16) {
+    std::memcpy(out, from, 16);
+    return;
+  }
+  if (dist >= len) {
+    std::memcpy(out, from, len);
+    return;
+  }
+  // Overlapping (RLE-like) match: the output is periodic in |dist|, so each
+  // copy may read everything written so far, doubling the chunk size.
+  u32 done = 0;
+  for (u32 period = dist; done < len; period *= 2) {
+    const u32 n = std::min(period, len - done);
+    std::memcpy(out + done, out + done - period, n);
+    done += n;
+  }
+}
+
 Result<void> decode(std::span<u8> dst, std::span<const u8> src) {
-  EXPECT(dst.size() >= TRY(getExpandedSize(src)));
+  const u32 expanded = TRY(getExpandedSize(src));
+  EXPECT(dst.size() >= expanded);
+  EXPECT(src.size() >= 16, "File too small to be a YAZ0 file");
+
+  const u8* in = src.data() + 16;
+  const u8* const in_end = src.data() + src.size();
+  u8* out = dst.data();
+  u8* const out_begin = dst.data();
+  u8* const out_end = dst.data() + expanded;
+
+  while (out < out_end) {
+    EXPECT(in < in_end, "Truncated YAZ0 stream");
+    u8 header = *in++;
+
+    // Eight raw bytes
+    if (header == 0xFF && in_end - in >= 8 && out_end - out >= 8) {
+      std::memcpy(out, in, 8);
+      in += 8;
+      out += 8;
+      continue;
+    }
 
-  int in_position = 0x10;
-  int out_position = 0;
+    for (int i = 0; i < 8 && out < out_end; ++i, header <<= 1) {
+      if (header & 0x80) {
+        EXPECT(in < in_end, "Truncated YAZ0 stream");
+        *out++ = *in++;
+        continue;
+      }
 
-  const auto take8 = [&]() {
-    const u8 result = src[in_position];
-    ++in_position;
-    return result;
-  };
-  const auto take16 = [&]() {
-    const u32 high = src[in_position];
-    ++in_position;
-    const u32 low = src[in_position];
-    ++in_position;
-    return (high << 8) | low;
-  };
-  const auto give8 = [&](u8 val) {
-    dst[out_position] = val;
-    ++out_position;
-  };
+      EXPECT(in_end - in >= 2, "Truncated YAZ0 stream");
+      const u32 group = (in[0] << 8) | in[1];
+      in += 2;
+      const u32 dist = (group & 0xfff) + 1;
+      u32 len = group >> 12;
+      if (len == 0) {
+        EXPECT(in < in_end, "Truncated YAZ0 stream");
+        len = *in++ + 18;
+      } else {
+        len += 2;
+      }
 
-  const auto read_group = [&](bool raw) {
-    if (raw) {
-      give8(take8());
-      return;
+      EXPECT(dist <= static_cast<size_t>(out - out_begin),
+             "Invalid YAZ0 backreference: points before start of file");
+      EXPECT(len <= static_cast<size_t>(out_end - out),
+             "Invalid YAZ0 backreference: overflows expanded size");
+      copyBackref(out, dist, len, out_end - out);
+      out += len;
     }
+  }
 
-    const u16 group = take16();
-    const int reverse = (group & 0xfff) + 1;
-    const int g_size = group >> 12;
-
-    int size = g_size ? g_size + 2 : take8() + 18;
+  return {};
+}
 
-    // Invalid data could buffer overflow
+Result<StreamDecoder> StreamDecoder::create(std::span<const u8> src) {
+  StreamDecoder dec;
+  dec.mExpandedSize = TRY(getExpandedSize(src));
+  EXPECT(src.size() >= 16, "File too small to be a YAZ0 file");
+  dec.mSrc = src;
+  dec.mInPos = 16;
+  return dec;
+}
 
-    for (int i = 0; i < size; ++i) {
-      give8(dst[out_position - reverse]);
-    }
+Result<u32> StreamDecoder::read(std::span<u8> out) {
+  u32 written = 0;
+  const auto put = [&](u8 c) {
+    mWindow[mOutPos % mWindow.size()] = c;
+    out[written++] = c;
+    ++mOutPos;
   };
 
-  const auto read_chunk = [&]() {
-    const u8 header = take8();
-
-    for (int i = 0; i < 8; ++i) {
-      if (in_position >= src.size() || out_position >= dst.size())
-        return;
-      read_group(header & (1 << (7 - i)));
+  while (written < out.size() && mOutPos < mExpandedSize) {
+    // Drain the backreference split across the previous call
+    if (mPendingLen) {
+      const u32 n = std::min<u32>(mPendingLen, out.size() - written);
+      for (u32 i = 0; i < n; ++i)
+        put(mWindow[(mOutPos - mPendingDist) % mWindow.size()]);
+      mPendingLen -= n;
+      continue;
     }
-  };
-
-  while (in_position < src.size() && out_position < dst.size())
-    read_chunk();
-
-  // if (out_position < dst.size())
-  //   return llvm::createStringError(
-  //       std::errc::executable_format_error,
-  //       "Truncated source file: the file could not be decompressed fully");
-
-  // if (in_position != src.size())
-  //   return llvm::createStringError(
-  //       std::errc::no_buffer_space,
-  //       "Invalid YAZ0 header: file is larger than reported");
+    if (mHeaderBits == 0) {
+      EXPECT(mInPos < mSrc.size(), "Truncated YAZ0 stream");
+      mHeader = mSrc[mInPos++];
+      mHeaderBits = 8;
+    }
+    const bool raw = mHeader & 0x80;
+    mHeader <<= 1;
+    --mHeaderBits;
+    if (raw) {
+      EXPECT(mInPos < mSrc.size(), "Truncated YAZ0 stream");
+      put(mSrc[mInPos++]);
+      continue;
+    }
+    EXPECT(mSrc.size() - mInPos >= 2, "Truncated YAZ0 stream");
+    const u32 group = (mSrc[mInPos] << 8) | mSrc[mInPos + 1];
+    mInPos += 2;
+    u32 len = group >> 12;
+    if (len == 0) {
+      EXPECT(mInPos < mSrc.size(), "Truncated YAZ0 stream");
+      len = mSrc[mInPos++] + 18;
+    } else {
+      len += 2;
+    }
+    mPendingDist = (group & 0xfff) + 1;
+    mPendingLen = len;
+    EXPECT(mPendingDist <= mOutPos,
+           "Invalid YAZ0 backreference: points before start of file");
+    EXPECT(mPendingLen <= mExpandedSize - mOutPos,
+           "Invalid YAZ0 backreference: overflows expanded size");
+  }
 
-  return {};
+  return written;
 }
 
 u32 getWorstEncodingSize(std::span<const u8> src) {
-  return 16 + roundUp(src.size(), 8) / 8 * 9 - 1;
+  // Header + one group header per 8 raw bytes
+  return 16 + roundUp(src.size(), 8) / 8 * 9;
 }
 std::vector<u8> encodeFast(std::span<const u8> src) {
   std::vector<u8> result(getWorstEncodingSize(src));
@@ -113,19 +187,25 @@ std::vector<u8> encodeFast(std::span<const u8> src) {
   return result;
 }
 
-static u16 sSkipTable[256];
+// Per-encoder scratch state, so that multiple files (or blocks of a file) may
+// be compressed concurrently.
+struct SkipTable {
+  u16 data[256];
+};
 
 static void findMatch(const u8* src, int srcPos, int maxSize, int* matchOffset,
-                      int* matchSize);
+                      int* matchSize, SkipTable& skip);
 static int searchWindow(const u8* needle, int needleSize, const u8* haystack,
-                        int haystackSize);
-static void computeSkipTable(const u8* needle, int needleSize);
+                        int haystackSize, SkipTable& skip);
+static void computeSkipTable(const u8* needle, int needleSize,
+                             SkipTable& skip);
 
 int encodeBoyerMooreHorspool(const u8* src, u8* dst, int srcSize) {
   int srcPos;
   int groupHeaderPos;
   int dstPos;
   u8 groupHeaderBitRaw;
+  SkipTable skip;
 
   dst[0] = 'Y';
   dst[1] = 'a';
@@ -144,11 +224,12 @@ int encodeBoyerMooreHorspool(const u8* src, u8* dst, int srcSize) {
   while (srcPos < srcSize) {
     int matchOffset;
     int firstMatchLen;
-    findMatch(src, srcPos, srcSize, &matchOffset, &firstMatchLen);
+    findMatch(src, srcPos, srcSize, &matchOffset, &firstMatchLen, skip);
     if (firstMatchLen > 2) {
       int secondMatchOffset;
       int secondMatchLen;
-      findMatch(src, srcPos + 1, srcSize, &secondMatchOffset, &secondMatchLen);
+      findMatch(src, srcPos + 1, srcSize, &secondMatchOffset, &secondMatchLen,
+                skip);
       if (firstMatchLen + 1 < secondMatchLen) {
         // Put a single byte
         dst[groupHeaderPos] |= groupHeaderBitRaw;
@@ -195,7 +276,7 @@ int encodeBoyerMooreHorspool(const u8* src, u8* dst, int srcSize) {
 }
 
 void findMatch(const u8* src, int srcPos, int maxSize, int* matchOffset,
-               int* matchSize) {
+               int* matchSize, SkipTable& skip) {
   // SZS backreference types:
   // (2 bytes) N >= 2:  NR RR    -> maxMatchSize=16+2,    windowOffset=4096+1
   // (3 bytes) N >= 18: 0R RR NN -> maxMatchSize=0xFF+18, windowOffset=4096+1
@@ -209,10 +290,10 @@ void findMatch(const u8* src, int srcPos, int maxSize, int* matchOffset,
   }
 
   int windowOffset;
-  int foundMatchOffset;
+  int foundMatchOffset = 0;
   while (window < srcPos &&
          (windowOffset = searchWindow(&src[srcPos], windowSize, &src[window],
-                                      srcPos + windowSize - window)) <
+                                      srcPos + windowSize - window, skip)) <
              srcPos - window) {
     for (; windowSize < maxMatchSize; ++windowSize) {
       if (src[window + windowOffset + windowSize] != src[srcPos + windowSize])
@@ -232,30 +313,30 @@ void findMatch(const u8* src, int srcPos, int maxSize, int* matchOffset,
 }
 
 static int searchWindow(const u8* needle, int needleSize, const u8* haystack,
-                        int haystackSize) {
+                        int haystackSize, SkipTable& skip) {
   int itHaystack; // r8
   int itNeedle;   // r9
 
   if (needleSize > haystackSize)
     return haystackSize;
-  computeSkipTable(needle, needleSize);
+  computeSkipTable(needle, needleSize, skip);
 
   // Scan forwards for the last character in the needle
   for (itHaystack = needleSize - 1;;) {
     while (1) {
       if (needle[needleSize - 1] == haystack[itHaystack])
         break;
-      itHaystack += sSkipTable[haystack[itHaystack]];
+      itHaystack += skip.data[haystack[itHaystack]];
     }
     --itHaystack;
     itNeedle = needleSize - 2;
     break;
   Difference:
     // The entire needle was not found, continue search
-    int skip = sSkipTable[haystack[itHaystack]];
-    if (needleSize - itNeedle > skip)
-      skip = needleSize - itNeedle;
-    itHaystack += skip;
+    int shift = skip.data[haystack[itHaystack]];
+    if (needleSize - itNeedle > shift)
+      shift = needleSize - itNeedle;
+    itHaystack += shift;
   }
 
   // Scan backwards for the first difference
@@ -270,13 +351,319 @@ static int searchWindow(const u8* needle, int needleSize, const u8* haystack,
   return itHaystack + 1;
 }
 
-static void computeSkipTable(const u8* needle, int needleSize) {
+static void computeSkipTable(const u8* needle, int needleSize,
+                             SkipTable& skip) {
   for (int i = 0; i < 256; ++i) {
-    sSkipTable[i] = needleSize;
+    skip.data[i] = needleSize;
   }
   for (int i = 0; i < needleSize; ++i) {
-    sSkipTable[needle[i]] = needleSize - i - 1;
+    skip.data[needle[i]] = needleSize - i - 1;
+  }
+}
+
+// Block-parallel encoder
+//
+// Each block produces a stream of tokens (without group headers) which are
+// then stitched together in order. Backreferences may reach up to 4KiB before
+// the start of their block, but never extend past its end.
+
+namespace {
+
+constexpr u32 MaxDistance = 0x1000;
+constexpr u32 MinMatch = 3;
+constexpr u32 MaxMatch = 0xFF + 18;
+constexpr u32 BlockSize = 256 * 1024;
+
+struct TokenStream {
+  std::vector<u8> payload;
+  std::vector<bool> is_raw;
+
+  void literal(u8 c) {
+    payload.push_back(c);
+    is_raw.push_back(true);
+  }
+  void backref(u32 dist, u32 len) {
+    assert(dist >= 1 && dist <= MaxDistance);
+    assert(len >= MinMatch && len <= MaxMatch);
+    const u32 rev = dist - 1;
+    if (len < 18) {
+      payload.push_back(((len - 2) << 4) | (rev >> 8));
+      payload.push_back(rev & 0xff);
+    } else {
+      payload.push_back(rev >> 8);
+      payload.push_back(rev & 0xff);
+      payload.push_back(len - 18);
+    }
+    is_raw.push_back(false);
+  }
+};
+
+struct Match {
+  u32 dist = 0;
+  u32 len = 0;
+};
+
+class HashChainMatcher {
+public:
+  HashChainMatcher(std::span<const u8> src, u32 max_chain)
+      : mSrc(src), mMaxChain(max_chain), mHead(HashSize, -1) {}
+
+  void insert(u32 pos) {
+    if (pos + MinMatch > mSrc.size())
+      return;
+    const u32 h = hash(pos);
+    mPrev[pos % MaxDistance] = mHead[h];
+    mHead[h] = static_cast<s32>(pos);
+  }
+
+  // All positions before |pos| (and none after) must have been inserted.
+  Match find(u32 pos, u32 end) const {
+    const u32 max_len = std::min(end - pos, MaxMatch);
+    if (max_len < MinMatch)
+      return {};
+    Match best;
+    s32 cand = mHead[hash(pos)];
+    for (u32 chain = mMaxChain; chain && cand >= 0; --chain) {
+      const u32 dist = pos - static_cast<u32>(cand);
+      if (dist > MaxDistance)
+        break;
+      const u8* a = mSrc.data() + cand;
+      const u8* b = mSrc.data() + pos;
+      // Cheap rejection: a longer match must agree at index best.len
+      if (a[best.len] == b[best.len]) {
+        u32 len = 0;
+        while (len < max_len && a[len] == b[len])
+          ++len;
+        if (len > best.len) {
+          best = {.dist = dist, .len = len};
+          if (len == max_len)
+            break;
+        }
+      }
+      cand = mPrev[static_cast<u32>(cand) % MaxDistance];
+    }
+    if (best.len < MinMatch)
+      return {};
+    return best;
   }
+
+private:
+  static constexpr u32 HashBits = 15;
+  static constexpr u32 HashSize = 1 << HashBits;
+
+  u32 hash(u32 pos) const {
+    const u8* p = mSrc.data() + pos;
+    const u32 v = (p[0] << 16) | (p[1] << 8) | p[2];
+    return (v * 2654435761u) >> (32 - HashBits);
+  }
+
+  std::span<const u8> mSrc;
+  u32 mMaxChain;
+  std::vector<s32> mHead;
+  std::array<s32, MaxDistance> mPrev{};
+};
+
+TokenStream encodeBlockHashChain(std::span<const u8> src, u32 begin, u32 end,
+                                 u32 max_chain, bool lazy) {
+  TokenStream out;
+  HashChainMatcher matcher(src, max_chain);
+  // Positions before |inserted| are in the hash chains
+  u32 inserted = begin > MaxDistance ? begin - MaxDistance : 0;
+  const auto insertUpTo = [&](u32 pos) {
+    for (; inserted < pos; ++inserted)
+      matcher.insert(inserted);
+  };
+
+  u32 pos = begin;
+  while (pos < end) {
+    insertUpTo(pos);
+    Match m = matcher.find(pos, end);
+    if (lazy && m.len && m.len < MaxMatch && pos + 1 < end) {
+      insertUpTo(pos + 1);
+      const Match next = matcher.find(pos + 1, end);
+      if (next.len > m.len + 1) {
+        out.literal(src[pos++]);
+        m = next;
+      }
+    }
+    if (m.len) {
+      out.backref(m.dist, m.len);
+      pos += m.len;
+    } else {
+      out.literal(src[pos++]);
+    }
+  }
+  return out;
+}
+
+TokenStream encodeBlockBoyerMooreHorspool(std::span<const u8> src, u32 begin,
+                                          u32 end) {
+  TokenStream out;
+  SkipTable skip;
+  const int maxSize = static_cast<int>(end);
+  int srcPos = static_cast<int>(begin);
+  while (srcPos < maxSize) {
+    int matchOffset;
+    int matchLen;
+    findMatch(src.data(), srcPos, maxSize, &matchOffset, &matchLen, skip);
+    if (matchLen <= 2) {
+      out.literal(src[srcPos++]);
+      continue;
+    }
+    int secondMatchOffset;
+    int secondMatchLen;
+    findMatch(src.data(), srcPos + 1, maxSize, &secondMatchOffset,
+              &secondMatchLen, skip);
+    if (matchLen + 1 < secondMatchLen) {
+      out.literal(src[srcPos++]);
+      matchLen = secondMatchLen;
+      matchOffset = secondMatchOffset;
+    }
+    out.backref(srcPos - matchOffset, matchLen);
+    srcPos += matchLen;
+  }
+  return out;
+}
+
+// Bit cost of each token: one group header bit plus its payload.
+constexpr u32 LiteralCost = 1 + 8;
+constexpr u32 ShortMatchCost = 1 + 16; // N R R
+constexpr u32 LongMatchCost = 1 + 24;  // 0 R R N
+
+TokenStream encodeBlockUltra(std::span<const u8> src, u32 begin, u32 end) {
+  const u32 n = end - begin;
+
+  // Token costs do not depend on distance, and any prefix of a match is also
+  // a match. The longest match at each position is therefore all we need.
+  std::vector<Match> longest(n);
+  {
+    HashChainMatcher matcher(src, MaxDistance);
+    for (u32 i = begin > MaxDistance ? begin - MaxDistance : 0; i < begin; ++i)
+      matcher.insert(i);
+    for (u32 i = 0; i < n; ++i) {
+      longest[i] = matcher.find(begin + i, end);
+      matcher.insert(begin + i);
+    }
+  }
+
+  // cost[i]: Minimum bits to encode [begin + i, end)
+  // step[i]: Length of the first token of that encoding (1 = literal)
+  std::vector<u32> cost(n + 1);
+  std::vector<u16> step(n);
+  cost[n] = 0;
+  for (u32 i = n; i-- > 0;) {
+    cost[i] = cost[i + 1] + LiteralCost;
+    step[i] = 1;
+    for (u32 len = MinMatch; len <= longest[i].len; ++len) {
+      const u32 c = cost[i + len] + (len < 18 ? ShortMatchCost : LongMatchCost);
+      if (c < cost[i]) {
+        cost[i] = c;
+        step[i] = len;
+      }
+    }
+  }
+
+  TokenStream out;
+  for (u32 i = 0; i < n; i += step[i]) {
+    if (step[i] == 1) {
+      out.literal(src[begin + i]);
+    } else {
+      out.backref(longest[i].dist, step[i]);
+    }
+  }
+  return out;
+}
+
+TokenStream encodeBlock(std::span<const u8> src, u32 begin, u32 end,
+                        Algo algo) {
+  switch (algo) {
+  case Algo::Store: {
+    TokenStream out;
+    for (u32 i = begin; i < end; ++i)
+      out.literal(src[i]);
+    return out;
+  }
+  case Algo::Fast:
+    return encodeBlockHashChain(src, begin, end, 16, false);
+  case Algo::BoyerMooreHorspool:
+    return encodeBlockBoyerMooreHorspool(src, begin, end);
+  case Algo::Lazy:
+    return encodeBlockHashChain(src, begin, end, MaxDistance, true);
+  case Algo::Ultra:
+    return encodeBlockUltra(src, begin, end);
+  }
+  return {};
+}
+
+void writeHeader(u8* dst, u32 expanded_size) {
+  dst[0] = 'Y';
+  dst[1] = 'a';
+  dst[2] = 'z';
+  dst[3] = '0';
+  dst[4] = (expanded_size >> 24) & 0xff;
+  dst[5] = (expanded_size >> 16) & 0xff;
+  dst[6] = (expanded_size >> 8) & 0xff;
+  dst[7] = (expanded_size >> 0) & 0xff;
+  std::fill(dst + 8, dst + 16, 0);
+}
+
+// Interleave group headers back into the token streams.
+std::vector<u8> stitch(std::span<const u8> src,
+                       std::span<const TokenStream> blocks) {
+  std::vector<u8> result(getWorstEncodingSize(src));
+  writeHeader(result.data(), src.size());
+  u8* dst = result.data() + 16;
+  u8* group = nullptr;
+  u8 bit = 0;
+  for (auto& block : blocks) {
+    const u8* payload = block.payload.data();
+    for (bool raw : block.is_raw) {
+      if (!bit) {
+        group = dst++;
+        *group = 0;
+        bit = 0x80;
+      }
+      if (raw) {
+        *group |= bit;
+        *dst++ = *payload++;
+      } else {
+        // Three-byte form when the length nibble is zero
+        const int n = (*payload >> 4) ? 2 : 3;
+        std::memcpy(dst, payload, n);
+        dst += n;
+        payload += n;
+      }
+      bit >>= 1;
+    }
+  }
+  assert(dst <= result.data() + result.size());
+  result.resize(dst - result.data());
+  return result;
+}
+
+} // namespace
+
+Result<std::vector<u8>> encodeAlgo(std::span<const u8> src, Algo algo,
+                                   u32 num_threads) {
+  EXPECT(src.size() <= 0xFFFF'FFFF, "File too large to be a YAZ0 file");
+  const u32 num_blocks = (src.size() + BlockSize - 1) / BlockSize;
+  std::vector<TokenStream> blocks(num_blocks);
+  rsl::ParallelFor(num_blocks, num_threads, [&](size_t i) {
+    const u32 begin = i * BlockSize;
+    const u32 end = std::min<u32>(begin + BlockSize, src.size());
+    blocks[i] = encodeBlock(src, begin, end, algo);
+  });
+
+  auto result = stitch(src, blocks);
+
+  if (algo == Algo::Ultra) {
+    // Ultra is only used for release builds: verify the round trip
+    std::vector<u8> check(src.size());
+    TRY(decode(check, result));
+    EXPECT(std::ranges::equal(check, src), "YAZ0 round trip failed");
+  }
+
+  return result;
 }
 
 } // namespace librii::szs
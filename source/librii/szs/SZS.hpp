@@ -7,11 +7,65 @@
 namespace librii::szs {
 
 Result<u32> getExpandedSize(std::span<const u8> src);
+//! Expand |src| into |dst|, which must hold at least getExpandedSize(src)
+//! bytes. Malformed streams are rejected rather than read/written out of
+//! bounds.
 Result<void> decode(std::span<u8> dst, std::span<const u8> src);
 
+//! Incremental decoder for inspecting large files without allocating the
+//! full expanded size. Only the last 4KiB of output is retained.
+class StreamDecoder {
+public:
+  //! |src| must outlive the decoder.
+  static Result<StreamDecoder> create(std::span<const u8> src);
+
+  //! Decode the next (up to) |out.size()| bytes. Returns the number of bytes
+  //! written, which is only less than |out.size()| at the end of the stream.
+  Result<u32> read(std::span<u8> out);
+
+  u32 expandedSize() const { return mExpandedSize; }
+  u32 position() const { return mOutPos; }
+  bool done() const { return mOutPos >= mExpandedSize; }
+
+private:
+  std::span<const u8> mSrc;
+  u32 mExpandedSize = 0;
+  size_t mInPos = 0;
+  u32 mOutPos = 0;
+  u8 mHeader = 0;
+  u32 mHeaderBits = 0;
+  // Backreference not yet fully written out
+  u32 mPendingDist = 0;
+  u32 mPendingLen = 0;
+  std::array<u8, 0x1000> mWindow{};
+};
+
 u32 getWorstEncodingSize(std::span<const u8> src);
 std::vector<u8> encodeFast(std::span<const u8> src);
 
 int encodeBoyerMooreHorspool(const u8* src, u8* dst, int srcSize);
 
+enum class Algo {
+  //! No compression: every byte is stored raw.
+  Store,
+  //! Greedy hash-chain matcher with a short chain limit.
+  Fast,
+  //! Boyer-Moore-Horspool matcher with one byte of lookahead (Nintendo-like).
+  BoyerMooreHorspool,
+  //! Greedy parse over an exhaustive hash-chain search, deferring each match
+  //! by one byte when the next position matches longer (lazy matching).
+  Lazy,
+  //! Optimal parse: dynamic programming over the bit cost of each token.
+  //! Produces the smallest stream possible, at a significant time cost.
+  Ultra,
+};
+
+//! Compress |src| as a YAZ0 stream.
+//!
+//! The input is split into fixed-size blocks whose matches are found in
+//! parallel, each block seeing the preceding 4KiB of history. The output is
+//! independent of |num_threads| (0 = one per hardware thread).
+Result<std::vector<u8>> encodeAlgo(std::span<const u8> src, Algo algo,
+                                   u32 num_threads = 0);
+
 } // namespace librii::szs
@@ -3,6 +3,10 @@
 #include <core/util/oishii.hpp>
 #include <core/util/timestamp.hpp>
 #include <fstream>
+#include <future>
+#include <librii/szs/SZS.hpp>
+#include <rsl/MappedFile.hpp>
+#include <rsl/ParallelFor.hpp>
 #include <rsl/SimpleReader.hpp>
 
 IMPORT_STD;
@@ -314,104 +318,149 @@ s32 PathToEntrynum(const U8Archive& arc, const char* path, u32 currentPath) {
   }
 }
 
-Result<void> Extract(const U8Archive& arc, std::filesystem::path out) {
-  auto tmp = out;
-  std::vector<u32> stack;
-  u32 i = 0;
-  for (auto& node : arc.nodes) {
-    if (!stack.empty() && stack.back() == i) {
-      stack.resize(stack.size() - 1);
-      tmp = tmp.parent_path();
+// Shared by U8Archive and ArchiveView.
+//
+// Folders are created serially up front; file writes are then spread over
+// |num_threads| threads.
+template <typename NodeT, typename GetData>
+static Result<void> ExtractImpl(std::span<const NodeT> nodes,
+                                GetData&& get_data,
+                                const std::filesystem::path& out,
+                                u32 num_threads) {
+  struct Folder {
+    u32 sibling_next;
+    std::filesystem::path path;
+  };
+  struct Job {
+    std::filesystem::path path;
+    std::span<const u8> data;
+  };
+  std::vector<Folder> stack;
+  std::vector<Job> jobs;
+  auto dir = out;
+  for (u32 i = 0; i < nodes.size(); ++i) {
+    while (!stack.empty() && stack.back().sibling_next <= i) {
+      dir = std::move(stack.back().path);
+      stack.pop_back();
     }
-    ++i;
+    auto& node = nodes[i];
+    // Never write outside of |out|
+    EXPECT(node.name != ".." &&
+               std::string_view(node.name).find_first_of("/\\") ==
+                   std::string_view::npos,
+           std::format("Invalid file name {}", node.name));
     if (node.is_folder) {
-      stack.push_back(node.folder.sibling_next);
-      tmp /= node.name;
-      std::filesystem::create_directory(tmp);
+      stack.push_back({node.folder.sibling_next, dir});
+      dir /= node.name;
+      std::error_code ec;
+      std::filesystem::create_directories(dir, ec);
+      EXPECT(!ec, std::format("Failed to create folder {}", dir.string()));
     } else {
-      auto fpath = (tmp / node.name).string();
-      std::ofstream out(fpath);
-      auto data = std::span(arc.file_data.begin(), arc.file_data.end())
-                      .subspan(node.file.offset, node.file.size);
-      EXPECT(data.size() == node.file.size);
-      out.write(reinterpret_cast<const char*>(data.data()), data.size());
+      jobs.push_back({dir / node.name, TRY(get_data(node))});
     }
   }
+
+  std::vector<Result<void>> results(jobs.size());
+  rsl::ParallelFor(jobs.size(), num_threads, [&](size_t i) {
+    results[i] = [&](const Job& job) -> Result<void> {
+      std::ofstream stream(job.path, std::ios::binary);
+      stream.write(reinterpret_cast<const char*>(job.data.data()),
+                   job.data.size());
+      EXPECT(stream.good(),
+             std::format("Failed to write file {}", job.path.string()));
+      return {};
+    }(jobs[i]);
+  });
+  for (auto& r : results) {
+    TRY(r);
+  }
   return {};
 }
 
-// Insertion into a sorted list would be O(n^2) on a vector structure; a heap or
-// tree structure is probably not meritful. Instead, simply use std::sort
-// (O(nlgn)) to get files in the proper order and then iterate through them.
-Result<U8Archive> Create(std::filesystem::path root) {
-  struct Entry {
-    std::string str;
-    bool is_folder = false;
-
-    std::vector<u8> data;
-    std::string name;
+Result<void> Extract(const U8Archive& arc, std::filesystem::path out,
+                     u32 num_threads) {
+  const auto get_data =
+      [&](const U8Archive::Node& node) -> Result<std::span<const u8>> {
+    EXPECT(static_cast<u64>(node.file.offset) + node.file.size <=
+           arc.file_data.size());
+    return std::span(arc.file_data).subspan(node.file.offset, node.file.size);
+  };
+  return ExtractImpl(std::span(arc.nodes), get_data, out, num_threads);
+}
 
-    int depth = -1;
-    int parent = 0; // Default files put parent as 0 for root
-    int nextAtGreaterDepth = -1;
+Result<void> Extract(const ArchiveView& arc, std::filesystem::path out,
+                     u32 num_threads) {
+  TRY(arc.wait());
+  const auto get_data =
+      [&](const ArchiveView::Node& node) -> Result<std::span<const u8>> {
+    return arc.fileData(node);
+  };
+  return ExtractImpl(arc.nodes(), get_data, out, num_threads);
+}
 
-    bool operator<(const Entry& rhs) const {
-      return str < rhs.str && (is_folder ? 1 : 0) < (rhs.is_folder ? 1 : 0);
-    }
+Result<U8Archive> Create(std::filesystem::path root, u32 num_threads) {
+  struct Entry {
+    std::filesystem::path path;
+    std::string name;
+    bool is_folder = false;
+    u32 parent = 0;       // Folders only
+    u32 sibling_next = 0; // Folders only
+    u32 offset = 0;       // Files only
+    u32 size = 0;         // Files only
   };
-  std::vector<Entry> paths{{
-      .str = ".",
+
+  // Sizing pass: walk the tree depth-first, in sorted order, without reading
+  // any file contents
+  std::vector<Entry> entries{{
+      .path = root,
+      .name = ".",
       .is_folder = true,
   }};
-  for (auto&& it : std::filesystem::recursive_directory_iterator{root}) {
-    auto path = it.path();
-    bool folder = std::filesystem::is_directory(path);
-    if (path.filename() == ".DS_Store") {
-      continue;
+  u64 total_size = 0;
+  const auto visit = [&](auto& self, const std::filesystem::path& dir,
+                         u32 folder) -> Result<void> {
+    std::error_code ec;
+    std::vector<std::filesystem::directory_entry> children;
+    for (auto it = std::filesystem::directory_iterator(dir, ec);
+         !ec && it != std::filesystem::directory_iterator(); it.increment(ec)) {
+      children.push_back(*it);
     }
-    std::vector<u8> data;
-    if (!folder) {
-      auto f = ReadFile(path.string());
-      if (!f) {
-        return std::unexpected(
-            std::format("Failed to read file {}", path.string()));
-      }
-      data = *f;
-    }
-    path = std::filesystem::path(".") / std::filesystem::relative(path, root);
-
-    paths.push_back(Entry{
-        .str = path.string(),
-        .is_folder = folder,
-        .data = data,
-        .name = path.filename().string(),
-    });
-  }
-  // They are almost certainly already in sorted order
-  std::sort(paths.begin(), paths.end());
-  for (auto& p : paths) {
-    for (auto c : p.str) {
-      // relative paths are weakly_canonical
-      if (c == '/') {
-        ++p.depth;
+    EXPECT(!ec, std::format("Failed to read folder {}", dir.string()));
+    std::ranges::sort(children, {}, [](auto& x) { return x.path(); });
+
+    for (auto& child : children) {
+      auto name = child.path().filename().string();
+      if (name == ".DS_Store") {
+        continue;
       }
-    }
-  }
-  for (size_t i = 0; i < paths.size(); ++i) {
-    auto& p = paths[i];
-    if (p.is_folder) {
-      for (int j = i; i < paths.size(); ++j) {
-        if (paths[j].depth <= p.depth) {
-          p.nextAtGreaterDepth = j;
-          break;
-        }
-        paths[j].parent = i;
+      if (child.is_directory(ec)) {
+        const u32 index = entries.size();
+        entries.push_back({
+            .path = child.path(),
+            .name = name,
+            .is_folder = true,
+            .parent = folder,
+        });
+        TRY(self(self, child.path(), index));
+        entries[index].sibling_next = entries.size();
+        continue;
       }
+      const u64 size = child.file_size(ec);
+      EXPECT(!ec, std::format("Failed to read file {}", child.path().string()));
+      entries.push_back({
+          .path = child.path(),
+          .name = name,
+          .offset = static_cast<u32>(total_size),
+          .size = static_cast<u32>(size),
+      });
+      total_size += size;
+      EXPECT(total_size <= 0xFFFF'FFFF, "Archive would exceed 4GB");
     }
-  }
-  for (auto& p : paths) {
-    fmt::print("PATH: {} (folder:{}, depth:{})\n", p.str, p.is_folder, p.depth);
-  }
+    return {};
+  };
+  TRY(visit(visit, root, 0));
+  entries[0].sibling_next = entries.size();
+
   U8Archive result;
   std::array<char, 16> watermark{};
   std::format_to_n(watermark.data(), std::size(watermark), "{}",
@@ -419,25 +468,36 @@ Result<U8Archive> Create(std::filesystem::path root) {
   static_assert(result.watermark.size() == watermark.size());
   memcpy(result.watermark.data(), watermark.data(), result.watermark.size());
 
-  u32 size = 0;
-  for (auto&p:paths) {
-    size += p.data.size();
+  // Read every file straight into its slot of the preallocated buffer
+  result.file_data.resize(total_size);
+  std::vector<Result<void>> results(entries.size());
+  rsl::ParallelFor(entries.size(), num_threads, [&](size_t i) {
+    results[i] = [&](const Entry& e) -> Result<void> {
+      if (e.is_folder || e.size == 0) {
+        return {};
+      }
+      std::ifstream stream(e.path, std::ios::binary);
+      stream.read(reinterpret_cast<char*>(result.file_data.data() + e.offset),
+                  e.size);
+      EXPECT(stream.gcount() == e.size,
+             std::format("Failed to read file {}", e.path.string()));
+      return {};
+    }(entries[i]);
+  });
+  for (auto& r : results) {
+    TRY(r);
   }
-  result.file_data.resize(size);
 
-  u32 i = 0;
-  for (auto& p : paths) {
+  for (auto& e : entries) {
     U8Archive::Node node;
-    node.is_folder = p.is_folder;
-    node.name = p.name;
-    if (p.is_folder) {
-      node.folder.parent = p.parent;
-      node.folder.sibling_next = p.nextAtGreaterDepth;
+    node.is_folder = e.is_folder;
+    node.name = e.name;
+    if (e.is_folder) {
+      node.folder.parent = e.parent;
+      node.folder.sibling_next = e.sibling_next;
     } else {
-      node.file.offset = result.file_data.size();
-      node.file.size = p.data.size();
-      memcpy(result.file_data.data() + i, p.data.data(), p.data.size());
-      i += p.data.size();
+      node.file.offset = e.offset;
+      node.file.size = e.size;
     }
     result.nodes.push_back(node);
   }
@@ -445,4 +505,219 @@ Result<U8Archive> Create(std::filesystem::path root) {
   return result;
 }
 
+struct ArchiveView::State {
+  rsl::MappedFile file;
+  std::span<const u8> source; // Possibly YAZ0 compressed
+  std::vector<u8> expanded;   // Only for YAZ0 sources
+  std::span<const u8> data;   // U8 buffer
+
+  std::vector<Node> nodes;
+  // Lowercase path (no leading slash, "." folders elided) -> node
+  std::unordered_map<std::string, u32> index;
+
+  Result<void> load();
+  Result<void> buildIndex();
+
+  // Last: must be joined before the buffers above are destroyed
+  std::shared_future<Result<void>> ready;
+};
+
+// rvlArchiveNode has no default constructor
+static rvlArchiveNode ReadNode(std::span<const u8> data) {
+  std::array<u8, sizeof(rvlArchiveNode)> raw{};
+  std::memcpy(raw.data(), data.data(), raw.size());
+  return reinterpret_cast<rvlArchiveNode&>(raw);
+}
+
+static std::string LowerCase(std::string_view str) {
+  std::string result(str);
+  for (auto& c : result)
+    c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+  return result;
+}
+
+Result<void> ArchiveView::State::load() {
+  if (!expanded.empty()) {
+    TRY(librii::szs::decode(expanded, source));
+    data = expanded;
+  } else {
+    data = source;
+  }
+
+  rvlArchiveHeader header;
+  EXPECT(SafeMemCopy(header, data), "Invalid header");
+  EXPECT(header.magic == 0x55aa382d, "Not a U8 archive");
+  const u32 nodes_ofs = header.nodes.offset;
+  EXPECT(nodes_ofs >= sizeof(rvlArchiveHeader) &&
+             nodes_ofs + sizeof(rvlArchiveNode) <= data.size(),
+         "Invalid nodes");
+
+  const rvlArchiveNode root = ReadNode(data.subspan(nodes_ofs));
+  const u32 node_count = root.folder.sibling_next;
+  const size_t strings_ofs =
+      nodes_ofs + static_cast<size_t>(node_count) * sizeof(rvlArchiveNode);
+  const size_t strings_end = nodes_ofs + static_cast<u32>(header.nodes.size);
+  EXPECT(node_count > 0 && strings_ofs <= strings_end &&
+             strings_end <= data.size(),
+         "Invalid node table");
+  const auto strings = std::string_view(
+      reinterpret_cast<const char*>(data.data()) + strings_ofs,
+      strings_end - strings_ofs);
+
+  nodes.resize(node_count);
+  for (u32 i = 0; i < node_count; ++i) {
+    const rvlArchiveNode raw =
+        ReadNode(data.subspan(nodes_ofs + i * sizeof(rvlArchiveNode)));
+    auto& node = nodes[i];
+    node.is_folder = rvlArchiveNodeIsFolder(raw);
+    const u32 name_ofs = rvlArchiveNodeGetName(raw);
+    EXPECT(name_ofs < strings.size(), "Invalid node name");
+    node.name = strings.substr(name_ofs);
+    node.name = node.name.substr(0, node.name.find('\0'));
+    if (node.is_folder) {
+      node.folder.parent = raw.folder.parent;
+      node.folder.sibling_next = raw.folder.sibling_next;
+      EXPECT(node.folder.sibling_next > i &&
+                 node.folder.sibling_next <= node_count,
+             "Invalid folder node");
+    } else {
+      node.file.offset = raw.file.offset;
+      node.file.size = raw.file.size;
+      EXPECT(static_cast<u64>(node.file.offset) + node.file.size <=
+                 data.size(),
+             "Invalid file node");
+    }
+  }
+
+  return buildIndex();
+}
+
+Result<void> ArchiveView::State::buildIndex() {
+  struct Folder {
+    u32 sibling_next;
+    size_t prefix_len;
+  };
+  std::vector<Folder> stack{{nodes[0].folder.sibling_next, 0}};
+  std::string path;
+  index.reserve(nodes.size());
+  index.emplace("", 0);
+  for (u32 i = 1; i < nodes.size(); ++i) {
+    while (stack.back().sibling_next <= i) {
+      path.resize(stack.back().prefix_len);
+      stack.pop_back();
+      EXPECT(!stack.empty(), "Invalid U8 structure");
+    }
+    const auto& node = nodes[i];
+    const size_t prefix_len = path.size();
+    // "." folders are transparent to lookups (see PathToEntrynum)
+    if (node.name != ".") {
+      if (!path.empty())
+        path += '/';
+      path += LowerCase(node.name);
+      index.emplace(path, i);
+    }
+    if (node.is_folder) {
+      EXPECT(node.folder.sibling_next <= stack.back().sibling_next,
+             "Invalid U8 structure");
+      stack.push_back({node.folder.sibling_next, prefix_len});
+    } else {
+      path.resize(prefix_len);
+    }
+  }
+  return {};
+}
+
+ArchiveView::ArchiveView(std::unique_ptr<State> state)
+    : mState(std::move(state)) {}
+ArchiveView::ArchiveView(ArchiveView&&) noexcept = default;
+ArchiveView& ArchiveView::operator=(ArchiveView&&) noexcept = default;
+ArchiveView::~ArchiveView() = default;
+
+Result<ArchiveView> ArchiveView::create(std::unique_ptr<State> state) {
+  auto& src = state->source;
+  if (src.size() >= 4 && src[0] == 'Y' && src[1] == 'a' && src[2] == 'z' &&
+      src[3] == '0') {
+    state->expanded.resize(TRY(librii::szs::getExpandedSize(src)));
+    state->ready = std::async(std::launch::async,
+                              [s = state.get()] { return s->load(); })
+                       .share();
+    return ArchiveView(std::move(state));
+  }
+  // Uncompressed: nothing worth deferring
+  TRY(state->load());
+  std::promise<Result<void>> done;
+  done.set_value({});
+  state->ready = done.get_future().share();
+  return ArchiveView(std::move(state));
+}
+
+Result<ArchiveView> ArchiveView::open(const std::filesystem::path& path) {
+  auto state = std::make_unique<State>();
+  state->file = TRY(rsl::MappedFile::open(path));
+  state->source = state->file.data();
+  return create(std::move(state));
+}
+
+Result<ArchiveView> ArchiveView::fromBuffer(std::span<const u8> buf) {
+  auto state = std::make_unique<State>();
+  state->source = buf;
+  return create(std::move(state));
+}
+
+Result<void> ArchiveView::wait() const { return mState->ready.get(); }
+
+std::span<const ArchiveView::Node> ArchiveView::nodes() const {
+  if (!wait())
+    return {};
+  return mState->nodes;
+}
+
+std::span<const u8> ArchiveView::data() const {
+  if (!wait())
+    return {};
+  return mState->data;
+}
+
+std::span<const u8> ArchiveView::fileData(const Node& node) const {
+  assert(!node.is_folder);
+  return data().subspan(node.file.offset, node.file.size);
+}
+
+s32 ArchiveView::pathToEntrynum(std::string_view path) const {
+  if (!wait())
+    return -1;
+  // Normalize to the form used by the index
+  std::vector<std::string_view> parts;
+  while (!path.empty()) {
+    const auto slash = path.find('/');
+    const auto part = path.substr(0, slash);
+    path = slash == std::string_view::npos ? std::string_view{}
+                                           : path.substr(slash + 1);
+    if (part.empty() || part == ".")
+      continue;
+    if (part == "..") {
+      if (!parts.empty())
+        parts.pop_back();
+      continue;
+    }
+    parts.push_back(part);
+  }
+  std::string key;
+  for (auto part : parts) {
+    if (!key.empty())
+      key += '/';
+    key += LowerCase(part);
+  }
+  auto it = mState->index.find(key);
+  return it != mState->index.end() ? static_cast<s32>(it->second) : -1;
+}
+
+std::optional<std::span<const u8>>
+ArchiveView::findFile(std::string_view path) const {
+  const s32 entry = pathToEntrynum(path);
+  if (entry < 0 || mState->nodes[entry].is_folder)
+    return std::nullopt;
+  return fileData(mState->nodes[entry]);
+}
+
 } // namespace librii::U8
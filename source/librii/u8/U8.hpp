@@ -2,8 +2,11 @@
 
 #include <array>
 #include <core/common.h>
+#include <memory>
+#include <optional>
 #include <span>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace librii::U8 {
@@ -37,7 +40,70 @@ std::vector<u8> SaveU8Archive(const U8Archive& arc);
 //! Highly accurate function to game behavior.
 s32 PathToEntrynum(const U8Archive& arc, const char* path, u32 currentPath = 0);
 
-Result<void> Extract(const U8Archive& arc, std::filesystem::path out);
-Result<U8Archive> Create(std::filesystem::path root);
+//! Write every file in |arc| under |out|, using up to |num_threads| threads
+//! (0 = one per core).
+Result<void> Extract(const U8Archive& arc, std::filesystem::path out,
+                     u32 num_threads = 0);
+//! Pack the folder |root| into an archive. Files are sized first, then read
+//! in parallel straight into the preallocated file buffer.
+Result<U8Archive> Create(std::filesystem::path root, u32 num_threads = 0);
+
+//! Read-only view of a U8 archive (optionally YAZ0 compressed).
+//!
+//! Files are exposed as spans into a single buffer: the memory mapped file
+//! itself, or its decompressed contents. Decompression happens on a
+//! background thread; lookups block until it has finished. A path index is
+//! built once, so lookups are O(path length).
+class ArchiveView {
+public:
+  struct Node {
+    bool is_folder = false;
+    std::string_view name;
+
+    union {
+      struct {
+        u32 offset; // Relative to data()
+        u32 size;
+      } file;
+      struct {
+        u32 parent;
+        u32 sibling_next;
+      } folder;
+    };
+  };
+
+  //! Map |path| from disk.
+  static Result<ArchiveView> open(const std::filesystem::path& path);
+  //! View an in-memory .szs/.arc. |buf| must outlive the view.
+  static Result<ArchiveView> fromBuffer(std::span<const u8> buf);
+
+  ArchiveView(ArchiveView&&) noexcept;
+  ArchiveView& operator=(ArchiveView&&) noexcept;
+  ~ArchiveView();
+
+  //! Block until the archive has been decompressed and indexed.
+  Result<void> wait() const;
+
+  //! Empty if the archive failed to load.
+  std::span<const Node> nodes() const;
+  //! The whole (decompressed) U8 buffer.
+  std::span<const u8> data() const;
+  std::span<const u8> fileData(const Node& node) const;
+
+  //! Case-insensitive, like the game. "." and ".." are resolved lexically.
+  //! Returns the node index, or -1.
+  s32 pathToEntrynum(std::string_view path) const;
+  std::optional<std::span<const u8>> findFile(std::string_view path) const;
+
+private:
+  struct State;
+  explicit ArchiveView(std::unique_ptr<State> state);
+  static Result<ArchiveView> create(std::unique_ptr<State> state);
+
+  std::unique_ptr<State> mState;
+};
+
+Result<void> Extract(const ArchiveView& arc, std::filesystem::path out,
+                     u32 num_threads = 0);
 
 } // namespace librii::U8
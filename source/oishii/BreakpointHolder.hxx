@@ -8,6 +8,7 @@ namespace oishii {
 class BreakpointHolder {
 public:
   bool shouldBreak(uint32_t pos, uint32_t size);
+  bool hasBreakpoints() const { return !m_breakPoints.empty(); }
 
   void add_bp(uint32_t offset, uint32_t size);
   template <typename U> void add_bp(uint32_t offset) {
@@ -120,35 +120,51 @@ public:
   void warnAt(const char* msg, uint32_t selectBegin, uint32_t selectEnd,
               bool checkStack = true);
 
-  template <typename T>
-  auto tryReadBuffer(uint32_t size, uint32_t addr) -> Result<std::vector<T>> {
+  //! Read |out.size()| values of T from |addr|. The whole range is checked
+  //! once and endian-swapped in bulk, rather than per element.
+  template <typename T,                             //
+            EndianSelect E = EndianSelect::Current, //
+            bool unaligned = false>
+  auto tryReadBufferInto(std::span<T> out, uint32_t addr) -> Result<void> {
     static_assert(sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4);
-    if (addr + size * sizeof(T)  > endpos()) {
-      rsl::debug_break();
-      return std::unexpected("Buffer read exceeds file length");
+    if (!unaligned && (addr % sizeof(T))) {
+      auto err = std::format("Alignment error: {} is not {}-byte aligned.",
+                             addr, sizeof(T));
+      if (gTestMode) {
+        fprintf(stderr, "%s\n", err.c_str());
+        rsl::debug_break();
+      }
+      return std::unexpected(err);
     }
-    readerBpCheck(size, addr - tell());
-    if constexpr (sizeof(T) == 1) {
-      std::vector<T> out(size);
-      std::copy_n(mBuf.begin() + addr, size, out.begin());
-      return out;
+    if (static_cast<u64>(addr) + out.size_bytes() > endpos()) {
+      auto err = std::format(
+          "Bounds error: Reading {} bytes from {} exceeds buffer size of {}",
+          out.size_bytes(), addr, endpos());
+      if (gTestMode) {
+        fprintf(stderr, "%s\n", err.c_str());
+        rsl::debug_break();
+      }
+      return std::unexpected(err);
     }
+    readerBpCheck(out.size_bytes(), addr - tell());
+    const bool swap = endianDecode<u16, E>(1, m_endian) != 1;
+    endianCopy<T>(out.data(),
+                  reinterpret_cast<const T*>(getStreamStart() + addr),
+                  out.size(), swap);
+    return {};
+  }
+
+  template <typename T>
+  auto tryReadBuffer(uint32_t size, uint32_t addr) -> Result<std::vector<T>> {
     std::vector<T> out(size);
-    auto it = addr;
-    for (auto& t : out) {
-      t = TRY(tryGetAt<T>(it));
-      it += sizeof(T);
-	}
+    TRY(tryReadBufferInto<T>(out, addr));
     return out;
   }
   template <typename T>
   auto tryReadBuffer(uint32_t size) -> Result<std::vector<T>> {
-    auto buf = tryReadBuffer<T>(size, tell());
-    if (!buf) {
-      return std::unexpected(buf.error());
-    }
-    seekSet(tell() + size);
-    return *buf;
+    auto buf = TRY(tryReadBuffer<T>(size, tell()));
+    seekSet(tell() + size * sizeof(T));
+    return buf;
   }
 
 private:
@@ -8,8 +8,10 @@
 #include <bit>
 static_assert(__cpp_lib_byteswap >= 202110L, "Depends on std::byteswap");
 
+#include <cstring>
 #include <oishii/options.hxx>
 #include <stdint.h>
+#include <type_traits>
 
 #include <core/common.h>
 
@@ -155,6 +157,32 @@ inline T endianDecode(T val, std::endian fileEndian) {
   return val;
 }
 
+//! @brief Copy |count| values from |src| to |dst|, byte-swapping each one if
+//! |swap| is set.
+//!
+//! @details The swap loop is branch-free over plain integers so optimizing
+//! compilers turn it into SIMD byte shuffles. |dst| and |src| may be unaligned
+//! but must not overlap.
+//!
+template <typename T>
+inline void endianCopy(void* dst, const T* src, std::size_t count,
+                       bool swap) {
+  static_assert(std::is_trivially_copyable_v<T>);
+  if (!swap || sizeof(T) == 1) {
+    std::memcpy(dst, src, count * sizeof(T));
+    return;
+  }
+  using integral_t = integral_of_equal_size_t<T>;
+  auto* out = reinterpret_cast<u8*>(dst);
+  const auto* in = reinterpret_cast<const u8*>(src);
+  for (std::size_t i = 0; i < count; ++i) {
+    integral_t v;
+    std::memcpy(&v, in + i * sizeof(T), sizeof(T));
+    v = std::byteswap(v);
+    std::memcpy(out + i * sizeof(T), &v, sizeof(T));
+  }
+}
+
 std::expected<std::vector<u8>, std::string> UtilReadFile(std::string_view path);
 using FlushFileHandler = void (*)(std::span<const uint8_t> buf,
                                   std::string_view path);
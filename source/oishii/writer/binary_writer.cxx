@@ -1,12 +1,17 @@
 #include "binary_writer.hxx"
 
+#include <algorithm>
+
 namespace oishii {
 
 Writer::Writer(std::endian endian) : m_endian(endian) {}
+Writer::Writer(std::endian endian, SizeHint hint) : m_endian(endian) {
+  reserve(hint.bytes);
+}
 Writer::Writer(uint32_t buffer_size, std::endian endian)
-    : VectorWriter(buffer_size), m_endian(endian) {}
+    : VectorWriter(buffer_size), m_endian(endian), mEnd(buffer_size) {}
 Writer::Writer(std::vector<u8>&& buf, std::endian endian)
-    : VectorWriter(std::move(buf)), m_endian(endian) {}
+    : VectorWriter(std::move(buf)), m_endian(endian), mEnd(mBuf.size()) {}
 
 uint32_t Writer::reserveNext(int32_t n) {
   assert(n > 0);
@@ -23,7 +28,33 @@ uint32_t Writer::reserveNext(int32_t n) {
   return start;
 }
 
-void Writer::saveToDisk(std::string_view path) const { FlushFile(mBuf, path); }
+void Writer::growSlow(std::size_t end) {
+  if (end > 200'000'000) {
+    fprintf(stderr, "File size is astronomical");
+    rsl::debug_break();
+    abort();
+  }
+  mBuf.resize(std::max<std::size_t>({end, mBuf.size() * 2, 4096}));
+}
+
+#ifndef NDEBUG
+void Writer::checkMatch(uint32_t pos, uint32_t size) const {
+  for (uint32_t i = 0; i < size; ++i) {
+    if (mBuf[pos + i] != mDebugMatch[pos + i]) {
+      fprintf(stderr,
+              "Matching violation at 0x%x: writing %x where should be %x\n",
+              pos + i, (uint32_t)mBuf[pos + i],
+              (uint32_t)mDebugMatch[pos + i]);
+      rsl::debug_break();
+      return;
+    }
+  }
+}
+#endif
+
+void Writer::saveToDisk(std::string_view path) const {
+  FlushFile(std::span(mBuf).subspan(0, mEnd), path);
+}
 
 void Writer::breakPointProcess(uint32_t tell, uint32_t size) {
   if (shouldBreak(tell, size)) {
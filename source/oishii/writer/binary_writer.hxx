@@ -1,6 +1,7 @@
 #pragma once
 
 #include <bit>
+#include <span>
 #include <string>
 #include <vector>
 
@@ -10,24 +11,30 @@
 
 namespace oishii {
 
+//! @brief Binary writer over a growable buffer.
+//!
+//! @details mBuf is allocated in geometrically growing, zero-filled chunks and
+//! may extend past endpos(); use getBufSize()/takeBuf() for the written data.
+//!
 class Writer final : public VectorWriter {
 public:
+  //! Expected output size, used to allocate the buffer up front.
+  struct SizeHint {
+    uint32_t bytes = 0;
+  };
+
   Writer(std::endian endian);
+  Writer(std::endian endian, SizeHint hint);
   Writer(uint32_t buffer_size, std::endian endian);
   Writer(std::vector<u8>&& buf, std::endian endian);
 
   template <typename T, EndianSelect E = EndianSelect::Current>
   void write(T val, bool checkmatch = true) {
     using integral_t = integral_of_equal_size_t<T>;
-    if (tell() > 200'000'000) {
-      fprintf(stderr, "File size is astronomical");
-      rsl::debug_break();
-      abort();
-    }
-    while (tell() + sizeof(T) > mBuf.size())
-      mBuf.push_back(0);
+    growTo(tell() + sizeof(T));
 
-    breakPointProcess(sizeof(T));
+    if (hasBreakpoints())
+      breakPointProcess(sizeof(T));
 
     union {
       integral_t integral;
@@ -60,13 +67,7 @@ public:
   }
   template <EndianSelect E = EndianSelect::Current>
   void writeN(std::size_t sz, uint32_t val) {
-    if (tell() > 200'000'000) {
-      fprintf(stderr, "File size is astronomical");
-      rsl::debug_break();
-      abort();
-    }
-    while (tell() + sz > mBuf.size())
-      mBuf.push_back(0);
+    growTo(tell() + sz);
 
     uint32_t decoded = endianDecode<uint32_t, E>(val);
 
@@ -92,23 +93,72 @@ public:
     seek<Whence::Current>(sz);
   }
 
-  std::string mNameSpace = ""; // set by linker, stored in reservations
-  std::string mBlockName = ""; // set by linker, stored in reservations
+  //! @brief Write |count| values of T at once, endian-swapping the whole run.
+  //!
+  template <typename T, EndianSelect E = EndianSelect::Current>
+  void writeArray(const T* data, std::size_t count) {
+    const auto size = static_cast<uint32_t>(count * sizeof(T));
+    if (size == 0)
+      return;
+    growTo(tell() + size);
+    if (hasBreakpoints())
+      breakPointProcess(size);
+
+    const bool swap = endianDecode<u16, E>(1, m_endian) != 1;
+    endianCopy<T>(&mBuf[tell()], data, count, swap);
+
+#ifndef NDEBUG
+    if (mDebugMatch.size() > tell() + size) {
+      checkMatch(tell(), size);
+    }
+#endif
+
+    seek<Whence::Current>(size);
+  }
+  template <typename T, EndianSelect E = EndianSelect::Current>
+  void writeSpan(std::span<const T> data) {
+    writeArray<T, E>(data.data(), data.size());
+  }
+
+  //! @brief Allocate room for |size| bytes total without changing endpos().
+  //!
+  void reserve(uint32_t size) {
+    if (size > mBuf.size())
+      mBuf.resize(size);
+  }
+
+  uint32_t endpos() const override { return mEnd; }
+  uint32_t getBufSize() const { return mEnd; }
+  void resize(uint32_t sz) {
+    mBuf.resize(mEnd);
+    mBuf.resize(sz);
+    mEnd = sz;
+  }
+  //! Move out the written data, leaving the writer empty at position 0.
+  std::vector<u8> takeBuf() {
+    mBuf.resize(mEnd);
+    std::vector<u8> buf = std::move(mBuf);
+    mBuf.clear();
+    mEnd = 0;
+    seekSet(0);
+    return buf;
+  }
+
+  uint32_t mScope = 0; // set by linker (block being written), stored in
+                       // reservations
 
   struct ReferenceEntry {
     std::size_t addr;  //!< Address in writer stream.
     std::size_t TSize; //!< Size of link type
     Link mLink;        //!< The link.
 
-    std::string nameSpace; //!< Namespace
-    std::string blockName; //!< Necessary for child namespace lookup
+    uint32_t scope; //!< Linker handle of the block that wrote the link
   };
   std::vector<ReferenceEntry> mLinkReservations; // To be resolved by linker
 
   template <typename T> void writeLink(const Link& link) {
     // Add our resolvement reservation
-    mLinkReservations.push_back(
-        {tell(), sizeof(T), link, mNameSpace, mBlockName}); // copy
+    mLinkReservations.push_back({tell(), sizeof(T), link, mScope}); // copy
 
     // Dummy data
     write<T>(
@@ -149,7 +199,22 @@ public:
   void breakPointProcess(uint32_t size);
 
 private:
+  //! Extend endpos() to at least |end|. Bytes past endpos() are kept zeroed,
+  //! so growing within the current chunk is just a bump.
+  void growTo(std::size_t end) {
+    if (end <= mEnd) [[likely]]
+      return;
+    if (end > mBuf.size())
+      growSlow(end);
+    mEnd = static_cast<uint32_t>(end);
+  }
+  void growSlow(std::size_t end);
+#ifndef NDEBUG
+  void checkMatch(uint32_t pos, uint32_t size) const;
+#endif
+
   std::endian m_endian = std::endian::big; // to swap
+  uint32_t mEnd = 0;                        // logical size of mBuf
 };
 
 inline auto writePlaceholder(oishii::Writer& writer) {
@@ -10,6 +10,7 @@
 
 #include <algorithm>
 #include <memory>
+#include <span>
 #include <string>
 
 #include <core/common.h>
@@ -20,138 +21,142 @@
 
 namespace oishii {
 
+u32 Linker::SymbolTable::intern(std::string_view symbol) {
+  if (auto it = mIndex.find(symbol); it != mIndex.end()) {
+    return it->second;
+  }
+  const u32 handle = size();
+  const auto& stored = mStrings.emplace_back(symbol);
+  mIndex.emplace(stored, handle);
+  return handle;
+}
+u32 Linker::SymbolTable::find(std::string_view symbol) const {
+  auto it = mIndex.find(symbol);
+  return it != mIndex.end() ? it->second : None;
+}
+
+u32 Linker::layoutIndexOf(std::string_view symbol) const {
+  const u32 handle = mSymbols.find(symbol);
+  return handle != SymbolTable::None ? mFirstOfSymbol[handle]
+                                     : SymbolTable::None;
+}
+
 // Helpers
 class LinkerHelper {
 public:
-  static const Node* findNamespacedID(const Linker& linker,
-                                      const std::string& symbol,
-                                      const std::string& nameSpace,
-                                      const std::string& blockName,
-                                      std::string& resultName) {
-    // TODO: This can be optimized, no need to check two constructed strings
-
+  // Order: local -> children -> global. Returns the layout index of the first
+  // block whose namespaced ID matches, or SymbolTable::None.
+  static u32 findNamespacedID(const Linker& linker, const std::string& symbol,
+                              const std::string& nameSpace,
+                              const std::string& blockName) {
     // On same level
     {
       const std::string nameSpacedSymbol =
           nameSpace.empty() ? symbol : nameSpace + "::" + symbol;
-      for (const auto& entry : linker.mLayout)
-        if ((entry.mNamespace.empty()
-                 ? entry.mNode->getId()
-                 : entry.mNamespace + "::" + entry.mNode->getId()) ==
-            nameSpacedSymbol) {
-          // if (resultName)
-          resultName = nameSpacedSymbol;
-          return entry.mNode.get();
-        }
+      if (u32 i = linker.layoutIndexOf(nameSpacedSymbol);
+          i != Linker::SymbolTable::None)
+        return i;
     }
     // Children
     {
       std::string nameSpacePrefix = nameSpace.empty() ? "" : nameSpace + "::";
-      //	if (hasEnding(nameSpacePrefix, "::::"))
-      //		nameSpacePrefix = nameSpacePrefix.substr(0,
-      // nameSpacePrefix.size() - 2);
       const std::string nameSpacedSymbol =
           nameSpacePrefix + (blockName.empty() ? "" : blockName + "::") +
           symbol;
-      for (const auto& entry : linker.mLayout)
-        if ((entry.mNamespace.empty()
-                 ? entry.mNode->getId()
-                 : entry.mNamespace + "::" + entry.mNode->getId()) ==
-            nameSpacedSymbol) {
-          // if (resultName)
-          resultName = nameSpacedSymbol;
-          return entry.mNode.get();
-        }
+      if (u32 i = linker.layoutIndexOf(nameSpacedSymbol);
+          i != Linker::SymbolTable::None)
+        return i;
     }
     // Global
-    {
-      for (const auto& entry : linker.mLayout)
-        if ((entry.mNamespace.empty()
-                 ? entry.mNode->getId()
-                 : entry.mNamespace + "::" + entry.mNode->getId()) == symbol) {
-          // if (resultName)
-          resultName = symbol;
-          return entry.mNode.get();
-        }
-    }
+    if (u32 i = linker.layoutIndexOf(symbol); i != Linker::SymbolTable::None)
+      return i;
+
     printf("Search for %s failed!\n", symbol.c_str());
     assert(!"Failed critical namespaced symbol lookup in layout");
-    return nullptr;
+    return Linker::SymbolTable::None;
   }
   // TODO: Offset might be better removed
-  static u32 resolveHook(const Linker& linker, const std::string& symbol,
-                         Hook::RelativePosition pos, int offset = 0) {
-    std::string symbol_ = symbol;
-    // TODO: This can be much more optimized
+  static u32 resolveHook(const Linker& linker, std::span<const Linker::MapEntry> map,
+                         u32 index, Hook::RelativePosition pos,
+                         int offset = 0) {
+    static const std::string none;
+    const std::string& symbol =
+        index != Linker::SymbolTable::None
+            ? linker.mSymbols.str(linker.mLayout[index].mSymbol)
+            : none;
+    u32 entry_index = index;
     if (pos == Hook::RelativePosition::EndOfChildren) {
-      if (!symbol_.empty())
-        symbol_ += "::";
-      symbol_ += "EndOfChildren";
+      entry_index = linker.layoutIndexOf(
+          symbol.empty() ? "EndOfChildren" : symbol + "::EndOfChildren");
+    }
+    if (entry_index == Linker::SymbolTable::None) {
+      printf("Linker Error: Cannot resolve symbol \"%s%s\"!\n", symbol.c_str(),
+             pos == Hook::RelativePosition::EndOfChildren
+                 ? (symbol.empty() ? "EndOfChildren" : "::EndOfChildren")
+                 : "");
+      return 0xcccccccc;
+    }
+    const auto& entry = map[entry_index];
+    switch (pos) {
+    case Hook::RelativePosition::Begin:
+    case Hook::RelativePosition::EndOfChildren: // begin of marker node
+    {
+      u32 x = entry.begin + offset;
+      u32 align = pos == Hook::RelativePosition::Begin
+                      ? entry.restrict.alignment
+                      : (index != Linker::SymbolTable::None
+                             ? map[index].restrict.alignment
+                             : 0);
+      return roundUp(x, align);
     }
-    for (const auto& entry : linker.mMap) {
-      if (entry.symbol == symbol_) {
-        switch (pos) {
-        case Hook::RelativePosition::Begin:
-        case Hook::RelativePosition::EndOfChildren: // begin of marker node
-        {
-          auto roundDown = [](u32 in, u32 align) -> u32 {
-            return align ? in & ~(align - 1) : in;
-          };
-          auto roundUp = [roundDown](u32 in, u32 align) -> u32 {
-            return align ? roundDown(in + (align - 1), align) : in;
-          };
-          u32 x = entry.begin + offset;
-          // TODO: We don't need to make another pass from the start
-          u32 align = pos == Hook::RelativePosition::Begin
-                          ? entry.restrict.alignment
-                          : std::find_if(linker.mMap.begin(), linker.mMap.end(),
-                                         [symbol](auto& e) {
-                                           return e.symbol == symbol;
-                                         })
-                                ->restrict.alignment;
-          u32 rounded = roundUp(x, align);
-          return rounded;
-        }
-        case Hook::RelativePosition::End:
-          return entry.end + offset;
-        default:
-          printf("Linker Error: Unknown hook type %u -- assuming Begin (no "
-                 "align)\n",
-                 pos);
-          return entry.begin + offset;
-        }
-      }
+    case Hook::RelativePosition::End:
+      return entry.end + offset;
+    default:
+      printf("Linker Error: Unknown hook type %u -- assuming Begin (no "
+             "align)\n",
+             pos);
+      return entry.begin + offset;
     }
-    printf("Linker Error: Cannot resolve symbol \"%s\"!\n", symbol_.c_str());
-    return 0xcccccccc;
   }
 };
 
-struct EndOfChildrenMarker : public Node {
-  EndOfChildrenMarker(const Node& parent)
-      : Node("EndOfChildren", {.Leaf = true}), mParent(parent) {}
-
-  const Node& mParent;
-};
-
 // We call this recursively
 void Linker::gather(std::unique_ptr<Node> pRoot,
                     const std::string& nameSpace) noexcept {
+  gather(std::move(pRoot), mSymbols.intern(nameSpace));
+}
+void Linker::gather(std::unique_ptr<Node> pRoot, u32 nameSpace) {
   // Add the node
-  auto& root = *mLayout.emplace_back(std::move(pRoot), nameSpace).mNode.get();
+  auto& root = *mNodes.emplace_back(std::move(pRoot));
+  const auto& ns = mSymbols.str(nameSpace);
+  // The namespace of our children is our own symbol.
+  const u32 symbol =
+      mSymbols.intern(ns.empty() ? root.getId() : ns + "::" + root.getId());
+  const auto push = [&](Node& node, u32 node_ns, u32 node_symbol) {
+    const u32 index = static_cast<u32>(mLayout.size());
+    mLayout.push_back({&node, node_ns, node_symbol});
+    mIndexOfNode.emplace(&node, index);
+    if (node_symbol >= mFirstOfSymbol.size())
+      mFirstOfSymbol.resize(node_symbol + 1, SymbolTable::None);
+    if (mFirstOfSymbol[node_symbol] == SymbolTable::None)
+      mFirstOfSymbol[node_symbol] = index;
+  };
+  push(root, nameSpace, symbol);
 
   std::vector<std::unique_ptr<Node>> children;
   const auto result = root.getChildren(children);
   assert(result);
 
   for (auto& child : children)
-    gather(std::move(child),
-           (nameSpace.empty() ? "" : (nameSpace + "::")) + root.getId());
+    gather(std::move(child), symbol);
 
   if (!(root.getLinkingRestriction().Leaf)) {
-    mLayout.emplace_back(std::make_unique<EndOfChildrenMarker>(root),
-                         (nameSpace.empty() ? "" : (nameSpace + "::")) +
-                             root.getId());
+    auto& marker = mMarkers.emplace_back(
+        "EndOfChildren", LinkingRestriction{.Leaf = true});
+    push(marker, symbol,
+         mSymbols.intern(mSymbols.str(symbol).empty()
+                             ? "EndOfChildren"
+                             : mSymbols.str(symbol) + "::EndOfChildren"));
   }
 }
 
@@ -162,14 +167,30 @@ void Linker::shuffle() {
 
 void Linker::enforceRestrictions() {}
 
+u32 Linker::estimateSize() const {
+  u32 size = 0;
+  for (const auto& entry : mLayout) {
+    const auto& restrict = entry.mNode->getLinkingRestriction();
+    size += entry.mNode->sizeHint();
+    if (restrict.alignment) {
+      size += restrict.alignment * (restrict.PadEnd ? 2 : 1);
+    }
+  }
+  return size;
+}
+
 Result<void> Linker::write(Writer& writer, bool doShuffle) {
   if (doShuffle) {
     shuffle();
     enforceRestrictions();
   }
 
+  writer.reserve(writer.tell() + estimateSize());
+
   // Write data
-  for (const auto& entry : mLayout) {
+  const auto map_begin = mMap.size();
+  for (u32 i = 0; i < mLayout.size(); ++i) {
+    const auto& entry = mLayout[i];
     // align
     u32 alignment = entry.mNode->getLinkingRestriction().alignment;
     if (alignment) {
@@ -181,17 +202,15 @@ Result<void> Linker::write(Writer& writer, bool doShuffle) {
                  writer.tell() - pad_begin);
     }
     // Fill map: symbol and begin position
-    mMap.push_back({(entry.mNamespace.empty() ? "" : entry.mNamespace + "::") +
-                        entry.mNode->getId(),
-                    writer.tell(), 0, entry.mNode->getLinkingRestriction()});
+    mMap.push_back({mSymbols.str(entry.mSymbol), writer.tell(), 0,
+                    entry.mNode->getLinkingRestriction()});
     // Write
-    writer.mNameSpace = entry.mNamespace;
-    writer.mBlockName = entry.mNode->getId();
+    writer.mScope = i;
     auto ok = entry.mNode->write(writer);
     if (!ok) {
-      return std::unexpected(
-          std::format("Linker failure: {} while writing node {}::{}",
-                      ok.error(), entry.mNamespace, entry.mNode->getId()));
+      return std::unexpected(std::format(
+          "Linker failure: {} while writing node {}::{}", ok.error(),
+          mSymbols.str(entry.mNamespace), entry.mNode->getId()));
     }
     // Set ending position
     mMap[mMap.size() - 1].end = writer.tell();
@@ -205,6 +224,7 @@ Result<void> Linker::write(Writer& writer, bool doShuffle) {
                  writer.tell() - pad_begin);
     }
   }
+  const auto map = std::span(mMap).subspan(map_begin);
 
   {
     printf("Begin    End      Size     Align    Static Leaf  Symbol\n");
@@ -219,73 +239,43 @@ Result<void> Linker::write(Writer& writer, bool doShuffle) {
 
   // Resolve
 
+  // Layout index of the first block sharing the hooked block's symbol.
+  // Failures are reported and left for resolveHook to fill with 0xcccccccc.
+  const auto resolveBlock = [&](const Hook& hook,
+                                const LayoutElement& scope) -> u32 {
+    if (!hook.mBlock) {
+      // Order: local -> children -> global
+      const auto& ns = mSymbols.str(scope.mNamespace);
+      return LinkerHelper::findNamespacedID(*this, hook.mId,
+                                            ns.empty() ? "" : ns + "::",
+                                            scope.mNode->getId());
+    }
+    auto it = mIndexOfNode.find(hook.mBlock);
+    if (it == mIndexOfNode.end()) {
+      printf("Linker Error: Block %s was never written to stream, so canot "
+             "be resolved.\n",
+             hook.mBlock->getId().c_str());
+      return layoutIndexOf("");
+    }
+    return mFirstOfSymbol[mLayout[it->second].mSymbol];
+  };
+
   // TODO: map::ktpt::...::enpt is map::enpt
   for (const auto& reserve : writer.mLinkReservations) {
-    // todo: make map
     const u32 addr = static_cast<u32>(reserve.addr);
     const Link& link = reserve.mLink;
+    EXPECT(reserve.scope < mLayout.size());
+    const auto& scope = mLayout[reserve.scope];
 
-    std::string fromBlockSymbol;
-    std::string toBlockSymbol;
+    const u32 from = resolveBlock(link.from, scope);
+    const u32 to = resolveBlock(link.to, scope);
 
-    // #ifdef BUILD_DEBUG
-    const std::string& nameSpace =
-        reserve.nameSpace.empty() ? "" : reserve.nameSpace + "::";
-
-    // Order: local -> children -> global
-
-    MAYBE_UNUSED const Node& from =
-        link.from.mBlock
-            ? *link.from.mBlock
-            : *LinkerHelper::findNamespacedID(*this, link.from.mId, nameSpace,
-                                              reserve.blockName,
-                                              fromBlockSymbol);
-    MAYBE_UNUSED const Node& to =
-        link.to.mBlock
-            ? *link.to.mBlock
-            : *LinkerHelper::findNamespacedID(*this, link.to.mId, nameSpace,
-                                              reserve.blockName, toBlockSymbol);
-    // #endif
-    //  TODO: Generalize all of these from/to methods
-    if (link.from.mBlock) {
-      bool bSuccess = false;
-      for (const auto& entry : mLayout) {
-        if (entry.mNode.get() == link.from.mBlock) {
-          fromBlockSymbol =
-              entry.mNamespace.empty()
-                  ? entry.mNode->getId()
-                  : entry.mNamespace + "::" + entry.mNode->getId();
-          bSuccess = true;
-          break;
-        }
-      }
-      if (!bSuccess)
-        printf("Linker Error: Block %s was never written to stream, so canot "
-               "be resolved.\n",
-               link.from.mBlock->getId().c_str());
-    }
-    if (link.to.mBlock) {
-      bool bSuccess = false;
-      for (const auto& entry : mLayout) {
-        if (entry.mNode.get() == link.to.mBlock) {
-          toBlockSymbol = entry.mNamespace.empty()
-                              ? entry.mNode->getId()
-                              : entry.mNamespace + "::" + entry.mNode->getId();
-          bSuccess = true;
-          break;
-        }
-      }
-      if (!bSuccess)
-        printf("Linker Error: Block %s was never written to stream, so canot "
-               "be resolved.\n",
-               link.to.mBlock->getId().c_str());
-    }
     // TODO: Link: EndOfChildren + put that in map + if not all children static
     // and in shuffle, supply random number
     const u32 fromAddr = LinkerHelper::resolveHook(
-        *this, fromBlockSymbol, link.from.mRelation, link.from.mOffset);
+        *this, map, from, link.from.mRelation, link.from.mOffset);
     const u32 toAddr = LinkerHelper::resolveHook(
-        *this, toBlockSymbol, link.to.mRelation, link.to.mOffset);
+        *this, map, to, link.to.mRelation, link.to.mOffset);
 
     writer.seek<Whence::Set>(addr);
 
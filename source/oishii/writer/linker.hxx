@@ -10,6 +10,10 @@
 
 #include <stdint.h>
 
+#include <deque>
+#include <string_view>
+#include <unordered_map>
+
 #include "hook.hxx"
 #include "node.hxx"
 
@@ -48,6 +52,11 @@ public:
   //!
   void enforceRestrictions();
 
+  //! @brief Estimate the serialized size of the layout from the node size
+  //! hints, including worst-case alignment padding.
+  //!
+  u32 estimateSize() const;
+
   //! @brief Write the internal layout to a stream.
   //!
   //! @param[in] writer The output stream.
@@ -59,15 +68,39 @@ public:
   PadFunction mUserPad = nullptr;
 
 private:
-  struct LayoutElement {
-    std::unique_ptr<Node> mNode;
-    std::string mNamespace;
+  //! Namespaced IDs interned to dense integer handles.
+  class SymbolTable {
+  public:
+    static constexpr u32 None = ~0u;
+
+    u32 intern(std::string_view symbol);
+    u32 find(std::string_view symbol) const;
+    const std::string& str(u32 handle) const { return mStrings[handle]; }
+    u32 size() const { return static_cast<u32>(mStrings.size()); }
+
+  private:
+    std::deque<std::string> mStrings; // Stable storage for mIndex keys
+    std::unordered_map<std::string_view, u32> mIndex;
+  };
 
-    LayoutElement(std::unique_ptr<Node> node, const std::string& Namespace)
-        : mNode(std::move(node)), mNamespace(Namespace) {}
+  struct LayoutElement {
+    Node* mNode;
+    u32 mNamespace; //!< Interned namespace
+    u32 mSymbol;    //!< Interned namespace::id
   };
 
+  SymbolTable mSymbols;
   std::vector<LayoutElement> mLayout;
+  //! Owners of gathered nodes; end-of-children markers live in their own
+  //! chunked arena rather than one heap allocation each.
+  std::vector<std::unique_ptr<Node>> mNodes;
+  std::deque<Node> mMarkers;
+  //! First layout index for each symbol handle (SymbolTable::None if none).
+  std::vector<u32> mFirstOfSymbol;
+  std::unordered_map<const Node*, u32> mIndexOfNode;
+
+  void gather(std::unique_ptr<Node> root, u32 nameSpace);
+  u32 layoutIndexOf(std::string_view symbol) const;
 
 public:
   //! Associates namespaced IDs to writer positions.
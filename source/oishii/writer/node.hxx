@@ -96,6 +96,13 @@ public:
     return {};
   }
 
+  //! @brief Expected size of this block in bytes, excluding children.
+  //!
+  //! @details Only used to presize the output stream; it need not be exact.
+  //! Default behavior reports no estimate.
+  //!
+  virtual u32 sizeHint() const noexcept { return 0; }
+
 public:
   struct NodeDelegate {
     void addNode(std::unique_ptr<Node> node) {
@@ -2,18 +2,29 @@
 #include <librii/gl/Compiler.hpp>
 
 #include <random>
+#include <rsl/InternPool.hpp>
+#include <unordered_map>
 #include <vendor/magic_enum/magic_enum.hpp>
 
 namespace libcube {
 
 using namespace librii;
 
+// A GPU vertex: one GX index tuple within one primitive. The primitive ID
+// attribute differs between primitives, so tuples are only welded inside one.
+struct WeldKey {
+  librii::gx::IndexedVertex vtx;
+  u32 prim = 0;
+
+  bool operator==(const WeldKey&) const = default;
+};
+
 std::expected<riistudio::lib3d::IndexRange, std::string>
 IndexedPolygon::propagate(const riistudio::lib3d::Model& mdl, u32 mp_id,
                           librii::glhelper::VBOBuilder& out) const {
   riistudio::lib3d::IndexRange vertex_indices;
   vertex_indices.start = static_cast<u32>(out.mIndices.size());
-  // Expand mIndices by adding vertices
+  // Expand mIndices, adding a vertex for each new index tuple
 
   const libcube::Model& gmdl = reinterpret_cast<const libcube::Model&>(mdl);
   u32 final_bitfield = 0;
@@ -21,6 +32,7 @@ IndexedPolygon::propagate(const riistudio::lib3d::Model& mdl, u32 mp_id,
   PolyIndexer indexer(*this, gmdl);
 
   glm::vec4 prim_id(1.0f, 1.0f, 1.0f, 1.0f);
+  u32 prim_serial = 0;
 
   using rng = std::mt19937;
   std::uniform_int_distribution<rng::result_type> u24dist(0, 0xFF'FFFF);
@@ -31,26 +43,51 @@ IndexedPolygon::propagate(const riistudio::lib3d::Model& mdl, u32 mp_id,
     prim_id.r = static_cast<float>((clr >> 16) & 0xff) / 255.0f;
     prim_id.g = static_cast<float>((clr >> 8) & 0xff) / 255.0f;
     prim_id.b = static_cast<float>((clr >> 0) & 0xff) / 255.0f;
+    ++prim_serial;
   };
 
-  auto propVtx = [&](const librii::gx::IndexedVertex& vtx) -> Result<void> {
-    const auto& vcd = getVcd();
-    out.mIndices.push_back(static_cast<u32>(out.mIndices.size()));
-    EXPECT(final_bitfield == 0 || final_bitfield == vcd.mBitfield);
-    final_bitfield |= vcd.mBitfield;
+  auto& mprims = getMeshData().mMatrixPrimitives;
+  const auto& vcd = getVcd();
+
+  // Resolve every attribute stream once, and reserve for the worst case of no
+  // vertex being shared: one per GX vertex.
+  size_t max_vertices = 0;
+  for (auto& idx : mprims[mp_id].mPrimitives) {
+    max_vertices += idx.mVertices.size();
+  }
+  using VertexArray = librii::glhelper::VBOBuilder::VertexArray;
+  std::array<VertexArray*, 16> streams{};
+  auto stream = [&](u32 binding_point, size_t element_size) -> VertexArray& {
+    if (streams[binding_point] == nullptr) {
+      streams[binding_point] = &out.attribute(binding_point);
+      out.reserve(*streams[binding_point], max_vertices * element_size);
+    }
+    return *streams[binding_point];
+  };
+  auto& pnmtx = stream(1, sizeof(float));
+  auto& normal = stream(4, sizeof(glm::vec3));
+  auto& color0 = stream(5, sizeof(glm::vec4));
+  auto& tex0 = stream(7, sizeof(glm::vec2));
+  auto& tex1 = stream(8, sizeof(glm::vec2));
+  auto& prim = stream(15, sizeof(glm::vec4));
+
+  std::unordered_map<WeldKey, u32, rsl::InternHash<WeldKey>> welded;
+  welded.reserve(max_vertices);
+
+  auto pushVtx = [&](const librii::gx::IndexedVertex& vtx) -> Result<void> {
     // HACK:
     if (!(vcd.mBitfield &
           (1 << (u32)gx::VertexAttribute::PositionNormalMatrixIndex)))
-      out.pushData(1, (float)0);
+      out.pushData(pnmtx, (float)0);
     if (!(vcd.mBitfield & (1 << (u32)gx::VertexAttribute::TexCoord0)))
-      out.pushData(7, glm::vec2{});
+      out.pushData(tex0, glm::vec2{});
     if (!(vcd.mBitfield & (1 << (u32)gx::VertexAttribute::TexCoord1)))
-      out.pushData(8, glm::vec2{});
+      out.pushData(tex1, glm::vec2{});
     if (!(vcd.mBitfield & (1 << (u32)gx::VertexAttribute::Normal)))
-      out.pushData(4, glm::vec3{});
+      out.pushData(normal, glm::vec3{});
     if (!(vcd.mBitfield & (1 << (u32)gx::VertexAttribute::Color0)))
-      out.pushData(5, glm::vec4{1.0f, 1.0f, 1.0f, 1.0f});
-    out.pushData(15, prim_id);
+      out.pushData(color0, glm::vec4{1.0f, 1.0f, 1.0f, 1.0f});
+    out.pushData(prim, prim_id);
     for (u32 i = 0; i < (u32)gx::VertexAttribute::Max; ++i) {
       if (!(vcd.mBitfield & (1 << i)))
         continue;
@@ -58,7 +95,7 @@ IndexedPolygon::propagate(const riistudio::lib3d::Model& mdl, u32 mp_id,
       switch (static_cast<gx::VertexAttribute>(i)) {
       case gx::VertexAttribute::PositionNormalMatrixIndex:
         out.pushData(
-            1, (float)vtx[gx::VertexAttribute::PositionNormalMatrixIndex]);
+            pnmtx, (float)vtx[gx::VertexAttribute::PositionNormalMatrixIndex]);
         break;
       case gx::VertexAttribute::Texture0MatrixIndex:
       case gx::VertexAttribute::Texture1MatrixIndex:
@@ -71,18 +108,20 @@ IndexedPolygon::propagate(const riistudio::lib3d::Model& mdl, u32 mp_id,
         break;
       case gx::VertexAttribute::Position:
         out.pushData(
-            0, TRY(indexer.positions[vtx[gx::VertexAttribute::Position]]));
+            stream(0, sizeof(glm::vec3)),
+            TRY(indexer.positions[vtx[gx::VertexAttribute::Position]]));
         break;
       case gx::VertexAttribute::Color0: {
         auto c0 = indexer.colors[0];
-        out.pushData(5, static_cast<librii::gx::ColorF32>(
-                            TRY(c0[vtx[gx::VertexAttribute::Color0]])));
+        out.pushData(color0, static_cast<librii::gx::ColorF32>(
+                                 TRY(c0[vtx[gx::VertexAttribute::Color0]])));
         break;
       }
       case gx::VertexAttribute::Color1: {
         auto c1 = indexer.colors[0];
-        out.pushData(6, static_cast<librii::gx::ColorF32>(
-                            TRY(c1[vtx[gx::VertexAttribute::Color1]])));
+        out.pushData(stream(6, sizeof(glm::vec4)),
+                     static_cast<librii::gx::ColorF32>(
+                         TRY(c1[vtx[gx::VertexAttribute::Color1]])));
         break;
       }
       case gx::VertexAttribute::TexCoord0:
@@ -97,11 +136,12 @@ IndexedPolygon::propagate(const riistudio::lib3d::Model& mdl, u32 mp_id,
         const auto attr = static_cast<gx::VertexAttribute>(i);
         auto uvN = indexer.uvs[chan];
         const auto data = TRY(uvN[vtx[attr]]);
-        out.pushData(7 + chan, data);
+        out.pushData(stream(7 + chan, sizeof(glm::vec2)), data);
         break;
       }
       case gx::VertexAttribute::Normal:
-        out.pushData(4, TRY(indexer.normals[vtx[gx::VertexAttribute::Normal]]));
+        out.pushData(normal,
+                     TRY(indexer.normals[vtx[gx::VertexAttribute::Normal]]));
         break;
       case gx::VertexAttribute::NormalBinormalTangent:
         break;
@@ -112,6 +152,26 @@ IndexedPolygon::propagate(const riistudio::lib3d::Model& mdl, u32 mp_id,
     return {};
   };
 
+  auto propVtx = [&](const librii::gx::IndexedVertex& vtx) -> Result<void> {
+    final_bitfield = vcd.mBitfield;
+    // Unused slots are not necessarily zeroed
+    WeldKey key{};
+    key.prim = prim_serial;
+    for (u32 i = 0; i < (u32)gx::VertexAttribute::Max; ++i) {
+      if (vcd.mBitfield & (1 << i)) {
+        const auto attr = static_cast<gx::VertexAttribute>(i);
+        key.vtx[attr] = vtx[attr];
+      }
+    }
+    auto [it, inserted] = welded.try_emplace(key, out.mVertexCount);
+    if (inserted) {
+      TRY(pushVtx(vtx));
+      ++out.mVertexCount;
+    }
+    out.mIndices.push_back(it->second);
+    return {};
+  };
+
   auto propPrim = [&](const librii::gx::IndexedPrimitive& idx) -> Result<void> {
     auto propV = [&](int id) -> Result<void> {
       TRY(propVtx(idx.mVertices[id]));
@@ -169,7 +229,6 @@ IndexedPolygon::propagate(const riistudio::lib3d::Model& mdl, u32 mp_id,
     EXPECT(false, "Unexpected primitive type");
   };
 
-  auto& mprims = getMeshData().mMatrixPrimitives;
   for (auto& idx : mprims[mp_id].mPrimitives)
     TRY(propPrim(idx));
 
@@ -8,6 +8,10 @@
 #include <librii/mtx/TexMtx.hpp>
 #include <rsl/ArrayVector.hpp>
 
+namespace librii::gl {
+struct ShaderKey;
+}
+
 namespace libcube {
 
 class Scene;
@@ -25,6 +29,10 @@ struct IGCMaterial : public riistudio::lib3d::Material {
   virtual const libcube::Model* getParent() const { return nullptr; }
   std::expected<std::pair<std::string, std::string>, std::string>
   generateShaders(riistudio::lib3d::RenderType type) const override;
+  //! What the generated shaders depend on; materials with equal keys may
+  //! share a program.
+  Result<librii::gl::ShaderKey>
+  getShaderKey(riistudio::lib3d::RenderType type) const;
 
   virtual kpi::ConstCollectionRange<Texture>
   getTextureSource(const libcube::Scene& scn) const;
@@ -36,6 +36,26 @@ struct Texture : public riistudio::lib3d::Texture {
         librii::gx::TextureFormat::Extension_RawRGBA32, getData(), getWidth(),
         getHeight(), mip ? getMipmapCount() : 0);
   }
+  std::function<Result<std::vector<u8>>()>
+  makeDecoder(bool mip) const override {
+    // The encoded image is a fraction of the size of the decoded one
+    std::vector<u8> data(getData().begin(), getData().end());
+    return [data = std::move(data), size = getDecodedSize(mip),
+            format = getTextureFormat(), width = getWidth(),
+            height = getHeight(), mips = mip ? getMipmapCount() : 0]()
+               -> Result<std::vector<u8>> {
+      if (librii::gx::IsPaletteFormat(format)) {
+        // Palettes not supported
+        return std::unexpected("CI formats are unsupported");
+      }
+      std::vector<u8> out(size);
+      TRY(librii::image::transform(
+          out, width, height, format,
+          librii::gx::TextureFormat::Extension_RawRGBA32, data, width, height,
+          mips));
+      return out;
+    };
+  }
 
   virtual librii::gx::TextureFormat getTextureFormat() const = 0;
   virtual void setTextureFormat(librii::gx::TextureFormat format) = 0;
@@ -69,12 +89,19 @@ struct Texture : public riistudio::lib3d::Texture {
   //! include all additional mip levels.
   //!
   Result<void> encode(std::span<const u8> rawRGBA) override {
+    return encode(rawRGBA, librii::image::CmprQuality::Normal);
+  }
+  //! @brief As above, with the endpoint search to use if the format is CMPR.
+  //!
+  Result<void> encode(std::span<const u8> rawRGBA,
+                      librii::image::CmprQuality cmpr_quality) {
     resizeData();
 
-    return librii::image::transform(getData(), getWidth(), getHeight(),
-                                    librii::gx::TextureFormat::Extension_RawRGBA32,
-                                    getTextureFormat(), rawRGBA, getWidth(),
-                                    getHeight(), getMipmapCount());
+    return librii::image::transform(
+        getData(), getWidth(), getHeight(),
+        librii::gx::TextureFormat::Extension_RawRGBA32, getTextureFormat(),
+        rawRGBA, getWidth(), getHeight(), getMipmapCount(),
+        librii::image::ResizingAlgorithm::Lanczos, cmpr_quality);
   }
 
   virtual void setLod(bool custom, f32 min_, f32 max_) = 0;
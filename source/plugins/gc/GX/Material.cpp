@@ -10,25 +10,33 @@ IMPORT_STD;
 
 namespace libcube {
 
+static Result<librii::gl::VisType>
+ToVisType(riistudio::lib3d::RenderType type) {
+  switch (type) {
+  case riistudio::lib3d::RenderType::Topology_RandomColorPerPrimitive:
+    return librii::gl::VisType::PrimID;
+  case riistudio::lib3d::RenderType::Preview:
+    return librii::gl::VisType::None;
+  case riistudio::lib3d::RenderType::Topology_ColorByPrimitiveType:
+    return librii::gl::VisType::PrimType;
+  }
+  return std::unexpected("Unexpected RenderType");
+}
+
 std::expected<std::pair<std::string, std::string>, std::string>
 IGCMaterial::generateShaders(riistudio::lib3d::RenderType type) const {
-  auto result = TRY(librii::gl::compileShader(
-      getMaterialData(), getName(), TRY([&]() -> Result<librii::gl::VisType> {
-        switch (type) {
-        case riistudio::lib3d::RenderType::Topology_RandomColorPerPrimitive:
-          return librii::gl::VisType::PrimID;
-        case riistudio::lib3d::RenderType::Preview:
-          return librii::gl::VisType::None;
-        case riistudio::lib3d::RenderType::Topology_ColorByPrimitiveType:
-          return librii::gl::VisType::PrimType;
-        }
-        return std::unexpected("Unexpected RenderType");
-      }())));
+  auto result = TRY(librii::gl::compileShader(getMaterialData(), getName(),
+                                              TRY(ToVisType(type))));
   if (!applyCacheAgain)
     cachedPixelShader = result.fragment + "\n\n // End of shader";
   return std::pair<std::string, std::string>{result.vertex, result.fragment};
 }
 
+Result<librii::gl::ShaderKey>
+IGCMaterial::getShaderKey(riistudio::lib3d::RenderType type) const {
+  return librii::gl::ShaderKey::make(getMaterialData(), TRY(ToVisType(type)));
+}
+
 Result<librii::gfx::MegaState> IGCMaterial::setMegaState() const {
   return librii::gl::translateGfxMegaState(getMaterialData());
 }
@@ -8,7 +8,9 @@
 #include <librii/hx/PixMode.hpp>
 #include <librii/hx/TextureFilter.hpp>
 #include <librii/image/CheckerBoard.hpp>
+#include <librii/rhst/CompactMesh.hpp>
 #include <librii/rhst/RHST.hpp>
+#include <librii/rhst/StripifyCache.hpp>
 
 #include <oishii/reader/binary_reader.hxx>
 
@@ -18,8 +20,8 @@
 
 #include <rsl/FsDialog.hpp>
 #include <rsl/Stb.hpp>
+#include <rsl/ThreadPool.hpp>
 
-#include <future>
 
 // XXX: Hack, though we'll refactor all of this way soon
 std::string rebuild_dest;
@@ -309,8 +311,8 @@ void compileBone(libcube::IBoneDelegate& out, const librii::rhst::Bone& in) {
 }
 
 void compileVert(librii::gx::IndexedVertex& dst,
-                 const librii::rhst::Vertex& src, libcube::IndexedPolygon& poly,
-                 libcube::Model& mdl) {
+                 const librii::rhst::VertexArrays& src, u32 index,
+                 libcube::IndexedPolygon& poly, libcube::Model& mdl) {
   u32 vcd_cursor = 0;
 
   auto& data = poly.getMeshData();
@@ -329,36 +331,41 @@ void compileVert(librii::gx::IndexedVertex& dst,
 
     if (cur_attr == 0) {
       dst[librii::gx::VertexAttribute::PositionNormalMatrixIndex] =
-          src.matrix_index * 3;
+          src.matrixIndices()[index] * 3;
       continue;
     }
     if (cur_attr == 9) {
       dst[librii::gx::VertexAttribute::Position] =
-          poly.addPos(mdl, src.position);
+          poly.addPos(mdl, src.positions()[index]);
       continue;
     }
     if (cur_attr == 10) {
-      dst[librii::gx::VertexAttribute::Normal] = poly.addNrm(mdl, src.normal);
+      dst[librii::gx::VertexAttribute::Normal] =
+          poly.addNrm(mdl, src.normals()[index]);
       continue;
     }
 
     if (cur_attr >= 11 && cur_attr <= 12) {
       const int color_index = cur_attr - 11;
       dst[(librii::gx::VertexAttribute)cur_attr] =
-          poly.addClr(mdl, color_index, src.colors[color_index]);
+          poly.addClr(mdl, color_index, src.colors(color_index)[index]);
       continue;
     }
     if (cur_attr >= 13 && cur_attr <= 20) {
       const int uv_index = cur_attr - 13;
       dst[(librii::gx::VertexAttribute)cur_attr] =
-          poly.addUv(mdl, uv_index, src.uvs[uv_index]);
+          poly.addUv(mdl, uv_index, src.uvs(uv_index)[index]);
       continue;
     }
   }
 }
 
+// |compiled| caches the GX vertex of each compact vertex: the add* buffer
+// lookups are linear, so each unique vertex should only go through them once.
 void compilePrim(librii::gx::IndexedPrimitive& dst,
-                 const librii::rhst::Primitive& src,
+                 const librii::rhst::IndexedPrimitive& src,
+                 const librii::rhst::VertexArrays& vertices,
+                 std::vector<std::optional<librii::gx::IndexedVertex>>& compiled,
                  libcube::IndexedPolygon& poly, libcube::Model& model) {
   switch (src.topology) {
   case librii::rhst::Topology::Triangles:
@@ -372,17 +379,21 @@ void compilePrim(librii::gx::IndexedPrimitive& dst,
     break;
   }
 
-  dst.mVertices.reserve(src.vertices.size());
-  for (auto& vert : src.vertices) {
-    compileVert(dst.mVertices.emplace_back(), vert, poly, model);
+  dst.mVertices.reserve(src.indices.size());
+  for (u32 index : src.indices) {
+    auto& vert = compiled[index];
+    if (!vert) {
+      compileVert(vert.emplace(), vertices, index, poly, model);
+    }
+    dst.mVertices.push_back(*vert);
   }
 }
 
 [[nodiscard]] Result<void>
 compileMatrixPrim(librii::gx::MatrixPrimitive& dst,
-                  const librii::rhst::MatrixPrimitive& src, s32 current_matrix,
-                  libcube::IndexedPolygon& poly, libcube::Model& model,
-                  bool optimize) {
+                  const librii::rhst::CompactMatrixPrimitive& src,
+                  s32 current_matrix, libcube::IndexedPolygon& poly,
+                  libcube::Model& model, bool optimize) {
   dst.mCurrentMatrix = current_matrix;
   std::array<s32, 10> empty{
       -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
@@ -405,13 +416,19 @@ compileMatrixPrim(librii::gx::MatrixPrimitive& dst,
   }
 
   // Convert to tristrips
-  librii::rhst::MatrixPrimitive tmp = src;
+  std::vector<librii::rhst::IndexedPrimitive> tmp = src.primitives;
   if (optimize) {
-    TRY(librii::rhst::StripifyTriangles(tmp));
+    TRY(librii::rhst::StripifyTriangles(src.vertices, tmp));
   }
 
-  for (auto& prim : tmp.primitives) {
-    compilePrim(dst.mPrimitives.emplace_back(), prim, poly, model);
+  std::vector<std::optional<librii::gx::IndexedVertex>> compiled(
+      src.vertices.size());
+  for (auto& prim : tmp) {
+    for (u32 index : prim.indices) {
+      EXPECT(index < src.vertices.size());
+    }
+    compilePrim(dst.mPrimitives.emplace_back(), prim, src.vertices, compiled,
+                poly, model);
   }
 
   return {};
@@ -525,6 +542,14 @@ Result<librii::rhst::Mesh> decompileMesh(const libcube::IndexedPolygon& src,
 Result<void> compileMesh(libcube::IndexedPolygon& dst,
                          const librii::rhst::Mesh& src, libcube::Model& model,
                          bool optimize, bool reinit_bufs) {
+  return compileMesh(dst, librii::rhst::Compact(src), model, optimize,
+                     reinit_bufs);
+}
+
+Result<void> compileMesh(libcube::IndexedPolygon& dst,
+                         const librii::rhst::CompactMesh& src,
+                         libcube::Model& model, bool optimize,
+                         bool reinit_bufs) {
   dst.setName(src.name);
 
   // No skinning/BB
@@ -556,6 +581,9 @@ Result<void> compileMesh(libcube::IndexedPolygon& dst,
   }
 
   for (auto& matrix_prim : src.matrix_primitives) {
+    // compileVert reads every attribute of the descriptor
+    const u32 vcd = matrix_prim.vertices.vertexDescriptor();
+    EXPECT((vcd & src.vertex_descriptor) == src.vertex_descriptor);
     TRY(compileMatrixPrim(data.mMatrixPrimitives.emplace_back(), matrix_prim,
                           src.current_matrix, dst, model, optimize));
   }
@@ -593,7 +621,13 @@ Result<void> importTextureImpl(libcube::Texture& data, std::span<u8> image,
                                std::vector<u8>& scratch, int num_mip, int width,
                                int height, int source_w, int source_h,
                                librii::gx::TextureFormat fmt,
-                               librii::image::ResizingAlgorithm resize) {
+                               librii::image::ResizingAlgorithm resize,
+                               librii::image::CmprQuality cmpr_quality) {
+  if (librii::gx::IsPaletteFormat(fmt)) {
+    // librii::image can encode them, but BRRES and BMD textures have nowhere
+    // to store the palette yet.
+    return std::unexpected("C4/C8/C14X2 textures cannot be saved yet");
+  }
   data.setTextureFormat(fmt);
   data.setWidth(width);
   data.setHeight(height);
@@ -604,7 +638,7 @@ Result<void> importTextureImpl(libcube::Texture& data, std::span<u8> image,
     std::vector<u8> scratch(4 * width * height);
     librii::image::resize(scratch, width, height, image, source_w, source_h,
                           resize);
-    TRY(data.encode(scratch));
+    TRY(data.encode(scratch, cmpr_quality));
   } else {
     rsl::trace("Width: {}, Height: {}.", width, height);
     u32 size = 0;
@@ -614,21 +648,17 @@ Result<void> importTextureImpl(libcube::Texture& data, std::span<u8> image,
                  height >> i, size);
     }
     scratch.resize(size);
+    librii::image::generateMipChain(scratch, width, height, num_mip, image,
+                                    source_w, source_h, resize);
 
-    u32 slide = 0;
-    for (int i = 0; i <= num_mip; ++i) {
-      librii::image::resize(std::span(scratch).subspan(slide), width >> i,
-                            height >> i, image, source_w, source_h, resize);
-      slide += (width >> i) * (height >> i) * 4;
-    }
-
-    TRY(data.encode(scratch));
+    TRY(data.encode(scratch, cmpr_quality));
   }
   return {};
 }
 Result<void> importTexture(libcube::Texture& data, std::span<u8> image,
                            std::vector<u8>& scratch, bool mip_gen, int min_dim,
-                           int max_mip, int width, int height, int channels) {
+                           int max_mip, int width, int height, int channels,
+                           librii::image::CmprQuality cmpr_quality) {
   if (image.empty()) {
     return std::unexpected(
         "STB failed to parse image. Unsupported file format?");
@@ -657,21 +687,25 @@ Result<void> importTexture(libcube::Texture& data, std::span<u8> image,
   }
 
   return importTextureImpl(data, image, scratch, num_mip, width, height, width,
-                           height, librii::gx::TextureFormat::CMPR);
+                           height, librii::gx::TextureFormat::CMPR,
+                           librii::image::ResizingAlgorithm::Lanczos,
+                           cmpr_quality);
 }
 
 Result<void> importTextureFromMemory(libcube::Texture& data,
                                      std::span<const u8> span,
                                      std::vector<u8>& scratch, bool mip_gen,
-                                     int min_dim, int max_mip) {
+                                     int min_dim, int max_mip,
+                                     librii::image::CmprQuality cmpr_quality) {
   auto image = TRY(rsl::stb::load_from_memory(span));
   return importTexture(data, image.data, scratch, mip_gen, min_dim, max_mip,
-                       image.width, image.height, image.channels);
+                       image.width, image.height, image.channels, cmpr_quality);
 }
 Result<void> importTextureFromFile(libcube::Texture& data,
                                    std::string_view path,
                                    std::vector<u8>& scratch, bool mip_gen,
-                                   int min_dim, int max_mip) {
+                                   int min_dim, int max_mip,
+                                   librii::image::CmprQuality cmpr_quality) {
   if (path.ends_with(".tex0")) {
     auto obuf = ReadFile(path);
     if (!obuf) {
@@ -691,12 +725,13 @@ Result<void> importTextureFromFile(libcube::Texture& data,
   }
   auto image = TRY(rsl::stb::load(path));
   return importTexture(data, image.data, scratch, mip_gen, min_dim, max_mip,
-                       image.width, image.height, image.channels);
+                       image.width, image.height, image.channels, cmpr_quality);
 }
 
 void import_texture(std::string tex, libcube::Texture* pdata,
                     std::filesystem::path file_path,
-                    std::optional<MipGen> mips) {
+                    std::optional<MipGen> mips,
+                    librii::image::CmprQuality cmpr_quality) {
   libcube::Texture& data = *pdata;
   std::vector<u8> scratch;
   bool mip_gen = mips.has_value();
@@ -713,7 +748,7 @@ void import_texture(std::string tex, libcube::Texture* pdata,
 
   for (const auto& path : search_paths) {
     if (importTextureFromFile(data, path.string().c_str(), scratch, mip_gen,
-                              min_dim, max_mip)) {
+                              min_dim, max_mip, cmpr_quality)) {
       return;
     }
   }
@@ -736,7 +771,10 @@ bool CompileRHST(librii::rhst::SceneTree& rhst, libcube::Scene& scene,
                  std::string path,
                  std::function<void(std::string, std::string)> info,
                  std::function<void(std::string_view, float)> progress,
-                 std::optional<MipGen> mips, bool tristrip, bool verbose) {
+                 std::optional<MipGen> mips, bool tristrip, bool verbose,
+                 unsigned num_threads, bool use_cache,
+                 librii::image::CmprQuality cmpr_quality,
+                 u32 stripify_budget_ms) {
   std::set<std::string> textures_needed;
 
   for (auto& mat : rhst.materials) {
@@ -769,59 +807,80 @@ bool CompileRHST(librii::rhst::SceneTree& rhst, libcube::Scene& scene,
   // Favor PNG, and the current directory
   auto file_path = std::filesystem::path(path);
 
-  std::vector<std::future<void>> futures;
+  rsl::ThreadPool pool(num_threads);
+  rsl::TaskGroup texture_tasks(pool);
 
   for (int i = 0; i < scene.getTextures().size(); ++i) {
     libcube::Texture* data = &scene.getTextures()[i];
 
-    futures.push_back(std::async(std::launch::async, [=] {
-      import_texture(data->getName(), data, file_path, mips);
-    }));
+    texture_tasks.run([=] {
+      import_texture(data->getName(), data, file_path, mips, cmpr_quality);
+    });
+  }
+
+  // Only the attributes in each vertex descriptor survive compilation; drop
+  // the rest up front, along with duplicate vertices.
+  std::vector<librii::rhst::CompactMesh> meshes;
+  meshes.reserve(rhst.meshes.size());
+  for (auto& mesh : rhst.meshes) {
+    meshes.push_back(librii::rhst::Compact(std::move(mesh)));
   }
+  rhst.meshes.clear();
 
   // Optimize meshes
   if (tristrip) {
-    progress(std::format("Optimizing meshes {}/{}", 0, 0), 0.0f);
-    std::atomic<int> so_far = 0;
-    int total = rhst.meshes.size();
+    const int total = meshes.size();
     progress(std::format("Optimizing meshes ({} / {})", 0, total), 0.0f);
 
+    std::optional<librii::rhst::StripifyCache> cache;
+    if (use_cache) {
+      cache.emplace(librii::rhst::StripifyCache::DefaultPath());
+    }
+
     rsl::Timer timer;
-    for (auto& mesh : rhst.meshes) {
-      auto task = [&](librii::rhst::Mesh* mesh) {
-        assert(mesh != nullptr);
-        int i = 0;
-        for (auto& mp : mesh->matrix_primitives) {
-          auto ok = librii::rhst::StripifyTriangles(
-              mp, std::nullopt,
-              mesh->matrix_primitives.size() > 1
-                  ? std::format("{}::{}", mesh->name, i)
-                  : mesh->name,
-              verbose);
-          ++i;
-          if (!ok) {
-            rsl::error("Error: Failed to stripify mesh {}. {}", mesh->name,
-                       ok.error());
-          }
+    rsl::TaskGroup strip_tasks(pool, [&](size_t done, size_t) {
+      progress(std::format("Optimizing meshes ({} / {})", done, total),
+               static_cast<float>(done) / static_cast<float>(total));
+    });
+    for (auto& mesh : meshes) {
+      strip_tasks.run([&pool, &cache, &mesh, verbose, stripify_budget_ms] {
+        // Each matrix primitive is independent; let idle workers steal them
+        rsl::TaskGroup mp_tasks(pool);
+        for (size_t i = 0; i < mesh.matrix_primitives.size(); ++i) {
+          mp_tasks.run([&pool, &cache, &mesh, i, verbose, stripify_budget_ms] {
+            auto& mp = mesh.matrix_primitives[i];
+            const auto name = mesh.matrix_primitives.size() > 1
+                                  ? std::format("{}::{}", mesh.name, i)
+                                  : mesh.name;
+            auto ok = cache ? librii::rhst::StripifyTrianglesCached(
+                                  *cache, mp, std::nullopt, name, verbose,
+                                  &pool, stripify_budget_ms)
+                            : librii::rhst::StripifyTriangles(
+                                  mp, std::nullopt, name, verbose, &pool,
+                                  stripify_budget_ms);
+            if (!ok) {
+              rsl::error("Error: Failed to stripify mesh {}. {}", mesh.name,
+                         ok.error());
+            }
+          });
         }
-        ++so_far;
-        int x = static_cast<int>(so_far);
-        progress(std::format("Optimizing meshes ({} / {})", x, total),
-                 static_cast<float>(x) / static_cast<float>(total));
-      };
-      futures.push_back(std::async(std::launch::async, std::bind(task, &mesh)));
+        mp_tasks.wait();
+      });
     }
 
-    futures.clear();
-    rsl::error("Elapsed stripping time (multicore) (or texture import time if "
-               "greater): {}ms",
-               timer.elapsed());
+    strip_tasks.wait();
+    rsl::info("Elapsed stripping time ({} threads): {}ms", pool.size(),
+              timer.elapsed());
+    if (verbose && cache) {
+      rsl::info("Stripify cache: {} hits, {} misses", cache->hits(),
+                cache->misses());
+    }
   }
 
-  progress(std::format("Compiling meshes {}/{}", 0, rhst.meshes.size()), 0.0f);
-  for (auto&& [i, mesh] : rsl::enumerate(rhst.meshes)) {
-    progress(std::format("Compiling meshes {}/{}", i, rhst.meshes.size()),
-             static_cast<float>(i) / static_cast<float>(rhst.meshes.size()));
+  progress(std::format("Compiling meshes {}/{}", 0, meshes.size()), 0.0f);
+  for (auto&& [i, mesh] : rsl::enumerate(meshes)) {
+    progress(std::format("Compiling meshes {}/{}", i, meshes.size()),
+             static_cast<float>(i) / static_cast<float>(meshes.size()));
     // Already optimized (and in parallel)
     auto ok = compileMesh(mdl.getMeshes().add(), mesh, mdl, false);
     if (!ok) {
@@ -842,6 +901,7 @@ bool CompileRHST(librii::rhst::SceneTree& rhst, libcube::Scene& scene,
   }
 
   // Now that all textures are loaded, correct sampler settings
+  texture_tasks.wait();
   for (auto& mat : mdl.getMaterials()) {
     for (auto& sampler : mat.getMaterialData().samplers) {
       const auto* tex = mat.getTexture(scene, sampler.mTexture);
@@ -2,6 +2,7 @@
 
 #include <LibBadUIFramework/Plugins.hpp>
 #include <librii/image/ImagePlatform.hpp>
+#include <librii/rhst/CompactMesh.hpp>
 #include <librii/rhst/RHST.hpp>
 #include <plugins/gc/Export/Scene.hpp>
 #include <plugins/gc/Export/Texture.hpp>
@@ -13,35 +14,45 @@ importTextureImpl(libcube::Texture& data, std::span<u8> image,
                   std::vector<u8>& scratch, int num_mip, int width, int height,
                   int first_w, int first_h, librii::gx::TextureFormat fmt,
                   librii::image::ResizingAlgorithm resize =
-                      librii::image::ResizingAlgorithm::Lanczos);
-
-[[nodiscard]] Result<void> importTexture(libcube::Texture& data,
-                                         std::span<u8> image,
-                                         std::vector<u8>& scratch, bool mip_gen,
-                                         int min_dim, int max_mip, int width,
-                                         int height, int channels);
-[[nodiscard]] Result<void> importTextureFromMemory(libcube::Texture& data,
-                                                   std::span<const u8> span,
-                                                   std::vector<u8>& scratch,
-                                                   bool mip_gen, int min_dim,
-                                                   int max_mip);
-[[nodiscard]] Result<void> importTextureFromFile(libcube::Texture& data,
-                                                 std::string_view path,
-                                                 std::vector<u8>& scratch,
-                                                 bool mip_gen, int min_dim,
-                                                 int max_mip);
+                      librii::image::ResizingAlgorithm::Lanczos,
+                  librii::image::CmprQuality cmpr_quality =
+                      librii::image::CmprQuality::Normal);
+
+[[nodiscard]] Result<void>
+importTexture(libcube::Texture& data, std::span<u8> image,
+              std::vector<u8>& scratch, bool mip_gen, int min_dim, int max_mip,
+              int width, int height, int channels,
+              librii::image::CmprQuality cmpr_quality =
+                  librii::image::CmprQuality::Normal);
+[[nodiscard]] Result<void>
+importTextureFromMemory(libcube::Texture& data, std::span<const u8> span,
+                        std::vector<u8>& scratch, bool mip_gen, int min_dim,
+                        int max_mip,
+                        librii::image::CmprQuality cmpr_quality =
+                            librii::image::CmprQuality::Normal);
+[[nodiscard]] Result<void>
+importTextureFromFile(libcube::Texture& data, std::string_view path,
+                      std::vector<u8>& scratch, bool mip_gen, int min_dim,
+                      int max_mip,
+                      librii::image::CmprQuality cmpr_quality =
+                          librii::image::CmprQuality::Normal);
 
 struct MipGen {
   u32 min_dim = 32;
   u32 max_mip = 5;
 };
+// Consumes the meshes of |rhst|.
 [[nodiscard]] bool
 CompileRHST(librii::rhst::SceneTree& rhst, libcube::Scene& scene,
             std::string path,
             std::function<void(std::string, std::string)> info,
             std::function<void(std::string_view, float)> progress,
             std::optional<MipGen> mips = {}, bool tristrip = true,
-            bool verbose = true);
+            bool verbose = true, unsigned num_threads = 0,
+            bool use_cache = true,
+            librii::image::CmprQuality cmpr_quality =
+                librii::image::CmprQuality::Normal,
+            u32 stripify_budget_ms = 0);
 
 [[nodiscard]] Result<librii::rhst::Mesh>
 decompileMesh(const libcube::IndexedPolygon& src, const libcube::Model& mdl);
@@ -51,5 +62,10 @@ decompileMesh(const libcube::IndexedPolygon& src, const libcube::Model& mdl);
                                        libcube::Model& model,
                                        bool optimize = true,
                                        bool reinit_bufs = true);
+[[nodiscard]] Result<void> compileMesh(libcube::IndexedPolygon& dst,
+                                       const librii::rhst::CompactMesh& src,
+                                       libcube::Model& model,
+                                       bool optimize = true,
+                                       bool reinit_bufs = true);
 
 } // namespace riistudio::rhst
@@ -0,0 +1,179 @@
+#pragma once
+
+#include <bit>
+#include <cassert>
+#include <core/common.h>
+#include <functional>
+#include <rsl/SmallVector.hpp>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace rsl {
+
+//! Hash used by InternPool. Must agree with T's operator== (a == b implies
+//! equal hashes); it need not cover every field.
+//!
+//! The primary template handles arithmetic types, enums, strings, pairs, ranges
+//! and types without padding. Everything else must be specialized.
+template <typename T> struct InternHash;
+
+inline void HashCombine(std::size_t& seed, std::size_t h) {
+  seed ^= h + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+}
+
+template <typename T> std::size_t HashValue(const T& x) {
+  return InternHash<T>{}(x);
+}
+
+//! Combine the hashes of several fields.
+template <typename... Ts> std::size_t HashFields(const Ts&... xs) {
+  std::size_t seed = 0;
+  (HashCombine(seed, HashValue(xs)), ...);
+  return seed;
+}
+
+template <typename T> struct InternHash {
+  std::size_t operator()(const T& x) const {
+    if constexpr (std::is_enum_v<T>) {
+      return std::hash<std::underlying_type_t<T>>{}(
+          static_cast<std::underlying_type_t<T>>(x));
+    } else if constexpr (std::is_same_v<T, f32>) {
+      // 0.0f == -0.0f
+      return x == 0.0f ? 0 : std::hash<u32>{}(std::bit_cast<u32>(x));
+    } else if constexpr (std::is_arithmetic_v<T> ||
+                         std::is_convertible_v<const T&, std::string_view>) {
+      return std::hash<T>{}(x);
+    } else if constexpr (requires { x.first, x.second; }) {
+      return HashFields(x.first, x.second);
+    } else if constexpr (requires { x.begin(), x.end(); }) {
+      std::size_t seed = 0;
+      for (const auto& e : x)
+        HashCombine(seed, HashValue(e));
+      return seed;
+    } else {
+      static_assert(std::has_unique_object_representations_v<T>,
+                    "T has padding or floats: specialize rsl::InternHash<T>");
+      return std::hash<std::string_view>{}(std::string_view(
+          reinterpret_cast<const char*>(std::addressof(x)), sizeof(T)));
+    }
+  }
+};
+
+//! Insertion-ordered pool of unique values with O(1) lookup.
+//!
+//! Replaces the std::find-based deduplication in the section writers. Indices
+//! are stable: entries are never reordered or erased. push() bypasses
+//! deduplication for uncompressed sections, and find() can report the first or
+//! last equal entry to keep output byte-matching.
+//!
+//! Entries may be edited in place through the non-const accessors (e.g. by
+//! readers); the index is then rebuilt on the next lookup.
+template <typename T, typename Hash = InternHash<T>> class InternPool {
+public:
+  enum class Match { First, Last };
+
+  InternPool() = default;
+  InternPool(std::vector<T> entries)
+      : mEntries(std::move(entries)), mDirty(true) {}
+
+  //! Returns the index of an entry equal to |x|, inserting it if absent.
+  u32 append(const T& x) {
+    const auto h = Hash{}(x);
+    auto& bucket = getIndex()[h];
+    for (u32 i : bucket)
+      if (mEntries[i] == x)
+        return i;
+    return insert(bucket, x);
+  }
+  //! Unconditionally inserts |x|, returning its index.
+  u32 push(const T& x) { return insert(getIndex()[Hash{}(x)], x); }
+
+  //! Index of an entry equal to |x|, or -1.
+  int find(const T& x, Match match = Match::First) const {
+    const auto& index = getIndex();
+    const auto it = index.find(Hash{}(x));
+    if (it == index.end())
+      return -1;
+    int found = -1;
+    for (u32 i : it->second) {
+      if (mEntries[i] == x) {
+        found = static_cast<int>(i);
+        if (match == Match::First)
+          break;
+      }
+    }
+    return found;
+  }
+  bool contains(const T& x) const { return find(x) >= 0; }
+
+  const std::vector<T>& entries() const { return mEntries; }
+  std::size_t size() const { return mEntries.size(); }
+  bool empty() const { return mEntries.empty(); }
+  const T& operator[](std::size_t i) const {
+    assert(i < mEntries.size());
+    return mEntries[i];
+  }
+  auto begin() const { return mEntries.begin(); }
+  auto end() const { return mEntries.end(); }
+
+  // Mutable access invalidates the index
+  T& operator[](std::size_t i) {
+    assert(i < mEntries.size());
+    mDirty = true;
+    return mEntries[i];
+  }
+  auto begin() {
+    mDirty = true;
+    return mEntries.begin();
+  }
+  auto end() {
+    mDirty = true;
+    return mEntries.end();
+  }
+  void resize(std::size_t n) {
+    mEntries.resize(n);
+    mDirty = true;
+  }
+  void push_back(const T& x) {
+    mEntries.push_back(x);
+    mDirty = true;
+  }
+  void clear() {
+    mEntries.clear();
+    mIndex.clear();
+    mDirty = false;
+  }
+
+  bool operator==(const InternPool& rhs) const {
+    return mEntries == rhs.mEntries;
+  }
+
+private:
+  using Bucket = rsl::small_vector<u32, 1>;
+  using Index = std::unordered_map<std::size_t, Bucket>;
+
+  u32 insert(Bucket& bucket, const T& x) {
+    const u32 i = static_cast<u32>(mEntries.size());
+    mEntries.push_back(x);
+    bucket.push_back(i);
+    return i;
+  }
+  Index& getIndex() const {
+    if (mDirty) {
+      mIndex.clear();
+      for (u32 i = 0; i < mEntries.size(); ++i)
+        mIndex[Hash{}(mEntries[i])].push_back(i);
+      mDirty = false;
+    }
+    return mIndex;
+  }
+
+  std::vector<T> mEntries;
+  mutable Index mIndex;
+  mutable bool mDirty = false;
+};
+
+} // namespace rsl
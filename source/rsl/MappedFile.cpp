@@ -0,0 +1,121 @@
+#include "MappedFile.hpp"
+
+#ifdef _WIN32
+#include <Windows.h>
+#elif !defined(RII_PLATFORM_EMSCRIPTEN)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define RSL_HAS_MMAP
+#endif
+
+#include <fstream>
+
+namespace rsl {
+
+#if !defined(_WIN32) && !defined(RSL_HAS_MMAP)
+static Result<std::vector<u8>>
+ReadWholeFile(const std::filesystem::path& path) {
+  std::ifstream stream(path, std::ios::binary | std::ios::ate);
+  EXPECT(stream.good(), "Failed to open file");
+  std::vector<u8> buf(stream.tellg());
+  stream.seekg(0, std::ios::beg);
+  stream.read(reinterpret_cast<char*>(buf.data()), buf.size());
+  EXPECT(stream.good(), "Failed to read file");
+  return buf;
+}
+#endif
+
+Result<MappedFile> MappedFile::open(const std::filesystem::path& path) {
+  MappedFile result;
+#ifdef _WIN32
+  HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                            nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                            nullptr);
+  EXPECT(file != INVALID_HANDLE_VALUE, "Failed to open file");
+  result.mFile = file;
+  LARGE_INTEGER size;
+  EXPECT(GetFileSizeEx(file, &size), "Failed to query file size");
+  result.mSize = static_cast<size_t>(size.QuadPart);
+  if (result.mSize == 0) {
+    return result;
+  }
+  HANDLE mapping =
+      CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  EXPECT(mapping != nullptr, "Failed to map file");
+  result.mMapping = mapping;
+  result.mData = reinterpret_cast<const u8*>(
+      MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+  EXPECT(result.mData != nullptr, "Failed to map file");
+#elif defined(RSL_HAS_MMAP)
+  int fd = ::open(path.c_str(), O_RDONLY);
+  EXPECT(fd >= 0, "Failed to open file");
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    ::close(fd);
+    return std::unexpected("Failed to query file size");
+  }
+  result.mSize = static_cast<size_t>(st.st_size);
+  if (result.mSize == 0) {
+    ::close(fd);
+    return result;
+  }
+  void* addr = mmap(nullptr, result.mSize, PROT_READ, MAP_PRIVATE, fd, 0);
+  // The mapping keeps its own reference to the file
+  ::close(fd);
+  if (addr == MAP_FAILED) {
+    result.mSize = 0;
+    return std::unexpected("Failed to map file");
+  }
+  result.mData = reinterpret_cast<const u8*>(addr);
+#else
+  result.mFallback = TRY(ReadWholeFile(path));
+  result.mData = result.mFallback.data();
+  result.mSize = result.mFallback.size();
+#endif
+  return result;
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& rhs) noexcept {
+  if (this == &rhs) {
+    return *this;
+  }
+  close();
+  mData = std::exchange(rhs.mData, nullptr);
+  mSize = std::exchange(rhs.mSize, 0);
+#ifdef _WIN32
+  mFile = std::exchange(rhs.mFile, nullptr);
+  mMapping = std::exchange(rhs.mMapping, nullptr);
+#endif
+  // Moving a vector keeps its heap buffer, so mData stays valid
+  mFallback = std::move(rhs.mFallback);
+  return *this;
+}
+
+void MappedFile::close() {
+  if (!mFallback.empty()) {
+    mFallback.clear();
+  }
+#ifdef _WIN32
+  else if (mData) {
+    UnmapViewOfFile(mData);
+  }
+  if (mMapping) {
+    CloseHandle(mMapping);
+  }
+  if (mFile) {
+    CloseHandle(mFile);
+  }
+  mMapping = nullptr;
+  mFile = nullptr;
+#elif defined(RSL_HAS_MMAP)
+  else if (mData) {
+    munmap(const_cast<u8*>(mData), mSize);
+  }
+#endif
+  mData = nullptr;
+  mSize = 0;
+}
+
+} // namespace rsl
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <core/common.h>
+#include <filesystem>
+#include <span>
+
+namespace rsl {
+
+//! Read-only memory mapping of a file on disk.
+//!
+//! Falls back to reading the file into memory on platforms without mmap.
+class MappedFile {
+public:
+  static Result<MappedFile> open(const std::filesystem::path& path);
+
+  MappedFile() = default;
+  MappedFile(MappedFile&& rhs) noexcept { *this = std::move(rhs); }
+  MappedFile& operator=(MappedFile&& rhs) noexcept;
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  ~MappedFile() { close(); }
+
+  std::span<const u8> data() const { return {mData, mSize}; }
+  size_t size() const { return mSize; }
+
+private:
+  void close();
+
+  const u8* mData = nullptr;
+  size_t mSize = 0;
+#ifdef _WIN32
+  void* mFile = nullptr;
+  void* mMapping = nullptr;
+#endif
+  // Used when mapping is unavailable
+  std::vector<u8> mFallback;
+};
+
+} // namespace rsl
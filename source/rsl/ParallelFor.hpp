@@ -0,0 +1,98 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <rsl/Defer.hpp>
+#include <rsl/ThreadPool.hpp>
+#include <thread>
+#include <vector>
+
+namespace rsl {
+
+//! Number of worker threads to use for a requested count (0 = one per core).
+inline unsigned ResolveThreadCount(unsigned requested) {
+  if (requested != 0) {
+    return requested;
+  }
+  return std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+namespace detail {
+// Set on threads running the items of a ParallelFor outside of a ThreadPool
+inline thread_local bool tInParallelFor = false;
+} // namespace detail
+
+//! Call |func(i)| for every i in [0, count) as up to |num_tasks| tasks of
+//! |pool| (0 = one per worker, plus the caller). The calling thread
+//! participates through TaskGroup::wait(), so loops nested in any item also
+//! run on |pool|. Items are handed out in order, one at a time.
+template <typename F>
+void ParallelFor(ThreadPool& pool, size_t count, unsigned num_tasks,
+                 F&& func) {
+  if (num_tasks == 0) {
+    num_tasks = pool.size() + 1;
+  }
+  num_tasks = std::min<size_t>(num_tasks, count);
+  std::atomic<size_t> next = 0;
+  const auto worker = [&]() {
+    for (size_t i = next++; i < count; i = next++) {
+      func(i);
+    }
+  };
+  if (num_tasks <= 1) {
+    worker();
+    return;
+  }
+  TaskGroup group(pool);
+  for (unsigned i = 0; i < num_tasks; ++i) {
+    group.run(worker);
+  }
+  group.wait();
+}
+
+//! Call |func(i)| for every i in [0, count), spread over up to |num_threads|
+//! threads (0 = one per core). The calling thread participates. Items are
+//! handed out in order, one at a time.
+//!
+//! Called from a ThreadPool worker, the items are shared with that pool
+//! instead, so loops nested in pool tasks stay within its thread count. Loops
+//! nested in the items of a loop that did start threads run inline.
+template <typename F>
+void ParallelFor(size_t count, unsigned num_threads, F&& func) {
+  if (auto* pool = ThreadPool::current()) {
+    ParallelFor(*pool, count, num_threads, func);
+    return;
+  }
+  num_threads = std::min<size_t>(ResolveThreadCount(num_threads), count);
+  std::atomic<size_t> next = 0;
+  const auto worker = [&]() {
+    for (size_t i = next++; i < count; i = next++) {
+      func(i);
+    }
+  };
+  if (num_threads <= 1 || detail::tInParallelFor) {
+    worker();
+    return;
+  }
+  const auto nested_worker = [&]() {
+    // std::async may run this on a reused thread
+    detail::tInParallelFor = true;
+    RSL_DEFER(detail::tInParallelFor = false);
+    worker();
+  };
+  std::vector<std::future<void>> futures;
+  for (unsigned i = 1; i < num_threads; ++i) {
+    futures.push_back(std::async(std::launch::async, nested_worker));
+  }
+  {
+    detail::tInParallelFor = true;
+    RSL_DEFER(detail::tInParallelFor = false);
+    worker();
+  }
+  for (auto& f : futures) {
+    f.get();
+  }
+}
+
+} // namespace rsl
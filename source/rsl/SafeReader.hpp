@@ -122,6 +122,16 @@ public:
     return buf | rsl::ToArray<size>();
   }
 
+  //! Read |count| values of T in one bounds check and endian swap.
+  template <typename T> auto Buffer(u32 count) -> Result<std::vector<T>> {
+    return mReader.tryReadBuffer<T>(count);
+  }
+  template <typename T> auto BufferInto(std::span<T> out) -> Result<void> {
+    TRY(mReader.tryReadBufferInto<T>(out, mReader.tell()));
+    mReader.skip(out.size_bytes());
+    return {};
+  }
+
   auto Magic(std::string_view ident) -> Result<std::string_view>;
 
   Result<std::string> StringOfs32(u32 relative);
@@ -0,0 +1,9 @@
+#pragma once
+
+// RSL_HAS_SSE2 is defined when SSE2 intrinsics can be used. Every x86-64
+// target has them; 32-bit x86 needs -msse2 or /arch:SSE2.
+#if defined(__SSE2__) || defined(_M_X64) ||                                   \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RSL_HAS_SSE2 1
+#endif
@@ -0,0 +1,221 @@
+#pragma once
+
+#include <core/common.h>
+#include <deque>
+#include <memory>
+#include <ranges>
+#include <tuple>
+#include <utility>
+
+namespace rsl {
+
+//! Splits a document into sections that snapshots share while unchanged.
+//!
+//! Specialize with a tuple of pointers to the members that are edited
+//! independently (e.g. one per list of a file format). By default, the whole
+//! document is a single section.
+template <typename T> struct SnapshotSections {
+  static constexpr std::tuple<> members{};
+};
+
+//! Undo history of a value type, kept as immutable snapshots.
+//!
+//! A commit copies only the sections that differ from the current state and
+//! shares the rest with it, so a long history of small edits costs little
+//! more than one document. Once over budget, the oldest states are dropped.
+template <typename T> class SnapshotHistory {
+  static constexpr auto Members = SnapshotSections<T>::members;
+  static constexpr size_t NumMembers =
+      std::tuple_size_v<std::remove_cvref_t<decltype(Members)>>;
+  static constexpr size_t NumSections = NumMembers ? NumMembers : 1;
+
+  template <size_t I, typename D> static auto& section(D& doc) {
+    if constexpr (NumMembers == 0) {
+      return doc;
+    } else {
+      return doc.*std::get<I>(Members);
+    }
+  }
+  template <size_t... I>
+  static auto makeSnapshot(std::index_sequence<I...>)
+      -> std::tuple<std::shared_ptr<const std::remove_cvref_t<
+          decltype(section<I>(std::declval<T&>()))>>...>;
+  using Snapshot =
+      decltype(makeSnapshot(std::make_index_sequence<NumSections>{}));
+
+  template <typename F> static void forEach(F&& f) {
+    [&]<size_t... I>(std::index_sequence<I...>) {
+      (f(std::integral_constant<size_t, I>{}), ...);
+    }(std::make_index_sequence<NumSections>{});
+  }
+
+  //! Heap and inline bytes of a section, ignoring nested allocations.
+  template <typename S> static size_t sizeOf(const S& s) {
+    if constexpr (std::ranges::sized_range<S>) {
+      return sizeof(S) +
+             std::ranges::size(s) * sizeof(std::ranges::range_value_t<S>);
+    } else {
+      return sizeof(S);
+    }
+  }
+
+  struct Entry {
+    Snapshot snapshot;
+    //! Bytes of the sections not shared with the previous entry.
+    size_t bytes;
+  };
+
+public:
+  //! Default budget: a few hundred full copies of a large KMP.
+  static constexpr size_t DefaultBudget = 64 * 1024 * 1024;
+
+  explicit SnapshotHistory(size_t budget = DefaultBudget) : mBudget(budget) {}
+
+  bool empty() const { return mEntries.empty(); }
+  //! Number of states held, including the current one.
+  size_t size() const { return mEntries.size(); }
+  size_t cursor() const { return mCursor; }
+  //! Approximate bytes of the distinct sections held.
+  size_t bytes() const { return mBytes; }
+
+  size_t budget() const { return mBudget; }
+  //! The current state is kept even if larger than |budget|.
+  void setBudget(size_t budget) {
+    mBudget = budget;
+    trim();
+  }
+
+  //! Forget every state and start over from |doc|.
+  void reset(const T& doc) {
+    mEntries.clear();
+    mCursor = 0;
+    mBytes = 0;
+    mLastDirty = 0;
+    push(doc);
+  }
+
+  //! @brief Whether |doc| differs from the current state.
+  //!
+  //! The section that changed last is compared first: while it is being
+  //! edited, the others are skipped.
+  //!
+  bool differs(const T& doc) {
+    assert(!empty());
+    const Snapshot& cur = mEntries[mCursor].snapshot;
+    bool dirty = false;
+    forEach([&](auto i) {
+      if (i == mLastDirty && section<i>(doc) != *std::get<i>(cur)) {
+        dirty = true;
+      }
+    });
+    forEach([&](auto i) {
+      if (!dirty && i != mLastDirty && section<i>(doc) != *std::get<i>(cur)) {
+        dirty = true;
+        mLastDirty = i;
+      }
+    });
+    return dirty;
+  }
+
+  //! Record |doc| as the state after the current one, dropping any states
+  //! that could have been redone.
+  void commit(const T& doc) {
+    assert(!empty());
+    while (mEntries.size() > mCursor + 1) {
+      mBytes -= mEntries.back().bytes;
+      mEntries.pop_back();
+    }
+    push(doc);
+    ++mCursor;
+    trim();
+  }
+
+  //! @brief Step back to the previous state. |doc| must match the current
+  //! state: only the sections that differ between the two are written.
+  //!
+  //! @return False if there is no previous state.
+  //!
+  bool undo(T& doc) {
+    if (mCursor == 0) {
+      return false;
+    }
+    apply(doc, mEntries[mCursor].snapshot, mEntries[mCursor - 1].snapshot);
+    --mCursor;
+    return true;
+  }
+
+  //! As undo(), stepping forward.
+  bool redo(T& doc) {
+    if (mCursor + 1 >= mEntries.size()) {
+      return false;
+    }
+    apply(doc, mEntries[mCursor].snapshot, mEntries[mCursor + 1].snapshot);
+    ++mCursor;
+    return true;
+  }
+
+  //! Write the current state over the sections of |doc| that differ from it.
+  void restore(T& doc) const {
+    assert(!empty());
+    const Snapshot& cur = mEntries[mCursor].snapshot;
+    forEach([&](auto i) {
+      // Not `!=`: a section holding NaN never compares equal
+      if (!(section<i>(doc) == *std::get<i>(cur))) {
+        section<i>(doc) = *std::get<i>(cur);
+      }
+    });
+  }
+
+private:
+  void push(const T& doc) {
+    Entry entry{};
+    const Snapshot* prev =
+        mEntries.empty() ? nullptr : &mEntries[mCursor].snapshot;
+    forEach([&](auto i) {
+      const auto& s = section<i>(doc);
+      if (prev != nullptr && s == *std::get<i>(*prev)) {
+        std::get<i>(entry.snapshot) = std::get<i>(*prev);
+        return;
+      }
+      using S = std::remove_cvref_t<decltype(s)>;
+      std::get<i>(entry.snapshot) = std::make_shared<const S>(s);
+      entry.bytes += sizeOf(s);
+    });
+    mBytes += entry.bytes;
+    mEntries.push_back(std::move(entry));
+  }
+
+  static void apply(T& doc, const Snapshot& from, const Snapshot& to) {
+    forEach([&](auto i) {
+      if (std::get<i>(from) != std::get<i>(to)) {
+        section<i>(doc) = *std::get<i>(to);
+      }
+    });
+  }
+
+  void trim() {
+    while (mBytes > mBudget && mCursor > 0) {
+      // Sections the next entry shares with the oldest now belong to it
+      Entry& next = mEntries[1];
+      const Snapshot& oldest = mEntries.front().snapshot;
+      size_t inherited = 0;
+      forEach([&](auto i) {
+        if (std::get<i>(next.snapshot) == std::get<i>(oldest)) {
+          inherited += sizeOf(*std::get<i>(oldest));
+        }
+      });
+      next.bytes += inherited;
+      mBytes = mBytes + inherited - mEntries.front().bytes;
+      mEntries.pop_front();
+      --mCursor;
+    }
+  }
+
+  std::deque<Entry> mEntries;
+  size_t mCursor = 0;
+  size_t mBytes = 0;
+  size_t mBudget;
+  size_t mLastDirty = 0;
+};
+
+} // namespace rsl
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <bit>
+#include <core/common.h>
+#include <string>
+#include <string_view>
+
+namespace rsl {
+
+//! 128-bit hash for naming on-disk cache entries.
+//!
+//! Two independent 64-bit multiply-rotate lanes over 32-bit words. Unlike
+//! std::hash the result is stable across runs and standard libraries.
+class StableHasher {
+public:
+  void word(u32 w) {
+    a = (a ^ w) * 0x100000001B3ull;
+    b = std::rotl(b ^ w, 27) * 0x9E3779B97F4A7C15ull + 0x52DCE729ull;
+  }
+  //! The length, then the bytes four at a time (little endian).
+  void bytes(std::string_view s) {
+    word(static_cast<u32>(s.size()));
+    for (size_t i = 0; i < s.size(); i += 4) {
+      u32 w = 0;
+      for (size_t j = 0; j < 4 && i + j < s.size(); ++j) {
+        w |= static_cast<u32>(static_cast<u8>(s[i + j])) << (8 * j);
+      }
+      word(w);
+    }
+  }
+
+  std::string hex() const {
+    return std::format("{:016x}{:016x}", fmix(a), fmix(b ^ a));
+  }
+
+private:
+  static u64 fmix(u64 k) {
+    k ^= k >> 33;
+    k *= 0xFF51AFD7ED558CCDull;
+    k ^= k >> 33;
+    k *= 0xC4CEB9FE1A85EC53ull;
+    k ^= k >> 33;
+    return k;
+  }
+
+  u64 a = 0xCBF29CE484222325ull;
+  u64 b = 0x84222325CBF29CE4ull;
+};
+
+} // namespace rsl
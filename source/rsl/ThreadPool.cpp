@@ -0,0 +1,186 @@
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <rsl/Defer.hpp>
+#include <rsl/ParallelFor.hpp>
+
+namespace rsl {
+
+// The pool and queue index of the current worker thread, if any.
+static thread_local ThreadPool* tCurrentPool = nullptr;
+static thread_local unsigned tCurrentIndex = 0;
+// The pool of the task running on this thread, if any.
+static thread_local ThreadPool* tRunningPool = nullptr;
+
+ThreadPool::ThreadPool(unsigned num_threads) {
+  const unsigned n = ResolveThreadCount(num_threads);
+  for (unsigned i = 0; i <= n; ++i) {
+    mQueues.push_back(std::make_unique<Queue>());
+  }
+  for (unsigned i = 0; i < n; ++i) {
+    mWorkers.emplace_back([this, i] { workerMain(i); });
+  }
+}
+
+ThreadPool* ThreadPool::current() { return tRunningPool; }
+
+ThreadPool::~ThreadPool() {
+  {
+    std::unique_lock g(mSleepMutex);
+    mStop = true;
+  }
+  mWake.notify_all();
+  for (auto& t : mWorkers) {
+    t.join();
+  }
+}
+
+void ThreadPool::push(Task&& task) {
+  const bool is_worker = tCurrentPool == this;
+  auto& queue = *mQueues[is_worker ? tCurrentIndex : size()];
+  {
+    // Counted before it is visible so that mQueued never underflows
+    std::unique_lock g(mSleepMutex);
+    ++mQueued;
+  }
+  {
+    std::unique_lock g(queue.mutex);
+    queue.tasks.push_back(std::move(task));
+  }
+  mWake.notify_one();
+}
+
+bool ThreadPool::pop(Task& out, TaskGroup* group) {
+  const bool is_worker = tCurrentPool == this;
+  const unsigned self = is_worker ? tCurrentIndex : size();
+  const auto take = [&](std::deque<Task>& tasks, auto it) {
+    out = std::move(*it);
+    tasks.erase(it);
+    --mQueued;
+    --out.group->mQueued;
+  };
+  const auto matches = [&](const Task& task) {
+    return group == nullptr || task.group == group;
+  };
+  // Newest task of our own queue first: it is the most likely to be cache-warm
+  // and is what a nested wait() is blocked on.
+  {
+    auto& queue = *mQueues[self];
+    std::unique_lock g(queue.mutex);
+    auto it = std::find_if(queue.tasks.rbegin(), queue.tasks.rend(), matches);
+    if (it != queue.tasks.rend()) {
+      take(queue.tasks, std::next(it).base());
+      return true;
+    }
+  }
+  // Otherwise steal the oldest task of another queue
+  const unsigned count = static_cast<unsigned>(mQueues.size());
+  for (unsigned i = 1; i < count; ++i) {
+    auto& queue = *mQueues[(self + i) % count];
+    std::unique_lock g(queue.mutex);
+    auto it = std::find_if(queue.tasks.begin(), queue.tasks.end(), matches);
+    if (it != queue.tasks.end()) {
+      take(queue.tasks, it);
+      return true;
+    }
+  }
+  return false;
+}
+
+bool ThreadPool::runOne() {
+  Task task;
+  if (!pop(task, nullptr)) {
+    return false;
+  }
+  task.group->execute(task);
+  return true;
+}
+
+bool ThreadPool::runOneOf(TaskGroup& group) {
+  Task task;
+  if (!pop(task, &group)) {
+    return false;
+  }
+  task.group->execute(task);
+  return true;
+}
+
+void ThreadPool::workerMain(unsigned index) {
+  tCurrentPool = this;
+  tCurrentIndex = index;
+  while (true) {
+    if (runOne()) {
+      continue;
+    }
+    std::unique_lock g(mSleepMutex);
+    mWake.wait(g, [&] { return mStop || mQueued > 0; });
+    if (mStop && mQueued == 0) {
+      return;
+    }
+  }
+}
+
+TaskGroup::~TaskGroup() {
+  try {
+    wait();
+  } catch (...) {
+  }
+}
+
+void TaskGroup::run(std::function<void()> fn) {
+  ++mPending;
+  ++mTotal;
+  // Counted before it is visible so that mQueued never underflows
+  ++mQueued;
+  mPool.push({.fn = std::move(fn), .group = this});
+  {
+    // A task of ours may be adding more work while wait() sleeps
+    std::unique_lock g(mMutex);
+  }
+  mFinished.notify_all();
+}
+
+void TaskGroup::wait() {
+  while (mPending > 0) {
+    if (mPool.runOneOf(*this)) {
+      continue;
+    }
+    // Our remaining tasks are running elsewhere. Sleep until they finish or
+    // one of them queues more work for this group.
+    std::unique_lock g(mMutex);
+    mFinished.wait(g, [&] { return mPending == 0 || mQueued > 0; });
+  }
+  std::unique_lock g(mMutex);
+  if (mError) {
+    std::rethrow_exception(std::exchange(mError, nullptr));
+  }
+}
+
+void TaskGroup::execute(ThreadPool::Task& task) {
+  if (!mCancelled) {
+    ThreadPool* const outer = std::exchange(tRunningPool, &mPool);
+    RSL_DEFER(tRunningPool = outer);
+    try {
+      task.fn();
+    } catch (...) {
+      std::unique_lock g(mMutex);
+      if (!mError) {
+        mError = std::current_exception();
+      }
+      mCancelled = true;
+    }
+  }
+  task.fn = nullptr;
+
+  std::unique_lock g(mMutex);
+  const size_t done = ++mDone;
+  if (mProgress) {
+    mProgress(done, mTotal);
+  }
+  // The group may be destroyed as soon as mPending reaches zero, so notify
+  // while still holding the lock.
+  --mPending;
+  mFinished.notify_all();
+}
+
+} // namespace rsl
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <core/common.h>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace rsl {
+
+class TaskGroup;
+
+//! Fixed-size pool of worker threads with per-worker work-stealing queues.
+//!
+//! Work is submitted through a TaskGroup. Tasks spawned from a worker go to
+//! that worker's own queue (run LIFO) and idle workers steal from the others
+//! (FIFO), so nested groups stay bounded by the pool size instead of spawning
+//! a thread per task.
+class ThreadPool {
+public:
+  //! |num_threads| = 0 uses one worker per core.
+  explicit ThreadPool(unsigned num_threads = 0);
+  ~ThreadPool();
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  unsigned size() const { return static_cast<unsigned>(mWorkers.size()); }
+
+  //! The pool whose task is running on the calling thread, if any. This
+  //! includes tasks run by TaskGroup::wait() on threads outside the pool.
+  static ThreadPool* current();
+
+private:
+  friend class TaskGroup;
+
+  struct Task {
+    std::function<void()> fn;
+    TaskGroup* group = nullptr;
+  };
+  struct Queue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  void push(Task&& task);
+  //! Run one queued task, if any. Safe to call from any thread.
+  bool runOne();
+  //! Run one queued task of |group|, if any. Safe to call from any thread.
+  bool runOneOf(TaskGroup& group);
+  bool pop(Task& out, TaskGroup* group);
+  void workerMain(unsigned index);
+
+  // One queue per worker, plus one for tasks submitted from other threads.
+  std::vector<std::unique_ptr<Queue>> mQueues;
+  std::vector<std::thread> mWorkers;
+
+  std::mutex mSleepMutex;
+  std::condition_variable mWake;
+  std::atomic<size_t> mQueued = 0;
+  bool mStop = false;
+};
+
+//! A set of tasks on a ThreadPool that can be waited on together.
+//!
+//! wait() runs the group's own queued tasks on the calling thread instead of
+//! blocking, so groups may be nested inside tasks. It never picks up tasks of
+//! other groups, which could outlast this one. Once cancel() is called, tasks
+//! that have not started are skipped; running tasks may poll cancelled(). The
+//! first exception thrown by a task is rethrown by wait().
+class TaskGroup {
+public:
+  //! |progress(done, total)| is called after each task finishes. Calls are
+  //! serialized but may come from any thread.
+  explicit TaskGroup(ThreadPool& pool,
+                     std::function<void(size_t, size_t)> progress = {})
+      : mPool(pool), mProgress(std::move(progress)) {}
+  ~TaskGroup();
+  TaskGroup(const TaskGroup&) = delete;
+  TaskGroup& operator=(const TaskGroup&) = delete;
+
+  void run(std::function<void()> fn);
+  void wait();
+
+  void cancel() { mCancelled = true; }
+  bool cancelled() const { return mCancelled; }
+
+  size_t done() const { return mDone; }
+  size_t total() const { return mTotal; }
+
+private:
+  friend class ThreadPool;
+  void execute(ThreadPool::Task& task);
+
+  ThreadPool& mPool;
+  std::function<void(size_t, size_t)> mProgress;
+
+  std::mutex mMutex;
+  std::condition_variable mFinished;
+  std::atomic<size_t> mPending = 0;
+  // Tasks pushed to the pool but not yet taken by any thread
+  std::atomic<size_t> mQueued = 0;
+  std::atomic<size_t> mDone = 0;
+  std::atomic<size_t> mTotal = 0;
+  std::atomic<bool> mCancelled = false;
+  std::exception_ptr mError;
+};
+
+} // namespace rsl
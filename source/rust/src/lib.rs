@@ -190,6 +190,22 @@ pub struct ImportCommand {
 
     #[clap(short, long, default_value="false")]
     verbose: bool,
+
+    /// Number of threads to use (0 for one per core)
+    #[arg(short, long, default_value = "0")]
+    jobs: u32,
+
+    /// Always rerun triangle stripification instead of reusing cached results
+    #[clap(long, default_value="false")]
+    no_cache: bool,
+
+    /// CMPR texture encoding: fast, normal or high (slowest, best quality)
+    #[arg(long, default_value = "normal", value_parser = ["fast", "normal", "high"])]
+    cmpr_quality: String,
+
+    /// Milliseconds to spend trying stripification algorithms per mesh (0 for no limit)
+    #[arg(long, default_value = "0")]
+    stripify_budget_ms: u32,
 }
 
 /// Decompress a .szs file
@@ -216,6 +232,14 @@ pub struct CompressCommand {
     /// Output file for compressed file (.szs)
     to: Option<String>,
 
+    /// Compression level: store, fast, bmh (Nintendo-like), lazy or ultra (smallest)
+    #[arg(short, long, default_value = "bmh", value_parser = ["store", "fast", "bmh", "lazy", "ultra"])]
+    level: String,
+
+    /// Number of threads to use (0 for one per core)
+    #[arg(short, long, default_value = "0")]
+    jobs: u32,
+
     #[clap(short, long, default_value="false")]
     verbose: bool,
 }
@@ -232,6 +256,22 @@ pub struct Rhst2BrresCommand {
 
     #[clap(short, long, default_value="false")]
     verbose: bool,
+
+    /// Number of threads to use (0 for one per core)
+    #[arg(short, long, default_value = "0")]
+    jobs: u32,
+
+    /// Always rerun triangle stripification instead of reusing cached results
+    #[clap(long, default_value="false")]
+    no_cache: bool,
+
+    /// CMPR texture encoding: fast, normal or high (slowest, best quality)
+    #[arg(long, default_value = "normal", value_parser = ["fast", "normal", "high"])]
+    cmpr_quality: String,
+
+    /// Milliseconds to spend trying stripification algorithms per mesh (0 for no limit)
+    #[arg(long, default_value = "0")]
+    stripify_budget_ms: u32,
 }
 
 /// Convert a .rhst file to a .bmd file
@@ -246,12 +286,28 @@ pub struct Rhst2BmdCommand {
 
     #[clap(short, long, default_value="false")]
     verbose: bool,
+
+    /// Number of threads to use (0 for one per core)
+    #[arg(short, long, default_value = "0")]
+    jobs: u32,
+
+    /// Always rerun triangle stripification instead of reusing cached results
+    #[clap(long, default_value="false")]
+    no_cache: bool,
+
+    /// CMPR texture encoding: fast, normal or high (slowest, best quality)
+    #[arg(long, default_value = "normal", value_parser = ["fast", "normal", "high"])]
+    cmpr_quality: String,
+
+    /// Milliseconds to spend trying stripification algorithms per mesh (0 for no limit)
+    #[arg(long, default_value = "0")]
+    stripify_budget_ms: u32,
 }
 
 /// Extract a .szs file to a folder.
 #[derive(Parser, Debug)]
 pub struct ExtractCommand {
-    /// SZS-compressed ARC file to read
+    /// SZS-compressed ARC file to read (or a folder of them to extract each)
     #[arg(required=true)]
     from: String,
 
@@ -260,6 +316,10 @@ pub struct ExtractCommand {
 
     #[clap(short, long, default_value="false")]
     verbose: bool,
+
+    /// Number of threads to use (0 for one per core)
+    #[arg(short, long, default_value = "0")]
+    jobs: u32,
 }
 
 /// Create a .szs file from a folder.
@@ -274,6 +334,14 @@ pub struct CreateCommand {
 
     #[clap(short, long, default_value="false")]
     verbose: bool,
+
+    /// Compression level: store, fast, bmh (Nintendo-like), lazy or ultra (smallest)
+    #[arg(short, long, default_value = "bmh", value_parser = ["store", "fast", "bmh", "lazy", "ultra"])]
+    level: String,
+
+    /// Number of threads to use (0 for one per core)
+    #[arg(short, long, default_value = "0")]
+    jobs: u32,
 }
 
 #[derive(Subcommand, Debug)]
@@ -327,6 +395,35 @@ pub struct CliOptions {
 
     // TYPE 2: "decompress"
     // Uses "from", "to" and "verbose" above
+
+    // TYPE 3: "compress"
+    pub szs_algo: c_uint,
+    pub jobs: c_uint,
+
+    // TYPE 1, 4, 5: Import
+    pub no_cache: c_uint,
+    pub cmpr_quality: c_uint,
+    pub stripify_budget_ms: c_uint,
+}
+
+fn szs_algo_from_str(level: &str) -> c_uint {
+    match level {
+        "store" => 0,
+        "fast" => 1,
+        "bmh" => 2,
+        "lazy" => 3,
+        "ultra" => 4,
+        _ => 2,
+    }
+}
+
+fn cmpr_quality_from_str(quality: &str) -> c_uint {
+    match quality {
+        "fast" => 0,
+        "normal" => 1,
+        "high" => 2,
+        _ => 1,
+    }
 }
 
 fn is_valid_hexcode(value: String) -> Result<(), String> {
@@ -377,6 +474,11 @@ impl MyArgs {
                     fuse_vertices: i.fuse_vertices as c_uint,
                     no_tristrip: i.no_tristrip as c_uint,
                     ai_json: i.ai_json as c_uint,
+                    szs_algo: 0 as c_uint,
+                    jobs: i.jobs as c_uint,
+                    no_cache: i.no_cache as c_uint,
+                    cmpr_quality: cmpr_quality_from_str(&i.cmpr_quality),
+                    stripify_budget_ms: i.stripify_budget_ms as c_uint,
                     verbose: i.verbose as c_uint,
                 }
             },
@@ -411,6 +513,11 @@ impl MyArgs {
                     fuse_vertices: 0 as c_uint,
                     no_tristrip: 0 as c_uint,
                     ai_json: 0 as c_uint,
+                    szs_algo: 0 as c_uint,
+                    jobs: 0 as c_uint,
+                    no_cache: 0 as c_uint,
+                    cmpr_quality: 1 as c_uint,
+                    stripify_budget_ms: 0 as c_uint,
                 }
             },
             Commands::Compress(i) => {
@@ -444,6 +551,11 @@ impl MyArgs {
                     fuse_vertices: 0 as c_uint,
                     no_tristrip: 0 as c_uint,
                     ai_json: 0 as c_uint,
+                    szs_algo: szs_algo_from_str(&i.level),
+                    jobs: i.jobs as c_uint,
+                    no_cache: 0 as c_uint,
+                    cmpr_quality: 1 as c_uint,
+                    stripify_budget_ms: 0 as c_uint,
                 }
             },
             Commands::Rhst2Brres(i) => {
@@ -477,6 +589,11 @@ impl MyArgs {
                     fuse_vertices: 0 as c_uint,
                     no_tristrip: 0 as c_uint,
                     ai_json: 0 as c_uint,
+                    szs_algo: 0 as c_uint,
+                    jobs: i.jobs as c_uint,
+                    no_cache: i.no_cache as c_uint,
+                    cmpr_quality: cmpr_quality_from_str(&i.cmpr_quality),
+                    stripify_budget_ms: i.stripify_budget_ms as c_uint,
                 }
             },
             Commands::Rhst2Bmd(i) => {
@@ -510,6 +627,11 @@ impl MyArgs {
                     fuse_vertices: 0 as c_uint,
                     no_tristrip: 0 as c_uint,
                     ai_json: 0 as c_uint,
+                    szs_algo: 0 as c_uint,
+                    jobs: i.jobs as c_uint,
+                    no_cache: i.no_cache as c_uint,
+                    cmpr_quality: cmpr_quality_from_str(&i.cmpr_quality),
+                    stripify_budget_ms: i.stripify_budget_ms as c_uint,
                 }
             },
             Commands::Extract(i) => {
@@ -543,6 +665,11 @@ impl MyArgs {
                   fuse_vertices: 0 as c_uint,
                   no_tristrip: 0 as c_uint,
                   ai_json: 0 as c_uint,
+                  szs_algo: 0 as c_uint,
+                  jobs: i.jobs as c_uint,
+                  no_cache: 0 as c_uint,
+                  cmpr_quality: 1 as c_uint,
+                  stripify_budget_ms: 0 as c_uint,
               }
             },
             Commands::Create(i) => {
@@ -576,6 +703,11 @@ impl MyArgs {
                   fuse_vertices: 0 as c_uint,
                   no_tristrip: 0 as c_uint,
                   ai_json: 0 as c_uint,
+                  szs_algo: szs_algo_from_str(&i.level),
+                  jobs: i.jobs as c_uint,
+                  no_cache: 0 as c_uint,
+                  cmpr_quality: 1 as c_uint,
+                  stripify_budget_ms: 0 as c_uint,
               }
           },
         }
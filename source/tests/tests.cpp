@@ -1,11 +1,27 @@
+#include <core/3d/i3dmodel.hpp>
 #include <core/util/oishii.hpp>
 #include <librii/egg/BDOF.hpp>
 #include <librii/egg/Blight.hpp>
 #include <librii/egg/LTEX.hpp>
 #include <librii/egg/PBLM.hpp>
+#include <librii/glhelper/DecodedTextureCache.hpp>
+#include <librii/glhelper/ShaderCache.hpp>
+#include <librii/gpu/DLMesh.hpp>
+#include <librii/image/ImagePlatform.hpp>
+#include <librii/kcol/Encoder.hpp>
+#include <librii/g3d/io/WiiTrig.hpp>
+#include <librii/j3d/BinaryBTK.hpp>
 #include <librii/kmp/io/KMP.hpp>
+#include <librii/math/keyframes.hpp>
+#include <librii/math/util.hpp>
+#include <librii/szs/SZS.hpp>
 #include <plugins/api.hpp>
+#include <plugins/g3d/collection.hpp>
+#include <plugins/gc/Export/Scene.hpp>
 #include <rsl/Ranges.hpp>
+#include <rsl/SnapshotHistory.hpp>
+#include <rsl/Stb.hpp>
+#include <rsl/Timer.hpp>
 #include <vendor/llvm/Support/InitLLVM.h>
 
 IMPORT_STD;
@@ -218,6 +234,1018 @@ void rebuild(std::string from, const std::string_view to, bool check,
            rsl::ToList());
 }
 
+// Time reading the position, normal and UV buffers of every model in a BRRES
+// with one bulk read per buffer (readGenericComponentsArray) and one read per
+// scalar (readGenericComponents), and check both agree.
+void benchRead(const std::string& path, u32 iterations) {
+  // The comparison below needs at least one read of each kind
+  iterations = std::max(iterations, 1u);
+  auto file = OishiiReadFile2(path);
+  if (!file) {
+    fprintf(stderr, "Error: Cannot read %s\n", path.c_str());
+    return;
+  }
+  librii::g3d::BinaryArchive archive;
+  {
+    oishii::BinaryReader reader(*file, path, std::endian::big);
+    kpi::LightIOTransaction transaction;
+    transaction.callback = [](auto...) {};
+    if (auto ok = archive.read(reader, transaction); !ok) {
+      fprintf(stderr, "Error: Cannot parse %s: %s\n", path.c_str(),
+              ok.error().c_str());
+      return;
+    }
+  }
+  const auto bench = [&](const char* name, librii::gx::VertexBufferKind kind,
+                          auto& buffers) {
+    for (auto& buf : buffers) {
+      using T = typename std::decay_t<decltype(buf.mEntries)>::value_type;
+      const auto& q = buf.mQuantize;
+      const auto comps = librii::gx::computeComponentCount(kind, q.mComp);
+      if (!comps) {
+        continue;
+      }
+      // Re-encode the buffer as stored in the file
+      oishii::Writer writer(std::endian::big);
+      for (auto& entry : buf.mEntries) {
+        if (!librii::gx::writeComponents(writer, entry, q.mType, *comps,
+                                         q.divisor)) {
+          fprintf(stderr, "Error: Cannot write %s\n", buf.mName.c_str());
+          return;
+        }
+      }
+      const u32 size = writer.tell();
+      std::vector<u8> bytes = writer.takeBuf();
+      bytes.resize(size);
+      oishii::BinaryReader reader(bytes, path, std::endian::big);
+
+      std::vector<T> bulk(buf.mEntries.size());
+      rsl::Timer timer;
+      for (u32 i = 0; i < iterations; ++i) {
+        reader.seekSet(0);
+        if (!librii::gx::readGenericComponentsArray<T>(
+                reader, q.mType.generic, *comps, bulk, q.divisor)) {
+          fprintf(stderr, "Error: Cannot read %s\n", buf.mName.c_str());
+          return;
+        }
+      }
+      const u32 bulk_ms = timer.elapsed();
+
+      std::vector<T> single(buf.mEntries.size());
+      timer.reset();
+      for (u32 i = 0; i < iterations; ++i) {
+        reader.seekSet(0);
+        for (auto& entry : single) {
+          auto v = librii::gx::readGenericComponents<T>(
+              reader, q.mType.generic, *comps, q.divisor);
+          if (!v) {
+            fprintf(stderr, "Error: Cannot read %s\n", buf.mName.c_str());
+            return;
+          }
+          entry = *v;
+        }
+      }
+      const u32 single_ms = timer.elapsed();
+
+      printf("%s %s: %zu entries of %s, bulk %u ms, per-entry %u ms (%.2fx)"
+             "%s\n",
+             name, buf.mName.c_str(), buf.mEntries.size(),
+             magic_enum::enum_name(q.mType.generic).data(), bulk_ms,
+             single_ms,
+             static_cast<double>(single_ms) / std::max(bulk_ms, 1u),
+             bulk == single ? "" : " MISMATCH");
+    }
+  };
+  for (auto& model : archive.models) {
+    bench("Position", librii::gx::VertexBufferKind::position, model.positions);
+    bench("Normal", librii::gx::VertexBufferKind::normal, model.normals);
+    bench("UV", librii::gx::VertexBufferKind::textureCoordinate,
+          model.texcoords);
+  }
+}
+
+// Time repeated in-memory writes of a file, e.g. a BMD with many vertices to
+// exercise the linker.
+void benchWrite(const std::string& path, u32 iterations) {
+  auto result = open(path);
+  if (!result) {
+    fprintf(stderr, "Error: Cannot read %s\n", path.c_str());
+    return;
+  }
+  auto& root = *result->first;
+  rsl::Timer timer;
+  for (u32 i = 0; i < iterations; ++i) {
+    oishii::Writer writer(std::endian::big);
+    auto ok = SpawnExporter(root)->write_(root, writer);
+    if (!ok) {
+      fprintf(stderr, "Error writing file: %s\n", ok.error().c_str());
+      return;
+    }
+  }
+  const u32 ms = timer.elapsed();
+  printf("%s: %u writes in %u ms (%.3f ms/write)\n", path.c_str(), iterations,
+         ms, static_cast<double>(ms) / std::max(iterations, 1u));
+}
+
+// Decode a YAZ0 file (compressing it first if needed) in one shot, then
+// through a StreamDecoder in chunks of several sizes, and check they agree.
+void benchSzs(const std::string& path, u32 iterations) {
+  // The comparison below needs at least one decode of each kind
+  iterations = std::max(iterations, 1u);
+  auto buf = OishiiReadFile2(path);
+  if (!buf) {
+    fprintf(stderr, "Error: Cannot read %s\n", path.c_str());
+    return;
+  }
+  std::vector<u8> src(buf->begin(), buf->end());
+  if (!librii::szs::getExpandedSize(src)) {
+    auto encoded =
+        librii::szs::encodeAlgo(src, librii::szs::Algo::BoyerMooreHorspool);
+    if (!encoded) {
+      fprintf(stderr, "Error encoding file: %s\n", encoded.error().c_str());
+      return;
+    }
+    src = std::move(*encoded);
+  }
+  std::vector<u8> expected(*librii::szs::getExpandedSize(src));
+  rsl::Timer timer;
+  for (u32 i = 0; i < iterations; ++i) {
+    auto ok = librii::szs::decode(expected, src);
+    if (!ok) {
+      fprintf(stderr, "Error decoding file: %s\n", ok.error().c_str());
+      return;
+    }
+  }
+  const u32 decode_ms = timer.elapsed();
+  printf("%s: %zu -> %zu bytes\n", path.c_str(), src.size(), expected.size());
+  printf("One shot: %.3f ms\n", static_cast<double>(decode_ms) / iterations);
+  // Odd sizes split backreferences across calls
+  for (u32 chunk : {1u, 7u, 4093u, 0x10000u}) {
+    std::vector<u8> out(expected.size());
+    std::vector<u8> tmp(chunk);
+    bool ok = true;
+    timer.reset();
+    for (u32 i = 0; i < iterations && ok; ++i) {
+      auto dec = librii::szs::StreamDecoder::create(src);
+      ok = dec.has_value();
+      while (ok && !dec->done()) {
+        const auto pos = dec->position();
+        auto n = dec->read(tmp);
+        ok = n.has_value() && *n > 0;
+        if (ok) {
+          std::copy_n(tmp.begin(), *n, out.begin() + pos);
+        }
+      }
+    }
+    const u32 ms = timer.elapsed();
+    printf("Stream (%u byte chunks): %.3f ms, %s\n", chunk,
+           static_cast<double>(ms) / iterations,
+           ok && out == expected ? "identical" : "MISMATCH");
+  }
+}
+
+// Re-encode the triangles of a KCL file and check the octree of both the
+// original and the result.
+void benchKcl(const std::string& path, u32 iterations) {
+  auto buf = OishiiReadFile2(path);
+  if (!buf) {
+    fprintf(stderr, "Error: Cannot read %s\n", path.c_str());
+    return;
+  }
+  librii::kcol::KCollisionData kcl;
+  auto err = librii::kcol::ReadKCollisionData(kcl, *buf, buf->size());
+  if (!err.empty()) {
+    fprintf(stderr, "Error: %s\n", err.c_str());
+    return;
+  }
+  err = librii::kcol::ValidateKCollisionBlocks(kcl);
+  printf("Original: %zu prisms, %zu bytes of blocks (%s)\n",
+         kcl.prism_data.size(), kcl.block_data.size(),
+         err.empty() ? "valid" : err.c_str());
+
+  const auto tris = librii::kcol::ToTriangles(kcl);
+  Result<librii::kcol::KCollisionData> encoded;
+  rsl::Timer timer;
+  for (u32 i = 0; i < iterations; ++i) {
+    encoded = librii::kcol::EncodeKCollisionData(tris);
+    if (!encoded) {
+      fprintf(stderr, "Error encoding file: %s\n", encoded.error().c_str());
+      return;
+    }
+  }
+  const u32 ms = timer.elapsed();
+  err = librii::kcol::ValidateKCollisionBlocks(*encoded);
+  printf("Encoded: %zu prisms, %zu bytes of blocks (%s)\n",
+         encoded->prism_data.size(), encoded->block_data.size(),
+         err.empty() ? "valid" : err.c_str());
+  printf("%s: %u encodes in %u ms (%.3f ms/encode)\n", path.c_str(),
+         iterations, ms, static_cast<double>(ms) / std::max(iterations, 1u));
+}
+
+// Encode every PNG in a folder as CMPR at each quality, reporting throughput
+// and the PSNR of the opaque pixels as the hardware would decode them.
+void benchCmpr(const std::string& folder, u32 iterations) {
+  using librii::image::CmprQuality;
+  struct Image {
+    std::string path;
+    rsl::stb::ImageResult image;
+  };
+  std::vector<Image> images;
+  for (auto& it : std::filesystem::directory_iterator(folder)) {
+    if (it.path().extension() != ".png") {
+      continue;
+    }
+    auto image = rsl::stb::load(it.path().string());
+    if (!image) {
+      fprintf(stderr, "Error: Cannot read %s: %s\n",
+              it.path().string().c_str(), image.error().c_str());
+      continue;
+    }
+    images.push_back({it.path().filename().string(), std::move(*image)});
+  }
+  for (auto quality : {CmprQuality::Fast, CmprQuality::Normal,
+                       CmprQuality::High}) {
+    const auto name = magic_enum::enum_name(quality);
+    u64 bytes = 0;
+    u32 ms = 0;
+    for (auto& [path, image] : images) {
+      const u32 w = image.width, h = image.height;
+      std::vector<u8> encoded(librii::image::getEncodedSize(
+          w, h, librii::gx::TextureFormat::CMPR));
+      rsl::Timer timer;
+      for (u32 i = 0; i < iterations; ++i) {
+        librii::image::EncodeDXT1(encoded.data(), image.data.data(), w, h,
+                                  quality);
+      }
+      ms += timer.elapsed();
+      bytes += static_cast<u64>(w) * h * 4 * iterations;
+
+      // The decoder writes whole blocks
+      const u32 bw = roundUp(w, 8), bh = roundUp(h, 8);
+      std::vector<u8> decoded(bw * bh * 4);
+      librii::image::decode(decoded.data(), encoded.data(), bw, bh,
+                            librii::gx::TextureFormat::CMPR);
+      double sse = 0.0;
+      u64 samples = 0;
+      for (u32 y = 0; y < h; ++y) {
+        for (u32 x = 0; x < w; ++x) {
+          const u8* src = &image.data[(y * w + x) * 4];
+          const u8* dst = &decoded[(y * bw + x) * 4];
+          if (src[3] < 0x80) {
+            continue;
+          }
+          for (int c = 0; c < 3; ++c) {
+            const double d = static_cast<double>(src[c]) - dst[c];
+            sse += d * d;
+          }
+          samples += 3;
+        }
+      }
+      const double psnr =
+          sse == 0.0 ? 99.0
+                     : 10.0 * std::log10(255.0 * 255.0 * samples / sse);
+      printf("%s: %s %ux%u PSNR %.2f dB\n", name.data(), path.c_str(), w, h,
+             psnr);
+    }
+    printf("%s: %zu images in %u ms (%.2f MB/s)\n", name.data(),
+           images.size(), ms,
+           static_cast<double>(bytes) / (1024.0 * 1024.0) /
+               (std::max(ms, 1u) / 1000.0));
+  }
+}
+
+// Quantize and encode every PNG in a folder to each palette format and palette
+// entry format, with and without dithering. Report the size against direct
+// color, the PSNR after decoding and throughput.
+void benchPalette(const std::string& folder, u32 iterations) {
+  using librii::gx::PaletteFormat;
+  using librii::gx::TextureFormat;
+  iterations = std::max(iterations, 1u);
+  struct Image {
+    std::string path;
+    rsl::stb::ImageResult image;
+  };
+  std::vector<Image> images;
+  for (auto& it : std::filesystem::directory_iterator(folder)) {
+    if (it.path().extension() != ".png") {
+      continue;
+    }
+    auto image = rsl::stb::load(it.path().string());
+    if (!image) {
+      fprintf(stderr, "Error: Cannot read %s: %s\n",
+              it.path().string().c_str(), image.error().c_str());
+      continue;
+    }
+    images.push_back({it.path().filename().string(), std::move(*image)});
+  }
+  for (auto format : {TextureFormat::C4, TextureFormat::C8,
+                      TextureFormat::C14X2}) {
+    // The decoder works on whole blocks
+    const u32 block_w = format == TextureFormat::C14X2 ? 4 : 8;
+    const u32 block_h = format == TextureFormat::C4 ? 8 : 4;
+    for (auto tlut_format : {PaletteFormat::IA8, PaletteFormat::RGB565,
+                             PaletteFormat::RGB5A3}) {
+      const int channels = tlut_format == PaletteFormat::RGB565 ? 3 : 4;
+      for (bool dither : {false, true}) {
+        const auto name =
+            std::format("{}/{}{}", magic_enum::enum_name(format),
+                        magic_enum::enum_name(tlut_format),
+                        dither ? " (dither)" : "");
+        u64 bytes = 0;
+        u32 ms = 0;
+        for (auto& [path, image] : images) {
+          const u32 w = image.width, h = image.height;
+          const u32 bw = roundUp(w, block_w), bh = roundUp(h, block_h);
+          std::vector<u8> encoded(
+              librii::image::getEncodedSize(bw, bh, format));
+          std::vector<u8> tlut;
+          rsl::Timer timer;
+          for (u32 i = 0; i < iterations; ++i) {
+            tlut = librii::image::QuantizePalette(
+                image.data, librii::image::getPaletteSize(format),
+                tlut_format);
+            librii::image::EncodePalette(encoded.data(), image.data.data(), w,
+                                         h, format, tlut, tlut_format, dither);
+          }
+          ms += timer.elapsed();
+          bytes += static_cast<u64>(w) * h * 4 * iterations;
+
+          // The decoder looks up any index the format can hold
+          std::vector<u8> full_tlut(librii::image::getPaletteSize(format) * 2);
+          std::ranges::copy(tlut, full_tlut.begin());
+          std::vector<u8> decoded(bw * bh * 4);
+          librii::image::decode(decoded.data(), encoded.data(), bw, bh, format,
+                                full_tlut.data(), tlut_format);
+          double sse = 0.0;
+          for (u32 y = 0; y < h; ++y) {
+            for (u32 x = 0; x < w; ++x) {
+              const u8* src = &image.data[(y * w + x) * 4];
+              const u8* dst = &decoded[(y * bw + x) * 4];
+              for (int c = 0; c < channels; ++c) {
+                const double d = static_cast<double>(src[c]) - dst[c];
+                sse += d * d;
+              }
+            }
+          }
+          const double samples = static_cast<double>(w) * h * channels;
+          const double psnr =
+              sse == 0.0 ? 99.0
+                         : 10.0 * std::log10(255.0 * 255.0 * samples / sse);
+          printf("%s: %s %ux%u %zu colors, %d + %zu bytes (RGB5A3: %d, "
+                 "RGBA8: %d), PSNR %.2f dB\n",
+                 name.c_str(), path.c_str(), w, h, tlut.size() / 2,
+                 librii::image::getEncodedSize(w, h, format), tlut.size(),
+                 librii::image::getEncodedSize(w, h, TextureFormat::RGB5A3),
+                 librii::image::getEncodedSize(w, h, TextureFormat::RGBA8),
+                 psnr);
+        }
+        printf("%s: %zu images in %u ms (%.2f MB/s)\n", name.c_str(),
+               images.size(), ms,
+               static_cast<double>(bytes) / (1024.0 * 1024.0) /
+                   (std::max(ms, 1u) / 1000.0));
+      }
+    }
+  }
+}
+
+// Generate and encode a 1024x1024 mip chain from |path|.
+void benchMip(const std::string& path, u32 iterations) {
+  using librii::image::MipFilter;
+  auto image = rsl::stb::load(path);
+  if (!image) {
+    fprintf(stderr, "Error: Cannot read %s: %s\n", path.c_str(),
+            image.error().c_str());
+    return;
+  }
+  const int dim = 1024;
+  const u32 num_mip = 6;
+  u32 size = 0;
+  for (u32 i = 0; i <= num_mip; ++i) {
+    size += (dim >> i) * (dim >> i) * 4;
+  }
+  std::vector<u8> chain(size);
+  for (auto filter : {MipFilter::Box, MipFilter::Resample}) {
+    rsl::Timer timer;
+    for (u32 i = 0; i < iterations; ++i) {
+      librii::image::generateMipChain(chain, dim, dim, num_mip, image->data,
+                                      image->width, image->height,
+                                      librii::image::ResizingAlgorithm::Lanczos,
+                                      filter);
+    }
+    printf("Generate (%s): %u levels in %.2f ms\n",
+           magic_enum::enum_name(filter).data(), num_mip + 1,
+           static_cast<double>(timer.elapsed()) / iterations);
+  }
+  for (auto format : {librii::gx::TextureFormat::CMPR,
+                      librii::gx::TextureFormat::RGB5A3}) {
+    std::vector<u8> encoded(
+        librii::image::getEncodedSize(dim, dim, format, num_mip));
+    rsl::Timer timer;
+    for (u32 i = 0; i < iterations; ++i) {
+      auto ok = librii::image::transform(
+          encoded, dim, dim, librii::gx::TextureFormat::Extension_RawRGBA32,
+          format, chain, dim, dim, num_mip);
+      if (!ok) {
+        fprintf(stderr, "Error: %s\n", ok.error().c_str());
+        return;
+      }
+    }
+    printf("Encode (%s): %u levels in %.2f ms\n",
+           magic_enum::enum_name(format).data(), num_mip + 1,
+           static_cast<double>(timer.elapsed()) / iterations);
+  }
+}
+
+// Decode every texture of a scene on the calling thread, then through a
+// DecodedTextureCache, and check the results agree.
+void benchDecode(const std::string& path, u32 iterations) {
+  auto result = open(path);
+  if (!result) {
+    fprintf(stderr, "Error: Cannot read %s\n", path.c_str());
+    return;
+  }
+  auto* scene = dynamic_cast<riistudio::lib3d::Scene*>(result->first.get());
+  if (scene == nullptr) {
+    fprintf(stderr, "Error: %s has no textures\n", path.c_str());
+    return;
+  }
+  std::vector<std::vector<u8>> expected;
+  rsl::Timer timer;
+  for (u32 i = 0; i < iterations; ++i) {
+    expected.clear();
+    for (auto& tex : scene->getTextures()) {
+      auto& buf = expected.emplace_back();
+      if (tex.decode(buf, true)) {
+        buf.resize(tex.getDecodedSize(true));
+      } else {
+        buf.clear();
+      }
+    }
+  }
+  const u32 sync_ms = timer.elapsed();
+
+  u32 mismatches = 0;
+  timer.reset();
+  for (u32 i = 0; i < iterations; ++i) {
+    librii::glhelper::DecodedTextureCache cache;
+    for (auto& tex : scene->getTextures()) {
+      (void)cache.request(tex, true);
+    }
+    cache.wait();
+    size_t j = 0;
+    for (auto& tex : scene->getTextures()) {
+      auto image = cache.request(tex, true);
+      const auto& want = expected[j++];
+      if (image ? *image == nullptr || **image != want : !want.empty()) {
+        ++mismatches;
+      }
+    }
+  }
+  const u32 cache_ms = timer.elapsed();
+  printf("%s: %zu textures, %.2f ms/iteration on one thread, %.2f ms through "
+         "the cache, %u mismatches\n",
+         path.c_str(), expected.size(),
+         static_cast<double>(sync_ms) / iterations,
+         static_cast<double>(cache_ms) / iterations, mismatches);
+}
+
+// Make |edits| small edits to a KMP, recording each in an undo history, and
+// compare against the full deep copy and compare per frame it replaces.
+void benchHistory(const std::string& path, u32 edits) {
+  auto file = OishiiReadFile2(path);
+  if (!file) {
+    fprintf(stderr, "Error: Cannot read %s\n", path.c_str());
+    return;
+  }
+  auto map = librii::kmp::readKMP(*file);
+  if (!map) {
+    fprintf(stderr, "Failed to read kmp: %s\n", map.error().c_str());
+    return;
+  }
+  if (map->mGeoObjs.empty() && map->mAreas.empty() &&
+      map->mRespawnPoints.empty()) {
+    fprintf(stderr, "Error: %s has nothing to edit\n", path.c_str());
+    return;
+  }
+  rsl::SnapshotHistory<librii::kmp::CourseMap> history(
+      std::numeric_limits<size_t>::max());
+  history.reset(*map);
+  const size_t full_bytes = history.bytes();
+
+  // What the history used to do every frame, for comparison
+  const librii::kmp::CourseMap copy = *map;
+  rsl::Timer timer;
+  u32 equal = 0;
+  for (u32 i = 0; i < 1000; ++i) {
+    equal += *map == *map && !(*map != copy);
+  }
+  const double deep_us = timer.elapsed() * 1000.0 / 1000;
+  timer.reset();
+  for (u32 i = 0; i < 1000; ++i) {
+    equal += !history.differs(*map);
+  }
+  const double clean_us = timer.elapsed() * 1000.0 / 1000;
+
+  // The last states, to check undo against
+  constexpr u32 NumChecked = 64;
+  std::deque<librii::kmp::CourseMap> recent;
+  u32 seed = 1;
+  timer.reset();
+  for (u32 i = 0; i < edits; ++i) {
+    seed = seed * 1103515245 + 12345;
+    const u32 r = seed >> 8;
+    // Drag an object, respawn point or area around
+    for (u32 j = 0; j < 3; ++j) {
+      const u32 k = (r + j) % 3;
+      if (k == 0 && !map->mGeoObjs.empty()) {
+        map->mGeoObjs[r % map->mGeoObjs.size()].position.x += 1.0f;
+      } else if (k == 1 && !map->mRespawnPoints.empty()) {
+        map->mRespawnPoints[r % map->mRespawnPoints.size()].position.x += 1.0f;
+      } else if (k == 2 && !map->mAreas.empty()) {
+        map->mAreas[r % map->mAreas.size()].mModel.mPosition.x += 1.0f;
+      } else {
+        continue;
+      }
+      break;
+    }
+    if (history.differs(*map)) {
+      history.commit(*map);
+    }
+    if (edits - i <= NumChecked) {
+      recent.push_back(*map);
+    }
+  }
+  const u32 edit_ms = timer.elapsed();
+
+  u32 mismatches = 0;
+  for (u32 i = recent.size(); i-- > 1;) {
+    history.undo(*map);
+    mismatches += *map != recent[i - 1];
+  }
+  while (history.redo(*map)) {
+  }
+  mismatches += *map != recent.back();
+
+  printf("%s: %u edits in %u ms, %zu states\n", path.c_str(), edits, edit_ms,
+         history.size());
+  printf("Memory: %.2f MiB shared vs %.2f MiB as full copies\n",
+         history.bytes() / (1024.0 * 1024.0),
+         full_bytes * static_cast<double>(history.size()) /
+             (1024.0 * 1024.0));
+  printf("Unchanged frame: %.2f us vs %.2f us with deep compares\n",
+         clean_us, deep_us);
+  printf("%u mismatches\n", mismatches + (equal != 2000));
+}
+
+struct BenchBone {
+  librii::math::SRT3 srt;
+  s32 parent;
+  bool ssc;
+};
+librii::math::SRT3 getSrt(const BenchBone& bone) { return bone.srt; }
+s32 parentOf(const BenchBone& bone) { return bone.parent; }
+bool ssc(const BenchBone& bone) { return bone.ssc; }
+
+// Compute every bone matrix of each model by walking each bone's chain, then
+// parent-first, and check the results agree.
+void benchSkeleton(const std::string& path, u32 iterations) {
+  auto result = open(path);
+  if (!result) {
+    fprintf(stderr, "Error: Cannot read %s\n", path.c_str());
+    return;
+  }
+  auto* scene = dynamic_cast<libcube::Scene*>(result->first.get());
+  if (scene == nullptr) {
+    fprintf(stderr, "Error: %s has no models\n", path.c_str());
+    return;
+  }
+  constexpr auto Rule = librii::g3d::ScalingRule::Maya;
+  u32 model_id = 0;
+  for (auto& model : scene->getModels()) {
+    std::vector<BenchBone> bones;
+    for (auto& bone : model.getBones()) {
+      bones.push_back({.srt = bone.getSRT(),
+                       .parent = static_cast<s32>(bone.getBoneParent()),
+                       .ssc = bone.getSSC()});
+    }
+    std::vector<glm::mat4> expected;
+    rsl::Timer timer;
+    for (u32 i = 0; i < iterations; ++i) {
+      expected.clear();
+      for (auto& bone : bones) {
+        expected.push_back(librii::g3d::calcSrtMtx(bone, bones, Rule));
+      }
+    }
+    const u32 chain_ms = timer.elapsed();
+    std::vector<glm::mat4> matrices;
+    timer.reset();
+    for (u32 i = 0; i < iterations; ++i) {
+      matrices = librii::g3d::calcSrtMtxAll(bones, Rule);
+    }
+    const u32 all_ms = timer.elapsed();
+    printf("Model %u: %zu bones, %.3f ms per chain, %.3f ms parent-first, "
+           "%s\n",
+           model_id++, bones.size(),
+           static_cast<double>(chain_ms) / iterations,
+           static_cast<double>(all_ms) / iterations,
+           matrices == expected ? "identical" : "MISMATCH");
+  }
+}
+
+// The per-key scan the SRT0 curve editor used, for reference.
+static f32 sampleByScan(std::span<const librii::math::HermiteKey> keys,
+                        f32 frame, librii::math::Extrapolation extrapolation) {
+  if (keys.empty())
+    return 0.0f;
+  const bool linear = extrapolation == librii::math::Extrapolation::Linear;
+  if (frame < keys[0].frame)
+    return keys[0].value +
+           (frame - keys[0].frame) * (linear ? keys[0].tangentIn : 0.0f);
+  for (size_t i = 1; i < keys.size(); ++i) {
+    const auto& l = keys[i - 1];
+    const auto& r = keys[i];
+    if (frame >= l.frame && frame <= r.frame && l.frame < r.frame)
+      return librii::math::hermite(frame, l.frame, l.value, l.tangentOut,
+                                   r.frame, r.value, r.tangentIn);
+  }
+  return keys.back().value + (frame - keys.back().frame) *
+                                 (linear ? keys.back().tangentOut : 0.0f);
+}
+
+// Sample the SRT0 (.brres) or BTK (.btk) tracks of a file, plus random
+// tracks, key by key and through a KeyframeSampler, and compare.
+void benchAnim(const std::string& path, u32 iterations) {
+  using librii::math::Extrapolation;
+  using librii::math::HermiteKey;
+  struct Track {
+    std::vector<HermiteKey> keys;
+    Extrapolation extrapolation;
+  };
+  std::vector<Track> tracks;
+  auto add = [&](auto&& keys, Extrapolation extrapolation) {
+    auto& track = tracks.emplace_back(Track{{}, extrapolation});
+    for (auto& key : keys) {
+      track.keys.push_back(toHermiteKey(key));
+    }
+  };
+  f32 duration = 0.0f;
+  if (path.ends_with(".btk")) {
+    librii::j3d::BinaryBTK btk;
+    if (auto ok = btk.loadFromFile(path); !ok) {
+      fprintf(stderr, "Error: %s\n", ok.error().c_str());
+      return;
+    }
+    for (auto& m : btk.matrices) {
+      for (auto* t : {&m.scales_x, &m.scales_y, &m.scales_z, &m.rotations_x,
+                      &m.rotations_y, &m.rotations_z, &m.translations_x,
+                      &m.translations_y, &m.translations_z}) {
+        add(*t, Extrapolation::Clamp);
+      }
+    }
+  } else if (auto result = open(path)) {
+    if (auto* g3d =
+            dynamic_cast<riistudio::g3d::Collection*>(result->first.get())) {
+      for (auto& srt : g3d->getAnim_Srts()) {
+        duration = std::max<f32>(duration, srt.frameDuration);
+        for (auto& m : srt.matrices) {
+          for (size_t i = 0; i < 5; ++i) {
+            add(m.matrix.subtrack(i), Extrapolation::Linear);
+          }
+        }
+      }
+    }
+  }
+  const size_t num_file_tracks = tracks.size();
+
+  // Random curves, and CLR0-like tracks of one value per frame
+  u32 seed = 1;
+  auto rand = [&](f32 range) {
+    seed = seed * 1103515245 + 12345;
+    return static_cast<f32>((seed >> 8) & 0xffff) / 0xffff * range;
+  };
+  for (u32 i = 0; i < 256; ++i) {
+    auto& track = tracks.emplace_back();
+    track.extrapolation = i % 2 ? Extrapolation::Linear : Extrapolation::Clamp;
+    f32 frame = rand(10.0f);
+    for (u32 k = 0, n = i % 16 + 1; k < n; ++k) {
+      track.keys.push_back({.frame = frame,
+                            .value = rand(200.0f) - 100.0f,
+                            .tangentIn = rand(20.0f) - 10.0f,
+                            .tangentOut = rand(20.0f) - 10.0f});
+      frame += 1.0f + rand(20.0f);
+    }
+    duration = std::max(duration, frame);
+  }
+  std::vector<std::vector<f32>> sampled(64);
+  for (auto& values : sampled) {
+    for (u32 k = 0; k < 60; ++k) {
+      values.push_back(static_cast<f32>(static_cast<u8>(rand(255.0f))));
+    }
+  }
+
+  librii::math::KeyframeSampler sampler;
+  for (auto& track : tracks) {
+    sampler.addTrack(track.keys, track.extrapolation);
+  }
+  for (auto& values : sampled) {
+    sampler.addSampledTrack(values);
+  }
+
+  // Accuracy: against the scan at every quarter frame, and between the ways
+  // of sampling
+  const u32 num_frames = static_cast<u32>((duration + 8.0f) * 4.0f);
+  auto frameAt = [](u32 i) { return -4.0f + static_cast<f32>(i) * 0.25f; };
+  std::vector<f32> out(sampler.size());
+  std::vector<std::vector<f32>> baked(sampler.size());
+  for (u32 t = 0; t < sampler.size(); ++t) {
+    baked[t].resize(num_frames);
+    sampler.bake(t, frameAt(0), 0.25f, baked[t]);
+  }
+  f32 max_error = 0.0f;
+  u32 mismatches = 0;
+  for (u32 i = 0; i < num_frames; ++i) {
+    const f32 frame = frameAt(i);
+    sampler.sample(frame, out);
+    for (u32 t = 0; t < sampler.size(); ++t) {
+      f32 expected, exact;
+      if (t < tracks.size()) {
+        expected = sampleByScan(tracks[t].keys, frame, tracks[t].extrapolation);
+        exact = librii::math::KeyframeSampler::sampleOnce(
+            tracks[t].keys, frame, tracks[t].extrapolation);
+      } else {
+        const auto& values = sampled[t - tracks.size()];
+        const f32 f = std::clamp(frame, 0.0f, values.size() - 1.0f);
+        const size_t k = std::min<size_t>(f, values.size() - 2);
+        expected = values[k] + (values[k + 1] - values[k]) * (f - k);
+        exact = out[t];
+      }
+      max_error = std::max(max_error, std::abs(out[t] - expected) /
+                                          std::max(1.0f, std::abs(expected)));
+      mismatches += out[t] != exact || baked[t][i] != exact;
+    }
+  }
+
+  // Throughput: the whole set at each frame, played forward
+  rsl::Timer timer;
+  f32 sink = 0.0f;
+  for (u32 it = 0; it < iterations; ++it) {
+    for (u32 i = 0; i < num_frames; ++i) {
+      for (auto& track : tracks) {
+        sink += sampleByScan(track.keys, frameAt(i), track.extrapolation);
+      }
+    }
+  }
+  const u32 scan_ms = timer.elapsed();
+  timer.reset();
+  for (u32 it = 0; it < iterations; ++it) {
+    for (u32 i = 0; i < num_frames; ++i) {
+      sampler.sample(frameAt(i), out);
+      sink += out[0];
+    }
+  }
+  const u32 batch_ms = timer.elapsed();
+  const double samples = static_cast<double>(iterations) * num_frames;
+  printf("%s: %zu tracks (%zu from the file), %u frames\n", path.c_str(),
+         tracks.size(), num_file_tracks, num_frames);
+  printf("Key scan: %.1f M samples/s, sampler: %.1f M samples/s (%g)\n",
+         samples * tracks.size() / std::max(scan_ms, 1u) / 1000.0,
+         samples * sampler.size() / std::max(batch_ms, 1u) / 1000.0,
+         sink != 0.0f ? 1.0 : 0.0);
+  printf("Max relative error %g, %u mismatches\n", max_error, mismatches);
+}
+
+// The display list decoder J3D used, for reference.
+static Result<void>
+decodeDLReference(oishii::BinaryReader& reader, u32 start, u32 size,
+                  std::vector<librii::gx::IndexedPrimitive>& out,
+                  const librii::gx::VertexDescriptor& descriptor,
+                  std::map<librii::gx::VertexBufferAttribute, u32>& usage) {
+  using namespace librii;
+  constexpr auto BE = oishii::EndianSelect::Big;
+  oishii::Jump<oishii::Whence::Set> g(reader, start);
+  const u32 end = reader.tell() + size;
+  while (reader.tell() < end) {
+    const u8 tag = TRY(reader.tryRead<u8, BE, true>());
+    if (tag == 0)
+      continue;
+    EXPECT((tag & 0x80) != 0);
+    u16 nVerts = TRY(reader.tryRead<u16, BE, true>());
+    auto& prim =
+        out.emplace_back(gx::DecodeDrawPrimitiveCommand(tag), nVerts);
+    for (u16 vi = 0; vi < nVerts; ++vi) {
+      for (int a = 0; a < (int)gx::VertexAttribute::Max; ++a) {
+        if ((descriptor.mBitfield & (1 << a)) == 0)
+          continue;
+        const auto attr = static_cast<gx::VertexAttribute>(a);
+        u16 val = 0;
+        switch (descriptor.mAttributes.at(attr)) {
+        case gx::VertexAttributeType::None:
+          break;
+        case gx::VertexAttributeType::Direct:
+          EXPECT(attr == gx::VertexAttribute::PositionNormalMatrixIndex ||
+                 gx::IsTexNMtxIdx(attr));
+          [[fallthrough]];
+        case gx::VertexAttributeType::Byte:
+          val = TRY(reader.tryRead<u8, BE, true>());
+          EXPECT(val != 0xff);
+          break;
+        case gx::VertexAttributeType::Short:
+          val = TRY(reader.tryRead<u16, BE, true>());
+          EXPECT(val != 0xffff);
+          break;
+        }
+        prim.mVertices[vi][attr] = val;
+        if (attr != gx::VertexAttribute::PositionNormalMatrixIndex &&
+            !gx::IsTexNMtxIdx(attr)) {
+          auto& m = usage[static_cast<gx::VertexBufferAttribute>(a)];
+          m = std::max<u32>(m, val);
+        }
+      }
+    }
+  }
+  return {};
+}
+
+// Encode the primitives of every polygon of a scene as display lists, then
+// decode them with the reference decoder and with librii::gpu's, one list
+// at a time and in parallel, and check the results agree.
+void benchDisplayList(const std::string& path, u32 iterations) {
+  using namespace librii;
+  auto result = open(path);
+  if (!result) {
+    fprintf(stderr, "Error: Cannot read %s\n", path.c_str());
+    return;
+  }
+  auto* scene = dynamic_cast<libcube::Scene*>(result->first.get());
+  if (scene == nullptr) {
+    fprintf(stderr, "Error: %s has no models\n", path.c_str());
+    return;
+  }
+  struct List {
+    u32 start;
+    u32 size;
+    const gx::VertexDescriptor* descriptor;
+  };
+  oishii::Writer writer(std::endian::big);
+  std::vector<List> lists;
+  for (auto& model : scene->getModels()) {
+    for (auto& poly : model.getMeshes()) {
+      const auto& mesh = poly.getMeshData();
+      const auto& desc = mesh.mVertexDescriptor;
+      for (const auto& mp : mesh.mMatrixPrimitives) {
+        const u32 start = writer.tell();
+        for (const auto& prim : mp.mPrimitives) {
+          writer.writeUnaligned<u8>(
+              gx::EncodeDrawPrimitiveCommand(prim.mType));
+          writer.writeUnaligned<u16>(prim.mVertices.size());
+          for (const auto& v : prim.mVertices) {
+            for (auto [attr, type] : desc.mAttributes) {
+              if (!desc[attr])
+                continue;
+              if (type == gx::VertexAttributeType::Short)
+                writer.writeUnaligned<u16>(v[attr]);
+              else if (type != gx::VertexAttributeType::None)
+                writer.writeUnaligned<u8>(v[attr]);
+            }
+          }
+        }
+        while (writer.tell() % 32)
+          writer.write<u8>(0);
+        lists.push_back({start, writer.tell() - start, &desc});
+      }
+    }
+  }
+  const u32 size = writer.tell();
+  std::vector<u8> bytes = writer.takeBuf();
+  bytes.resize(size);
+  oishii::BinaryReader reader(bytes, path, std::endian::big);
+
+  std::vector<std::vector<gx::IndexedPrimitive>> ref_prims(lists.size());
+  std::map<gx::VertexBufferAttribute, u32> ref_usage;
+  std::vector<bool> ref_ok(lists.size());
+  rsl::Timer timer;
+  for (u32 it = 0; it < iterations; ++it) {
+    for (size_t i = 0; i < lists.size(); ++i) {
+      ref_prims[i].clear();
+      ref_ok[i] = decodeDLReference(reader, lists[i].start, lists[i].size,
+                                    ref_prims[i], *lists[i].descriptor,
+                                    ref_usage)
+                      .has_value();
+    }
+  }
+  const u32 ref_ms = timer.elapsed();
+
+  std::vector<std::vector<gx::IndexedPrimitive>> prims(lists.size());
+  std::vector<gpu::MeshDisplayList> jobs;
+  for (size_t i = 0; i < lists.size(); ++i) {
+    jobs.push_back({.data = std::span(bytes).subspan(lists[i].start,
+                                                     lists[i].size),
+                    .descriptor = lists[i].descriptor,
+                    .primitives = &prims[i]});
+  }
+  u32 ms[2]{};
+  u32 mismatches = 0;
+  for (unsigned threads : {1u, 0u}) {
+    gpu::VertexBufferUsage usage;
+    timer.reset();
+    for (u32 it = 0; it < iterations; ++it) {
+      for (auto& p : prims)
+        p.clear();
+      usage = {};
+      (void)gpu::DecodeMeshDisplayLists(jobs, &usage, threads);
+    }
+    ms[threads == 0] = timer.elapsed();
+    for (size_t i = 0; i < lists.size(); ++i) {
+      // Decoding each list on its own also checks its error
+      std::vector<gx::IndexedPrimitive> p;
+      const auto layout = gpu::VertexLayout::make(*lists[i].descriptor);
+      const bool ok =
+          layout && gpu::DecodeMeshDisplayList(jobs[i].data, *layout, p);
+      if (ok != ref_ok[i] ||
+          (ok && (p != ref_prims[i] || prims[i] != ref_prims[i]))) {
+        ++mismatches;
+      }
+    }
+    gpu::VertexBufferUsage expected_usage;
+    for (auto [attr, max] : ref_usage) {
+      expected_usage.maxIndex[static_cast<size_t>(attr)] = max;
+    }
+    if (usage != expected_usage) {
+      ++mismatches;
+    }
+  }
+  const double mb = static_cast<double>(bytes.size()) * iterations / 1e6;
+  printf("%s: %zu display lists, %zu bytes\n", path.c_str(), lists.size(),
+         bytes.size());
+  printf("Reference: %.1f MB/s, one thread: %.1f MB/s, parallel: %.1f MB/s, "
+         "%u mismatches\n",
+         mb * 1000.0 / std::max(ref_ms, 1u), mb * 1000.0 / std::max(ms[0], 1u),
+         mb * 1000.0 / std::max(ms[1], 1u), mismatches);
+}
+
+void benchShaders(const std::string& path, u32 iterations) {
+  auto result = open(path);
+  if (!result) {
+    fprintf(stderr, "Error: Cannot read %s\n", path.c_str());
+    return;
+  }
+  auto* scene = dynamic_cast<libcube::Scene*>(result->first.get());
+  if (scene == nullptr) {
+    fprintf(stderr, "Error: %s has no models\n", path.c_str());
+    return;
+  }
+  std::vector<const libcube::IGCMaterial*> mats;
+  for (auto& model : scene->getModels()) {
+    for (auto& mat : model.getMaterials()) {
+      mats.push_back(&mat);
+    }
+  }
+  // Every material, every time
+  rsl::Timer timer;
+  for (u32 i = 0; i < iterations; ++i) {
+    for (auto* mat : mats) {
+      (void)librii::gl::compileShader(mat->getMaterialData(), mat->getName());
+    }
+  }
+  const u32 per_material_ms = timer.elapsed();
+  // Once per key, on every core
+  size_t programs = 0;
+  timer.reset();
+  for (u32 i = 0; i < iterations; ++i) {
+    librii::glhelper::ShaderCache cache("");
+    std::vector<librii::gl::ShaderKey> keys;
+    for (auto* mat : mats) {
+      keys.push_back(librii::gl::ShaderKey::make(mat->getMaterialData()));
+    }
+    cache.prepare(keys);
+    std::set<std::string> hashes;
+    for (auto& key : keys) {
+      hashes.insert(key.hash);
+    }
+    programs = hashes.size();
+  }
+  const u32 keyed_ms = timer.elapsed();
+  // A key must hold everything the generator reads
+  u32 mismatches = 0;
+  librii::glhelper::ShaderCache cache("");
+  for (auto* mat : mats) {
+    const auto key = librii::gl::ShaderKey::make(mat->getMaterialData());
+    auto expected =
+        librii::gl::compileShader(mat->getMaterialData(), key.hash);
+    auto sources = cache.sources(key);
+    if (expected.has_value() != sources.has_value() ||
+        (expected && ((*sources)->vertex != expected->vertex ||
+                      (*sources)->fragment != expected->fragment))) {
+      ++mismatches;
+    }
+  }
+  printf("%s: %zu materials, %zu programs\n", path.c_str(), mats.size(),
+         programs);
+  printf("Per material: %.3f ms, keyed: %.3f ms, %u mismatches\n",
+         static_cast<double>(per_material_ms) / iterations,
+         static_cast<double>(keyed_ms) / iterations, mismatches);
+}
+
 extern bool gTestMode;
 
 #define ANNOUNCE(TITLE) printf("------\n" TITLE "\n\n")
@@ -234,7 +1262,46 @@ int main(int argc, const char** argv) {
   ANNOUNCE("Performing tasks");
   if (argc < 3) {
     fprintf(stderr,
-            "Error: Too few arguments:\ntests.exe <from> <to> [check?]\n");
+            "Error: Too few arguments:\ntests.exe <from> <to> [check?]\n"
+            "tests.exe bench-read <from.brres> [iterations]\n"
+            "tests.exe bench-write <from> [iterations]\n"
+            "tests.exe bench-szs <from> [iterations]\n"
+            "tests.exe bench-kcl <from.kcl> [iterations]\n"
+            "tests.exe bench-cmpr <folder of .png> [iterations]\n"
+            "tests.exe bench-palette <folder of .png> [iterations]\n"
+            "tests.exe bench-mip <image> [iterations]\n"
+            "tests.exe bench-decode <from> [iterations]\n"
+            "tests.exe bench-history <from.kmp> [edits]\n"
+            "tests.exe bench-skeleton <from> [iterations]\n"
+            "tests.exe bench-anim <from.brres|.btk> [iterations]\n"
+            "tests.exe bench-dl <from> [iterations]\n"
+            "tests.exe bench-shader <from> [iterations]\n");
+  } else if (!strcmp(argv[1], "bench-read")) {
+    benchRead(argv[2], argc > 3 ? std::stoi(argv[3]) : 100);
+  } else if (!strcmp(argv[1], "bench-write")) {
+    benchWrite(argv[2], argc > 3 ? std::stoi(argv[3]) : 100);
+  } else if (!strcmp(argv[1], "bench-szs")) {
+    benchSzs(argv[2], argc > 3 ? std::stoi(argv[3]) : 10);
+  } else if (!strcmp(argv[1], "bench-kcl")) {
+    benchKcl(argv[2], argc > 3 ? std::stoi(argv[3]) : 10);
+  } else if (!strcmp(argv[1], "bench-cmpr")) {
+    benchCmpr(argv[2], argc > 3 ? std::stoi(argv[3]) : 1);
+  } else if (!strcmp(argv[1], "bench-palette")) {
+    benchPalette(argv[2], argc > 3 ? std::stoi(argv[3]) : 1);
+  } else if (!strcmp(argv[1], "bench-mip")) {
+    benchMip(argv[2], argc > 3 ? std::stoi(argv[3]) : 10);
+  } else if (!strcmp(argv[1], "bench-decode")) {
+    benchDecode(argv[2], argc > 3 ? std::stoi(argv[3]) : 10);
+  } else if (!strcmp(argv[1], "bench-history")) {
+    benchHistory(argv[2], argc > 3 ? std::stoi(argv[3]) : 10000);
+  } else if (!strcmp(argv[1], "bench-skeleton")) {
+    benchSkeleton(argv[2], argc > 3 ? std::stoi(argv[3]) : 100);
+  } else if (!strcmp(argv[1], "bench-anim")) {
+    benchAnim(argv[2], argc > 3 ? std::stoi(argv[3]) : 100);
+  } else if (!strcmp(argv[1], "bench-dl")) {
+    benchDisplayList(argv[2], argc > 3 ? std::stoi(argv[3]) : 100);
+  } else if (!strcmp(argv[1], "bench-shader")) {
+    benchShaders(argv[2], argc > 3 ? std::stoi(argv[3]) : 10);
   } else {
     std::vector<s32> bps;
     for (int i = 4; i < argc; ++i) {
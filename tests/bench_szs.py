@@ -0,0 +1,87 @@
+'''
+SZS throughput benchmark:
+Compress every sample at every level, check it round-trips through
+`rszst decompress` and report ratio and MB/s (for both directions).
+
+.szs inputs are decompressed first, so their payload is what gets measured.
+A per-level summary at the end helps pick the level for a build.
+'''
+
+import os
+import sys
+import time
+from subprocess import Popen, PIPE
+
+# level: [input bytes, output bytes, encode seconds, decode seconds]
+TOTALS = {}
+
+LEVELS = ["store", "fast", "bmh", "lazy", "ultra"]
+
+def run(args):
+	process = Popen(args, stdout=PIPE, stderr=PIPE)
+	(output, err) = process.communicate()
+	if process.wait():
+		print(output, err)
+		raise RuntimeError("Failed: %s" % ' '.join(args))
+
+def read(path):
+	with open(path, "rb") as file:
+		return file.read()
+
+def bench_file(rszst, path, out, jobs):
+	name = os.path.basename(path)
+	raw = os.path.join(out, name + ".raw")
+	if path.endswith(".szs"):
+		run([rszst, "decompress", path, raw])
+	else:
+		with open(raw, "wb") as file:
+			file.write(read(path))
+	expected = read(raw)
+	if not len(expected):
+		return
+
+	for level in LEVELS:
+		szs = os.path.join(out, "%s.%s.szs" % (name, level))
+		dec = os.path.join(out, "%s.%s.arc" % (name, level))
+
+		begin = time.perf_counter()
+		run([rszst, "compress", raw, szs, "--level", level, "--jobs", str(jobs)])
+		seconds = time.perf_counter() - begin
+
+		begin = time.perf_counter()
+		run([rszst, "decompress", szs, dec])
+		decode_seconds = time.perf_counter() - begin
+		ok = read(dec) == expected
+
+		size = len(read(szs))
+		totals = TOTALS.setdefault(level, [0, 0, 0.0, 0.0])
+		totals[0] += len(expected)
+		totals[1] += size
+		totals[2] += seconds
+		totals[3] += decode_seconds
+		mb = len(expected) / 1000000.0
+		print("%-32s %-8s %10d -> %10d (%5.1f%%) enc %8.2f MB/s dec %8.2f MB/s %s" % (
+		      name, level, len(expected), size, 100.0 * size / len(expected),
+		      mb / seconds, mb / decode_seconds, "OK" if ok else "MISMATCH"))
+
+if len(sys.argv) < 4:
+	print("Usage: bench_szs.py <rszst.exe> <input_folder> <output_folder> [jobs]")
+	sys.exit(1)
+
+rszst, data, out = sys.argv[1], sys.argv[2], sys.argv[3]
+jobs = int(sys.argv[4]) if len(sys.argv) > 4 else 0
+if not os.path.isdir(out):
+	os.mkdir(out)
+for file in sorted(os.listdir(data)):
+	path = os.path.join(data, file)
+	if os.path.isfile(path):
+		bench_file(rszst, path, out, jobs)
+
+print()
+for level in LEVELS:
+	if level in TOTALS:
+		src, dst, seconds, decode_seconds = TOTALS[level]
+		mb = src / 1000000.0
+		print("%-8s %12d bytes (%5.1f%%) enc %8.2f s %8.2f MB/s dec %8.2f MB/s" % (
+		      level, dst, 100.0 * dst / src, seconds, mb / seconds,
+		      mb / decode_seconds))
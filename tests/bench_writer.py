@@ -0,0 +1,66 @@
+'''
+Writer benchmark:
+Rebuild every BRRES/BMD/BDL sample with two builds of `tests` (e.g. before and
+after a change to oishii::Writer) and compare wall-clock times.
+
+Each file is rebuilt [runs] times per build and the fastest run is kept, so
+process startup noise mostly cancels out. Outputs of both builds must match.
+'''
+
+import os
+import sys
+import time
+from hashlib import md5
+from subprocess import Popen, PIPE
+
+EXTENSIONS = (".brres", ".bmd", ".bdl")
+
+def hash(path):
+	with open(path, "rb") as file:
+		return md5(file.read()).hexdigest()
+
+def rebuild(test_exec, input_path, output_path):
+	if os.path.isfile(output_path):
+		os.remove(output_path)
+	args = [test_exec, input_path, output_path, ""]
+	begin = time.perf_counter()
+	process = Popen(args, stdout=PIPE, stderr=PIPE)
+	(output, err) = process.communicate()
+	seconds = time.perf_counter() - begin
+	if process.wait() or not os.path.isfile(output_path):
+		print(output, err)
+		raise RuntimeError("Failed: %s" % ' '.join(args))
+	return seconds
+
+def best_of(test_exec, input_path, output_path, runs):
+	return min(rebuild(test_exec, input_path, output_path) for _ in range(runs))
+
+if len(sys.argv) < 5:
+	print("Usage: bench_writer.py <old_tests.exe> <new_tests.exe> <input_folder> <output_folder> [runs]")
+	sys.exit(1)
+
+old_exec, new_exec, data, out = sys.argv[1:5]
+runs = int(sys.argv[5]) if len(sys.argv) > 5 else 5
+if not os.path.isdir(out):
+	os.mkdir(out)
+
+total_old = 0.0
+total_new = 0.0
+for file in sorted(os.listdir(data)):
+	path = os.path.join(data, file)
+	if not os.path.isfile(path) or not file.endswith(EXTENSIONS):
+		continue
+	old_out = os.path.join(out, "old_" + file)
+	new_out = os.path.join(out, "new_" + file)
+	old = best_of(old_exec, path, old_out, runs)
+	new = best_of(new_exec, path, new_out, runs)
+	total_old += old
+	total_new += new
+	same = hash(old_out) == hash(new_out)
+	print("%-48s old %8.1f ms new %8.1f ms (%5.2fx) %s" % (
+	      file, old * 1000, new * 1000, old / new, "OK" if same else "MISMATCH"))
+
+if total_new:
+	print()
+	print("%-48s old %8.1f ms new %8.1f ms (%5.2fx)" % (
+	      "TOTAL", total_old * 1000, total_new * 1000, total_old / total_new))
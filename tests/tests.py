@@ -85,6 +85,11 @@ TEST_DATA = {
 	'8d3255359e750f3900e6928c40b05da1': '8d3255359e750f3900e6928c40b05da1', # old_House_ds
 }
 
+# Rebuilding the output of these formats again must reproduce it exactly. The
+# BMD/BDL writers deduplicate section data through intern pools; a pool that
+# picks a different entry changes the second rebuild.
+STABLE_REBUILD_EXTENSIONS = ('.bmd', '.bdl')
+
 BREAKPOINTS = {
   '8e882b37c306c0f98f3f08363ba61e31': [ ]
 }
@@ -130,6 +135,21 @@ def rebuild(test_exec, rszst, input_path, output_path, check, bps):
 		print(' '.join(args))
 		raise RuntimeError(err)
 
+def check_stable_rebuild(test_exec, rszst, path, rebuild_path, first_hash):
+	second_path = add_to_name(rebuild_path, "_2")
+	rebuild(test_exec, rszst, rebuild_path, second_path, True, [])
+	if not os.path.isfile(second_path):
+		print("Error: %s Rebuilding twice did not produce any file" % pretty_path(path))
+		return
+
+	second = hash(second_path)
+	if second != first_hash:
+		print("Error: %s: Second rebuild does not match the first!" % pretty_path(path))
+		print("--> Expected: %s" % first_hash)
+		print("--> Actual:   %s" % second)
+	else:
+		print("%s: Stable rebuild" % pretty_path(path))
+
 def run_test(test_exec, rszst, path, out_path):
 	md5 = hash(path)
 	expected = "<None>"
@@ -161,6 +181,8 @@ def run_test(test_exec, rszst, path, out_path):
 		print("--> Actual:   %s" % actual)
 	else:
 		print("%s: Success" % pretty_path(path))
+		if path.endswith(STABLE_REBUILD_EXTENSIONS):
+			check_stable_rebuild(test_exec, rszst, path, rebuild_path, actual)
 
 	# os.remove(rebuild_path)
 